@@ -1,10 +1,12 @@
 #pragma once
+#include <algorithm>
 #include <array>
 #include <concepts>
 #include <cassert>
 #include <cmath>
 #include <chrono>
 #include <variant>
+#include <vector>
 #include "math.hpp"
 #include "matrix.hpp"
 #include "sharedTypes.hpp"
@@ -387,4 +389,164 @@ namespace my_gl {
         // make sence only with pause / play system
         // bool                                _is_paused{ false };
     };
+
+    enum class Interpolation {
+        STEP,
+        LINEAR,
+        // every key holds in tangent, value, out tangent
+        CUBIC_SPLINE
+    };
+
+    // sampled keyframes of one transformation, e.g. a glTF animation channel
+    // TRANSLATION and SCALING keys are vec3, ROTATION3d keys unit quaternions (x, y, z, w)
+    // updated like Animation, so both can sit in the same TransformsByType
+    template<std::floating_point T>
+    struct KeyframeTrack {
+        // matrix at the current time
+        math::Matrix44<T>& update() {
+            const std::size_t width{ _anim_type == math::TransformationType::ROTATION3d ? 4u : 3u };
+            const std::size_t stride{ _interpolation == Interpolation::CUBIC_SPLINE ? width * 3 : width };
+            const std::size_t key_count{ _times.size() };
+            if (key_count == 0 || _values.size() < key_count * stride) {
+                return _mat;
+            }
+            // tangents come before the value of a cubic key
+            const std::size_t value_offset{ _interpolation == Interpolation::CUBIC_SPLINE ? width : 0u };
+
+            T value[4];
+            const T time{ _curr_time.count() };
+            const std::size_t next{ static_cast<std::size_t>(std::upper_bound(_times.begin(), _times.end(), time) - _times.begin()) };
+            if (next == 0 || next == key_count || _interpolation == Interpolation::STEP) {
+                const std::size_t key{ next == 0 ? 0 : next - 1 };
+                std::copy_n(&_values[key * stride + value_offset], width, value);
+            }
+            else {
+                const std::size_t prev{ next - 1 };
+                const T span{ _times[next] - _times[prev] };
+                const T s{ span > T(0) ? (time - _times[prev]) / span : T(0) };
+                const T* a{ &_values[prev * stride + value_offset] };
+                const T* b{ &_values[next * stride + value_offset] };
+
+                if (_interpolation == Interpolation::CUBIC_SPLINE) {
+                    // hermite: out tangent of the previous key, in tangent of the next one
+                    const T* a_out{ a + width };
+                    const T* b_in{ b - width };
+                    const T s2{ s * s };
+                    const T s3{ s2 * s };
+                    for (std::size_t c = 0; c < width; ++c) {
+                        value[c] = (2 * s3 - 3 * s2 + 1) * a[c] + (s3 - 2 * s2 + s) * span * a_out[c]
+                            + (-2 * s3 + 3 * s2) * b[c] + (s3 - s2) * span * b_in[c];
+                    }
+                }
+                else if (width == 4) {
+                    slerp(a, b, s, value);
+                }
+                else {
+                    for (std::size_t c = 0; c < width; ++c) {
+                        value[c] = math::Global::lerp(a[c], b[c], s);
+                    }
+                }
+            }
+
+            _mat = math::Matrix44<T>::identity_new();
+            switch (_anim_type) {
+                case math::TransformationType::TRANSLATION:
+                    _mat.translate(math::Vec3<T>{ value[0], value[1], value[2] });
+                    break;
+                case math::TransformationType::SCALING:
+                    _mat.scale(math::Vec3<T>{ value[0], value[1], value[2] });
+                    break;
+                case math::TransformationType::ROTATION3d:
+                    set_rotation(_mat, value);
+                    break;
+                default:
+                    assert(false && "keyframe tracks only translate, rotate and scale");
+                    break;
+            }
+            return _mat;
+        }
+
+        // should be called at the end of the current frame
+        void update_time(Duration_sec frame_time) {
+            if (_is_reversed) {
+                frame_time *= -1.0f;
+            }
+            _curr_time += frame_time;
+
+            if (_duration.count() <= 0.0f) {
+                _curr_time = Duration_sec{ 0.0f };
+                return;
+            }
+            if (_curr_time >= _duration) {
+                if (_loop == Loop_type::NONE) {
+                    _curr_time = _duration;
+                }
+                else if (_loop == Loop_type::DEFAULT) {
+                    _curr_time = Duration_sec{ std::fmod(_curr_time.count(), _duration.count()) };
+                }
+                else {
+                    _curr_time = _duration;
+                    _is_reversed = !_is_reversed;
+                }
+            }
+            else if (_curr_time.count() < 0.0f && _loop == Loop_type::INVERT) {
+                _curr_time = Duration_sec{ 0.0f };
+                _is_reversed = !_is_reversed;
+            }
+        }
+
+        // shortest arc, falls back to a normalized lerp for nearly equal rotations
+        static void slerp(const T* a, const T* b, T s, T* out) {
+            T cos_angle{ a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] };
+            const T sign{ cos_angle < T(0) ? T(-1) : T(1) };
+            cos_angle *= sign;
+
+            T weight_a{ T(1) - s };
+            T weight_b{ s };
+            if (cos_angle < T(0.9995)) {
+                const T angle{ std::acos(cos_angle) };
+                const T inv_sin{ T(1) / std::sin(angle) };
+                weight_a = std::sin(weight_a * angle) * inv_sin;
+                weight_b = std::sin(weight_b * angle) * inv_sin;
+            }
+
+            T length{ 0 };
+            for (int c = 0; c < 4; ++c) {
+                out[c] = weight_a * a[c] + weight_b * sign * b[c];
+                length += out[c] * out[c];
+            }
+            length = std::sqrt(length);
+            for (int c = 0; c < 4 && length > T(0); ++c) {
+                out[c] /= length;
+            }
+        }
+
+        // unit quaternion (x, y, z, w) into the upper 3x3 of 'mat'
+        static void set_rotation(math::Matrix44<T>& mat, const T* q) {
+            const T length{ std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]) };
+            const T inv_length{ length > T(0) ? T(1) / length : T(0) };
+            const T x{ q[0] * inv_length }, y{ q[1] * inv_length }, z{ q[2] * inv_length }, w{ length > T(0) ? q[3] * inv_length : T(1) };
+            mat.at(0, 0) = 1 - 2 * (y * y + z * z);
+            mat.at(0, 1) = 2 * (x * y - w * z);
+            mat.at(0, 2) = 2 * (x * z + w * y);
+            mat.at(1, 0) = 2 * (x * y + w * z);
+            mat.at(1, 1) = 1 - 2 * (x * x + z * z);
+            mat.at(1, 2) = 2 * (y * z - w * x);
+            mat.at(2, 0) = 2 * (x * z - w * y);
+            mat.at(2, 1) = 2 * (y * z + w * x);
+            mat.at(2, 2) = 1 - 2 * (x * x + y * y);
+        }
+
+        // key times in seconds, ascending
+        std::vector<T>                      _times;
+        std::vector<T>                      _values;
+        math::Matrix44<T>                   _mat{ math::Matrix44<T>::identity_new() };
+        // loop length, the one of the whole clip so tracks of it stay in step
+        Duration_sec                        _duration{ 0.0f };
+        Duration_sec                        _curr_time{ 0.0f };
+        math::TransformationType            _anim_type{ math::TransformationType::TRANSLATION };
+        Interpolation                       _interpolation{ Interpolation::LINEAR };
+        Loop_type                           _loop{ Loop_type::DEFAULT };
+        bool                                _is_reversed{ false };
+    };
 }
@@ -0,0 +1,104 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "meshes.hpp"
+#include "renderer.hpp"
+#include "texture.hpp"
+
+namespace my_gl {
+    class TextureLoader;
+
+    // one gl object per distinct content: assets are keyed by the hash of what their files contain (plus the
+    // options that end up in the gl object), so the same image under two paths or two requests of one shader pair
+    // share it; paths remember their hash until the file's size or write time changes
+    // handles are reference counted, an asset nobody holds stays cached until the budget needs its memory,
+    // least recently used first; assets still held are never evicted, so the budget can be exceeded
+    // gl thread only
+    class AssetCache {
+    public:
+        struct Stats {
+            uint32_t        hits{ 0 };
+            uint32_t        misses{ 0 };
+            uint32_t        evictions{ 0 };
+            // requests whose files couldn't be read, built without caching
+            uint32_t        uncached{ 0 };
+            uint32_t        entries{ 0 };
+            // gpu memory estimate of every cached asset, held or not, as of the last insert or trim
+            std::size_t     resident_bytes{ 0 };
+        };
+
+        explicit AssetCache(std::size_t budget_bytes = 256u << 20);
+        AssetCache(const AssetCache& rhs) = delete;
+        AssetCache& operator=(const AssetCache& rhs) = delete;
+
+        // Texture is itself a handle, copies share the gl texture; requests with another unit or sampler share it too
+        // decoded through 'loader' when given (see Texture), right away otherwise
+        Texture texture(
+            const char* path,
+            const Program& program,
+            const Uniform* const sampler_uniform,
+            uint32_t sampler_uniform_value,
+            GLenum texture_unit,
+            GLenum wrap_option = GL_REPEAT,
+            GLenum min_filter_option = GL_LINEAR_MIPMAP_LINEAR,
+            GLenum mag_filter_option = GL_LINEAR,
+            TextureLoader* loader = nullptr
+        );
+        // the attributes and uniforms are part of the key, shaders requested with other ones compile again
+        std::shared_ptr<const Program> program(
+            const char*                 vertex_shader_path,
+            const char*                 fragment_shader_path,
+            std::vector<Attribute>&&    attribs,
+            std::vector<Uniform>&&      uniforms = {}
+        );
+        // attribute locations come from 'programs', their attribute bindings are part of the key
+        std::shared_ptr<const VertexArray> mesh(meshes::MeshView mesh, const std::vector<const Program*>& programs);
+        // a Wavefront OBJ through meshes::load_obj
+        std::shared_ptr<const VertexArray> mesh(const char* obj_path, const std::vector<const Program*>& programs);
+
+        // evicts assets nobody holds until the cache fits 'budget_bytes'
+        void            trim();
+        void            set_budget(std::size_t budget_bytes);
+        std::size_t     get_budget() const { return _budget; }
+        const Stats&    get_stats() const { return _stats; }
+
+    private:
+        struct Entry {
+            uint64_t                    key;
+            // the State of textures, the Program or VertexArray otherwise
+            std::shared_ptr<const void> object;
+            // textures handed out for other units or samplers are made from this one
+            std::optional<Texture>      texture;
+            std::size_t                 bytes{ 0 };
+        };
+
+        struct PathHash {
+            std::uintmax_t                      size;
+            std::filesystem::file_time_type     write_time;
+            uint64_t                            hash;
+        };
+
+        // 0 if the file can't be read
+        uint64_t        content_hash(const char* path);
+        // moves a hit to the front of the lru list, nullptr on a miss
+        Entry*          find(uint64_t key);
+        void            insert(Entry&& entry);
+        bool            is_held(const Entry& entry) const;
+        std::size_t     entry_bytes(const Entry& entry) const;
+
+        // most recently used first
+        std::list<Entry>                                            _lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator>    _entries;
+        std::unordered_map<std::string, PathHash>                   _path_hashes;
+        std::size_t                                                 _budget;
+        Stats                                                       _stats;
+    };
+}
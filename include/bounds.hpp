@@ -0,0 +1,165 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "matrix.hpp"
+
+namespace my_gl {
+    namespace math {
+        // plain float storage on purpose: bounds are tested thousands of times per frame,
+        // VecBase allocates through std::valarray on every copy
+        struct Aabb {
+            float min[3]{  std::numeric_limits<float>::max(),  std::numeric_limits<float>::max(),  std::numeric_limits<float>::max() };
+            float max[3]{ -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+            bool is_empty() const {
+                return min[0] > max[0] || min[1] > max[1] || min[2] > max[2];
+            }
+
+            void expand(const float* point) {
+                for (int i = 0; i < 3; ++i) {
+                    min[i] = std::min(min[i], point[i]);
+                    max[i] = std::max(max[i], point[i]);
+                }
+            }
+
+            void expand(const Aabb& rhs) {
+                for (int i = 0; i < 3; ++i) {
+                    min[i] = std::min(min[i], rhs.min[i]);
+                    max[i] = std::max(max[i], rhs.max[i]);
+                }
+            }
+
+            float center(int axis) const {
+                return (min[axis] + max[axis]) * 0.5f;
+            }
+
+            float extent(int axis) const {
+                return max[axis] - min[axis];
+            }
+
+            float surface_area() const {
+                if (is_empty()) {
+                    return 0.0f;
+                }
+                const float dx{ extent(0) };
+                const float dy{ extent(1) };
+                const float dz{ extent(2) };
+                return 2.0f * (dx * dy + dy * dz + dz * dx);
+            }
+
+            bool overlaps(const Aabb& rhs) const {
+                return min[0] <= rhs.max[0] && max[0] >= rhs.min[0]
+                    && min[1] <= rhs.max[1] && max[1] >= rhs.min[1]
+                    && min[2] <= rhs.max[2] && max[2] >= rhs.min[2];
+            }
+
+            // Arvo's method, matrix is row-major and multiplies column vectors (same as the shaders)
+            Aabb transform(const Matrix44<float>& m) const {
+                if (is_empty()) {
+                    return *this;
+                }
+
+                Aabb res;
+                for (int r = 0; r < 3; ++r) {
+                    res.min[r] = m.at(r, 3);
+                    res.max[r] = m.at(r, 3);
+                    for (int c = 0; c < 3; ++c) {
+                        const float a{ m.at(r, c) * min[c] };
+                        const float b{ m.at(r, c) * max[c] };
+                        res.min[r] += std::min(a, b);
+                        res.max[r] += std::max(a, b);
+                    }
+                }
+                return res;
+            }
+        };
+
+        struct Ray {
+            float origin[3];
+            float dir[3];
+        };
+
+        // plane: dot(n, p) + d >= 0 means inside
+        struct Plane {
+            float n[3];
+            float d;
+        };
+
+        struct Frustum {
+            enum Side { LEFT, RIGHT, BOTTOM, TOP, NEAR, FAR, COUNT };
+
+            Frustum() = default;
+
+            // Gribb/Hartmann plane extraction from the rows of proj * view
+            explicit Frustum(const Matrix44<float>& view_proj) {
+                for (int i = 0; i < 3; ++i) {
+                    const float sign_rows[2]{ 1.0f, -1.0f };
+                    for (int s = 0; s < 2; ++s) {
+                        Plane& plane{ planes[i * 2 + s] };
+                        for (int c = 0; c < 3; ++c) {
+                            plane.n[c] = view_proj.at(3, c) + sign_rows[s] * view_proj.at(i, c);
+                        }
+                        plane.d = view_proj.at(3, 3) + sign_rows[s] * view_proj.at(i, 3);
+
+                        const float len{ std::sqrt(plane.n[0] * plane.n[0] + plane.n[1] * plane.n[1] + plane.n[2] * plane.n[2]) };
+                        if (len > 0.0f) {
+                            const float inv_len{ 1.0f / len };
+                            plane.n[0] *= inv_len;
+                            plane.n[1] *= inv_len;
+                            plane.n[2] *= inv_len;
+                            plane.d *= inv_len;
+                        }
+                    }
+                }
+            }
+
+            bool intersects(const Aabb& box) const {
+                for (const Plane& plane : planes) {
+                    // vertex furthest along the plane normal
+                    const float px{ plane.n[0] >= 0.0f ? box.max[0] : box.min[0] };
+                    const float py{ plane.n[1] >= 0.0f ? box.max[1] : box.min[1] };
+                    const float pz{ plane.n[2] >= 0.0f ? box.max[2] : box.min[2] };
+                    if (plane.n[0] * px + plane.n[1] * py + plane.n[2] * pz + plane.d < 0.0f) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            bool intersects_sphere(const float* center, float radius) const {
+                for (const Plane& plane : planes) {
+                    if (plane.n[0] * center[0] + plane.n[1] * center[1] + plane.n[2] * center[2] + plane.d < -radius) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            Plane planes[COUNT];
+        };
+
+        // slab test, returns entry distance through t_hit
+        inline bool ray_intersects(const Ray& ray, const Aabb& box, float t_max, float& t_hit) {
+            float t_near{ 0.0f };
+            float t_far{ t_max };
+
+            for (int i = 0; i < 3; ++i) {
+                const float inv_dir{ 1.0f / ray.dir[i] };
+                float t0{ (box.min[i] - ray.origin[i]) * inv_dir };
+                float t1{ (box.max[i] - ray.origin[i]) * inv_dir };
+                if (t0 > t1) {
+                    std::swap(t0, t1);
+                }
+                t_near = std::max(t_near, t0);
+                t_far = std::min(t_far, t1);
+                if (t_near > t_far) {
+                    return false;
+                }
+            }
+
+            t_hit = t_near;
+            return true;
+        }
+    }
+}
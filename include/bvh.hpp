@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "bounds.hpp"
+
+namespace my_gl {
+    // 4-wide bounding volume hierarchy over world-space boxes
+    // items are indices into a bounds array owned by the caller, several trees may share one array
+    class Bvh {
+    public:
+        static constexpr uint32_t invalid_child{ 0xFFFFFFFF };
+        static constexpr uint32_t max_leaf_size{ 4 };
+
+        // children bounds stored as SoA, one SIMD lane per child
+        struct alignas(16) Node {
+            float       min_x[4];
+            float       min_y[4];
+            float       min_z[4];
+            float       max_x[4];
+            float       max_y[4];
+            float       max_z[4];
+            // count == 0: child is a node index, count > 0: child is the first item of a leaf
+            uint32_t    child[4];
+            uint32_t    count[4];
+        };
+
+        struct RayHit {
+            uint32_t    item{ invalid_child };
+            float       t{ 0.0f };
+        };
+
+        Bvh() = default;
+
+        // SAH build over 'item_ids', each id indexes into 'bounds'
+        void    build(const std::vector<math::Aabb>& bounds, const std::vector<uint32_t>& item_ids);
+        // recompute node boxes from moved items, topology stays the same
+        void    refit(const std::vector<math::Aabb>& bounds);
+        // refit, then rebuild when the tree quality dropped too much or too many refits happened
+        void    update(const std::vector<math::Aabb>& bounds);
+
+        void    query_frustum(const math::Frustum& frustum, std::vector<uint32_t>& out) const;
+        void    query_overlap(const math::Aabb& box, std::vector<uint32_t>& out) const;
+        void    query_ray(const math::Ray& ray, float t_max, std::vector<uint32_t>& out) const;
+        RayHit  raycast(const math::Ray& ray, float t_max) const;
+
+        float   sah_cost() const;
+        bool    empty() const { return _nodes.empty(); }
+        const std::vector<Node>& get_nodes() const { return _nodes; }
+
+        // rebuild once the SAH cost grows by this factor relative to the last build
+        float       rebuild_cost_ratio{ 1.5f };
+        // rebuild at least this often for animated content, 0 disables
+        uint32_t    rebuild_interval{ 600 };
+
+    private:
+        struct BuildNode {
+            math::Aabb  bounds;
+            uint32_t    left{ invalid_child };
+            uint32_t    right{ invalid_child };
+            uint32_t    first{ 0 };
+            uint32_t    count{ 0 };
+        };
+
+        uint32_t    build_recursive(const std::vector<math::Aabb>& bounds, std::vector<BuildNode>& build_nodes, uint32_t first, uint32_t count);
+        uint32_t    collapse(const std::vector<BuildNode>& build_nodes, uint32_t build_index);
+        void        set_slot(Node& node, int slot, const math::Aabb& box, uint32_t child, uint32_t count);
+        math::Aabb  node_bounds(const Node& node) const;
+
+        std::vector<Node>       _nodes;
+        std::vector<uint32_t>   _items;
+        // copy of the item boxes in leaf order, so leaf tests read contiguous memory
+        std::vector<math::Aabb> _item_bounds;
+        math::Aabb              _root_bounds;
+        float                   _build_cost{ 0.0f };
+        uint32_t                _refits_since_build{ 0 };
+    };
+}
@@ -3,8 +3,12 @@
 #include <cstddef>
 #include <vector>
 #include "animation.hpp"
+#include "bounds.hpp"
 #include "matrix.hpp"
+#include "meshLod.hpp"
+#include "meshlets.hpp"
 #include "texture.hpp"
+#include "textureArrays.hpp"
 #include "sharedTypes.hpp"
 
 namespace my_gl {
@@ -16,7 +20,8 @@ namespace my_gl {
         TransformsByType(
             math::TransformationType                        arg_type,
             std::vector<math::Transformation<float>>&&      arg_transforms,
-            std::vector<my_gl::Animation<float>>&&          arg_anims
+            std::vector<my_gl::Animation<float>>&&          arg_anims,
+            std::vector<my_gl::KeyframeTrack<float>>&&      arg_tracks = {}
         );
         TransformsByType(TransformsByType&& rhs) = default;
         TransformsByType& operator=(TransformsByType&& rhs) = default;
@@ -26,6 +31,8 @@ namespace my_gl {
         math::TransformationType                            type;
         std::vector<math::Transformation<float>>            transforms;
         std::vector<my_gl::Animation<float>>                anims;
+        // applied after anims
+        std::vector<my_gl::KeyframeTrack<float>>            tracks;
     };
 
     class GeometryObjectPrimitive {
@@ -45,6 +52,8 @@ namespace my_gl {
         ~GeometryObjectPrimitive() = default;
 
         math::Matrix44<float>       get_model_mat();
+        // recomputes the cached model matrix and world bounds, call once per frame for animated primitives
+        void                        update_model_mat();
         void                        bind_state() const;
         void                        un_bind_state() const;
         void                        draw() const;
@@ -54,20 +63,70 @@ namespace my_gl {
         constexpr std::size_t       get_vertices_count() const {
             return _vertices_count;
         }
+        // into the 32 bit indices of the mesh, whatever index type the vao uploaded
         constexpr std::size_t       get_buffer_byte_offset() const {
             return _buffer_byte_offset;
         }
+        // range draw() submits: the current lod, or the whole primitive
+        std::size_t                 get_draw_byte_offset() const { return _lods.empty() ? _buffer_byte_offset : _lods[_curr_lod].buffer_byte_offset; }
+        std::size_t                 get_draw_index_count() const { return _lods.empty() ? _vertices_count : _lods[_curr_lod].index_count; }
+        GLenum                      get_draw_type() const { return _draw_type; }
+        bool                        has_textures() const { return !_textures.empty(); }
+        const std::vector<const my_gl::Texture*>& get_textures() const { return _textures; }
+        // a packed texture instead of bound ones: its unit, layer and uv transform go to the shader per draw
+        // (u_texture_array, u_texture_layer, u_texture_transform) or per object on the gpu driven path, nothing is bound
+        void                        set_texture_slot(const TextureSlot& slot) { _texture_slot = slot; }
+        const TextureSlot&          get_texture_slot() const { return _texture_slot; }
+        // uv units per object space unit of the surface (uv_density in textureStreamer.hpp), 0 leaves the
+        // primitive's textures out of streaming requests
+        void                        set_uv_density(float uv_density) { _uv_density = uv_density; }
+        float                       get_uv_density() const { return _uv_density; }
+        // uv units one screen pixel covers, px_per_unit as for select_lod
+        float                       get_uv_per_px(float px_per_unit) const;
         const Program&              get_program() const { return _program; }
         const VertexArray&          get_vao() const { return _vao; }
+        const math::Aabb&           get_local_bounds() const { return _local_bounds; }
+        const math::Aabb&           get_world_bounds() const { return _world_bounds; }
+        const math::Matrix44<float>& get_curr_model_mat() const { return _model_mat; }
+        bool                        is_animated() const;
+        // large closed primitives that hide others, rasterized by the cpu occlusion culler
+        void                        set_occluder(bool is_occluder) { _is_occluder = is_occluder; }
+        bool                        is_occluder() const { return _is_occluder; }
+        // index ranges of meshes::build_lod_chain, level 0 must be the primitive's own range
+        void                        set_lods(std::vector<meshes::LodLevel>&& lods) { _lods = std::move(lods); _curr_lod = 0; }
+        // px_per_unit: screen pixels covered by one world unit at the primitive's distance
+        void                        select_lod(float px_per_unit, float threshold_px, float hysteresis);
+        uint32_t                    get_curr_lod() const { return _curr_lod; }
+        std::size_t                 get_lod_count() const { return _lods.size(); }
+        // keeps only meshlets of the current lod that are inside the frustum and not facing away from camera_pos (world space),
+        // draw() then submits the surviving index ranges
+        void                        cull_meshlets(const math::Frustum& frustum, const float* camera_pos, meshes::MeshletCullStats& stats);
+        // back to drawing the whole range
+        void                        reset_meshlet_culling() { _meshlets_culled = false; }
 
     private:
+        // length of the shortest and longest basis vector of the model matrix
+        void                        get_axis_scales(float& min_scale, float& max_scale) const;
+
         std::vector<TransformsByType>                       _transforms;
+        math::Matrix44<float>                               _model_mat;
+        math::Aabb                                          _local_bounds;
+        math::Aabb                                          _world_bounds;
         std::vector<const my_gl::Texture*>                  _textures;
+        TextureSlot                                         _texture_slot;
+        float                                               _uv_density{ 0.0f };
         std::size_t                                         _vertices_count;
         std::size_t                                         _buffer_byte_offset;
         const Program&                                      _program;
         const VertexArray&                                  _vao;
         GLenum                                              _draw_type;
+        bool                                                _is_occluder{ false };
+        std::vector<meshes::LodLevel>                       _lods;
+        uint32_t                                            _curr_lod{ 0 };
+        std::vector<GLsizei>                                _draw_counts;
+        std::vector<const void*>                            _draw_offsets;
+        std::vector<GLint>                                  _draw_base_vertices;
+        bool                                                _meshlets_culled{ false };
     };
 
     class GeometryObjectComplex {
@@ -77,6 +136,8 @@ namespace my_gl {
 
         void render(const math::Matrix44<float>& view_mat, const math::Matrix44<float>& view_proj_mat, float time_0to1);
         void update_anims_time(Duration_sec frame_time);
+        std::vector<GeometryObjectPrimitive>&       get_primitives() { return _primitives; }
+        const std::vector<GeometryObjectPrimitive>& get_primitives() const { return _primitives; }
     private:
         std::vector<GeometryObjectPrimitive> _primitives;
     };
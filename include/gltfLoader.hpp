@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "animation.hpp"
+#include "geometryObject.hpp"
+#include "renderer.hpp"
+
+namespace my_gl {
+    struct GltfLoadOptions {
+        // program attributes the primitive attributes feed, nullptr leaves one out
+        const char*     position_name{ "a_pos" };
+        const char*     texcoord_name{ "a_tex" };
+        const char*     color_name{ "a_color" };
+        const char*     normal_name{ "a_normal" };
+        // index into the file's animations, -1 for a static pose
+        int32_t         animation{ 0 };
+        Loop_type       loop{ Loop_type::DEFAULT };
+    };
+
+    struct GltfModel {
+        // one per mesh primitive, shared by every node instancing the mesh
+        std::vector<std::unique_ptr<VertexArray>>   vaos;
+        // one per root node of the scene, each primitive carries the transforms of the nodes down to it
+        std::vector<GeometryObjectComplex>          objects;
+        std::vector<std::string>                    animation_names;
+    };
+
+    // binary glTF 2.0: vertex attributes and indices are uploaded straight from the mapped file in their stored
+    // component types, only positions and 32 bit indices are kept on the cpu for bounds and culling
+    // primitives missing normals or colors get generated ones (area weighted, material base color)
+    // false if the file isn't a valid glb, unsupported primitives (sparse accessors, external buffers) are skipped
+    // 'model' must outlive whatever renders its objects
+    bool load_glb(const char* path, const Program& program, GltfModel& model, const GltfLoadOptions& options = {});
+}
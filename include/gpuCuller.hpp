@@ -0,0 +1,96 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "bounds.hpp"
+#include "matrix.hpp"
+
+namespace my_gl {
+    class GeometryObjectPrimitive;
+    class Program;
+    class VertexArray;
+
+    // GPU driven path: object matrices and bounds live in an SSBO, a compute shader frustum culls them
+    // and writes DrawElementsIndirectCommands, every (program, vao, texture array) bucket is one glMultiDrawElementsIndirect
+    // objects carry the layer and uv transform of their texture slot, so packed textures don't split buckets further
+    // needs GL 4.3 (compute, multi draw indirect), compacts the command lists with GL 4.6 or ARB_indirect_parameters
+    class GpuCuller {
+    public:
+        // vertex shaders read the object through this instanced attribute, see shaders/vertShaderIndirect.glsl
+        static constexpr GLuint object_id_location{ 15 };
+
+        struct Stats {
+            uint32_t    objects{ 0 };
+            uint32_t    buckets{ 0 };
+            uint32_t    multi_draws{ 0 };
+        };
+
+        static bool is_supported();
+
+        GpuCuller(const char* cull_shader_path = "shaders/compShaderCull.glsl");
+        GpuCuller(const GpuCuller& rhs) = delete;
+        GpuCuller& operator=(const GpuCuller& rhs) = delete;
+        ~GpuCuller();
+
+        // groups the primitives into buckets, the pointers must stay valid until the next build
+        // 'indirect_programs[i]' replaces the program of 'primitives[i]' when drawing
+        void    build(const std::vector<GeometryObjectPrimitive*>& primitives, const std::vector<const Program*>& indirect_programs);
+        // uploads current matrices and bounds, culls on the gpu and submits every bucket
+        void    render(const math::Matrix44<float>& view_mat, const math::Matrix44<float>& view_proj_mat);
+
+        // number of draws that passed culling in the last frame, reads the gpu buffers back so it stalls:
+        // meant for verification (e.g. against the cpu frustum test on llvmpipe), not for every frame
+        uint32_t        read_back_visible_count() const;
+        const Stats&    get_stats() const { return _stats; }
+        bool            empty() const { return _primitives.empty(); }
+
+    private:
+        void    delete_buffers();
+
+        // std430 layout of Object in the shaders
+        struct GpuObject {
+            float       model_mat[16];
+            float       bounds_min[4];
+            float       bounds_max[4];
+            uint32_t    draw[4];
+            // quantized positions of the vao, p = stored * scale + offset
+            float       dequantize_scale[4];
+            float       dequantize_offset[4];
+            // uv scale, uv offset and layer of the texture slot
+            float       texture_transform[4];
+            uint32_t    texture[4];
+        };
+
+        struct DrawCommand {
+            uint32_t    count;
+            uint32_t    instance_count;
+            uint32_t    first_index;
+            int32_t     base_vertex;
+            uint32_t    base_instance;
+        };
+
+        struct Bucket {
+            const Program*      program;
+            const VertexArray*  vao;
+            // of the texture slot, -1 without one
+            int32_t             texture_unit;
+            uint32_t            first_command;
+            uint32_t            command_count;
+        };
+
+        GLuint                                  _cull_program{ 0 };
+        GLint                                   _frustum_planes_loc{ -1 };
+        GLint                                   _object_count_loc{ -1 };
+        GLint                                   _compact_loc{ -1 };
+        GLuint                                  _objects_buffer{ 0 };
+        GLuint                                  _commands_buffer{ 0 };
+        GLuint                                  _draw_counts_buffer{ 0 };
+        GLuint                                  _bucket_offsets_buffer{ 0 };
+        GLuint                                  _object_ids_buffer{ 0 };
+        bool                                    _compact;
+        std::vector<GeometryObjectPrimitive*>   _primitives;
+        std::vector<GpuObject>                  _objects;
+        std::vector<Bucket>                     _buckets;
+        Stats                                   _stats;
+    };
+}
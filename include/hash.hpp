@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace my_gl {
+    // 64 bit hash of a byte range, chain calls through 'seed' to cover several inputs (source file, format, options)
+    uint64_t hash_bytes(const void* data, std::size_t size, uint64_t seed = 0);
+    // hash of a whole file's content, 0 if it can't be read
+    uint64_t hash_file(const char* path, uint64_t seed = 0);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "mappedFile.hpp"
+
+namespace my_gl {
+    // the formats this project writes and reads, by their VkFormat value as KTX2 stores them
+    struct KtxFormat {
+        uint32_t    vk_format;
+        GLenum      gl_internal_format;
+        // 0 for block compressed formats
+        GLenum      gl_pixel_format;
+        // bytes of one texel block, 4x4 blocks for compressed formats, single texels otherwise
+        uint32_t    block_bytes;
+        uint32_t    block_size;
+        int         color_channels;
+    };
+
+    // by extension, anything else goes through stb_image
+    bool                is_ktx2_path(std::string_view path);
+    // nullptr for formats we don't handle
+    const KtxFormat*    find_ktx_format(uint32_t vk_format);
+    std::size_t         ktx_level_bytes(const KtxFormat& format, uint32_t width, uint32_t height);
+
+    // 2d, single layer and face, no supercompression; 'levels' are level 0 first, each ktx_level_bytes long
+    // 'source_hash' goes into the key/value data, see KtxFile::source_hash
+    bool write_ktx2(
+        const char*                                 path,
+        uint32_t                                    vk_format,
+        uint32_t                                    width,
+        uint32_t                                    height,
+        const std::vector<std::vector<uint8_t>>&    levels,
+        uint64_t                                    source_hash
+    );
+
+    // maps a KTX2 file written by write_ktx2 (or any 2d one in a known format without supercompression)
+    // levels point into the mapping, they are valid as long as the object
+    class KtxFile {
+    public:
+        KtxFile() = default;
+        explicit KtxFile(const char* path);
+
+        bool                        is_valid() const { return _format != nullptr; }
+        const KtxFormat&            format() const { return *_format; }
+        uint32_t                    width() const { return _width; }
+        uint32_t                    height() const { return _height; }
+        uint32_t                    level_count() const { return static_cast<uint32_t>(_levels.size()); }
+        std::span<const uint8_t>    level(uint32_t index) const { return _levels[index]; }
+        // hash of the image the file was made from, 0 if it wasn't written by write_ktx2
+        uint64_t                    source_hash() const { return _source_hash; }
+
+    private:
+        MappedFile                              _file;
+        const KtxFormat*                        _format{ nullptr };
+        uint32_t                                _width{ 0 };
+        uint32_t                                _height{ 0 };
+        std::vector<std::span<const uint8_t>>   _levels;
+        uint64_t                                _source_hash{ 0 };
+    };
+}
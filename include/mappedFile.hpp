@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+namespace my_gl {
+    // read only mapping of a whole file, unmapped with the object
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        explicit MappedFile(const char* path);
+        MappedFile(const MappedFile& rhs) = delete;
+        MappedFile& operator=(const MappedFile& rhs) = delete;
+        MappedFile(MappedFile&& rhs) noexcept;
+        MappedFile& operator=(MappedFile&& rhs) noexcept;
+        ~MappedFile();
+
+        // an empty file is open with size 0
+        bool                is_open() const { return _open; }
+        const char*         data() const { return _data; }
+        std::size_t         size() const { return _size; }
+        std::string_view    view() const { return { _data, _size }; }
+
+    private:
+        void close();
+
+        const char*     _data{ nullptr };
+        std::size_t     _size{ 0 };
+        bool            _open{ false };
+    };
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "meshes.hpp"
+#include "meshlets.hpp"
+#include "meshWeld.hpp"
+#include "vertexLayout.hpp"
+
+namespace my_gl {
+    class Program;
+
+    // first fit free list over [0, capacity), neighbouring free blocks are merged on free
+    class RangeAllocator {
+    public:
+        static constexpr uint32_t invalid_offset{ 0xFFFFFFFF };
+
+        explicit RangeAllocator(uint32_t capacity);
+
+        // invalid_offset when no free block is large enough
+        uint32_t    allocate(uint32_t size);
+        void        free(uint32_t offset, uint32_t size);
+        uint32_t    capacity() const { return _capacity; }
+        uint32_t    used() const { return _used; }
+
+    private:
+        struct Block {
+            uint32_t    offset;
+            uint32_t    size;
+        };
+
+        // sorted by offset
+        std::vector<Block>  _free;
+        uint32_t            _capacity;
+        uint32_t            _used{ 0 };
+    };
+
+    // one vbo/ibo pair and one vao shared by every mesh registered in it
+    // meshes come in planar and are converted to the arena layout, every stream of it spans the whole vbo capacity,
+    // so base vertex draws address every attribute of a mesh with the same offset
+    // identical meshes (by content) are stored once and reference counted
+    // indices are mesh relative, one index type for all of them keeps the arena a single multi draw
+    class MeshArena {
+    public:
+        struct Entry {
+            uint64_t                        hash;
+            uint32_t                        base_vertex;
+            uint32_t                        vertex_count;
+            uint32_t                        first_index;
+            uint32_t                        index_count;
+            uint32_t                        references;
+            meshes::Dequantize              dequantize;
+            // the only cpu copy: positions and indices for bounds, meshlets and cpu occlusion
+            std::vector<float>              positions;
+            std::vector<uint32_t>           indices;
+            std::vector<meshes::Meshlet>    meshlets;
+        };
+
+        struct Stats {
+            uint32_t    unique_meshes{ 0 };
+            uint32_t    references{ 0 };
+            uint32_t    vertices_used{ 0 };
+            uint32_t    indices_used{ 0 };
+        };
+
+        // 'format' describes the planar blocks of the registered meshes, positions first,
+        // every attribute of 'programs' is bound to the element of the same name
+        MeshArena(
+            const std::vector<meshes::VertexElement>&   format,
+            meshes::VertexLayoutType                    layout_type,
+            const std::vector<const Program*>&          programs,
+            uint32_t                                    vertex_capacity = 1 << 18,
+            uint32_t                                    index_capacity = 1 << 20,
+            GLenum                                      index_type = GL_UNSIGNED_SHORT
+        );
+        MeshArena(const MeshArena& rhs) = delete;
+        MeshArena& operator=(const MeshArena& rhs) = delete;
+        ~MeshArena();
+
+        // nullptr when the mesh doesn't fit the format or the arena is full
+        const Entry*    acquire(meshes::MeshView mesh);
+        void            release(const Entry* entry);
+
+        void            bind() const { glBindVertexArray(_vao_id); }
+        void            un_bind() const { glBindVertexArray(0); }
+        uint32_t        get_vao_id() const { return _vao_id; }
+        GLenum          get_index_type() const { return _index_type; }
+        const std::vector<meshes::VertexElement>& get_format() const { return _format; }
+        const meshes::VertexLayout& get_layout() const { return _layout; }
+        const std::vector<const Program*>& get_programs() const { return _programs; }
+        Stats           get_stats() const;
+
+    private:
+        std::vector<meshes::VertexElement>                  _format;
+        meshes::VertexLayout                                _layout;
+        std::vector<const Program*>                         _programs;
+        std::size_t                                         _floats_per_vertex;
+        GLenum                                              _index_type;
+        RangeAllocator                                      _vertex_alloc;
+        RangeAllocator                                      _index_alloc;
+        std::unordered_multimap<uint64_t, std::unique_ptr<Entry>> _entries;
+        uint32_t                                            _vao_id{ 0 };
+        uint32_t                                            _vbo_id{ 0 };
+        uint32_t                                            _ibo_id{ 0 };
+    };
+}
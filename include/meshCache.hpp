@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "bounds.hpp"
+#include "hash.hpp"
+#include "meshLod.hpp"
+#include "meshes.hpp"
+#include "renderer.hpp"
+#include "vertexLayout.hpp"
+
+namespace my_gl {
+    // file layout, every section 16 byte aligned and little endian:
+    // header | attribute records | gpu vertices | gpu indices | cpu positions | cpu indices | lod records | meshlets
+    // gpu sections are what glBufferData gets, cpu ones what bounds and culling read, nothing is decoded on load
+    // unless the cache is compressed: vertices and cpu sections then hold meshCodec streams decoded on load
+    // structs are written as laid out in memory, a cache belongs to the machine (and build) that wrote it
+    struct MeshCacheInfo {
+        uint64_t                        source_hash{ 0 };
+        std::size_t                     file_bytes{ 0 };
+        std::size_t                     vertex_count{ 0 };
+        std::size_t                     index_count{ 0 };
+        bool                            compressed{ false };
+        math::Aabb                      bounds;
+        // in the index units of the cached mesh, ready for GeometryObjectPrimitive::set_lods
+        std::vector<meshes::LodLevel>   lods;
+        double                          load_ms{ 0.0 };
+        // part of load_ms, 0 for uncompressed caches
+        double                          decode_ms{ 0.0 };
+    };
+
+    // converts 'mesh' (planar, in 'format') to 'layout' once and writes everything a VertexArray needs
+    // 'lods' index ranges of mesh.indices as build_lod_chain returns them, written next to the meshlets
+    // 'compress' trades a decode pass on load for a file several times smaller, for slow disks and downloads
+    bool write_mesh_cache(
+        const char*                                 path,
+        uint64_t                                    source_hash,
+        const meshes::Mesh&                         mesh,
+        const std::vector<meshes::VertexElement>&   format,
+        const meshes::VertexLayout&                 layout,
+        const std::vector<meshes::LodLevel>&        lods = {},
+        bool                                        compress = false
+    );
+
+    // maps 'path' and uploads its sections as they are, attributes get their locations from 'programs' by name
+    // nullptr if the file is missing, broken, from another version or built from another source than 'source_hash'
+    std::unique_ptr<VertexArray> load_mesh_cache(
+        const char*                                 path,
+        uint64_t                                    source_hash,
+        const std::vector<const Program*>&          programs,
+        MeshCacheInfo*                              info = nullptr
+    );
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "meshes.hpp"
+#include "vertexLayout.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        // lossless, bit exact round trips
+        // vertices: blocks of vertices are stored byte column by byte column, each byte as the zigzagged
+        // difference to the same byte of the previous vertex, packed in groups of 16 at 0, 2, 4 or 8 bits
+        // indices: every index as the zigzagged difference to the first index of its triangle
+        // (first indices to the previous triangle's first), split into 4 byte columns packed like the vertex ones
+        struct MeshCodecStats {
+            std::size_t     raw_bytes{ 0 };
+            std::size_t     encoded_bytes{ 0 };
+            // raw / encoded
+            double          ratio{ 0.0 };
+            double          decode_ms{ 0.0 };
+            // raw bytes produced per second of decoding
+            double          decode_gb_per_s{ 0.0 };
+        };
+
+        // 'stride' of 1 to 256 bytes, it and the vertex count aren't stored: the decoder needs the same ones
+        std::vector<uint8_t>    encode_vertex_stream(const uint8_t* vertices, std::size_t vertex_count, std::size_t stride);
+        // writes vertex_count * stride bytes to 'out', false if 'encoded' is broken or was made for other arguments
+        bool                    decode_vertex_stream(std::span<const uint8_t> encoded, std::size_t vertex_count, std::size_t stride, uint8_t* out);
+
+        std::vector<uint8_t>    encode_index_stream(std::span<const uint32_t> indices);
+        bool                    decode_index_stream(std::span<const uint8_t> encoded, std::size_t index_count, uint32_t* out);
+
+        // every stream of a convert_vertices buffer with its own stride, the strides are stored with them
+        std::vector<uint8_t>    encode_vertex_buffer(std::span<const uint8_t> converted, std::span<const uint16_t> stream_strides, std::size_t vertex_count);
+        // decodes straight into what glBufferData gets, false unless exactly 'out_size' bytes come out
+        bool                    decode_vertex_buffer(std::span<const uint8_t> encoded, std::size_t vertex_count, uint8_t* out, std::size_t out_size);
+
+        // encodes 'mesh' converted to 'layout' and its indices, then times decoding them 'repeats' times
+        MeshCodecStats          measure_mesh_codec(const Mesh& mesh, const std::vector<VertexElement>& format, const VertexLayout& layout, int repeats = 8);
+    }
+}
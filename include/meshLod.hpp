@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "meshes.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        // one detail level, an index range inside the mesh (and so inside the VertexArray built from it)
+        struct LodLevel {
+            std::size_t     buffer_byte_offset;
+            std::size_t     index_count;
+            // object space geometric deviation from level 0
+            float           error;
+        };
+
+        struct LodOptions {
+            // components of every planar attribute block after the positions (texcoords, colors, normals by default)
+            std::vector<uint16_t>   attrib_counts{ 2, 3, 3 };
+            // how much attribute differences weigh against squared distance when choosing collapses
+            float                   attrib_weight{ 0.5f };
+            uint32_t                max_levels{ 4 };
+            // index count of every level relative to the previous one
+            float                   reduction{ 0.5f };
+            // object space deviation at which simplification stops
+            float                   max_error{ 0.1f };
+        };
+
+        // quadric error metric edge collapse on the triangle list [buffer_byte_offset, +index_count)
+        // simplified index lists are appended to mesh.indices, vertices are never added or moved,
+        // so every level draws from the same vertex buffer; level 0 is the source range itself
+        // positions shared by several vertices (uv/normal seams) and open borders are never collapsed
+        std::vector<LodLevel>   build_lod_chain(Mesh& mesh, std::size_t buffer_byte_offset, std::size_t index_count, const LodOptions& options = {});
+
+        // coarsest level whose error stays below threshold_px once projected,
+        // switching to a coarser level than 'curr_level' needs an extra 'hysteresis' fraction of headroom
+        uint32_t                select_lod(const std::vector<LodLevel>& levels, uint32_t curr_level, float px_per_unit, float threshold_px, float hysteresis);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "meshes.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        struct MeshQuality {
+            // average cache miss ratio: transformed vertices per triangle, 0.5 is the best a grid can do, 3 the worst
+            float   acmr{ 0.0f };
+            // average transformed vertex ratio: transformed vertices per unique vertex, 1 is optimal
+            float   atvr{ 0.0f };
+            // shaded pixels per covered pixel, averaged over the six axis views, 1 is optimal
+            float   overdraw{ 0.0f };
+        };
+
+        struct MeshOptimizeOptions {
+            // fifo size the metrics simulate, small enough to hold on most hardware
+            uint32_t    cache_size{ 16 };
+            // how much worse than the vertex cache order the overdraw order may make the acmr
+            float       overdraw_threshold{ 1.05f };
+            bool        optimize_overdraw{ true };
+        };
+
+        struct MeshOptimizeReport {
+            MeshQuality     before;
+            MeshQuality     after;
+        };
+
+        MeshQuality         analyze_vertex_cache(const uint32_t* indices, std::size_t index_count, uint32_t cache_size = 16);
+        // software rasterizes the triangles in submission order from +-x, +-y, +-z, back faces culled
+        float               analyze_overdraw(const float* positions, const uint32_t* indices, std::size_t index_count);
+
+        // reorders the triangles of [buffer_byte_offset, +index_count) for the post transform cache (Forsyth's scoring)
+        void                optimize_vertex_cache(Mesh& mesh, std::size_t buffer_byte_offset, std::size_t index_count);
+        // splits the cache optimized range into clusters at cache restarts and draws outward facing ones first,
+        // kept only while the acmr stays within 'threshold' of the cache order
+        void                optimize_overdraw(Mesh& mesh, std::size_t buffer_byte_offset, std::size_t index_count, float threshold, uint32_t cache_size = 16);
+        // vertices in order of first use by the index buffer so fetches walk memory linearly, indices remapped
+        // unreferenced vertices move to the end, every index range of the mesh (lods too) stays valid
+        void                optimize_vertex_fetch(Mesh& mesh, const std::vector<VertexElement>& format);
+
+        // all of the above over the range, then the vertex fetch over the whole mesh
+        MeshOptimizeReport  optimize_mesh(Mesh& mesh, const std::vector<VertexElement>& format, std::size_t buffer_byte_offset, std::size_t index_count, const MeshOptimizeOptions& options = {});
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include "meshes.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        struct WeldOptions {
+            // per component, vertices closer than this share a position, 0 only welds exact copies
+            float   position_tolerance{ 1e-5f };
+            // per component of every other element: a seam in uvs or normals keeps its vertices apart
+            float   attribute_tolerance{ 1e-4f };
+        };
+
+        // merges vertices equal within tolerance in every element of 'format', the first of a group stays
+        // indices are remapped in place so every index range (lods too) keeps its triangles
+        // returns the vertex count after welding
+        std::size_t             weld_vertices(Mesh& mesh, const std::vector<VertexElement>& format, const WeldOptions& options = {});
+
+        // smallest of GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT addressing 'vertex_count' vertices
+        GLenum                  select_index_type(std::size_t vertex_count);
+        std::size_t             index_type_size(GLenum index_type);
+        // 'indices' narrowed to 'index_type' for upload, they are expected to fit
+        std::vector<uint8_t>    encode_indices(std::span<const uint32_t> indices, GLenum index_type);
+    }
+}
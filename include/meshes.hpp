@@ -1,15 +1,71 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <span>
 #include <vector>
 #include <cstdint>
 
 namespace my_gl {
     namespace meshes {
+        // vertices are planar: one block per element, every block holds all vertices
         struct Mesh {
             std::vector<float>      vertices;
-            std::vector<uint16_t>   indices;
+            std::vector<uint32_t>   indices;
         };
 
-        extern Mesh cube_mesh;
+        // a Mesh that lives somewhere else: a Mesh, a StaticMesh in read only data, a mapped file
+        struct MeshView {
+            std::span<const float>      vertices;
+            std::span<const uint32_t>   indices;
+
+            constexpr MeshView() = default;
+            constexpr MeshView(std::span<const float> arg_vertices, std::span<const uint32_t> arg_indices)
+                : vertices{ arg_vertices }
+                , indices{ arg_indices }
+            {}
+            MeshView(const Mesh& mesh)
+                : vertices{ mesh.vertices }
+                , indices{ mesh.indices }
+            {}
+
+            Mesh to_mesh() const { return { { vertices.begin(), vertices.end() }, { indices.begin(), indices.end() } }; }
+        };
+
+        // a Mesh of a size known at compile time, constexpr ones end up in read only data and cost nothing at startup
+        // FloatsPerVertex of cube_mesh_format by default
+        template<std::size_t VertexCount, std::size_t IndexCount, std::size_t FloatsPerVertex = 11>
+        struct StaticMesh {
+            static constexpr std::size_t vertex_count{ VertexCount };
+
+            std::array<float, VertexCount * FloatsPerVertex>    vertices;
+            std::array<uint32_t, IndexCount>                    indices;
+
+            constexpr operator MeshView() const { return { vertices, indices }; }
+        };
+
+        // how an element is stored on the gpu, meshes themselves are always float
+        enum class VertexEncoding {
+            FLOAT,
+            // positions only: 16 bit unorm relative to the mesh bounds, see VertexArray::get_dequantize_mat
+            UNORM16_BOUNDS,
+            // unit vectors, 10 bits per component (GL_INT_2_10_10_10_REV)
+            SNORM10_PACKED,
+            // [0, 1] values such as colors
+            UNORM8,
+            HALF_FLOAT,
+        };
+
+        // one planar block of a Mesh, in block order, positions come first
+        struct VertexElement {
+            const char*     name;
+            uint16_t        count;
+            VertexEncoding  encoding{ VertexEncoding::FLOAT };
+        };
+
+        extern const StaticMesh<24, 36> cube_mesh;
+        extern const std::vector<VertexElement> cube_mesh_format;
+        // same blocks, packed to 20 bytes per vertex instead of 44
+        extern const std::vector<VertexElement> cube_mesh_format_packed;
     }
 }
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace my_gl {
+    namespace meshes {
+        constexpr uint32_t meshlet_max_vertices{ 64 };
+        constexpr uint32_t meshlet_max_triangles{ 124 };
+
+        // a run of consecutive triangles of an index buffer, so surviving meshlets can be drawn straight from it
+        struct Meshlet {
+            uint32_t    index_offset{ 0 };
+            uint32_t    index_count{ 0 };
+            // object space bounding sphere
+            float       center[3]{ 0.0f, 0.0f, 0.0f };
+            float       radius{ 0.0f };
+            // every triangle faces away from a viewer inside the cone at cone_apex around -cone_axis
+            float       cone_apex[3]{ 0.0f, 0.0f, 0.0f };
+            float       cone_axis[3]{ 0.0f, 0.0f, 0.0f };
+            // sine of the cone half angle, 1.0 when the normals spread too much to ever cull
+            float       cone_cutoff{ 1.0f };
+        };
+
+        struct MeshletCullStats {
+            uint32_t    meshlets_tested{ 0 };
+            uint32_t    meshlets_culled{ 0 };
+            uint32_t    triangles_culled{ 0 };
+        };
+
+        // greedy split in index order, a new meshlet starts once either limit would be exceeded
+        // positions are tightly packed xyz, indices past position_count are left out of the bounds
+        std::vector<Meshlet>    build_meshlets(const float* positions, std::size_t position_count, const uint32_t* indices, std::size_t index_count);
+
+        // camera_pos in the meshlet's object space
+        inline bool meshlet_is_backfacing(const Meshlet& meshlet, const float* camera_pos) {
+            if (meshlet.cone_cutoff >= 1.0f) {
+                return false;
+            }
+            const float to_apex[3]{
+                meshlet.cone_apex[0] - camera_pos[0],
+                meshlet.cone_apex[1] - camera_pos[1],
+                meshlet.cone_apex[2] - camera_pos[2],
+            };
+            const float dist_sq{ to_apex[0] * to_apex[0] + to_apex[1] * to_apex[1] + to_apex[2] * to_apex[2] };
+            const float dp{ to_apex[0] * meshlet.cone_axis[0] + to_apex[1] * meshlet.cone_axis[1] + to_apex[2] * meshlet.cone_axis[2] };
+            // dot(normalize(to_apex), axis) >= cutoff without the square root
+            return dp > 0.0f && dp * dp >= meshlet.cone_cutoff * meshlet.cone_cutoff * dist_sq;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "meshes.hpp"
+#include "threadPool.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        struct ObjMaterial {
+            std::string     name;
+            float           diffuse[3]{ 1.0f, 1.0f, 1.0f };
+            // as written in the mtl file, relative to it, empty without one
+            std::string     diffuse_map;
+        };
+
+        // faces of one material, an index range of the model mesh
+        struct ObjGroup {
+            uint32_t        material;
+            std::size_t     buffer_byte_offset;
+            std::size_t     index_count;
+        };
+
+        struct ObjModel {
+            // blocks of cube_mesh_format: positions, texcoords, material diffuse color, normals
+            Mesh                        mesh;
+            std::vector<ObjGroup>       groups;
+            // materials[0] is the default one faces use before any usemtl
+            std::vector<ObjMaterial>    materials;
+        };
+
+        struct ObjLoadStats {
+            std::size_t     file_bytes{ 0 };
+            uint32_t        chunks{ 0 };
+            // face corners after triangulation, and the vertices they were deduplicated into
+            std::size_t     corners{ 0 };
+            std::size_t     vertices{ 0 };
+            double          parse_ms{ 0.0 };
+            double          merge_ms{ 0.0 };
+            double          mb_per_s{ 0.0 };
+        };
+
+        // mmaps 'path', parses line aligned chunks of it on 'pool' and merges them into one indexed mesh
+        // corners sharing position, texcoord, normal and material become one vertex, missing normals are generated
+        // false if the file can't be read, faces with out of range indices are dropped
+        bool load_obj(const char* path, ObjModel& model, ThreadPool& pool = ThreadPool::shared(), ObjLoadStats* stats = nullptr);
+    }
+}
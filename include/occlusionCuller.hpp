@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "bounds.hpp"
+#include "matrix.hpp"
+
+namespace my_gl {
+    class ThreadPool;
+
+    // CPU occlusion culling against a low resolution depth buffer
+    // no GL calls in here, so it runs headless on synthetic scenes
+    class OcclusionCuller {
+    public:
+        static constexpr uint32_t tile_size{ 8 };
+        static constexpr uint32_t bin_cols{ 4 };
+        static constexpr uint32_t bin_rows{ 4 };
+
+        struct Stats {
+            uint32_t    occluders{ 0 };
+            uint32_t    triangles_rasterized{ 0 };
+            uint32_t    objects_tested{ 0 };
+            uint32_t    objects_occluded{ 0 };
+        };
+
+        // width and height are rounded up to whole bins, pool == nullptr rasterizes on the calling thread
+        OcclusionCuller(uint32_t width = 256, uint32_t height = 128, ThreadPool* pool = nullptr);
+
+        void    begin_frame(const math::Matrix44<float>& view_proj);
+        // positions are tightly packed xyz, indices form a triangle list
+        void    add_occluder(const math::Matrix44<float>& model_mat, const float* positions, const uint32_t* indices, uint32_t index_count);
+        // bins and rasterizes all occluders of the frame, then builds the tile max depth level
+        void    rasterize();
+        // conservative, anything that can't be proven hidden is visible
+        bool    is_visible(const math::Aabb& world_bounds);
+
+        const Stats&                get_stats() const { return _stats; }
+        const std::vector<float>&   get_depth() const { return _depth; }
+        uint32_t                    width() const { return _width; }
+        uint32_t                    height() const { return _height; }
+
+    private:
+        struct Occluder {
+            math::Matrix44<float>   model_mat;
+            const float*            positions;
+            const uint32_t*         indices;
+            uint32_t                index_count;
+        };
+
+        // screen space triangle, depth as a plane z = a * x + b * y + c
+        struct Triangle {
+            float       x[3];
+            float       y[3];
+            float       z_a;
+            float       z_b;
+            float       z_c;
+            int32_t     min_x;
+            int32_t     min_y;
+            int32_t     max_x;
+            int32_t     max_y;
+        };
+
+        void    setup_triangles(const Occluder& occluder, std::vector<Triangle>& out) const;
+        void    rasterize_bin(uint32_t bin);
+        void    rasterize_triangle(const Triangle& tri, int32_t clip_min_x, int32_t clip_min_y, int32_t clip_max_x, int32_t clip_max_y);
+
+        ThreadPool*                         _pool;
+        uint32_t                            _width;
+        uint32_t                            _height;
+        uint32_t                            _tiles_x;
+        uint32_t                            _tiles_y;
+        math::Matrix44<float>               _view_proj;
+        std::vector<float>                  _depth;
+        // farthest depth of every tile
+        std::vector<float>                  _tile_max_depth;
+        std::vector<Occluder>               _occluders;
+        std::vector<Triangle>               _triangles;
+        std::vector<std::vector<uint32_t>>  _bins;
+        Stats                               _stats;
+    };
+}
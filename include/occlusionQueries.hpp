@@ -0,0 +1,73 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include "bounds.hpp"
+#include "matrix.hpp"
+#include "renderer.hpp"
+
+namespace my_gl {
+    class GeometryObjectPrimitive;
+
+    // recycles GL query objects instead of generating/deleting them every frame
+    class QueryPool {
+    public:
+        QueryPool() = default;
+        QueryPool(const QueryPool& rhs) = delete;
+        QueryPool& operator=(const QueryPool& rhs) = delete;
+        ~QueryPool();
+
+        GLuint          acquire();
+        void            release(GLuint query);
+        std::size_t     size() const { return _all.size(); }
+
+    private:
+        std::vector<GLuint>     _free;
+        std::vector<GLuint>     _all;
+    };
+
+    // hardware occlusion queries with one frame of latency:
+    // visibility of the previous frame decides whether an object is drawn, so the cpu never waits on results
+    class OcclusionQueries {
+    public:
+        struct Stats {
+            uint32_t    tracked{ 0 };
+            uint32_t    draws_skipped{ 0 };
+            uint32_t    conditional_draws{ 0 };
+            uint32_t    queries_issued{ 0 };
+        };
+
+        OcclusionQueries();
+        OcclusionQueries(const OcclusionQueries& rhs) = delete;
+        OcclusionQueries& operator=(const OcclusionQueries& rhs) = delete;
+
+        void    begin_frame(const math::Matrix44<float>& view_proj_mat);
+        // draws (or skips) the primitive based on earlier query results, 'id' must be stable across frames
+        void    render(GeometryObjectPrimitive& primitive, uint32_t id, const math::Matrix44<float>& view_mat, const math::Matrix44<float>& view_proj_mat, float time_0to1);
+        // issues bounding box queries for the objects skipped this frame, call after all opaque draws
+        void    end_frame();
+
+        const Stats&    get_stats() const { return _stats; }
+        GLenum          get_query_target() const { return _query_target; }
+
+    private:
+        struct Entry {
+            GLuint      query{ 0 };
+            uint64_t    last_frame{ 0 };
+            bool        visible{ true };
+        };
+
+        void    release_query(Entry& entry);
+        bool    reaches_near_plane(const math::Aabb& box) const;
+
+        QueryPool                                       _pool;
+        Program                                         _bounds_program;
+        VertexArray                                     _bounds_vao;
+        std::vector<Entry>                              _entries;
+        std::vector<std::pair<uint32_t, math::Aabb>>    _deferred;
+        math::Matrix44<float>                           _view_proj_mat;
+        GLenum                                          _query_target;
+        uint64_t                                        _frame{ 1 };
+        Stats                                           _stats;
+    };
+}
@@ -0,0 +1,268 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "meshes.hpp"
+#include "threadPool.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        // std::sin and std::cos aren't constexpr, both build time and run time generation go through these
+        // so a mesh comes out bit identical either way
+        constexpr double parametric_pi{ 3.14159265358979323846 };
+
+        constexpr double parametric_sin(double x) {
+            // into [-pi, pi], then folded into [-pi/2, pi/2] where the series is good to double precision by x^15
+            const double turns{ x / (2.0 * parametric_pi) };
+            x -= static_cast<double>(static_cast<int64_t>(turns + (turns >= 0.0 ? 0.5 : -0.5))) * 2.0 * parametric_pi;
+            if (x > parametric_pi / 2.0) {
+                x = parametric_pi - x;
+            }
+            else if (x < -parametric_pi / 2.0) {
+                x = -parametric_pi - x;
+            }
+
+            const double x2{ x * x };
+            double term{ x };
+            double sum{ x };
+            for (int n = 1; n <= 7; ++n) {
+                term *= -x2 / static_cast<double>((2 * n) * (2 * n + 1));
+                sum += term;
+            }
+            return sum;
+        }
+
+        constexpr double parametric_cos(double x) {
+            return parametric_sin(x + parametric_pi / 2.0);
+        }
+
+        enum class ParametricShape {
+            PLANE,
+            BOX,
+            SPHERE,
+            CYLINDER,
+            TORUS,
+        };
+
+        // one grid of quads, (segments_u + 1) * (segments_v + 1) vertices
+        struct ParametricPatch {
+            uint32_t    segments_u;
+            uint32_t    segments_v;
+            uint32_t    first_vertex;
+            uint32_t    first_index;
+        };
+
+        // a shape in cube_mesh_format, centered on the origin, counter clockwise front faces
+        // every shape is made of grids: seams and poles repeat vertices (poles and cylinder cap centers give
+        // degenerate triangles), that keeps the topology regular enough to generate one row at a time
+        struct ParametricMesh {
+            ParametricShape     shape{ ParametricShape::BOX };
+            // around the y axis for spheres, cylinders and tori, along x for planes and every face of a box
+            uint32_t            segments_u{ 1 };
+            // pole to pole, along the axis, around the tube, along z for planes and every face of a box
+            uint32_t            segments_v{ 1 };
+            // bounding box: x, y, z of boxes and planes (flat in y), diameter of spheres, diameter and height of
+            // cylinders, outer and tube diameter of tori
+            float               extent[3]{ 1.0f, 1.0f, 1.0f };
+            float               color[3]{ 1.0f, 1.0f, 1.0f };
+
+            constexpr uint32_t patch_count() const {
+                switch (shape) {
+                case ParametricShape::BOX:      return 6;
+                // side, top cap, bottom cap
+                case ParametricShape::CYLINDER: return 3;
+                default:                        return 1;
+                }
+            }
+
+            constexpr ParametricPatch patch(uint32_t id) const {
+                ParametricPatch result{ segments_u, segments_v, 0, 0 };
+                for (uint32_t p = 0; p <= id; ++p) {
+                    const bool cap{ shape == ParametricShape::CYLINDER && p > 0 };
+                    const ParametricPatch current{ segments_u, cap ? 1 : segments_v, result.first_vertex, result.first_index };
+                    if (p == id) {
+                        return current;
+                    }
+                    result.first_vertex += (current.segments_u + 1) * (current.segments_v + 1);
+                    result.first_index += current.segments_u * current.segments_v * 6;
+                }
+                return result;
+            }
+
+            constexpr std::size_t vertex_count() const {
+                const ParametricPatch last{ patch(patch_count() - 1) };
+                return last.first_vertex + (last.segments_u + 1) * (last.segments_v + 1);
+            }
+
+            constexpr std::size_t index_count() const {
+                const ParametricPatch last{ patch(patch_count() - 1) };
+                return last.first_index + last.segments_u * last.segments_v * 6;
+            }
+
+            // vertex rows of all patches, the unit make_mesh spreads over threads
+            constexpr uint32_t row_count() const {
+                uint32_t rows{ 0 };
+                for (uint32_t p = 0; p < patch_count(); ++p) {
+                    rows += patch(p).segments_v + 1;
+                }
+                return rows;
+            }
+
+            // writes one vertex row and the quads between it and the next row of its patch
+            // 'vertices' are planar and hold vertex_count() vertices, rows never write to the same place
+            constexpr void write_row(uint32_t row, float* vertices, uint32_t* indices) const {
+                uint32_t patch_id{ 0 };
+                ParametricPatch grid{ patch(0) };
+                while (row > grid.segments_v) {
+                    row -= grid.segments_v + 1;
+                    grid = patch(++patch_id);
+                }
+
+                const std::size_t count{ vertex_count() };
+                float* positions{ vertices };
+                float* texcoords{ vertices + count * 3 };
+                float* colors{ vertices + count * 5 };
+                float* normals{ vertices + count * 8 };
+
+                const double v{ static_cast<double>(row) / grid.segments_v };
+                for (uint32_t column = 0; column <= grid.segments_u; ++column) {
+                    const double u{ static_cast<double>(column) / grid.segments_u };
+                    const std::size_t vertex{ grid.first_vertex + static_cast<std::size_t>(row) * (grid.segments_u + 1) + column };
+
+                    double position[3]{};
+                    double normal[3]{};
+                    double texcoord[2]{ u, v };
+                    evaluate(patch_id, u, v, position, normal, texcoord);
+                    for (int c = 0; c < 3; ++c) {
+                        positions[vertex * 3 + c] = static_cast<float>(position[c]);
+                        colors[vertex * 3 + c] = color[c];
+                        normals[vertex * 3 + c] = static_cast<float>(normal[c]);
+                    }
+                    texcoords[vertex * 2] = static_cast<float>(texcoord[0]);
+                    texcoords[vertex * 2 + 1] = static_cast<float>(texcoord[1]);
+                }
+
+                if (row == grid.segments_v) {
+                    return;
+                }
+                // u x v points out of every patch, so (u, u + 1, next row u + 1) winds counter clockwise
+                uint32_t* quad{ indices + grid.first_index + static_cast<std::size_t>(row) * grid.segments_u * 6 };
+                for (uint32_t column = 0; column < grid.segments_u; ++column, quad += 6) {
+                    const uint32_t a{ grid.first_vertex + row * (grid.segments_u + 1) + column };
+                    const uint32_t b{ a + grid.segments_u + 1 };
+                    quad[0] = a;
+                    quad[1] = a + 1;
+                    quad[2] = b + 1;
+                    quad[3] = a;
+                    quad[4] = b + 1;
+                    quad[5] = b;
+                }
+            }
+
+        private:
+            constexpr void evaluate(uint32_t patch_id, double u, double v, double* position, double* normal, double* texcoord) const {
+                const double half[3]{ extent[0] * 0.5, extent[1] * 0.5, extent[2] * 0.5 };
+                const double phi{ 2.0 * parametric_pi * u };
+
+                switch (shape) {
+                case ParametricShape::PLANE: {
+                    // v runs from +z to -z so that x cross -z is +y
+                    position[0] = (u - 0.5) * extent[0];
+                    position[2] = (0.5 - v) * extent[2];
+                    normal[1] = 1.0;
+                    break;
+                }
+                case ParametricShape::BOX: {
+                    // per face: outward axis, u axis, v axis (u cross v == outward), all as signed axis indices + 1
+                    constexpr int faces[6][3]{
+                        { 3, 1, 2 }, { -3, -1, 2 }, { 1, -3, 2 }, { -1, 3, 2 }, { 2, 1, -3 }, { -2, 1, 3 },
+                    };
+                    const int* face{ faces[patch_id] };
+                    const double offsets[3]{ 1.0, u * 2.0 - 1.0, v * 2.0 - 1.0 };
+                    for (int k = 0; k < 3; ++k) {
+                        const int axis{ (face[k] > 0 ? face[k] : -face[k]) - 1 };
+                        const double sign{ face[k] > 0 ? 1.0 : -1.0 };
+                        position[axis] = sign * offsets[k] * half[axis];
+                    }
+                    const int out_axis{ (face[0] > 0 ? face[0] : -face[0]) - 1 };
+                    normal[out_axis] = face[0] > 0 ? 1.0 : -1.0;
+                    break;
+                }
+                case ParametricShape::SPHERE: {
+                    // v from the south pole up
+                    const double theta{ parametric_pi * (v - 0.5) };
+                    normal[0] = parametric_cos(theta) * parametric_sin(phi);
+                    normal[1] = parametric_sin(theta);
+                    normal[2] = parametric_cos(theta) * parametric_cos(phi);
+                    for (int c = 0; c < 3; ++c) {
+                        position[c] = normal[c] * half[0];
+                    }
+                    break;
+                }
+                case ParametricShape::CYLINDER: {
+                    const double sin_phi{ parametric_sin(phi) };
+                    const double cos_phi{ parametric_cos(phi) };
+                    if (patch_id == 0) {
+                        position[0] = half[0] * sin_phi;
+                        position[1] = (v - 0.5) * extent[1];
+                        position[2] = half[0] * cos_phi;
+                        normal[0] = sin_phi;
+                        normal[2] = cos_phi;
+                        break;
+                    }
+                    // caps shrink from the rim (top) or grow to it (bottom) so u cross v points away from the side
+                    const bool top{ patch_id == 1 };
+                    const double radius{ half[0] * (top ? 1.0 - v : v) };
+                    position[0] = radius * sin_phi;
+                    position[1] = top ? half[1] : -half[1];
+                    position[2] = radius * cos_phi;
+                    normal[1] = top ? 1.0 : -1.0;
+                    texcoord[0] = 0.5 + position[0] / extent[0];
+                    texcoord[1] = 0.5 - position[2] / extent[0];
+                    break;
+                }
+                case ParametricShape::TORUS: {
+                    const double theta{ 2.0 * parametric_pi * v };
+                    const double tube{ half[1] };
+                    const double ring{ half[0] - tube };
+                    normal[0] = parametric_cos(theta) * parametric_sin(phi);
+                    normal[1] = parametric_sin(theta);
+                    normal[2] = parametric_cos(theta) * parametric_cos(phi);
+                    position[0] = ring * parametric_sin(phi) + tube * normal[0];
+                    position[1] = tube * normal[1];
+                    position[2] = ring * parametric_cos(phi) + tube * normal[2];
+                    break;
+                }
+                }
+            }
+        };
+
+        template<const ParametricMesh& Shape>
+        using ParametricStaticMesh = StaticMesh<Shape.vertex_count(), Shape.index_count()>;
+
+        // evaluated by the compiler, a constexpr result goes to read only data
+        template<const ParametricMesh& Shape>
+        constexpr ParametricStaticMesh<Shape> make_static_mesh() {
+            static_assert(Shape.segments_u > 0 && Shape.segments_v > 0, "a parametric mesh needs at least one segment each way");
+            ParametricStaticMesh<Shape> mesh{};
+            for (uint32_t row = 0; row < Shape.row_count(); ++row) {
+                Shape.write_row(row, mesh.vertices.data(), mesh.indices.data());
+            }
+            return mesh;
+        }
+
+        // same vertices as make_static_mesh, rows generated in parallel, for shapes known only at run time
+        // an empty mesh if a segment count is 0 or the vertices don't fit 32 bit indices
+        Mesh make_mesh(const ParametricMesh& shape, ThreadPool& pool = ThreadPool::shared());
+
+        // built in shapes matching cube_mesh: a unit bounding box
+        inline constexpr ParametricMesh sphere_mesh_shape{ .shape = ParametricShape::SPHERE, .segments_u = 32, .segments_v = 16 };
+        inline constexpr ParametricMesh cylinder_mesh_shape{ .shape = ParametricShape::CYLINDER, .segments_u = 32, .segments_v = 1 };
+        inline constexpr ParametricMesh torus_mesh_shape{ .shape = ParametricShape::TORUS, .segments_u = 32, .segments_v = 16, .extent = { 1.0f, 0.3f, 1.0f } };
+        inline constexpr ParametricMesh plane_mesh_shape{ .shape = ParametricShape::PLANE, .segments_u = 16, .segments_v = 16 };
+
+        extern const ParametricStaticMesh<sphere_mesh_shape>      sphere_mesh;
+        extern const ParametricStaticMesh<cylinder_mesh_shape>    cylinder_mesh;
+        extern const ParametricStaticMesh<torus_mesh_shape>       torus_mesh;
+        extern const ParametricStaticMesh<plane_mesh_shape>       plane_mesh;
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace my_gl {
+    // one stage of a program, 'source' already holds its defines; 'path' is only used in error messages
+    struct ShaderSource {
+        GLenum          type;
+        std::string     source;
+        const char*     path{ "" };
+    };
+
+    // the file at 'path' with a '#define <define>' line for every define right after its #version line, a #line
+    // directive keeps compile errors pointing at the file's own lines; empty if the file can't be read
+    std::string load_shader_source(const char* path, const std::vector<std::string>& defines = {});
+
+    // name and location of every 'layout(location = N) in' declaration of a vertex shader source, lets attribute
+    // locations be known before the program linked
+    std::vector<std::pair<std::string, GLint>> explicit_attribute_locations(std::string_view vertex_source);
+
+    // sets every active uniform of 'to' that 'from' has with the same name and type to the value it has in 'from',
+    // samplers included; a rebuilt program starts where the one it replaces left off
+    void copy_uniform_values(GLuint from, GLuint to);
+
+    // linked program binaries on disk, one file per program named after its key: the hash of every stage's type and
+    // source (defines included) and the driver's vendor, renderer and version strings, so edited shaders, another
+    // gpu or a driver update simply miss; a binary the driver rejects anyway is compiled from source and replaced
+    // needs GL 4.1 program binaries and a driver exposing at least one binary format, compiles every time otherwise
+    // gl thread only
+    class ProgramCache {
+    public:
+        struct Stats {
+            uint32_t        hits{ 0 };
+            uint32_t        misses{ 0 };
+            // binaries the driver refused, recompiled
+            uint32_t        rejected{ 0 };
+            uint32_t        written{ 0 };
+            // time spent restoring binaries and compiling plus linking from source
+            double          load_ms{ 0.0 };
+            double          compile_ms{ 0.0 };
+            // builds started by build_async that didn't restore a binary, and the ones of them still running
+            uint32_t        async_builds{ 0 };
+            uint32_t        pending{ 0 };
+        };
+
+        // an empty 'directory' keeps binaries off the disk
+        explicit ProgramCache(std::string directory = "shader_cache");
+        ProgramCache(const ProgramCache& rhs) = delete;
+        ProgramCache& operator=(const ProgramCache& rhs) = delete;
+        ~ProgramCache();
+
+        // the program restored from its binary, or compiled and linked from 'stages' and then stored; a program that
+        // fails to link is still returned, its log printed like create_program does
+        GLuint              build(const std::vector<ShaderSource>& stages);
+        // like build but returns without waiting for the compiler: with GL_KHR_parallel_shader_compile the driver
+        // compiles and links on its own threads, otherwise the worker context does (start_worker), and with neither
+        // the program is built right here; a binary from the cache is restored right away
+        // the program can't be used until is_ready says so
+        GLuint              build_async(const std::vector<ShaderSource>& stages);
+        // true once the build_async of 'program' finished, linked or not (see GL_LINK_STATUS), its logs are printed
+        // and its binary stored then; never blocks, programs that aren't building are always ready
+        bool                is_ready(GLuint program);
+        // deletes a program whose build nobody waits for anymore, building or not
+        void                cancel(GLuint program);
+        // without the parallel compile extension, build_async hands its builds to a thread running
+        // 'make_context_current' first, which has to make a context current there that shares objects with ours,
+        // and 'release_context' after its last build, which has to make it no longer current there
+        // stop_worker joins it and then runs 'destroy_context' on the calling thread, before ours is destroyed
+        void                start_worker(
+            std::function<void()>   make_context_current,
+            std::function<void()>   release_context = {},
+            std::function<void()>   destroy_context = {}
+        );
+        void                stop_worker();
+        uint64_t            key(const std::vector<ShaderSource>& stages);
+        std::string         binary_path(uint64_t key) const;
+        bool                is_enabled();
+        const Stats&        get_stats() const { return _stats; }
+
+        // process wide, create_program and create_compute_program go through it
+        static ProgramCache& shared();
+        // GL_KHR_parallel_shader_compile or its ARB twin, the driver compiles in the background
+        static bool         has_parallel_compile();
+
+    private:
+        struct Pending {
+            uint64_t                    key{ 0 };
+            // shaders the driver compiles on its threads, the worker deletes its own
+            std::vector<GLuint>         shaders;
+            std::vector<GLenum>         types;
+            std::vector<std::string>    paths;
+            bool                        on_worker{ false };
+        };
+        struct Worker;
+
+        // logs, shader cleanup and the binary of a build that completed
+        void                finish(GLuint program, Pending& pending);
+        void                join_worker();
+        // false if there is no binary for 'key' or the driver rejected it
+        bool                load(GLuint program, uint64_t key);
+        void                store(GLuint program, uint64_t key);
+        // vendor, renderer and version, read once a context exists
+        uint64_t            driver_hash();
+
+        std::string     _directory;
+        uint64_t        _driver_hash{ 0 };
+        // -1 until the first build asked the driver for its binary formats
+        int             _binary_formats{ -1 };
+        Stats           _stats;
+        std::unordered_map<GLuint, Pending>     _pending;
+        std::unique_ptr<Worker>                 _worker;
+        bool                                    _compiler_threads_set{ false };
+    };
+}
@@ -1,18 +1,32 @@
 #pragma once
+#include <memory>
+#include <span>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <GL/glew.h>
 #include <cstdint>
 #include <string_view>
+#include "bounds.hpp"
+#include "bvh.hpp"
 #include "geometryObject.hpp"
 #include "matrix.hpp"
+#include "meshArena.hpp"
+#include "meshlets.hpp"
+#include "occlusionCuller.hpp"
 #include "sharedTypes.hpp"
+#include "staticBatch.hpp"
 #include "meshes.hpp"
+#include "meshWeld.hpp"
+#include "vertexLayout.hpp"
 
 namespace my_gl {
     class VertexArray;
     class Program;
     class Renderer;
+    class OcclusionQueries;
+    class GpuCuller;
+    class TextureStreamer;
 
     struct Attribute {
         const char*     name;
@@ -20,7 +34,9 @@ namespace my_gl {
         GLenum          gl_type;
         uint16_t        count;
         uint16_t        byte_stride;
-        uint16_t        byte_offset;
+        uint32_t        byte_offset;
+        // integer types read as [0, 1] / [-1, 1]
+        bool            normalized{ false };
     };
 
     struct Uniform {
@@ -28,14 +44,18 @@ namespace my_gl {
         int32_t         location{ -1 };
     };
 
+    // attributes 'names' of a buffer holding 'vertex_count' vertices in 'layout', strides and offsets filled in
+    std::vector<Attribute> make_attributes(const meshes::VertexLayout& layout, std::size_t vertex_count, const std::vector<const char*>& names);
+
     class VertexArray {
     public:
         VertexArray(
             meshes::Mesh&& mesh,
             const Program& program
         );
+        // only the positions and indices of a view stay on the cpu, the rest goes to the gpu without a copy
         VertexArray(
-            const meshes::Mesh& mesh,
+            meshes::MeshView mesh,
             const Program& program
         );
         VertexArray(
@@ -43,32 +63,104 @@ namespace my_gl {
             const std::vector<const Program*>& programs
         );
         VertexArray(
-            const meshes::Mesh& mesh,
+            meshes::MeshView mesh,
             const std::vector<const Program*>& programs
         );
+        // 'meshes' hold planar vertices in 'format', they are merged block by block so every element stays one block
+        // attributes of 'programs' have to address the combined vertex count
         VertexArray(
             const std::vector<meshes::Mesh>& meshes,
+            const std::vector<meshes::VertexElement>& format,
             const std::vector<const Program*>& programs
         );
-        VertexArray(const VertexArray& rhs) = default;
-        VertexArray(VertexArray&& rhs) = default;
+        // uploads the planar mesh converted to 'layout', attributes of 'programs' must come from make_attributes
+        VertexArray(
+            meshes::MeshView mesh,
+            const std::vector<meshes::VertexElement>& format,
+            const meshes::VertexLayout& layout,
+            const std::vector<const Program*>& programs
+        );
+        // 'vertex_ranges' are uploaded back to back as they are, e.g. straight out of a mapped file
+        // 'attributes' address that concatenation and take their locations from 'programs' by name
+        // 'index_bytes' hold 'index_type' indices, the uint32 ones of 'cpu_mesh' are uploaded when empty
+        // 'cpu_mesh' is what bounds and culling read: tightly packed xyz float positions and the same indices
+        // 'meshlets' are built from it when not given, 'dequantize' maps quantized positions of the ranges back
+        VertexArray(
+            const std::vector<std::span<const uint8_t>>&    vertex_ranges,
+            const std::vector<Attribute>&                   attributes,
+            std::span<const uint8_t>                        index_bytes,
+            GLenum                                          index_type,
+            meshes::Mesh&&                                  cpu_mesh,
+            const std::vector<const Program*>&              programs,
+            std::vector<meshes::Meshlet>&&                  meshlets = {},
+            const meshes::Dequantize&                       dequantize = {}
+        );
+        // a range of the shared arena buffers, identical meshes share it
+        // if the arena has no room for the mesh it gets buffers of its own in the arena's layout
+        VertexArray(
+            meshes::MeshView mesh,
+            MeshArena& arena
+        );
+        // owns its gl objects or its arena range, a moved-from vertex array holds neither
+        VertexArray(const VertexArray& rhs) = delete;
+        VertexArray& operator=(const VertexArray& rhs) = delete;
+        VertexArray(VertexArray&& rhs) noexcept;
+        VertexArray& operator=(VertexArray&& rhs) noexcept;
         ~VertexArray();
 
         void bind() const { glBindVertexArray(_vao_id); }
         void un_bind() const { glBindVertexArray(0); }
-        std::size_t get_ibo_size() const { return _ibo_data.size(); }
-        const uint16_t* get_ibo_data() const { return _ibo_data.data(); }
+        uint32_t get_id() const { return _vao_id; }
+        std::size_t get_ibo_size() const { return get_indices().size(); }
+        // only the positions and indices stay on the cpu after upload, indices as 32 bit
+        const uint32_t* get_ibo_data() const { return get_indices().data(); }
+        const float*    get_vbo_data() const { return get_positions().data(); }
+        // type of the gl index buffer, the smallest one fitting the mesh unless it lives in an arena
+        // index byte offsets elsewhere (primitives, lods) count 32 bit cpu indices, draws scale them by get_index_size
+        GLenum          get_index_type() const { return _arena ? _arena->get_index_type() : _index_type; }
+        std::size_t     get_index_size() const { return meshes::index_type_size(get_index_type()); }
+        // where the mesh starts inside the gl buffers, 0 unless it lives in an arena
+        // draws add them to their mesh relative index offsets (glDrawElementsBaseVertex)
+        std::size_t     get_first_index() const { return _arena_entry ? _arena_entry->first_index : 0; }
+        GLint           get_base_vertex() const { return _arena_entry ? static_cast<GLint>(_arena_entry->base_vertex) : 0; }
+        // quantized positions are stored relative to the mesh bounds, this maps them back to object space
+        // fold it into the matrices that transform positions, not into the normal matrix
+        const meshes::Dequantize&   get_dequantize() const { return _arena_entry ? _arena_entry->dequantize : _dequantize; }
+        math::Matrix44<float>       get_dequantize_mat() const;
+        // object space bounds of the vertices referenced by an index range
+        // positions are expected in the leading tightly packed block of the vbo (see meshes.cpp)
+        math::Aabb      compute_bounds(std::size_t index_byte_offset, std::size_t index_count) const;
+        // built over the whole index buffer on creation, sorted by index_offset
+        const std::vector<meshes::Meshlet>& get_meshlets() const { return _arena_entry ? _arena_entry->meshlets : _meshlets; }
+        // meshlets overlapping an index range, the first and last one may stick out of it
+        std::span<const meshes::Meshlet>    get_meshlets(std::size_t index_byte_offset, std::size_t index_count) const;
 
     private:
-        void init(const std::vector<const Program*>& programs);
-        void init(const Program& program);
-        void combine_meshes(const std::vector<meshes::Mesh>& meshes);
+        // uploads 'gpu_vertices' instead of the planar data when given
+        void init(const std::vector<const Program*>& programs, std::span<const uint8_t> gpu_vertices = {});
+        void init(const Program& program, std::span<const uint8_t> gpu_vertices = {});
+        // own buffers in the layout of 'arena', bound to the attributes of its programs
+        void init(meshes::MeshView mesh, const MeshArena& arena);
+        void destroy();
+        void combine_meshes(const std::vector<meshes::Mesh>& meshes, const std::vector<meshes::VertexElement>& format);
+        void build_meshlets();
+        void upload_indices();
+        void release_shadow_copy();
+        // the leading positions block, as much of it as the indices reach
+        static std::vector<float>   copy_positions(meshes::MeshView mesh);
+        std::span<const float>      get_positions() const;
+        std::span<const uint32_t>   get_indices() const;
 
         std::vector<float>              _vbo_data;
-        std::vector<uint16_t>           _ibo_data;
-        uint32_t                        _vao_id;
-        uint32_t                        _vbo_id;
-        uint32_t                        _ibo_id;
+        std::vector<uint32_t>           _ibo_data;
+        std::vector<meshes::Meshlet>    _meshlets;
+        meshes::Dequantize              _dequantize;
+        MeshArena*                      _arena{ nullptr };
+        const MeshArena::Entry*         _arena_entry{ nullptr };
+        uint32_t                        _vao_id{ 0 };
+        uint32_t                        _vbo_id{ 0 };
+        uint32_t                        _ibo_id{ 0 };
+        GLenum                          _index_type{ GL_UNSIGNED_SHORT };
     };
 
     class Program {
@@ -85,8 +177,23 @@ namespace my_gl {
             std::vector<Attribute>&&        attribs,
             std::vector<Uniform>&&          uniforms
         );
-        Program(const Program& rhs) = default;
-        Program(Program&& rhs) = default;
+        // built in the background (ProgramCache::build_async), 'fallback' is used in its place until it linked:
+        // use, get_uniform and the uniform setters go to 'fallback', values set meanwhile are set on the program
+        // once update swapped it in; if it fails to link it stays on 'fallback'
+        // attribute locations come from the layout(location = N) qualifiers of the vertex shader so vertex arrays
+        // can be set up right away, 'fallback' has to read its attributes from the same locations
+        Program(
+            const char*                     vertex_shader_path,
+            const char*                     fragment_shader_path,
+            std::vector<Attribute>&&        attribs,
+            std::vector<Uniform>&&          uniforms,
+            const Program&                  fallback
+        );
+        // owns its program and the build in flight, a moved-from program holds neither
+        Program(const Program& rhs) = delete;
+        Program& operator=(const Program& rhs) = delete;
+        Program(Program&& rhs) noexcept;
+        Program& operator=(Program&& rhs) noexcept;
         ~Program();
 
         const Attribute* const get_attrib(std::string_view attrib_name) const;
@@ -96,17 +203,47 @@ namespace my_gl {
         void  set_uniform_value(std::string_view unif_name, int32_t val) const;
         void  set_uniform_value(std::string_view unif_name, float val) const;
         void  set_uniform_value(std::string_view unif_name, float val1, float val2, float val3) const;
+        void  set_uniform_value(std::string_view unif_name, float val1, float val2, float val3, float val4) const;
         void  set_uniform_value(std::string_view unif_name, const float* matrix_val) const;
         const std::unordered_map<std::string_view, Attribute>& get_attrs() const;
         const std::unordered_map<std::string_view, Uniform>& get_unifs() const;
-        void  use() const { glUseProgram(_program_id); }
+        void  use() const { glUseProgram(is_on_fallback() ? _fallback->_program_id : _program_id); }
         void  un_use() const { glUseProgram(0); }
         uint32_t get_id() const { return _program_id; }
 
+        // starts rebuilding from the shader files it was made from in the background, the current program stays in
+        // use until update swaps in the rebuilt one; false if a file can't be read
+        bool  reload();
+        // between frames: a finished build that linked replaces the current program, its uniform values copied
+        // over and uniform locations looked up again; true if a program was swapped in
+        bool  update();
+        bool  is_building() const { return _building_id != 0; }
+        const std::string& get_vertex_path() const { return _vertex_path; }
+        const std::string& get_fragment_path() const { return _fragment_path; }
+
     private:
+        // a value set while on the fallback, 'type' is GL_INT, GL_FLOAT, GL_FLOAT_VEC3, GL_FLOAT_VEC4 or GL_FLOAT_MAT4
+        struct DeferredUniform {
+            std::string     name;
+            GLenum          type;
+            int32_t         int_value{ 0 };
+            float           values[16]{};
+        };
+
+        bool  is_on_fallback() const { return _program_id == 0 && _fallback; }
+        // cancels the build in flight and deletes the program
+        void  destroy();
+        void  defer_uniform_value(std::string_view unif_name, GLenum type, int32_t int_value, const float* values) const;
+
         std::unordered_map<std::string_view, Attribute>         _attrs;
         std::unordered_map<std::string_view, Uniform>           _unifs;
         uint32_t                                                _program_id{ 0 };
+        // the build in flight, the first one or a reload
+        uint32_t                                                _building_id{ 0 };
+        const Program*                                          _fallback{ nullptr };
+        std::string                                             _vertex_path;
+        std::string                                             _fragment_path;
+        mutable std::vector<DeferredUniform>                    _deferred_uniforms;
     };
 
     class Renderer {
@@ -117,10 +254,40 @@ namespace my_gl {
             math::Matrix44<float>&&                             view_mat,
             math::Matrix44<float>&&                             proj_mat
         );
+        // spatial index keeps pointers into the object vectors
+        Renderer(const Renderer& rhs) = delete;
+        Renderer& operator=(const Renderer& rhs) = delete;
+        ~Renderer();
 
         void render(float time_0to1);
         void update_time(Duration_sec frame_time);
         Duration_sec get_curr_rendering_duration() const;
+        // closest primitive whose world bounds are hit by the ray, nullptr if none
+        GeometryObjectPrimitive* pick(const math::Ray& ray, float t_max = 1000.0f) const;
+        // primitives (including ones of complex objects) whose world bounds overlap 'box'
+        void query_overlap(const math::Aabb& box, std::vector<GeometryObjectPrimitive*>& out) const;
+        // counts of the last rendered frame
+        const OcclusionCuller::Stats& get_occlusion_stats() const { return _occlusion_culler.get_stats(); }
+        // gpu query counts of the last rendered frame
+        const OcclusionQueries& get_occlusion_queries() const { return *_occlusion_queries; }
+        const meshes::MeshletCullStats& get_meshlet_stats() const { return _meshlet_stats; }
+        // primitives drawn with 'program' go through the gpu driven path using 'indirect_program' instead,
+        // which reads its model matrix from the object buffer (see shaders/vertShaderIndirect.glsl)
+        void set_indirect_program(const Program& program, const Program& indirect_program);
+        // nullptr until the gpu driven path was built
+        const GpuCuller* get_gpu_culler() const { return _gpu_culler.get(); }
+        // visible textured primitives with a uv density report the mips they need to 'streamer' every frame,
+        // TextureStreamer::update still has to be called; nullptr stops the requests
+        void set_texture_streamer(TextureStreamer* streamer) { _texture_streamer = streamer; }
+        // merges non-animated primitives sharing program and textures into world space batches stored in 'arena',
+        // 'sources' gives the mesh every VertexArray was built from, primitives of other vaos are left alone
+        // the planar layout comes from the arena format, only the chunking fields of 'options' are used
+        // call once before rendering, returns the number of batches created
+        std::size_t bake_static_batches(
+            MeshArena&                                                                  arena,
+            const std::vector<std::pair<const VertexArray*, meshes::MeshView>>&         sources,
+            const meshes::StaticBatchOptions&                                           options = {}
+        );
 
         std::vector<my_gl::GeometryObjectComplex>           _complex_objs;
         std::vector<my_gl::GeometryObjectPrimitive>         _primitives;
@@ -128,5 +295,43 @@ namespace my_gl {
         math::Matrix44<float>                               _proj_mat;
         Timepoint_sec                                       _rendering_time_curr;
         Timepoint_sec                                       _rendering_time_start;
+        bool                                                occlusion_culling_enabled{ true };
+        // primitives with at least this many indices are drawn through hardware occlusion queries
+        std::size_t                                         gpu_occlusion_min_indices{ 1024 };
+        // largest on screen deviation a coarser lod may introduce, and the extra margin needed before switching to it
+        float                                               lod_threshold_px{ 1.0f };
+        float                                               lod_hysteresis{ 0.25f };
+        bool                                                meshlet_culling_enabled{ true };
+        bool                                                gpu_driven_enabled{ true };
+
+    private:
+        void build_spatial_index();
+        void update_spatial_index();
+        // drops visible ids hidden behind primitives flagged as occluders
+        void cull_occluded(const math::Matrix44<float>& view_proj_mat);
+        // screen pixels one world unit covers at the nearest point of 'bounds'
+        float px_per_unit(const math::Aabb& bounds) const;
+        void select_lods();
+        void request_texture_mips();
+        void cull_meshlets(const math::Frustum& frustum);
+        void build_gpu_driven();
+
+        // flat view over every primitive, indices into it are the bvh item ids
+        std::vector<GeometryObjectPrimitive*>               _scene_primitives;
+        std::vector<math::Aabb>                             _scene_bounds;
+        std::vector<uint32_t>                               _animated_ids;
+        std::vector<uint32_t>                               _visible_ids;
+        Bvh                                                 _static_bvh;
+        Bvh                                                 _dynamic_bvh;
+        OcclusionCuller                                     _occlusion_culler;
+        std::unique_ptr<OcclusionQueries>                   _occlusion_queries;
+        meshes::MeshletCullStats                            _meshlet_stats;
+        std::unordered_map<const Program*, const Program*>  _indirect_programs;
+        std::unique_ptr<GpuCuller>                          _gpu_culler;
+        // per scene primitive, set when the gpu culler owns it
+        std::vector<uint8_t>                                _gpu_driven;
+        bool                                                _gpu_driven_dirty{ false };
+        std::vector<std::unique_ptr<VertexArray>>           _batch_vaos;
+        TextureStreamer*                                    _texture_streamer{ nullptr };
     };
 }
@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace my_gl {
+    class Program;
+
+    // hot reload of the shader files of a directory, watched with inotify
+    // update runs between two frames: it reads what changed without blocking, starts rebuilding every watched program
+    // made from a changed file in the background (Program::reload) and swaps in the rebuilds that finished, so a
+    // frame never draws with half of a reload; a rebuild that fails to compile keeps the program it would replace
+    // it also swaps in the first build of watched programs built in the background, gl thread only
+    class ShaderWatcher {
+    public:
+        struct Stats {
+            // change events of watched files and rebuilds started because of them
+            uint32_t        changes{ 0 };
+            uint32_t        reloads{ 0 };
+            // builds swapped in, first builds included, and builds that failed
+            uint32_t        swapped{ 0 };
+            uint32_t        failed{ 0 };
+        };
+
+        // nothing is watched if inotify can't watch 'directory', update still swaps in finished builds
+        explicit ShaderWatcher(std::string directory = "shaders");
+        ShaderWatcher(const ShaderWatcher& rhs) = delete;
+        ShaderWatcher& operator=(const ShaderWatcher& rhs) = delete;
+        ~ShaderWatcher();
+
+        // 'program' has to outlive the watcher
+        void            watch(Program& program);
+        // once per frame, after swapping buffers; the number of programs swapped in
+        uint32_t        update();
+        bool            is_watching() const { return _watch >= 0; }
+        const Stats&    get_stats() const { return _stats; }
+
+    private:
+        // names of the files written or moved into the directory since the last call
+        std::vector<std::string> read_changes();
+
+        std::string             _directory;
+        int                     _fd{ -1 };
+        int                     _watch{ -1 };
+        std::vector<Program*>   _programs;
+        Stats                   _stats;
+    };
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bounds.hpp"
+#include "matrix.hpp"
+#include "meshes.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        // a non-animated primitive going into a batch: an index range of its source mesh and its model matrix
+        struct BatchInstance {
+            MeshView                mesh;
+            std::size_t             buffer_byte_offset;
+            std::size_t             index_count;
+            math::Matrix44<float>   model_mat;
+        };
+
+        struct StaticBatchOptions {
+            // components of every planar attribute block after the positions (texcoords, colors, normals by default)
+            std::vector<uint16_t>   attrib_counts{ 2, 3, 3 };
+            // block of attrib_counts transformed as normals, -1 if there is none
+            int32_t                 normal_attrib{ 2 };
+            // a batch is one cull unit: split until it is at most this large, in indices and in world units
+            std::size_t             max_indices{ 6144 };
+            float                   max_extent{ 16.0f };
+        };
+
+        // groups instances into spatially compact chunks, returns indices into 'world_bounds'
+        // chunks never exceed options.max_indices unless a single instance does, so baked chunks fit 16 bit indices
+        std::vector<std::vector<uint32_t>>  split_static_batches(const std::vector<math::Aabb>& world_bounds, const std::vector<std::size_t>& index_counts, const StaticBatchOptions& options = {});
+
+        // world space mesh of the instances with the same planar layout as the sources:
+        // positions and normals are transformed, the other blocks copied, only referenced vertices are kept
+        // and indices are rebased onto them
+        Mesh                                bake_static_batch(const std::vector<BatchInstance>& instances, const StaticBatchOptions& options = {});
+    }
+}
@@ -1,14 +1,43 @@
 #pragma once
 #include <stdint.h>
+#include <cstddef>
+#include <memory>
 #include <STB_IMG/stb_image.h>
 #include <GL/glew.h>
 
 namespace my_gl {
+    class AssetCache;
+    class KtxFile;
     class Program;
+    class TextureLoader;
+    class TextureStreamer;
     struct Uniform;
 
     class Texture {
     public:
+        // the gl texture, shared by copies of a Texture and filled in once the image is resident
+        struct State {
+            State() = default;
+            State(const State& rhs) = delete;
+            State& operator=(const State& rhs) = delete;
+            ~State();
+
+            uint32_t    id{ 0 };
+            GLenum      target{ GL_TEXTURE_2D };
+            int         width{ 0 };
+            int         height{ 0 };
+            int         color_channels{ 0 };
+            bool        mipmapped{ false };
+            // GL_REPEAT, cpu made mips wrap around the edges
+            bool        repeats{ false };
+            bool        resident{ false };
+        };
+
+        // decodes and uploads right away on the calling thread
+        // .ktx2 files (see ktxFile.hpp) upload their stored mips as they are, compressed ones are decompressed
+        // on the cpu when the driver lacks the format
+        // other images with a mipmapping min filter load their chain from generate_mips_cached (textureMips.hpp),
+        // the first load writes it next to the image; glGenerateMipmap is only the fallback
         Texture(
             const char* path,
             const Program& program,
@@ -20,6 +49,39 @@ namespace my_gl {
             GLenum min_filter_option = GL_LINEAR_MIPMAP_LINEAR,
             GLenum mag_filter_option = GL_LINEAR
         );
+        // decodes on the loader's pool, binds the loader's placeholder until TextureLoader::update uploaded it
+        Texture(
+            const char* path,
+            TextureLoader& loader,
+            const Program& program,
+            const Uniform* const sampler_uniform,
+            uint32_t sampler_uniform_value,
+            GLenum texture_unit,
+            GLenum wrap_option = GL_REPEAT,
+            GLenum min_filter_option = GL_LINEAR_MIPMAP_LINEAR,
+            GLenum mag_filter_option = GL_LINEAR
+        );
+        // mip levels stream in and out with what the screen needs (see TextureStreamer), binds the streamer's
+        // placeholder until the coarse tail of the chain is resident
+        Texture(
+            const char* path,
+            TextureStreamer& streamer,
+            const Program& program,
+            const Uniform* const sampler_uniform,
+            uint32_t sampler_uniform_value,
+            GLenum texture_unit,
+            GLenum wrap_option = GL_REPEAT,
+            GLenum min_filter_option = GL_LINEAR_MIPMAP_LINEAR,
+            GLenum mag_filter_option = GL_LINEAR
+        );
+        // shares the gl texture of 'texture', bound to another unit and sampler
+        Texture(
+            const Texture& texture,
+            const Program& program,
+            const Uniform* const sampler_uniform,
+            uint32_t sampler_uniform_value,
+            GLenum texture_unit
+        );
         Texture(const Texture& rhs) = default;
         Texture(Texture&& rhs) = default;
         Texture& operator=(const Texture& rhs) = default;
@@ -27,21 +89,30 @@ namespace my_gl {
 
         void        bind() const;
         void        un_bind() const;
-        uint32_t    id() const { return _id; }
-        uint8_t*    data() const { return _data; }
-        int         width() const { return _width; }
-        int         height() const { return _height; }
-        int         depth() const { return _depth; }
-        int         color_channels() const { return _color_channels; }
+        bool        is_resident() const { return _state->resident; }
+        uint32_t    id() const { return _state->id; }
+        // 0 until resident
+        int         width() const { return _state->width; }
+        int         height() const { return _state->height; }
+        int         depth() const { return _3d ? 1 : 0; }
+        int         color_channels() const { return _state->color_channels; }
 
     private:
-        uint8_t*    _data;
-        uint32_t    _id;
-        GLenum      _texture_unit;
-        int         _width;
-        int         _height;
-        int         _depth;
-        int         _color_channels;
-        bool        _3d;
+        friend class AssetCache;
+        friend class TextureLoader;
+        friend class TextureStreamer;
+
+        void        init(const Program& program, const Uniform* const sampler_uniform, uint32_t sampler_uniform_value, GLenum wrap_option, GLenum min_filter_option, GLenum mag_filter_option);
+        // immutable storage sized for the image, 'pixels' is a pointer or an offset into the bound unpack buffer
+        static void store(State& state, int width, int height, int color_channels, const void* pixels);
+        // every stored level of 'file', the full chain is generated when only level 0 is there and the format allows it
+        // 'staged': the file's levels are also back to back, level 0 first, at 'staged_offset' of the bound pixel
+        // unpack buffer and upload from there; levels decompressed on the cpu still read the mapping
+        static void store(State& state, const KtxFile& file, bool staged = false, std::size_t staged_offset = 0);
+
+        std::shared_ptr<State>  _state;
+        uint32_t                _placeholder_id{ 0 };
+        GLenum                  _texture_unit;
+        bool                    _3d;
     };
 }
@@ -0,0 +1,86 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "textureMips.hpp"
+#include "threadPool.hpp"
+
+namespace my_gl {
+    // where one packed image lives: layer 'layer' of the array bound to 'texture_unit', at uv * uv_scale + uv_offset
+    // primitives carry this instead of Texture bindings, see GeometryObjectPrimitive::set_texture_slot
+    struct TextureSlot {
+        // -1 for images that failed to load
+        int32_t     texture_unit{ -1 };
+        uint32_t    layer{ 0 };
+        float       uv_scale[2]{ 1.0f, 1.0f };
+        float       uv_offset[2]{ 0.0f, 0.0f };
+
+        bool is_valid() const { return texture_unit >= 0; }
+        bool operator==(const TextureSlot& rhs) const = default;
+    };
+
+    struct TextureArrayOptions {
+        // images of one channel count and size get an array of their own from this many on,
+        // the rest share atlas pages
+        uint32_t        min_array_layers{ 2 };
+        // side of an atlas page, images that don't fit one get a single layer array
+        uint32_t        atlas_size{ 2048 };
+        // texels of edge repeated around every atlas rect, atlas mips stop at the level where it is one texel
+        uint32_t        atlas_padding{ 8 };
+        GLenum          wrap_option{ GL_REPEAT };
+        GLenum          min_filter_option{ GL_LINEAR_MIPMAP_LINEAR };
+        GLenum          mag_filter_option{ GL_LINEAR };
+        // how the cpu builds the mips, 'wrap' also makes atlas padding repeat the opposite edge
+        MipOptions      mip_options{ .wrap = true };
+    };
+
+    // packs images into GL_TEXTURE_2D_ARRAYs, one per channel count and layer size, so draws with different
+    // textures need no bind in between: every array stays bound to its own unit and shaders pick the layer and
+    // uv transform per draw or per instance (shaders/fragShaderArray.glsl)
+    // same sized images become layers as they are; odd sizes go into padded atlas pages, shaders wrap their uvs
+    // inside the rect with fract() and sample with textureGrad, so repeating across the rect has no mip seams
+    class TextureArrays {
+    public:
+        struct Stats {
+            uint32_t        images{ 0 };
+            uint32_t        failed{ 0 };
+            uint32_t        arrays{ 0 };
+            uint32_t        layers{ 0 };
+            // images sharing atlas pages rather than owning a layer
+            uint32_t        atlased{ 0 };
+            uint32_t        atlas_pages{ 0 };
+            // share of atlas page texels covered by images, padding counts as unused
+            float           atlas_occupancy{ 0.0f };
+            // every level of every array
+            std::size_t     bytes{ 0 };
+        };
+
+        // decodes 'paths' on 'pool' and uploads them, slot(i) is where paths[i] ended up
+        // whole image layers load their mips from generate_mips_cached (textureMips.hpp), atlas pages filter theirs
+        // arrays take the units first_unit, first_unit + 1, ... (indices, not GL_TEXTURE0 + i)
+        TextureArrays(
+            const std::vector<std::string>&     paths,
+            GLuint                              first_unit,
+            const TextureArrayOptions&          options = {},
+            ThreadPool&                         pool = ThreadPool::shared()
+        );
+        TextureArrays(const TextureArrays& rhs) = delete;
+        TextureArrays& operator=(const TextureArrays& rhs) = delete;
+        ~TextureArrays();
+
+        // binds every array to its unit again, after other textures were bound there
+        void                bind() const;
+        const TextureSlot&  slot(std::size_t image) const { return _slots[image]; }
+        std::size_t         array_count() const { return _arrays.size(); }
+        GLuint              array_id(std::size_t array) const { return _arrays[array]; }
+        const Stats&        get_stats() const { return _stats; }
+
+    private:
+        GLuint                      _first_unit;
+        std::vector<GLuint>         _arrays;
+        std::vector<TextureSlot>    _slots;
+        Stats                       _stats;
+    };
+}
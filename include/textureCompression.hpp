@@ -0,0 +1,68 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "threadPool.hpp"
+
+namespace my_gl {
+    // 4x4 block formats the cpu compressor writes, all linear (unorm)
+    // BC3 and BC7 keep alpha, BC4 and BC5 store one and two channels (grey maps, normal maps)
+    // BC7 only uses mode 6 (one rgba endpoint pair, 16 levels), ETC2_RGB only the ETC1 compatible modes
+    enum class BlockFormat : uint8_t {
+        BC1,
+        BC3,
+        BC4,
+        BC5,
+        BC7,
+        ETC2_RGB,
+    };
+
+    // KTX2 / Vulkan format value
+    uint32_t        block_format_vk(BlockFormat format);
+    // false for formats that aren't one of ours
+    bool            find_block_format(uint32_t vk_format, BlockFormat& format);
+    const char*     block_format_name(BlockFormat format);
+    std::size_t     block_format_bytes(BlockFormat format);
+    // of the current context: S3TC is an extension, the others are core in 4.3
+    bool            is_block_format_supported(BlockFormat format);
+    // BC4 for grey, BC5 for two channels, BC1 for rgb, BC7 with alpha
+    BlockFormat     default_block_format(int color_channels);
+
+    // 'rgba' is width * height 8 bit rgba pixels, edge blocks repeat the last row and column
+    // block rows are spread over 'pool'
+    std::vector<uint8_t>    compress_blocks(const uint8_t* rgba, int width, int height, BlockFormat format, ThreadPool& pool = ThreadPool::shared());
+    // writes width * height rgba pixels, channels a format doesn't store come out as 0 (alpha 255)
+    // reads what compress_blocks writes, other BC7 modes and the ETC2 T, H and planar modes aren't decoded
+    void                    decompress_blocks(const uint8_t* blocks, int width, int height, BlockFormat format, uint8_t* rgba);
+
+    struct TextureCompressionStats {
+        int             width{ 0 };
+        int             height{ 0 };
+        uint32_t        levels{ 0 };
+        std::size_t     compressed_bytes{ 0 };
+        // 8 bit rgba level 0 / compressed level 0
+        double          ratio{ 0.0 };
+        // level 0, over the channels the format stores
+        double          psnr_db{ 0.0 };
+        double          encode_ms{ 0.0 };
+        double          megapixels_per_s{ 0.0 };
+    };
+
+    // 'image_path' + ".<format>.ktx2", e.g. res/face.png.bc7.ktx2
+    std::string     compressed_texture_path(const char* image_path, BlockFormat format);
+    // compresses 'image_path' with its full mip chain (generate_mips, color formats filtered in linear light) into
+    // compressed_texture_path, unless that file already holds the current content of the image; returns the ktx2 path,
+    // empty if the image or the file can't be read or written
+    // 'stats' are only filled in when compressing
+    std::string     compress_texture_cached(
+        const char*                 image_path,
+        BlockFormat                 format,
+        ThreadPool&                 pool = ThreadPool::shared(),
+        TextureCompressionStats*    stats = nullptr
+    );
+
+    // compresses level 0 of 'image_path' 'repeats' times without writing anything, for quality and throughput
+    TextureCompressionStats measure_texture_compression(const char* image_path, BlockFormat format, ThreadPool& pool = ThreadPool::shared(), int repeats = 4);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include "texture.hpp"
+#include "threadPool.hpp"
+
+namespace my_gl {
+    // decodes images on a worker pool and uploads them on the gl thread through a persistently mapped
+    // pixel unpack buffer, textures bind a 1x1 placeholder until theirs is resident
+    // needs GL 4.4 (buffer storage), must outlive the textures it loads and be used from the gl thread only
+    class TextureLoader {
+    public:
+        struct Stats {
+            uint32_t        requested{ 0 };
+            uint32_t        uploaded{ 0 };
+            uint32_t        failed{ 0 };
+            std::size_t     uploaded_bytes{ 0 };
+            // uploads that had to wait for the gpu to finish reading an older one out of the staging buffer
+            uint32_t        staging_stalls{ 0 };
+            // images bigger than the staging buffer, uploaded from client memory instead
+            uint32_t        unstaged{ 0 };
+        };
+
+        explicit TextureLoader(ThreadPool& pool = ThreadPool::shared(), std::size_t staging_bytes = 32u << 20);
+        TextureLoader(const TextureLoader& rhs) = delete;
+        TextureLoader& operator=(const TextureLoader& rhs) = delete;
+        ~TextureLoader();
+
+        // called by the async Texture constructor
+        void            request(const std::shared_ptr<Texture::State>& texture, const char* path);
+        // once per frame: uploads decoded images until 'byte_budget' pixel bytes went out (at least one image),
+        // returns the number of textures that became resident
+        uint32_t        update(std::size_t byte_budget = 16u << 20);
+        // uploads everything requested so far, blocks until the pool decoded it (loading screens)
+        void            finish();
+
+        uint32_t        pending() const { return _pending; }
+        GLuint          placeholder_id() const { return _placeholder; }
+        const Stats&    get_stats() const { return _stats; }
+
+    private:
+        struct Queue;
+
+        struct InFlight {
+            std::size_t     begin;
+            std::size_t     end;
+            GLsync          fence;
+        };
+
+        // waits for every upload still reading [begin, begin + size) of the staging buffer
+        void            retire(std::size_t begin, std::size_t size);
+        std::size_t     allocate(std::size_t size);
+
+        ThreadPool&                 _pool;
+        std::shared_ptr<Queue>      _queue;
+        GLuint                      _placeholder{ 0 };
+        GLuint                      _staging{ 0 };
+        uint8_t*                    _staging_data{ nullptr };
+        std::size_t                 _staging_size{ 0 };
+        std::size_t                 _staging_head{ 0 };
+        std::deque<InFlight>        _in_flight;
+        uint32_t                    _pending{ 0 };
+        Stats                       _stats;
+    };
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "threadPool.hpp"
+
+namespace my_gl {
+    // separable downsampling kernels, sharpest last; box is what glGenerateMipmap does on most drivers
+    enum class MipFilter : uint8_t {
+        Box,
+        Triangle,
+        // B = C = 1/3 cubic
+        Mitchell,
+        // windowed sinc, 3 texels of the smaller level to each side
+        Kaiser,
+    };
+
+    struct MipOptions {
+        MipFilter   filter{ MipFilter::Kaiser };
+        // color channels hold sRGB encoded values, they are filtered in linear light and encoded again;
+        // alpha is always linear, data maps (normals, roughness) want this off
+        bool        srgb{ true };
+        // color weighted by alpha, fully transparent texels don't bleed their color into visible ones
+        bool        alpha_weighted{ true };
+        // taps past an edge wrap around instead of repeating the edge texel, for GL_REPEAT textures
+        bool        wrap{ false };
+    };
+
+    struct MipStats {
+        int         width{ 0 };
+        int         height{ 0 };
+        uint32_t    levels{ 0 };
+        double      generate_ms{ 0.0 };
+        // level 0 megapixels per second, the whole chain counted against it
+        double      megapixels_per_s{ 0.0 };
+    };
+
+    // the full chain down to 1x1, level 0 (a copy of 'pixels') first, every level has the input's 1 to 4 8 bit channels
+    // 2 channels are grey + alpha like stb_image returns them; levels are filtered in float from the previous one,
+    // rows spread over 'pool', and each level is written out to 8 bit while the next one is filtered
+    std::vector<std::vector<uint8_t>> generate_mips(
+        const uint8_t*      pixels,
+        int                 width,
+        int                 height,
+        int                 channels,
+        const MipOptions&   options = {},
+        ThreadPool&         pool = ThreadPool::shared()
+    );
+
+    // 'image_path' + ".mips.ktx2", e.g. res/face.png.mips.ktx2
+    std::string     mipmapped_texture_path(const char* image_path);
+    // writes the generate_mips chain of 'image_path' into mipmapped_texture_path as an uncompressed KTX2
+    // (R8 to RGBA8 unorm, the values stay encoded as in the image), unless that file already holds it for the
+    // image's current content and 'options'; returns the ktx2 path, empty if the image or the file can't be
+    // read or written. 'stats' are only filled in when generating
+    std::string     generate_mips_cached(
+        const char*         image_path,
+        const MipOptions&   options = {},
+        ThreadPool&         pool = ThreadPool::shared(),
+        MipStats*           stats = nullptr
+    );
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "meshes.hpp"
+#include "texture.hpp"
+#include "threadPool.hpp"
+
+namespace my_gl {
+    // uv units covered by one object space unit of a primitive's surface, sqrt(uv area / surface area) over its
+    // triangles; 0 when the format has no 'uv_name' element or the triangles are degenerate
+    // 'index_offset' and 'index_count' count indices of 'mesh', the defaults cover all of them
+    float uv_density(
+        meshes::MeshView                            mesh,
+        const std::vector<meshes::VertexElement>&   format,
+        std::size_t                                 index_offset = 0,
+        std::size_t                                 index_count = static_cast<std::size_t>(-1),
+        std::string_view                            uv_name = "a_tex"
+    );
+
+    // keeps only the mip levels of textures that the screen needs resident, under a memory budget
+    // every frame the renderer reports how many uv units one pixel covers on each visible primitive (request), update
+    // turns that into the finest level each texture needs, reads missing levels on the pool and uploads them one
+    // level at a time, and frees the finest levels of textures that need less when the budget runs out
+    // levels are defined one by one (mutable storage), GL_TEXTURE_BASE_LEVEL / GL_TEXTURE_MAX_LEVEL clamp sampling to
+    // the resident ones; the coarse tail up to 'tail_size' texels stays resident so there is always a texture to sample
+    // sources are the mip chains of generate_mips_cached or .ktx2 files; gl thread only, must outlive its textures
+    class TextureStreamer {
+    public:
+        struct Stats {
+            // streamed textures still alive
+            uint32_t        textures{ 0 };
+            uint32_t        failed{ 0 };
+            // files being prepared plus levels being read on the pool or waiting for upload
+            uint32_t        pending_requests{ 0 };
+            // every level defined on the gpu, the resident tails included
+            std::size_t     resident_bytes{ 0 };
+            std::size_t     budget_bytes{ 0 };
+            uint32_t        streamed_levels{ 0 };
+            uint32_t        evicted_levels{ 0 };
+            std::size_t     uploaded_bytes{ 0 };
+            // textures of the last update that wanted a finer level than the budget had room for
+            uint32_t        starved{ 0 };
+        };
+
+        explicit TextureStreamer(std::size_t budget_bytes = 256u << 20, ThreadPool& pool = ThreadPool::shared(), int tail_size = 64);
+        TextureStreamer(const TextureStreamer& rhs) = delete;
+        TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+        ~TextureStreamer();
+
+        // called by the streamed Texture constructor
+        void            add(const std::shared_ptr<Texture::State>& texture, const char* path);
+        // 'uv_per_px': uv units one screen pixel covers where 'texture' is drawn (see GeometryObjectPrimitive::get_uv_per_px),
+        // the smallest value reported since the last update wins
+        void            request(const Texture& texture, float uv_per_px);
+        // once per frame after the requests: uploads finished reads until 'byte_budget' bytes went out, evicts what
+        // the budget needs and starts reads of the next finer level of textures that need one
+        void            update(std::size_t byte_budget = 8u << 20);
+        // loads every requested level, blocks until the pool read them (loading screens, tests)
+        void            finish();
+
+        void            set_budget(std::size_t budget_bytes) { _stats.budget_bytes = budget_bytes; }
+        GLuint          placeholder_id() const { return _placeholder; }
+        const Stats&    get_stats() const { return _stats; }
+        // finest resident level of 'texture', -1 while it isn't resident
+        int             resident_level(const Texture& texture) const;
+
+        // added to the computed level, positive values stream less
+        float           mip_bias{ 0.0f };
+        // updates a texture keeps its levels after its last request before they count as unused
+        uint32_t        keep_frames{ 60 };
+        // level reads in flight at once
+        uint32_t        max_reads{ 16 };
+
+    private:
+        struct Queue;
+        struct Entry;
+
+        // defines 'level' of 'entry' from 'data' and makes it the base level
+        void            upload(Entry& entry, uint32_t level, std::span<const uint8_t> data);
+        void            evict(Entry& entry);
+        void            read(uint32_t entry_index, uint32_t level);
+        void            receive(std::size_t byte_budget);
+        // evicts what the budget needs and starts reads, from the wanted levels of the last update
+        void            plan();
+
+        ThreadPool&                                         _pool;
+        std::shared_ptr<Queue>                              _queue;
+        GLuint                                              _placeholder{ 0 };
+        int                                                 _tail_size;
+        uint64_t                                            _frame{ 0 };
+        std::vector<std::unique_ptr<Entry>>                 _entries;
+        std::unordered_map<const Texture::State*, uint32_t> _entry_of;
+        // bytes of levels being read, counted against the budget before they arrive
+        std::size_t                                         _reserved_bytes{ 0 };
+        Stats                                               _stats;
+    };
+}
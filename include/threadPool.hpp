@@ -0,0 +1,35 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace my_gl {
+    class ThreadPool {
+    public:
+        explicit ThreadPool(uint32_t thread_count = std::thread::hardware_concurrency());
+        ThreadPool(const ThreadPool& rhs) = delete;
+        ThreadPool& operator=(const ThreadPool& rhs) = delete;
+        ~ThreadPool();
+
+        void        submit(std::function<void()>&& job);
+        // runs fn(i) for every i in [0, count) and blocks until all are done, the calling thread helps out
+        void        parallel_for(uint32_t count, const std::function<void(uint32_t)>& fn);
+        uint32_t    size() const { return static_cast<uint32_t>(_workers.size()); }
+
+        // process wide pool, created on first use
+        static ThreadPool& shared();
+
+    private:
+        void worker_loop();
+
+        std::vector<std::thread>                _workers;
+        std::deque<std::function<void()>>       _jobs;
+        std::mutex                              _mutex;
+        std::condition_variable                 _cv;
+        bool                                    _stopping{ false };
+    };
+}
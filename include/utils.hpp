@@ -2,6 +2,8 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <concepts>
+#include <string>
+#include <vector>
 #include "vec.hpp"
 #include "window.hpp"
 
@@ -10,7 +12,14 @@ namespace my_gl {
     void          init_GLFW();
     void          init_GLEW();
     GLuint        create_shader(GLenum shaderType, const char* filePath);
-    GLuint        create_program(const char* vertexShaderFilePath, const char* fragmentShaderFilePath);    
+    // 'filePath' only names the shader in the error log
+    GLuint        compile_shader(GLenum shaderType, const char* source, const char* filePath);
+    // prints the info log of a shader that failed to compile
+    void          print_shader_log(GLuint shaderId, GLenum shaderType, const char* filePath);
+    // linked from the ProgramCache when it holds a binary for these sources and this driver, compiled otherwise
+    // 'defines' are "NAME" or "NAME VALUE", inserted after the #version line of every stage
+    GLuint        create_program(const char* vertexShaderFilePath, const char* fragmentShaderFilePath, const std::vector<std::string>& defines = {});
+    GLuint        create_compute_program(const char* computeShaderFilePath, const std::vector<std::string>& defines = {});
     void          callback_debug_message(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* msg, const void* data);
     void          callback_framebuffer_size(GLFWwindow* window, int width, int height);
     void          callback_keyboard(GLFWwindow* window, int key, int scancode, int action, int mode);
@@ -0,0 +1,61 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "meshes.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        enum class VertexLayoutType {
+            // one stream per element, the layout of Mesh itself
+            PLANAR,
+            // one stream, all elements of a vertex next to each other: one cache line per vertex fetch
+            INTERLEAVED,
+            // positions alone in stream 0 for position only passes (depth, occlusion proxies), the rest interleaved in stream 1
+            HOT_COLD,
+        };
+
+        struct LayoutElement {
+            const char*     name;
+            // components in the mesh
+            uint16_t        count;
+            VertexEncoding  encoding;
+            uint16_t        stream;
+            // inside one vertex of the stream
+            uint16_t        byte_offset;
+            // what glVertexAttribPointer gets
+            GLenum          gl_type;
+            uint16_t        attrib_count;
+            bool            normalized;
+        };
+
+        // where every element of a format lives once converted
+        // streams are stored one after another in a single buffer, each sized for the vertex count of the mesh
+        struct VertexLayout {
+            VertexLayoutType            type;
+            // in format order
+            std::vector<LayoutElement>  elements;
+            std::vector<uint16_t>       stream_strides;
+
+            // nullptr if the format has no element of that name
+            const LayoutElement*    find(std::string_view name) const;
+            std::size_t             stream_byte_offset(std::size_t stream, std::size_t vertex_count) const;
+            std::size_t             vertex_byte_size() const;
+        };
+
+        // maps stored positions back to object space: p = stored * scale + offset
+        struct Dequantize {
+            float   offset[3]{ 0.0f, 0.0f, 0.0f };
+            float   scale[3]{ 1.0f, 1.0f, 1.0f };
+        };
+
+        VertexLayout            make_vertex_layout(const std::vector<VertexElement>& format, VertexLayoutType type);
+        // planar float vertices of a mesh in 'format' encoded into the streams of 'layout'
+        // 'dequantize' receives the bounds UNORM16_BOUNDS positions were quantized against, identity otherwise
+        std::vector<uint8_t>    convert_vertices(std::span<const float> planar_vertices, const std::vector<VertexElement>& format, const VertexLayout& layout, Dequantize* dequantize = nullptr);
+        std::size_t             floats_per_vertex(const std::vector<VertexElement>& format);
+    }
+}
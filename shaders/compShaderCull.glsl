@@ -0,0 +1,76 @@
+#version 430
+
+layout(local_size_x = 64) in;
+
+struct Object {
+    mat4    model_mat;
+    vec4    bounds_min;
+    vec4    bounds_max;
+    // index count, first index, bucket, base vertex
+    uvec4   draw;
+    vec4    dequantize_scale;
+    vec4    dequantize_offset;
+    // uv scale, uv offset and layer of a packed texture
+    vec4    texture_transform;
+    uvec4   texture;
+};
+
+struct DrawCommand {
+    uint    count;
+    uint    instance_count;
+    uint    first_index;
+    int     base_vertex;
+    uint    base_instance;
+};
+
+layout(std430, row_major, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+layout(std430, binding = 1) writeonly buffer Commands {
+    DrawCommand commands[];
+};
+
+layout(std430, binding = 2) buffer DrawCounts {
+    uint draw_counts[];
+};
+
+layout(std430, binding = 3) readonly buffer BucketOffsets {
+    uint bucket_offsets[];
+};
+
+uniform vec4 u_frustum_planes[6];
+uniform uint u_object_count;
+uniform bool u_compact;
+
+void main() {
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= u_object_count) {
+        return;
+    }
+
+    vec3 bounds_min = objects[id].bounds_min.xyz;
+    vec3 bounds_max = objects[id].bounds_max.xyz;
+    uvec4 draw      = objects[id].draw;
+
+    bool visible = true;
+    for (int i = 0; i < 6; ++i) {
+        // corner furthest along the plane normal
+        vec3 corner = mix(bounds_min, bounds_max, greaterThanEqual(u_frustum_planes[i].xyz, vec3(0.0)));
+        if (dot(u_frustum_planes[i].xyz, corner) + u_frustum_planes[i].w < 0.0) {
+            visible = false;
+        }
+    }
+
+    // object id == command slot when not compacting
+    uint slot = id;
+    if (u_compact) {
+        if (!visible) {
+            return;
+        }
+        slot = bucket_offsets[draw.z] + atomicAdd(draw_counts[draw.z], 1u);
+    }
+
+    // base_instance feeds the per instance object id attribute
+    commands[slot] = DrawCommand(draw.x, visible ? 1u : 0u, draw.y, int(draw.w), id);
+}
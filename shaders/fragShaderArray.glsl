@@ -0,0 +1,40 @@
+#version 330
+
+flat    in vec3 passed_color;
+smooth  in vec3 passed_normal;
+smooth  in vec3 passed_frag_pos;
+smooth  in vec2 passed_tex;
+flat    in vec4 passed_texture_transform;
+flat    in int  passed_texture_layer;
+
+out vec4 output_color;
+
+uniform vec3            u_light_pos;
+uniform vec3            u_light_color;
+uniform vec3            u_view_pos;
+uniform sampler2DArray  u_texture_array;
+
+void main() {
+    float   ambient_coef        = 0.15;
+    float   shininess           = 16;
+    float   specular_intensity  = 0.8;
+
+    // atlas rects repeat inside themselves, the gradients of the unwrapped uvs keep fract's jump out of mip selection
+    vec2    uv_scale            = passed_texture_transform.xy;
+    vec2    tex_coord           = fract(passed_tex) * uv_scale + passed_texture_transform.zw;
+    vec4    texel               = textureGrad(
+        u_texture_array,
+        vec3(tex_coord, float(passed_texture_layer)),
+        dFdx(passed_tex) * uv_scale,
+        dFdy(passed_tex) * uv_scale
+    );
+
+    vec3    normal_normalized   = normalize(passed_normal);
+    vec3    light_dir           = normalize(u_light_pos - passed_frag_pos);
+    vec3    view_dir            = normalize(u_view_pos - passed_frag_pos);
+    vec3    reflect_dir         = reflect(-light_dir, normal_normalized);
+    float   diffuse_coef        = max(dot(light_dir, normal_normalized), 0.0);
+    float   specular_coef       = pow(max(dot(reflect_dir, view_dir), 0.0), shininess) * specular_intensity;
+    vec3    light_color_result  = u_light_color * (ambient_coef + diffuse_coef + specular_coef);
+    output_color                = vec4(passed_color * texel.rgb * light_color_result, texel.a);
+}
@@ -0,0 +1,30 @@
+#version 330
+
+flat    in vec3 passed_color;
+smooth  in vec3 passed_normal;
+smooth  in vec3 passed_frag_pos;
+smooth  in vec2 passed_tex;
+
+out vec4 output_color;
+
+uniform vec3        u_light_pos;
+uniform vec3        u_light_color;
+uniform vec3        u_view_pos;
+uniform sampler2D   u_texture;
+
+void main() {
+    float   ambient_coef        = 0.15;
+    float   shininess           = 16;
+    float   specular_intensity  = 0.8;
+
+    vec4    texel               = texture(u_texture, passed_tex);
+
+    vec3    normal_normalized   = normalize(passed_normal);
+    vec3    light_dir           = normalize(u_light_pos - passed_frag_pos);
+    vec3    view_dir            = normalize(u_view_pos - passed_frag_pos);
+    vec3    reflect_dir         = reflect(-light_dir, normal_normalized);
+    float   diffuse_coef        = max(dot(light_dir, normal_normalized), 0.0);
+    float   specular_coef       = pow(max(dot(reflect_dir, view_dir), 0.0), shininess) * specular_intensity;
+    vec3    light_color_result  = u_light_color * (ambient_coef + diffuse_coef + specular_coef);
+    output_color                = vec4(passed_color * texel.rgb * light_color_result, texel.a);
+}
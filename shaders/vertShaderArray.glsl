@@ -0,0 +1,31 @@
+#version 330
+
+layout(location = 0) in vec3 a_pos;
+layout(location = 1) in vec3 a_color;
+layout(location = 2) in vec3 a_normal;
+layout(location = 3) in vec2 a_tex;
+
+uniform mat4 u_model_view_mat;
+uniform mat4 u_normal_mat;
+uniform mat4 u_mvp_mat;
+// uv scale, uv offset and layer of the primitive's texture slot
+uniform vec4 u_texture_transform;
+uniform int  u_texture_layer;
+
+flat    out vec3 passed_color;
+smooth  out vec3 passed_normal;
+smooth  out vec3 passed_frag_pos;
+smooth  out vec2 passed_tex;
+flat    out vec4 passed_texture_transform;
+flat    out int  passed_texture_layer;
+
+void main() {
+    vec4 a_pos_homogen          =   vec4(a_pos, 1.0);
+    gl_Position                 =   u_mvp_mat * a_pos_homogen;
+    passed_frag_pos             =   vec3(u_model_view_mat * a_pos_homogen);
+    passed_color                =   a_color;
+    passed_normal               =   mat3(u_normal_mat) * a_normal;
+    passed_tex                  =   a_tex;
+    passed_texture_transform    =   u_texture_transform;
+    passed_texture_layer        =   u_texture_layer;
+}
@@ -0,0 +1,50 @@
+#version 430
+
+layout(location = 0) in vec3 a_pos;
+layout(location = 1) in vec3 a_color;
+layout(location = 2) in vec3 a_normal;
+layout(location = 3) in vec2 a_tex;
+// divisor 1, fetched at base_instance of the indirect command
+layout(location = 15) in uint a_object_id;
+
+struct Object {
+    mat4    model_mat;
+    vec4    bounds_min;
+    vec4    bounds_max;
+    uvec4   draw;
+    vec4    dequantize_scale;
+    vec4    dequantize_offset;
+    vec4    texture_transform;
+    uvec4   texture;
+};
+
+layout(std430, row_major, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+uniform mat4 u_view_mat;
+uniform mat4 u_view_proj_mat;
+
+flat    out vec3 passed_color;
+smooth  out vec3 passed_normal;
+smooth  out vec3 passed_frag_pos;
+smooth  out vec2 passed_tex;
+flat    out vec4 passed_texture_transform;
+flat    out int  passed_texture_layer;
+
+void main() {
+    mat4 model_mat              =   objects[a_object_id].model_mat;
+    mat4 model_view_mat         =   u_view_mat * model_mat;
+    mat3 normal_mat             =   transpose(inverse(mat3(model_view_mat)));
+
+    // quantized positions back to object space, normals don't go through this
+    vec3 object_pos             =   a_pos * objects[a_object_id].dequantize_scale.xyz + objects[a_object_id].dequantize_offset.xyz;
+    vec4 a_pos_homogen          =   vec4(object_pos, 1.0);
+    gl_Position                 =   u_view_proj_mat * model_mat * a_pos_homogen;
+    passed_frag_pos             =   vec3(model_view_mat * a_pos_homogen);
+    passed_color                =   a_color;
+    passed_normal               =   normal_mat * a_normal;
+    passed_tex                  =   a_tex;
+    passed_texture_transform    =   objects[a_object_id].texture_transform;
+    passed_texture_layer        =   int(objects[a_object_id].texture.x);
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "assetCache.hpp"
+#include "hash.hpp"
+#include "meshWeld.hpp"
+#include "objLoader.hpp"
+#include "textureLoader.hpp"
+
+namespace my_gl {
+    namespace {
+        // kinds seed their keys, a mesh and a texture of the same file stay apart
+        enum class AssetKind : uint32_t {
+            TEXTURE = 1,
+            PROGRAM,
+            MESH,
+        };
+
+        uint64_t key_seed(AssetKind kind) {
+            return hash_bytes(&kind, sizeof(kind));
+        }
+
+        // a vertex array only keeps the attribute bindings of its programs, program ids change with every build
+        uint64_t hash_programs(const std::vector<const Program*>& programs, uint64_t seed) {
+            for (const Program* program : programs) {
+                std::vector<const Attribute*> attribs;
+                for (const auto& [name, attrib] : program->get_attrs()) {
+                    attribs.push_back(&attrib);
+                }
+                // map order depends on insertion history, equal programs have to hash equal
+                std::sort(attribs.begin(), attribs.end(), [](const Attribute* lhs, const Attribute* rhs) {
+                    return std::strcmp(lhs->name, rhs->name) < 0;
+                });
+                for (const Attribute* attrib : attribs) {
+                    const uint32_t fields[]{ static_cast<uint32_t>(attrib->location), attrib->gl_type, attrib->count, attrib->byte_stride, attrib->byte_offset, attrib->normalized };
+                    seed = hash_bytes(attrib->name, std::strlen(attrib->name) + 1, seed);
+                    seed = hash_bytes(fields, sizeof(fields), seed);
+                }
+                // keeps the attributes of one program apart from the next one's
+                const uint32_t attrib_count{ static_cast<uint32_t>(attribs.size()) };
+                seed = hash_bytes(&attrib_count, sizeof(attrib_count), seed);
+            }
+            return seed;
+        }
+    }
+
+    AssetCache::AssetCache(std::size_t budget_bytes)
+        : _budget{ budget_bytes }
+    {}
+
+    Texture AssetCache::texture(
+        const char* path,
+        const Program& program,
+        const Uniform* const sampler_uniform,
+        uint32_t sampler_uniform_value,
+        GLenum texture_unit,
+        GLenum wrap_option,
+        GLenum min_filter_option,
+        GLenum mag_filter_option,
+        TextureLoader* loader
+    ) {
+        const auto load{ [&]() {
+            return loader
+                ? Texture{ path, *loader, program, sampler_uniform, sampler_uniform_value, texture_unit, wrap_option, min_filter_option, mag_filter_option }
+                : Texture{ path, program, sampler_uniform, sampler_uniform_value, texture_unit, false, wrap_option, min_filter_option, mag_filter_option };
+        } };
+
+        const uint64_t content{ content_hash(path) };
+        if (content == 0) {
+            ++_stats.uncached;
+            return load();
+        }
+
+        // the sampler state lives in the gl texture, so it is part of what gets shared
+        const GLenum options[]{ wrap_option, min_filter_option, mag_filter_option };
+        const uint64_t key{ hash_bytes(options, sizeof(options), hash_bytes(&content, sizeof(content), key_seed(AssetKind::TEXTURE))) };
+        if (Entry* entry{ find(key) }) {
+            return Texture{ *entry->texture, program, sampler_uniform, sampler_uniform_value, texture_unit };
+        }
+
+        Texture texture{ load() };
+        insert({ .key = key, .object = texture._state, .texture = texture });
+        return texture;
+    }
+
+    std::shared_ptr<const Program> AssetCache::program(
+        const char*                 vertex_shader_path,
+        const char*                 fragment_shader_path,
+        std::vector<Attribute>&&    attribs,
+        std::vector<Uniform>&&      uniforms
+    ) {
+        const uint64_t vertex_content{ content_hash(vertex_shader_path) };
+        const uint64_t fragment_content{ content_hash(fragment_shader_path) };
+        if (vertex_content == 0 || fragment_content == 0) {
+            ++_stats.uncached;
+            return std::make_shared<const Program>(vertex_shader_path, fragment_shader_path, std::move(attribs), std::move(uniforms));
+        }
+
+        uint64_t key{ key_seed(AssetKind::PROGRAM) };
+        key = hash_bytes(&vertex_content, sizeof(vertex_content), key);
+        key = hash_bytes(&fragment_content, sizeof(fragment_content), key);
+        for (const Attribute& attrib : attribs) {
+            const uint32_t fields[]{ attrib.gl_type, attrib.count, attrib.byte_stride, attrib.byte_offset, attrib.normalized };
+            key = hash_bytes(attrib.name, std::strlen(attrib.name) + 1, key);
+            key = hash_bytes(fields, sizeof(fields), key);
+        }
+        for (const Uniform& uniform : uniforms) {
+            key = hash_bytes(uniform.name, std::strlen(uniform.name) + 1, key);
+        }
+        if (Entry* entry{ find(key) }) {
+            return std::static_pointer_cast<const Program>(entry->object);
+        }
+
+        // the driver's binary isn't visible, the sources stand in for its size
+        const std::size_t bytes{ _path_hashes[vertex_shader_path].size + _path_hashes[fragment_shader_path].size };
+        const auto program{ std::make_shared<const Program>(vertex_shader_path, fragment_shader_path, std::move(attribs), std::move(uniforms)) };
+        insert({ .key = key, .object = program, .texture = std::nullopt, .bytes = bytes });
+        return program;
+    }
+
+    std::shared_ptr<const VertexArray> AssetCache::mesh(meshes::MeshView mesh, const std::vector<const Program*>& programs) {
+        uint64_t key{ key_seed(AssetKind::MESH) };
+        key = hash_bytes(mesh.vertices.data(), mesh.vertices.size_bytes(), key);
+        key = hash_bytes(mesh.indices.data(), mesh.indices.size_bytes(), key);
+        key = hash_programs(programs, key);
+        if (Entry* entry{ find(key) }) {
+            return std::static_pointer_cast<const VertexArray>(entry->object);
+        }
+
+        const auto vertex_array{ std::make_shared<const VertexArray>(mesh, programs) };
+        insert({ .key = key, .object = vertex_array, .texture = std::nullopt, .bytes = mesh.vertices.size_bytes() + mesh.indices.size_bytes() });
+        return vertex_array;
+    }
+
+    std::shared_ptr<const VertexArray> AssetCache::mesh(const char* obj_path, const std::vector<const Program*>& programs) {
+        const uint64_t content{ content_hash(obj_path) };
+        if (content == 0) {
+            ++_stats.uncached;
+            std::cerr << "failed to load mesh from path: " << obj_path << '\n';
+            return nullptr;
+        }
+
+        const uint64_t key{ hash_programs(programs, hash_bytes(&content, sizeof(content), key_seed(AssetKind::MESH))) };
+        if (Entry* entry{ find(key) }) {
+            return std::static_pointer_cast<const VertexArray>(entry->object);
+        }
+
+        meshes::ObjModel model;
+        if (!meshes::load_obj(obj_path, model)) {
+            ++_stats.uncached;
+            std::cerr << "failed to load mesh from path: " << obj_path << '\n';
+            return nullptr;
+        }
+        // load_obj merges corners by their v/vt/vn indices, exporters that repeat 'v' lines per face or per part
+        // still leave copies of one vertex behind
+        meshes::weld_vertices(model.mesh, meshes::cube_mesh_format);
+        const std::size_t bytes{ (model.mesh.vertices.size() + model.mesh.indices.size()) * sizeof(float) };
+        const auto vertex_array{ std::make_shared<const VertexArray>(std::move(model.mesh), programs) };
+        insert({ .key = key, .object = vertex_array, .texture = std::nullopt, .bytes = bytes });
+        return vertex_array;
+    }
+
+    void AssetCache::trim() {
+        // textures loaded asynchronously only know their size once resident
+        std::size_t total{ 0 };
+        for (Entry& entry : _lru) {
+            entry.bytes = entry_bytes(entry);
+            total += entry.bytes;
+        }
+
+        for (auto it = _lru.end(); it != _lru.begin() && total > _budget; ) {
+            --it;
+            if (is_held(*it)) {
+                continue;
+            }
+            total -= it->bytes;
+            _entries.erase(it->key);
+            it = _lru.erase(it);
+            ++_stats.evictions;
+        }
+
+        _stats.entries = static_cast<uint32_t>(_lru.size());
+        _stats.resident_bytes = total;
+    }
+
+    void AssetCache::set_budget(std::size_t budget_bytes) {
+        _budget = budget_bytes;
+        trim();
+    }
+
+    uint64_t AssetCache::content_hash(const char* path) {
+        std::error_code error;
+        const std::uintmax_t size{ std::filesystem::file_size(path, error) };
+        if (error) {
+            return 0;
+        }
+        const std::filesystem::file_time_type write_time{ std::filesystem::last_write_time(path, error) };
+        if (error) {
+            return 0;
+        }
+
+        const auto known{ _path_hashes.find(path) };
+        if (known != _path_hashes.end() && known->second.size == size && known->second.write_time == write_time) {
+            return known->second.hash;
+        }
+        const uint64_t hash{ hash_file(path) };
+        if (hash != 0) {
+            _path_hashes[path] = { size, write_time, hash };
+        }
+        return hash;
+    }
+
+    AssetCache::Entry* AssetCache::find(uint64_t key) {
+        const auto found{ _entries.find(key) };
+        if (found == _entries.end()) {
+            return nullptr;
+        }
+        _lru.splice(_lru.begin(), _lru, found->second);
+        ++_stats.hits;
+        return &_lru.front();
+    }
+
+    void AssetCache::insert(Entry&& entry) {
+        const uint64_t key{ entry.key };
+        _lru.push_front(std::move(entry));
+        _entries[key] = _lru.begin();
+        ++_stats.misses;
+        // the new asset is held by the caller, only older ones can go
+        trim();
+    }
+
+    bool AssetCache::is_held(const Entry& entry) const {
+        // the prototype texture holds the state once more
+        return entry.object.use_count() > (entry.texture ? 2 : 1);
+    }
+
+    std::size_t AssetCache::entry_bytes(const Entry& entry) const {
+        if (!entry.texture) {
+            return entry.bytes;
+        }
+        const Texture::State& state{ *entry.texture->_state };
+        if (!state.resident) {
+            return 0;
+        }
+        const std::size_t base{ static_cast<std::size_t>(state.width) * state.height * state.color_channels };
+        // a full mip chain adds a third
+        return state.mipmapped ? base + base / 3 : base;
+    }
+}
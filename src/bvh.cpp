@@ -0,0 +1,541 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "bvh.hpp"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace my_gl {
+    namespace {
+        constexpr uint32_t  sah_bin_count{ 12 };
+        constexpr float     traversal_cost{ 1.0f };
+
+        bool is_valid_slot(const Bvh::Node& node, int slot) {
+            return node.child[slot] != Bvh::invalid_child;
+        }
+
+        math::Aabb slot_bounds(const Bvh::Node& node, int slot) {
+            math::Aabb box;
+            box.min[0] = node.min_x[slot];
+            box.min[1] = node.min_y[slot];
+            box.min[2] = node.min_z[slot];
+            box.max[0] = node.max_x[slot];
+            box.max[1] = node.max_y[slot];
+            box.max[2] = node.max_z[slot];
+            return box;
+        }
+
+        // node tests return a 4 bit mask of the children that pass
+        int test_frustum4(const Bvh::Node& node, const math::Frustum& frustum) {
+#if defined(__SSE2__)
+            const __m128 min_x{ _mm_load_ps(node.min_x) };
+            const __m128 min_y{ _mm_load_ps(node.min_y) };
+            const __m128 min_z{ _mm_load_ps(node.min_z) };
+            const __m128 max_x{ _mm_load_ps(node.max_x) };
+            const __m128 max_y{ _mm_load_ps(node.max_y) };
+            const __m128 max_z{ _mm_load_ps(node.max_z) };
+            __m128 outside{ _mm_setzero_ps() };
+
+            for (const math::Plane& plane : frustum.planes) {
+                const __m128 px{ plane.n[0] >= 0.0f ? max_x : min_x };
+                const __m128 py{ plane.n[1] >= 0.0f ? max_y : min_y };
+                const __m128 pz{ plane.n[2] >= 0.0f ? max_z : min_z };
+                __m128 dist{ _mm_mul_ps(px, _mm_set1_ps(plane.n[0])) };
+                dist = _mm_add_ps(dist, _mm_mul_ps(py, _mm_set1_ps(plane.n[1])));
+                dist = _mm_add_ps(dist, _mm_mul_ps(pz, _mm_set1_ps(plane.n[2])));
+                dist = _mm_add_ps(dist, _mm_set1_ps(plane.d));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, _mm_setzero_ps()));
+            }
+
+            return ~_mm_movemask_ps(outside) & 0xF;
+#else
+            int mask{ 0 };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (frustum.intersects(slot_bounds(node, slot))) {
+                    mask |= 1 << slot;
+                }
+            }
+            return mask;
+#endif
+        }
+
+        int test_overlap4(const Bvh::Node& node, const math::Aabb& box) {
+#if defined(__SSE2__)
+            __m128 hit{ _mm_cmple_ps(_mm_load_ps(node.min_x), _mm_set1_ps(box.max[0])) };
+            hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_load_ps(node.min_y), _mm_set1_ps(box.max[1])));
+            hit = _mm_and_ps(hit, _mm_cmple_ps(_mm_load_ps(node.min_z), _mm_set1_ps(box.max[2])));
+            hit = _mm_and_ps(hit, _mm_cmpge_ps(_mm_load_ps(node.max_x), _mm_set1_ps(box.min[0])));
+            hit = _mm_and_ps(hit, _mm_cmpge_ps(_mm_load_ps(node.max_y), _mm_set1_ps(box.min[1])));
+            hit = _mm_and_ps(hit, _mm_cmpge_ps(_mm_load_ps(node.max_z), _mm_set1_ps(box.min[2])));
+            return _mm_movemask_ps(hit);
+#else
+            int mask{ 0 };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (slot_bounds(node, slot).overlaps(box)) {
+                    mask |= 1 << slot;
+                }
+            }
+            return mask;
+#endif
+        }
+
+        // 1 / dir, infinite components clamped to the largest finite float of their sign: an origin on a slab plane
+        // then gives 0 instead of 0 * inf = NaN, which min/max in test_ray4 would turn into a miss
+        void inverse_direction(const math::Ray& ray, float* inv_dir) {
+            for (int i = 0; i < 3; ++i) {
+                inv_dir[i] = 1.0f / ray.dir[i];
+                if (!std::isfinite(inv_dir[i])) {
+                    inv_dir[i] = std::copysign(std::numeric_limits<float>::max(), inv_dir[i]);
+                }
+            }
+        }
+
+        int test_ray4(const Bvh::Node& node, const math::Ray& ray, const float* inv_dir, float t_max, float* t_entry) {
+#if defined(__SSE2__)
+            const __m128 org_x{ _mm_set1_ps(ray.origin[0]) };
+            const __m128 org_y{ _mm_set1_ps(ray.origin[1]) };
+            const __m128 org_z{ _mm_set1_ps(ray.origin[2]) };
+            const __m128 inv_x{ _mm_set1_ps(inv_dir[0]) };
+            const __m128 inv_y{ _mm_set1_ps(inv_dir[1]) };
+            const __m128 inv_z{ _mm_set1_ps(inv_dir[2]) };
+
+            const __m128 tx0{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_x), org_x), inv_x) };
+            const __m128 tx1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_x), org_x), inv_x) };
+            const __m128 ty0{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_y), org_y), inv_y) };
+            const __m128 ty1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_y), org_y), inv_y) };
+            const __m128 tz0{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.min_z), org_z), inv_z) };
+            const __m128 tz1{ _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.max_z), org_z), inv_z) };
+
+            __m128 t_near{ _mm_max_ps(_mm_min_ps(tx0, tx1), _mm_setzero_ps()) };
+            t_near = _mm_max_ps(t_near, _mm_min_ps(ty0, ty1));
+            t_near = _mm_max_ps(t_near, _mm_min_ps(tz0, tz1));
+            __m128 t_far{ _mm_min_ps(_mm_max_ps(tx0, tx1), _mm_set1_ps(t_max)) };
+            t_far = _mm_min_ps(t_far, _mm_max_ps(ty0, ty1));
+            t_far = _mm_min_ps(t_far, _mm_max_ps(tz0, tz1));
+
+            _mm_storeu_ps(t_entry, t_near);
+            return _mm_movemask_ps(_mm_cmple_ps(t_near, t_far));
+#else
+            int mask{ 0 };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (math::ray_intersects(ray, slot_bounds(node, slot), t_max, t_entry[slot])) {
+                    mask |= 1 << slot;
+                }
+            }
+            return mask;
+#endif
+        }
+    }
+
+    void Bvh::build(const std::vector<math::Aabb>& bounds, const std::vector<uint32_t>& item_ids) {
+        _nodes.clear();
+        _items = item_ids;
+        _refits_since_build = 0;
+        _root_bounds = math::Aabb{};
+
+        if (_items.empty()) {
+            _build_cost = 0.0f;
+            return;
+        }
+
+        std::vector<BuildNode> build_nodes;
+        build_nodes.reserve(_items.size() * 2);
+        build_recursive(bounds, build_nodes, 0, static_cast<uint32_t>(_items.size()));
+
+        _nodes.reserve(build_nodes.size() / 2 + 1);
+        collapse(build_nodes, 0);
+
+        _item_bounds.resize(_items.size());
+        for (std::size_t i = 0; i < _items.size(); ++i) {
+            _item_bounds[i] = bounds[_items[i]];
+        }
+
+        _root_bounds = build_nodes[0].bounds;
+        _build_cost = sah_cost();
+    }
+
+    uint32_t Bvh::build_recursive(
+        const std::vector<math::Aabb>&  bounds,
+        std::vector<BuildNode>&         build_nodes,
+        uint32_t                        first,
+        uint32_t                        count
+    )
+    {
+        const uint32_t index{ static_cast<uint32_t>(build_nodes.size()) };
+        build_nodes.emplace_back();
+
+        math::Aabb box;
+        math::Aabb centroid_box;
+        for (uint32_t i = first; i < first + count; ++i) {
+            const math::Aabb& item_box{ bounds[_items[i]] };
+            const float centroid[3]{ item_box.center(0), item_box.center(1), item_box.center(2) };
+            box.expand(item_box);
+            centroid_box.expand(centroid);
+        }
+
+        build_nodes[index].bounds = box;
+        build_nodes[index].first = first;
+        build_nodes[index].count = count;
+
+        if (count <= max_leaf_size) {
+            return index;
+        }
+
+        // binned SAH
+        int     best_axis{ -1 };
+        int     best_split{ 0 };
+        float   best_cost{ std::numeric_limits<float>::max() };
+
+        for (int axis = 0; axis < 3; ++axis) {
+            const float extent{ centroid_box.extent(axis) };
+            if (extent <= 0.0f) {
+                continue;
+            }
+
+            math::Aabb  bin_bounds[sah_bin_count];
+            uint32_t    bin_counts[sah_bin_count]{};
+            const float scale{ static_cast<float>(sah_bin_count) / extent };
+
+            for (uint32_t i = first; i < first + count; ++i) {
+                const math::Aabb& item_box{ bounds[_items[i]] };
+                const uint32_t bin{ std::min(sah_bin_count - 1, static_cast<uint32_t>((item_box.center(axis) - centroid_box.min[axis]) * scale)) };
+                bin_bounds[bin].expand(item_box);
+                ++bin_counts[bin];
+            }
+
+            // sweep from the right to get area/count of every right partition
+            float       right_area[sah_bin_count];
+            uint32_t    right_count[sah_bin_count];
+            math::Aabb  acc_box;
+            uint32_t    acc_count{ 0 };
+            for (int bin = sah_bin_count - 1; bin > 0; --bin) {
+                acc_box.expand(bin_bounds[bin]);
+                acc_count += bin_counts[bin];
+                right_area[bin] = acc_box.surface_area();
+                right_count[bin] = acc_count;
+            }
+
+            acc_box = math::Aabb{};
+            acc_count = 0;
+            for (uint32_t split = 1; split < sah_bin_count; ++split) {
+                acc_box.expand(bin_bounds[split - 1]);
+                acc_count += bin_counts[split - 1];
+                if (acc_count == 0 || right_count[split] == 0) {
+                    continue;
+                }
+                const float cost{ acc_box.surface_area() * acc_count + right_area[split] * right_count[split] };
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_split = split;
+                }
+            }
+        }
+
+        uint32_t mid{ first + count / 2 };
+
+        if (best_axis != -1) {
+            const float scale{ static_cast<float>(sah_bin_count) / centroid_box.extent(best_axis) };
+            const float axis_min{ centroid_box.min[best_axis] };
+            auto it{ std::partition(_items.begin() + first, _items.begin() + first + count, [&](uint32_t item) {
+                const uint32_t bin{ std::min(sah_bin_count - 1, static_cast<uint32_t>((bounds[item].center(best_axis) - axis_min) * scale)) };
+                return bin < static_cast<uint32_t>(best_split);
+            }) };
+            mid = static_cast<uint32_t>(it - _items.begin());
+        }
+
+        // all centroids coincide or the partition was degenerate, split by count
+        if (mid == first || mid == first + count) {
+            mid = first + count / 2;
+        }
+
+        const uint32_t left{ build_recursive(bounds, build_nodes, first, mid - first) };
+        const uint32_t right{ build_recursive(bounds, build_nodes, mid, first + count - mid) };
+        build_nodes[index].left = left;
+        build_nodes[index].right = right;
+        build_nodes[index].count = 0;
+
+        return index;
+    }
+
+    // pulls grandchildren up until a node has 4 children, nodes end up in pre-order
+    uint32_t Bvh::collapse(const std::vector<BuildNode>& build_nodes, uint32_t build_index) {
+        const uint32_t node_index{ static_cast<uint32_t>(_nodes.size()) };
+        _nodes.emplace_back();
+        for (int slot = 0; slot < 4; ++slot) {
+            set_slot(_nodes[node_index], slot, math::Aabb{}, invalid_child, 0);
+        }
+
+        uint32_t    children[4];
+        int         child_count{ 0 };
+        const BuildNode& build_node{ build_nodes[build_index] };
+
+        if (build_node.count > 0) {
+            children[child_count++] = build_index;
+        }
+        else {
+            children[child_count++] = build_node.left;
+            children[child_count++] = build_node.right;
+
+            while (child_count < 4) {
+                int     largest{ -1 };
+                float   largest_area{ -1.0f };
+                for (int i = 0; i < child_count; ++i) {
+                    const BuildNode& candidate{ build_nodes[children[i]] };
+                    if (candidate.count == 0 && candidate.bounds.surface_area() > largest_area) {
+                        largest = i;
+                        largest_area = candidate.bounds.surface_area();
+                    }
+                }
+                if (largest == -1) {
+                    break;
+                }
+                const BuildNode& expanded{ build_nodes[children[largest]] };
+                children[largest] = expanded.left;
+                children[child_count++] = expanded.right;
+            }
+        }
+
+        for (int slot = 0; slot < child_count; ++slot) {
+            const BuildNode& child{ build_nodes[children[slot]] };
+            if (child.count > 0) {
+                set_slot(_nodes[node_index], slot, child.bounds, child.first, child.count);
+            }
+            else {
+                const uint32_t child_node{ collapse(build_nodes, children[slot]) };
+                set_slot(_nodes[node_index], slot, child.bounds, child_node, 0);
+            }
+        }
+
+        return node_index;
+    }
+
+    void Bvh::set_slot(Node& node, int slot, const math::Aabb& box, uint32_t child, uint32_t count) {
+        node.min_x[slot] = box.min[0];
+        node.min_y[slot] = box.min[1];
+        node.min_z[slot] = box.min[2];
+        node.max_x[slot] = box.max[0];
+        node.max_y[slot] = box.max[1];
+        node.max_z[slot] = box.max[2];
+        node.child[slot] = child;
+        node.count[slot] = count;
+    }
+
+    math::Aabb Bvh::node_bounds(const Node& node) const {
+        math::Aabb box;
+        for (int slot = 0; slot < 4; ++slot) {
+            if (is_valid_slot(node, slot)) {
+                box.expand(slot_bounds(node, slot));
+            }
+        }
+        return box;
+    }
+
+    void Bvh::refit(const std::vector<math::Aabb>& bounds) {
+        for (std::size_t i = 0; i < _items.size(); ++i) {
+            _item_bounds[i] = bounds[_items[i]];
+        }
+
+        // children always have a larger index than their parent
+        for (std::size_t i = _nodes.size(); i-- > 0;) {
+            Node& node{ _nodes[i] };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (!is_valid_slot(node, slot)) {
+                    continue;
+                }
+
+                math::Aabb box;
+                if (node.count[slot] > 0) {
+                    for (uint32_t item = node.child[slot]; item < node.child[slot] + node.count[slot]; ++item) {
+                        box.expand(_item_bounds[item]);
+                    }
+                }
+                else {
+                    box = node_bounds(_nodes[node.child[slot]]);
+                }
+                set_slot(node, slot, box, node.child[slot], node.count[slot]);
+            }
+        }
+
+        if (!_nodes.empty()) {
+            _root_bounds = node_bounds(_nodes[0]);
+        }
+        ++_refits_since_build;
+    }
+
+    void Bvh::update(const std::vector<math::Aabb>& bounds) {
+        if (_nodes.empty()) {
+            return;
+        }
+
+        refit(bounds);
+
+        const bool interval_passed{ rebuild_interval > 0 && _refits_since_build >= rebuild_interval };
+        if (interval_passed || sah_cost() > _build_cost * rebuild_cost_ratio) {
+            std::vector<uint32_t> items{ std::move(_items) };
+            build(bounds, items);
+        }
+    }
+
+    float Bvh::sah_cost() const {
+        const float root_area{ _root_bounds.surface_area() };
+        if (_nodes.empty() || root_area <= 0.0f) {
+            return 0.0f;
+        }
+
+        float cost{ 0.0f };
+        for (const Node& node : _nodes) {
+            for (int slot = 0; slot < 4; ++slot) {
+                if (!is_valid_slot(node, slot)) {
+                    continue;
+                }
+                const float area{ slot_bounds(node, slot).surface_area() };
+                cost += node.count[slot] > 0 ? area * node.count[slot] : area * traversal_cost;
+            }
+        }
+
+        return cost / root_area;
+    }
+
+    void Bvh::query_frustum(const math::Frustum& frustum, std::vector<uint32_t>& out) const {
+        if (_nodes.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+
+        while (!stack.empty()) {
+            const Node& node{ _nodes[stack.back()] };
+            stack.pop_back();
+
+            const int mask{ test_frustum4(node, frustum) };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (!(mask & (1 << slot)) || !is_valid_slot(node, slot)) {
+                    continue;
+                }
+                if (node.count[slot] == 0) {
+                    stack.push_back(node.child[slot]);
+                    continue;
+                }
+                for (uint32_t item = node.child[slot]; item < node.child[slot] + node.count[slot]; ++item) {
+                    if (frustum.intersects(_item_bounds[item])) {
+                        out.push_back(_items[item]);
+                    }
+                }
+            }
+        }
+    }
+
+    void Bvh::query_overlap(const math::Aabb& box, std::vector<uint32_t>& out) const {
+        if (_nodes.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+
+        while (!stack.empty()) {
+            const Node& node{ _nodes[stack.back()] };
+            stack.pop_back();
+
+            const int mask{ test_overlap4(node, box) };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (!(mask & (1 << slot)) || !is_valid_slot(node, slot)) {
+                    continue;
+                }
+                if (node.count[slot] == 0) {
+                    stack.push_back(node.child[slot]);
+                    continue;
+                }
+                for (uint32_t item = node.child[slot]; item < node.child[slot] + node.count[slot]; ++item) {
+                    if (_item_bounds[item].overlaps(box)) {
+                        out.push_back(_items[item]);
+                    }
+                }
+            }
+        }
+    }
+
+    void Bvh::query_ray(const math::Ray& ray, float t_max, std::vector<uint32_t>& out) const {
+        if (_nodes.empty()) {
+            return;
+        }
+
+        float inv_dir[3];
+        inverse_direction(ray, inv_dir);
+        float t_entry[4];
+
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+
+        while (!stack.empty()) {
+            const Node& node{ _nodes[stack.back()] };
+            stack.pop_back();
+
+            const int mask{ test_ray4(node, ray, inv_dir, t_max, t_entry) };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (!(mask & (1 << slot)) || !is_valid_slot(node, slot)) {
+                    continue;
+                }
+                if (node.count[slot] == 0) {
+                    stack.push_back(node.child[slot]);
+                    continue;
+                }
+                for (uint32_t item = node.child[slot]; item < node.child[slot] + node.count[slot]; ++item) {
+                    float t;
+                    if (math::ray_intersects(ray, _item_bounds[item], t_max, t)) {
+                        out.push_back(_items[item]);
+                    }
+                }
+            }
+        }
+    }
+
+    // items are tested by their boxes, closest box entry wins
+    Bvh::RayHit Bvh::raycast(const math::Ray& ray, float t_max) const {
+        RayHit hit;
+        if (_nodes.empty()) {
+            return hit;
+        }
+
+        float inv_dir[3];
+        inverse_direction(ray, inv_dir);
+        float best_t{ t_max };
+        float t_entry[4];
+
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+
+        while (!stack.empty()) {
+            const Node& node{ _nodes[stack.back()] };
+            stack.pop_back();
+
+            const int mask{ test_ray4(node, ray, inv_dir, best_t, t_entry) };
+            for (int slot = 0; slot < 4; ++slot) {
+                if (!(mask & (1 << slot)) || !is_valid_slot(node, slot)) {
+                    continue;
+                }
+                if (node.count[slot] == 0) {
+                    stack.push_back(node.child[slot]);
+                    continue;
+                }
+                for (uint32_t item = node.child[slot]; item < node.child[slot] + node.count[slot]; ++item) {
+                    float t;
+                    if (math::ray_intersects(ray, _item_bounds[item], best_t, t) && t < best_t) {
+                        best_t = t;
+                        hit.item = _items[item];
+                        hit.t = t;
+                    }
+                }
+            }
+        }
+
+        return hit;
+    }
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include "geometryObject.hpp"
 #include "animation.hpp"
 #include "matrix.hpp"
@@ -7,11 +10,13 @@
 my_gl::TransformsByType::TransformsByType(
     my_gl::math::TransformationType                 arg_type,
     std::vector<math::Transformation<float>>&&      arg_transforms,
-    std::vector<my_gl::Animation<float>>&&          arg_anims
+    std::vector<my_gl::Animation<float>>&&          arg_anims,
+    std::vector<my_gl::KeyframeTrack<float>>&&      arg_tracks
 )
     : type{ arg_type }
     , transforms{ std::move(arg_transforms) }
     , anims{ std::move(arg_anims) }
+    , tracks{ std::move(arg_tracks) }
 {}
 
 my_gl::GeometryObjectPrimitive::GeometryObjectPrimitive(
@@ -30,7 +35,16 @@ my_gl::GeometryObjectPrimitive::GeometryObjectPrimitive(
     , _program{ program }
     , _vao{ vao }
     , _draw_type{ draw_type }
-{}
+{
+    _local_bounds = _vao.compute_bounds(_buffer_byte_offset, _vertices_count);
+    _model_mat = my_gl::math::Matrix44<float>::identity_new();
+    _world_bounds = _local_bounds;
+
+    // animated ones are updated every frame, don't start their clocks before the first frame
+    if (!is_animated()) {
+        update_model_mat();
+    }
+}
 
 my_gl::math::Matrix44<float> my_gl::GeometryObjectPrimitive::get_model_mat() {
     auto result_mat{ my_gl::math::Matrix44<float>::identity_new() };
@@ -42,16 +56,36 @@ my_gl::math::Matrix44<float> my_gl::GeometryObjectPrimitive::get_model_mat() {
         for (my_gl::Animation<float>& animation : transforms_by_type.anims) {
             result_mat *= animation.update();
         }
+        for (my_gl::KeyframeTrack<float>& track : transforms_by_type.tracks) {
+            result_mat *= track.update();
+        }
     }
 
     return result_mat;
 }
 
+void my_gl::GeometryObjectPrimitive::update_model_mat() {
+    _model_mat = get_model_mat();
+    _world_bounds = _local_bounds.transform(_model_mat);
+}
+
+bool my_gl::GeometryObjectPrimitive::is_animated() const {
+    for (const my_gl::TransformsByType& transforms_by_type : _transforms) {
+        if (!transforms_by_type.anims.empty() || !transforms_by_type.tracks.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void my_gl::GeometryObjectPrimitive::update_anims_time(Duration_sec frame_time) {
     for (auto& transform_by_type : _transforms) {
         for (my_gl::Animation<float>& anim : transform_by_type.anims) {
             anim.update_time(frame_time);
         }
+        for (my_gl::KeyframeTrack<float>& track : transform_by_type.tracks) {
+            track.update_time(frame_time);
+        }
     }
 }
 
@@ -75,12 +109,119 @@ void my_gl::GeometryObjectPrimitive::un_bind_state() const {
     _vao.un_bind();
 }
 
+void my_gl::GeometryObjectPrimitive::get_axis_scales(float& min_scale, float& max_scale) const {
+    float min_scale_sq{ std::numeric_limits<float>::max() };
+    float max_scale_sq{ 0.0f };
+    for (int c = 0; c < 3; ++c) {
+        const float scale_sq{ _model_mat.at(0, c) * _model_mat.at(0, c) + _model_mat.at(1, c) * _model_mat.at(1, c) + _model_mat.at(2, c) * _model_mat.at(2, c) };
+        min_scale_sq = std::min(min_scale_sq, scale_sq);
+        max_scale_sq = std::max(max_scale_sq, scale_sq);
+    }
+    min_scale = std::sqrt(min_scale_sq);
+    max_scale = std::sqrt(max_scale_sq);
+}
+
+void my_gl::GeometryObjectPrimitive::select_lod(float px_per_unit, float threshold_px, float hysteresis) {
+    if (_lods.size() < 2) {
+        return;
+    }
+
+    // lod errors are in object space, the largest axis scale keeps it conservative
+    float min_scale;
+    float max_scale;
+    get_axis_scales(min_scale, max_scale);
+
+    _curr_lod = meshes::select_lod(_lods, _curr_lod, px_per_unit * max_scale, threshold_px, hysteresis);
+}
+
+float my_gl::GeometryObjectPrimitive::get_uv_per_px(float px_per_unit) const {
+    // the most stretched axis packs the most pixels into a uv unit, it decides the finest mip
+    float min_scale;
+    float max_scale;
+    get_axis_scales(min_scale, max_scale);
+
+    return _uv_density / std::max(px_per_unit * max_scale, 1e-6f);
+}
+
+void my_gl::GeometryObjectPrimitive::cull_meshlets(const math::Frustum& frustum, const float* camera_pos, meshes::MeshletCullStats& stats) {
+    const std::size_t byte_offset{ get_draw_byte_offset() };
+    const std::size_t index_count{ get_draw_index_count() };
+    const auto meshlets{ _vao.get_meshlets(byte_offset, index_count) };
+
+    _draw_counts.clear();
+    _draw_offsets.clear();
+    _draw_base_vertices.clear();
+    // a single meshlet is already covered by the per object frustum test
+    _meshlets_culled = _draw_type == GL_TRIANGLES && meshlets.size() > 1;
+    if (!_meshlets_culled) {
+        return;
+    }
+
+    math::Matrix44<float> inv_model_mat{ _model_mat };
+    inv_model_mat.invert();
+    float local_camera_pos[3];
+    for (int r = 0; r < 3; ++r) {
+        local_camera_pos[r] = inv_model_mat.at(r, 0) * camera_pos[0] + inv_model_mat.at(r, 1) * camera_pos[1] + inv_model_mat.at(r, 2) * camera_pos[2] + inv_model_mat.at(r, 3);
+    }
+
+    // non-uniform scale bends normals, the object space cone no longer holds
+    float min_scale;
+    float max_scale;
+    get_axis_scales(min_scale, max_scale);
+    const bool test_cones{ max_scale <= min_scale * 1.001f };
+
+    const std::size_t range_first{ byte_offset / sizeof(uint32_t) };
+    const std::size_t range_last{ range_first + index_count };
+    const std::size_t index_base{ _vao.get_first_index() };
+    const std::size_t index_size{ _vao.get_index_size() };
+
+    for (const meshes::Meshlet& meshlet : meshlets) {
+        ++stats.meshlets_tested;
+
+        float center[3];
+        for (int r = 0; r < 3; ++r) {
+            center[r] = _model_mat.at(r, 0) * meshlet.center[0] + _model_mat.at(r, 1) * meshlet.center[1] + _model_mat.at(r, 2) * meshlet.center[2] + _model_mat.at(r, 3);
+        }
+
+        const std::size_t first{ std::max<std::size_t>(meshlet.index_offset, range_first) };
+        const std::size_t last{ std::min<std::size_t>(meshlet.index_offset + meshlet.index_count, range_last) };
+
+        if (!frustum.intersects_sphere(center, meshlet.radius * max_scale) || (test_cones && meshes::meshlet_is_backfacing(meshlet, local_camera_pos))) {
+            ++stats.meshlets_culled;
+            stats.triangles_culled += static_cast<uint32_t>((last - first) / 3);
+            continue;
+        }
+
+        // neighbouring survivors become one range
+        const std::size_t first_byte{ (index_base + first) * index_size };
+        if (!_draw_counts.empty() && reinterpret_cast<std::size_t>(_draw_offsets.back()) + _draw_counts.back() * index_size == first_byte) {
+            _draw_counts.back() += static_cast<GLsizei>(last - first);
+        }
+        else {
+            _draw_counts.push_back(static_cast<GLsizei>(last - first));
+            _draw_offsets.push_back(reinterpret_cast<const void*>(first_byte));
+            _draw_base_vertices.push_back(_vao.get_base_vertex());
+        }
+    }
+}
+
 void my_gl::GeometryObjectPrimitive::draw() const {
-    glDrawElements(
+    if (_meshlets_culled) {
+        if (!_draw_counts.empty()) {
+            glMultiDrawElementsBaseVertex(_draw_type, _draw_counts.data(), _vao.get_index_type(), _draw_offsets.data(), static_cast<GLsizei>(_draw_counts.size()), _draw_base_vertices.data());
+        }
+        return;
+    }
+
+    // offsets are relative to the mesh and count 32 bit indices, the vao knows its index type
+    // and where it starts in shared buffers
+    const std::size_t first_index{ _vao.get_first_index() + get_draw_byte_offset() / sizeof(uint32_t) };
+    glDrawElementsBaseVertex(
         _draw_type,
-        _vertices_count,
-        GL_UNSIGNED_SHORT,
-        reinterpret_cast<const void*>(_buffer_byte_offset)
+        get_draw_index_count(),
+        _vao.get_index_type(),
+        reinterpret_cast<const void*>(first_index * _vao.get_index_size()),
+        _vao.get_base_vertex()
     );
 }
 
@@ -89,20 +230,28 @@ void my_gl::GeometryObjectPrimitive::render(
     const my_gl::math::Matrix44<float>& view_proj_mat,
     float time_0to1)
 {
-    bind_state();
-
     const Program& shader{ get_program() };
 
-    my_gl::math::Matrix44<float> model_mat{ get_model_mat() };
-    my_gl::math::Matrix44<float> model_view_mat{ view_mat * model_mat };
-    my_gl::math::Matrix44<float> normal_mat{ model_view_mat.invert().transpose() };
-    my_gl::math::Matrix44<float> mvp_mat{ view_proj_mat * model_mat };
+    // quantized positions are mapped back by the vao's dequantize matrix, normals aren't quantized against the bounds
+    const my_gl::math::Matrix44<float> position_mat{ _model_mat * _vao.get_dequantize_mat() };
+    my_gl::math::Matrix44<float> model_view_mat{ view_mat * position_mat };
+    my_gl::math::Matrix44<float> normal_mat{ view_mat * _model_mat };
+    normal_mat.invert();
+    normal_mat.transpose();
+    my_gl::math::Matrix44<float> mvp_mat{ view_proj_mat * position_mat };
 
     shader.set_uniform_value("u_model_view_mat", model_view_mat.data());
     shader.set_uniform_value("u_normal_mat", normal_mat.data());
     shader.set_uniform_value("u_mvp_mat", mvp_mat.data());
     shader.set_uniform_value("u_lerp", time_0to1);
+    if (_texture_slot.is_valid()) {
+        shader.set_uniform_value("u_texture_array", _texture_slot.texture_unit);
+        shader.set_uniform_value("u_texture_layer", static_cast<int32_t>(_texture_slot.layer));
+        shader.set_uniform_value("u_texture_transform", _texture_slot.uv_scale[0], _texture_slot.uv_scale[1], _texture_slot.uv_offset[0], _texture_slot.uv_offset[1]);
+    }
 
+    // the setters unbind the program once they found the uniform, so it's bound after them
+    bind_state();
     draw();
     un_bind_state();
 }
@@ -127,6 +276,9 @@ void my_gl::GeometryObjectComplex::render(
 )
 {
     for (auto& primitive : _primitives) {
+        if (primitive.is_animated()) {
+            primitive.update_model_mat();
+        }
         primitive.render(view_mat, view_proj_mat, time_0to1);
     }
 }
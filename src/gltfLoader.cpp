@@ -0,0 +1,851 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string_view>
+#include "gltfLoader.hpp"
+#include "mappedFile.hpp"
+
+namespace my_gl {
+    namespace {
+        constexpr uint32_t glb_magic{ 0x46546C67 };
+        constexpr uint32_t glb_chunk_json{ 0x4E4F534A };
+        constexpr uint32_t glb_chunk_bin{ 0x004E4942 };
+        constexpr int max_json_depth{ 64 };
+        constexpr int max_node_depth{ 256 };
+        constexpr int64_t mode_triangles{ 4 };
+
+        // just enough json for gltf, strings are views into the file with escapes left in
+        struct Json {
+            enum class Type : uint8_t {
+                NUL,
+                BOOL,
+                NUMBER,
+                STRING,
+                ARRAY,
+                OBJECT,
+            };
+
+            const Json& operator[](std::string_view key) const;
+            const Json& operator[](std::size_t index) const;
+            bool        has(std::string_view key) const { return &(*this)[key] != &null(); }
+            std::size_t size() const { return items.size(); }
+            double      number_or(double fallback) const { return type == Type::NUMBER ? number : fallback; }
+            // non negative integers only, anything else is 'fallback'
+            int64_t     index_or(int64_t fallback) const {
+                return type == Type::NUMBER && number >= 0.0 && number < 9.0e15 && number == std::floor(number) ? static_cast<int64_t>(number) : fallback;
+            }
+            static const Json& null() {
+                static const Json json{};
+                return json;
+            }
+
+            Type                            type{ Type::NUL };
+            bool                            boolean{ false };
+            double                          number{ 0.0 };
+            std::string_view                string;
+            // object keys, parallel to items
+            std::vector<std::string_view>   keys;
+            std::vector<Json>               items;
+        };
+
+        const Json& Json::operator[](std::string_view key) const {
+            if (type == Type::OBJECT) {
+                for (std::size_t i = 0; i < keys.size(); ++i) {
+                    if (keys[i] == key) {
+                        return items[i];
+                    }
+                }
+            }
+            return null();
+        }
+
+        const Json& Json::operator[](std::size_t index) const {
+            return type == Type::ARRAY && index < items.size() ? items[index] : null();
+        }
+
+        class JsonParser {
+        public:
+            JsonParser(const char* begin, const char* end)
+                : _p{ begin }
+                , _end{ end }
+            {}
+
+            bool parse(Json& out) {
+                if (!parse_value(out, 0)) {
+                    return false;
+                }
+                skip_spaces();
+                return _p == _end;
+            }
+
+        private:
+            void skip_spaces() {
+                while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) {
+                    ++_p;
+                }
+            }
+
+            bool consume(char c) {
+                skip_spaces();
+                if (_p < _end && *_p == c) {
+                    ++_p;
+                    return true;
+                }
+                return false;
+            }
+
+            bool consume_word(std::string_view word) {
+                if (static_cast<std::size_t>(_end - _p) >= word.size() && std::string_view{ _p, word.size() } == word) {
+                    _p += word.size();
+                    return true;
+                }
+                return false;
+            }
+
+            bool parse_string(std::string_view& out) {
+                if (!consume('"')) {
+                    return false;
+                }
+                const char* begin{ _p };
+                while (_p < _end && *_p != '"') {
+                    _p += *_p == '\\' ? 2 : 1;
+                }
+                if (_p >= _end) {
+                    return false;
+                }
+                out = { begin, static_cast<std::size_t>(_p - begin) };
+                ++_p;
+                return true;
+            }
+
+            bool parse_value(Json& out, int depth) {
+                if (depth > max_json_depth) {
+                    return false;
+                }
+                skip_spaces();
+                if (_p >= _end) {
+                    return false;
+                }
+
+                switch (*_p) {
+                case '{': {
+                    ++_p;
+                    out.type = Json::Type::OBJECT;
+                    if (consume('}')) {
+                        return true;
+                    }
+                    do {
+                        std::string_view key;
+                        if (!parse_string(key) || !consume(':')) {
+                            return false;
+                        }
+                        out.keys.push_back(key);
+                        out.items.emplace_back();
+                        if (!parse_value(out.items.back(), depth + 1)) {
+                            return false;
+                        }
+                    } while (consume(','));
+                    return consume('}');
+                }
+                case '[': {
+                    ++_p;
+                    out.type = Json::Type::ARRAY;
+                    if (consume(']')) {
+                        return true;
+                    }
+                    do {
+                        out.items.emplace_back();
+                        if (!parse_value(out.items.back(), depth + 1)) {
+                            return false;
+                        }
+                    } while (consume(','));
+                    return consume(']');
+                }
+                case '"':
+                    out.type = Json::Type::STRING;
+                    return parse_string(out.string);
+                case 't':
+                    out.type = Json::Type::BOOL;
+                    out.boolean = true;
+                    return consume_word("true");
+                case 'f':
+                    out.type = Json::Type::BOOL;
+                    return consume_word("false");
+                case 'n':
+                    return consume_word("null");
+                default: {
+                    out.type = Json::Type::NUMBER;
+                    const auto [next, error]{ std::from_chars(_p, _end, out.number) };
+                    if (error != std::errc{}) {
+                        return false;
+                    }
+                    _p = next;
+                    return true;
+                }
+                }
+            }
+
+            const char*     _p;
+            const char*     _end;
+        };
+
+        uint32_t read_u32(const char* p) {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        // elements of an accessor inside the binary chunk
+        struct AccessorView {
+            const uint8_t*  data{ nullptr };
+            std::size_t     count{ 0 };
+            GLenum          component_type{ GL_FLOAT };
+            uint32_t        components{ 0 };
+            std::size_t     element_size{ 0 };
+            std::size_t     stride{ 0 };
+            bool            normalized{ false };
+
+            // bytes from the first to the end of the last element
+            std::size_t     byte_span() const { return count ? (count - 1) * stride + element_size : 0; }
+        };
+
+        std::size_t component_size(GLenum component_type) {
+            switch (component_type) {
+            case GL_BYTE:
+            case GL_UNSIGNED_BYTE:  return 1;
+            case GL_SHORT:
+            case GL_UNSIGNED_SHORT: return 2;
+            case GL_UNSIGNED_INT:
+            case GL_FLOAT:          return 4;
+            default:                return 0;
+            }
+        }
+
+        uint32_t component_count(std::string_view type) {
+            if (type == "SCALAR") return 1;
+            if (type == "VEC2") return 2;
+            if (type == "VEC3") return 3;
+            if (type == "VEC4") return 4;
+            return 0;
+        }
+
+        bool resolve_accessor(const Json& doc, std::span<const uint8_t> bin, int64_t index, AccessorView& view) {
+            const Json& accessor{ doc["accessors"][static_cast<std::size_t>(index)] };
+            if (index < 0 || accessor.type != Json::Type::OBJECT) {
+                std::cerr << "gltf: no accessor " << index << '\n';
+                return false;
+            }
+            if (accessor.has("sparse")) {
+                std::cerr << "gltf: sparse accessors are not supported\n";
+                return false;
+            }
+
+            const int64_t view_index{ accessor["bufferView"].index_or(-1) };
+            const Json& buffer_view{ doc["bufferViews"][static_cast<std::size_t>(view_index)] };
+            // the binary chunk is buffer 0, without an uri
+            if (view_index < 0 || buffer_view["buffer"].index_or(-1) != 0 || doc["buffers"][0].has("uri")) {
+                std::cerr << "gltf: accessor " << index << " is not in the binary chunk\n";
+                return false;
+            }
+
+            view.component_type = static_cast<GLenum>(accessor["componentType"].index_or(0));
+            view.components = component_count(accessor["type"].string);
+            view.count = static_cast<std::size_t>(accessor["count"].index_or(0));
+            view.normalized = accessor["normalized"].boolean;
+            view.element_size = component_size(view.component_type) * view.components;
+            if (view.element_size == 0) {
+                std::cerr << "gltf: accessor " << index << " has an unsupported type\n";
+                return false;
+            }
+            view.stride = static_cast<std::size_t>(buffer_view["byteStride"].index_or(0));
+            if (view.stride == 0) {
+                view.stride = view.element_size;
+            }
+
+            const std::size_t view_offset{ static_cast<std::size_t>(buffer_view["byteOffset"].index_or(0)) };
+            const std::size_t view_length{ static_cast<std::size_t>(buffer_view["byteLength"].index_or(0)) };
+            const std::size_t offset{ static_cast<std::size_t>(accessor["byteOffset"].index_or(0)) };
+            if (view_offset > bin.size() || view_length > bin.size() - view_offset || offset > view_length
+                || (view.count && (view.count - 1 > (view_length - offset) / view.stride || view.byte_span() > view_length - offset))) {
+                std::cerr << "gltf: accessor " << index << " is out of its buffer view\n";
+                return false;
+            }
+
+            view.data = bin.data() + view_offset + offset;
+            return true;
+        }
+
+        // normalized integers map to [0, 1] / [-1, 1] as the gltf spec has it, plain ones keep their value
+        void read_floats(const AccessorView& view, std::vector<float>& out) {
+            out.resize(view.count * view.components);
+            for (std::size_t e = 0; e < view.count; ++e) {
+                const uint8_t* element{ view.data + e * view.stride };
+                for (uint32_t c = 0; c < view.components; ++c) {
+                    float value{ 0.0f };
+                    switch (view.component_type) {
+                    case GL_BYTE: {
+                        int8_t v; std::memcpy(&v, element + c, sizeof(v));
+                        value = view.normalized ? std::max(v / 127.0f, -1.0f) : v;
+                    } break;
+                    case GL_UNSIGNED_BYTE: {
+                        uint8_t v; std::memcpy(&v, element + c, sizeof(v));
+                        value = view.normalized ? v / 255.0f : v;
+                    } break;
+                    case GL_SHORT: {
+                        int16_t v; std::memcpy(&v, element + c * 2, sizeof(v));
+                        value = view.normalized ? std::max(v / 32767.0f, -1.0f) : v;
+                    } break;
+                    case GL_UNSIGNED_SHORT: {
+                        uint16_t v; std::memcpy(&v, element + c * 2, sizeof(v));
+                        value = view.normalized ? v / 65535.0f : v;
+                    } break;
+                    case GL_UNSIGNED_INT: {
+                        uint32_t v; std::memcpy(&v, element + c * 4, sizeof(v));
+                        value = static_cast<float>(v);
+                    } break;
+                    default:
+                        std::memcpy(&value, element + c * 4, sizeof(value));
+                        break;
+                    }
+                    out[e * view.components + c] = value;
+                }
+            }
+        }
+
+        void read_indices(const AccessorView& view, std::vector<uint32_t>& out) {
+            out.resize(view.count);
+            for (std::size_t i = 0; i < view.count; ++i) {
+                const uint8_t* element{ view.data + i * view.stride };
+                switch (view.component_type) {
+                case GL_UNSIGNED_BYTE:
+                    out[i] = *element;
+                    break;
+                case GL_UNSIGNED_SHORT: {
+                    uint16_t v; std::memcpy(&v, element, sizeof(v));
+                    out[i] = v;
+                } break;
+                default:
+                    std::memcpy(&out[i], element, sizeof(uint32_t));
+                    break;
+                }
+            }
+        }
+
+        struct PrimitiveRef {
+            VertexArray*    vao;
+            std::size_t     index_count;
+            GLenum          draw_type;
+        };
+
+        // one vertex attribute of a primitive: read from the file or generated
+        struct Stream {
+            const char*     name;
+            AccessorView    view;
+            bool            from_file;
+        };
+
+        // upload ranges of the mapped file, overlapping and touching attribute ranges share one
+        struct UploadRange {
+            std::size_t     begin;
+            std::size_t     end;
+            std::size_t     upload_offset;
+        };
+
+        bool build_primitive(
+            const Json&                                 doc,
+            std::span<const uint8_t>                    bin,
+            const Json&                                 primitive,
+            const std::vector<std::array<float, 4>>&    base_colors,
+            const Program&                              program,
+            const GltfLoadOptions&                      options,
+            GltfModel&                                  model,
+            PrimitiveRef&                               out
+        ) {
+            const int64_t mode{ primitive["mode"].index_or(mode_triangles) };
+            const Json& attributes{ primitive["attributes"] };
+            AccessorView position_view;
+            if (mode > 6 || !resolve_accessor(doc, bin, attributes["POSITION"].index_or(-1), position_view) || position_view.components != 3) {
+                std::cerr << "gltf: primitive without usable positions skipped\n";
+                return false;
+            }
+
+            meshes::Mesh cpu_mesh;
+            read_floats(position_view, cpu_mesh.vertices);
+            const std::size_t vertex_count{ position_view.count };
+
+            // indices, uploaded as stored when tightly packed
+            std::span<const uint8_t> index_bytes;
+            GLenum index_type{ GL_UNSIGNED_INT };
+            if (primitive.has("indices")) {
+                AccessorView index_view;
+                if (!resolve_accessor(doc, bin, primitive["indices"].index_or(-1), index_view) || index_view.components != 1
+                    || (index_view.component_type != GL_UNSIGNED_BYTE && index_view.component_type != GL_UNSIGNED_SHORT && index_view.component_type != GL_UNSIGNED_INT)) {
+                    std::cerr << "gltf: primitive with unusable indices skipped\n";
+                    return false;
+                }
+                read_indices(index_view, cpu_mesh.indices);
+                if (index_view.stride == index_view.element_size) {
+                    index_bytes = { index_view.data, index_view.byte_span() };
+                    index_type = index_view.component_type;
+                }
+            }
+            else {
+                cpu_mesh.indices.resize(vertex_count);
+                for (std::size_t i = 0; i < vertex_count; ++i) {
+                    cpu_mesh.indices[i] = static_cast<uint32_t>(i);
+                }
+            }
+            if (std::any_of(cpu_mesh.indices.begin(), cpu_mesh.indices.end(), [vertex_count](uint32_t index) { return index >= vertex_count; })) {
+                std::cerr << "gltf: primitive with out of range indices skipped\n";
+                return false;
+            }
+
+            // attributes the program reads, straight from the file when present
+            std::vector<Stream> streams;
+            const std::pair<const char*, const char*> semantics[]{
+                { options.position_name, "POSITION" },
+                { options.texcoord_name, "TEXCOORD_0" },
+                { options.color_name, "COLOR_0" },
+                { options.normal_name, "NORMAL" },
+            };
+            for (const auto& [name, semantic] : semantics) {
+                if (!name || !program.get_attrib(name)) {
+                    continue;
+                }
+                AccessorView view;
+                if (attributes.has(semantic) && resolve_accessor(doc, bin, attributes[semantic].index_or(-1), view) && view.count == vertex_count) {
+                    streams.push_back({ name, view, true });
+                }
+                else {
+                    streams.push_back({ name, {}, false });
+                }
+            }
+
+            std::vector<UploadRange> ranges;
+            for (const Stream& stream : streams) {
+                if (stream.from_file) {
+                    const std::size_t begin{ static_cast<std::size_t>(stream.view.data - bin.data()) };
+                    ranges.push_back({ begin, begin + stream.view.byte_span(), 0 });
+                }
+            }
+            std::sort(ranges.begin(), ranges.end(), [](const UploadRange& lhs, const UploadRange& rhs) { return lhs.begin < rhs.begin; });
+            std::vector<UploadRange> merged;
+            for (const UploadRange& range : ranges) {
+                if (!merged.empty() && range.begin <= merged.back().end) {
+                    merged.back().end = std::max(merged.back().end, range.end);
+                }
+                else {
+                    merged.push_back(range);
+                }
+            }
+
+            std::vector<std::span<const uint8_t>> vertex_ranges;
+            std::size_t upload_size{ 0 };
+            for (UploadRange& range : merged) {
+                range.upload_offset = upload_size;
+                vertex_ranges.push_back(bin.subspan(range.begin, range.end - range.begin));
+                upload_size += range.end - range.begin;
+            }
+
+            // generated streams go after the file ranges, 4 byte aligned
+            static constexpr uint8_t padding[4]{};
+            std::vector<float> generated_normals;
+            std::vector<uint8_t> generated_colors;
+            auto append_generated{ [&](std::span<const uint8_t> bytes) {
+                if (const std::size_t misalignment{ upload_size % 4 }) {
+                    vertex_ranges.push_back({ padding, 4 - misalignment });
+                    upload_size += 4 - misalignment;
+                }
+                const std::size_t offset{ upload_size };
+                vertex_ranges.push_back(bytes);
+                upload_size += bytes.size();
+                return offset;
+            } };
+
+            std::vector<Attribute> vertex_attributes;
+            for (const Stream& stream : streams) {
+                if (stream.from_file) {
+                    const std::size_t begin{ static_cast<std::size_t>(stream.view.data - bin.data()) };
+                    const auto range{ std::find_if(merged.begin(), merged.end(), [begin](const UploadRange& r) { return begin >= r.begin && begin < r.end; }) };
+                    vertex_attributes.push_back({
+                        .name = stream.name,
+                        .gl_type = stream.view.component_type,
+                        .count = static_cast<uint16_t>(stream.view.components),
+                        .byte_stride = static_cast<uint16_t>(stream.view.stride),
+                        .byte_offset = static_cast<uint32_t>(range->upload_offset + begin - range->begin),
+                        .normalized = stream.view.normalized,
+                    });
+                }
+                else if (stream.name == options.normal_name && mode == mode_triangles) {
+                    // area weighted face normals
+                    generated_normals.assign(vertex_count * 3, 0.0f);
+                    const float* p{ cpu_mesh.vertices.data() };
+                    for (std::size_t i = 0; i + 2 < cpu_mesh.indices.size(); i += 3) {
+                        const float* a{ p + cpu_mesh.indices[i] * 3 };
+                        const float* b{ p + cpu_mesh.indices[i + 1] * 3 };
+                        const float* c{ p + cpu_mesh.indices[i + 2] * 3 };
+                        const float e0[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                        const float e1[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                        const float n[3]{ e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+                        for (int k = 0; k < 3; ++k) {
+                            float* vertex_normal{ &generated_normals[cpu_mesh.indices[i + k] * 3] };
+                            vertex_normal[0] += n[0];
+                            vertex_normal[1] += n[1];
+                            vertex_normal[2] += n[2];
+                        }
+                    }
+                    for (std::size_t v = 0; v < vertex_count; ++v) {
+                        float* n{ &generated_normals[v * 3] };
+                        const float length{ std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) };
+                        for (int c = 0; length > 0.0f && c < 3; ++c) {
+                            n[c] /= length;
+                        }
+                    }
+                    vertex_attributes.push_back({
+                        .name = stream.name,
+                        .gl_type = GL_FLOAT,
+                        .count = 3,
+                        .byte_stride = 3 * sizeof(float),
+                        .byte_offset = static_cast<uint32_t>(append_generated({ reinterpret_cast<const uint8_t*>(generated_normals.data()), generated_normals.size() * sizeof(float) })),
+                    });
+                }
+                else if (stream.name == options.color_name) {
+                    // the material base color on every vertex
+                    const int64_t material{ primitive["material"].index_or(-1) };
+                    const std::array<float, 4> color{ material >= 0 && static_cast<std::size_t>(material) < base_colors.size() ? base_colors[material] : std::array<float, 4>{ 1.0f, 1.0f, 1.0f, 1.0f } };
+                    generated_colors.resize(vertex_count * 4);
+                    for (std::size_t v = 0; v < vertex_count; ++v) {
+                        for (int c = 0; c < 4; ++c) {
+                            generated_colors[v * 4 + c] = static_cast<uint8_t>(std::lround(std::clamp(color[c], 0.0f, 1.0f) * 255.0f));
+                        }
+                    }
+                    vertex_attributes.push_back({
+                        .name = stream.name,
+                        .gl_type = GL_UNSIGNED_BYTE,
+                        .count = 4,
+                        .byte_stride = 4,
+                        .byte_offset = static_cast<uint32_t>(append_generated(generated_colors)),
+                        .normalized = true,
+                    });
+                }
+            }
+
+            const std::size_t index_count{ cpu_mesh.indices.size() };
+            model.vaos.push_back(std::make_unique<VertexArray>(vertex_ranges, vertex_attributes, index_bytes, index_type, std::move(cpu_mesh), std::vector<const Program*>{ &program }));
+            out = { model.vaos.back().get(), index_count, static_cast<GLenum>(mode) };
+            return true;
+        }
+
+        struct NodeTracks {
+            std::vector<KeyframeTrack<float>>   translation;
+            std::vector<KeyframeTrack<float>>   rotation;
+            std::vector<KeyframeTrack<float>>   scale;
+        };
+
+        void load_animation(const Json& doc, std::span<const uint8_t> bin, const Json& animation, Loop_type loop, std::vector<NodeTracks>& node_tracks) {
+            const Json& channels{ animation["channels"] };
+            const Json& samplers{ animation["samplers"] };
+            float duration{ 0.0f };
+
+            for (std::size_t c = 0; c < channels.size(); ++c) {
+                const Json& target{ channels[c]["target"] };
+                const int64_t node{ target["node"].index_or(-1) };
+                const std::string_view path{ target["path"].string };
+                const Json& sampler{ samplers[static_cast<std::size_t>(channels[c]["sampler"].index_or(-1))] };
+                if (node < 0 || static_cast<std::size_t>(node) >= node_tracks.size() || sampler.type != Json::Type::OBJECT) {
+                    continue;
+                }
+
+                math::TransformationType type;
+                uint32_t width;
+                std::vector<KeyframeTrack<float>>* tracks;
+                if (path == "translation") {
+                    type = math::TransformationType::TRANSLATION;
+                    width = 3;
+                    tracks = &node_tracks[node].translation;
+                }
+                else if (path == "rotation") {
+                    type = math::TransformationType::ROTATION3d;
+                    width = 4;
+                    tracks = &node_tracks[node].rotation;
+                }
+                else if (path == "scale") {
+                    type = math::TransformationType::SCALING;
+                    width = 3;
+                    tracks = &node_tracks[node].scale;
+                }
+                else {
+                    // morph target weights
+                    continue;
+                }
+
+                const std::string_view interpolation_name{ sampler["interpolation"].string };
+                const Interpolation interpolation{
+                    interpolation_name == "STEP" ? Interpolation::STEP :
+                    interpolation_name == "CUBICSPLINE" ? Interpolation::CUBIC_SPLINE : Interpolation::LINEAR
+                };
+
+                AccessorView input;
+                AccessorView output;
+                if (!resolve_accessor(doc, bin, sampler["input"].index_or(-1), input) || input.components != 1
+                    || !resolve_accessor(doc, bin, sampler["output"].index_or(-1), output) || output.components != width
+                    || output.count != input.count * (interpolation == Interpolation::CUBIC_SPLINE ? 3 : 1) || input.count == 0) {
+                    std::cerr << "gltf: unusable animation sampler skipped\n";
+                    continue;
+                }
+
+                KeyframeTrack<float> track{
+                    ._times = {},
+                    ._values = {},
+                    ._anim_type = type,
+                    ._interpolation = interpolation,
+                    ._loop = loop,
+                };
+                read_floats(input, track._times);
+                read_floats(output, track._values);
+                if (!std::is_sorted(track._times.begin(), track._times.end())) {
+                    std::cerr << "gltf: animation sampler with unsorted times skipped\n";
+                    continue;
+                }
+                duration = std::max(duration, track._times.back());
+
+                tracks->clear();
+                tracks->push_back(std::move(track));
+            }
+
+            // one clip, every track loops over its full length
+            for (NodeTracks& tracks : node_tracks) {
+                for (auto* list : { &tracks.translation, &tracks.rotation, &tracks.scale }) {
+                    for (KeyframeTrack<float>& track : *list) {
+                        track._duration = Duration_sec{ duration };
+                    }
+                }
+            }
+        }
+
+        // the node's local transform, translation * rotation * scale or its matrix
+        void append_node_transforms(const Json& node, NodeTracks& tracks, std::vector<TransformsByType>& chain) {
+            const Json& matrix{ node["matrix"] };
+            if (matrix.size() == 16) {
+                // column major
+                math::Matrix44<float> mat{ math::Matrix44<float>::identity_new() };
+                for (int c = 0; c < 4; ++c) {
+                    for (int r = 0; r < 4; ++r) {
+                        mat.at(r, c) = static_cast<float>(matrix[c * 4 + r].number_or(r == c ? 1.0 : 0.0));
+                    }
+                }
+                chain.emplace_back(
+                    math::TransformationType::TRANSLATION,
+                    std::vector{ math::Transformation<float>{ ._inner_mat = mat, ._transformation_type = math::TransformationType::TRANSLATION } },
+                    std::vector<Animation<float>>{}
+                );
+                return;
+            }
+
+            float values[4];
+            auto read{ [&node, &values](std::string_view key, std::initializer_list<float> fallback) {
+                const Json& json{ node[key] };
+                std::size_t c{ 0 };
+                for (float value : fallback) {
+                    values[c] = static_cast<float>(json[c].number_or(value));
+                    ++c;
+                }
+                return std::equal(fallback.begin(), fallback.end(), values);
+            } };
+
+            // animated parts replace the static value of the node
+            if (!tracks.translation.empty()) {
+                chain.emplace_back(math::TransformationType::TRANSLATION, std::vector<math::Transformation<float>>{}, std::vector<Animation<float>>{}, std::vector<KeyframeTrack<float>>(tracks.translation));
+            }
+            else if (!read("translation", { 0.0f, 0.0f, 0.0f })) {
+                chain.emplace_back(
+                    math::TransformationType::TRANSLATION,
+                    std::vector{ math::Transformation<float>::translation({ values[0], values[1], values[2] }) },
+                    std::vector<Animation<float>>{}
+                );
+            }
+
+            if (!tracks.rotation.empty()) {
+                chain.emplace_back(math::TransformationType::ROTATION3d, std::vector<math::Transformation<float>>{}, std::vector<Animation<float>>{}, std::vector<KeyframeTrack<float>>(tracks.rotation));
+            }
+            else if (!read("rotation", { 0.0f, 0.0f, 0.0f, 1.0f })) {
+                math::Matrix44<float> mat{ math::Matrix44<float>::identity_new() };
+                KeyframeTrack<float>::set_rotation(mat, values);
+                chain.emplace_back(
+                    math::TransformationType::ROTATION3d,
+                    std::vector{ math::Transformation<float>{ ._inner_mat = mat, ._transformation_type = math::TransformationType::ROTATION3d } },
+                    std::vector<Animation<float>>{}
+                );
+            }
+
+            if (!tracks.scale.empty()) {
+                chain.emplace_back(math::TransformationType::SCALING, std::vector<math::Transformation<float>>{}, std::vector<Animation<float>>{}, std::vector<KeyframeTrack<float>>(tracks.scale));
+            }
+            else if (!read("scale", { 1.0f, 1.0f, 1.0f })) {
+                chain.emplace_back(
+                    math::TransformationType::SCALING,
+                    std::vector{ math::Transformation<float>::scaling({ values[0], values[1], values[2] }) },
+                    std::vector<Animation<float>>{}
+                );
+            }
+        }
+
+        void add_node(
+            const Json&                                 doc,
+            std::size_t                                 node_index,
+            std::vector<TransformsByType>&              chain,
+            std::vector<NodeTracks>&                    node_tracks,
+            const std::vector<std::vector<PrimitiveRef>>& mesh_primitives,
+            const Program&                              program,
+            std::vector<uint8_t>&                       visited,
+            int                                         depth,
+            std::vector<GeometryObjectPrimitive>&       out
+        ) {
+            const Json& node{ doc["nodes"][node_index] };
+            // nodes form a forest, a second visit means a broken file
+            if (node.type != Json::Type::OBJECT || visited[node_index] || depth > max_node_depth) {
+                return;
+            }
+            visited[node_index] = 1;
+
+            const std::size_t chain_size{ chain.size() };
+            append_node_transforms(node, node_tracks[node_index], chain);
+
+            const int64_t mesh{ node["mesh"].index_or(-1) };
+            if (mesh >= 0 && static_cast<std::size_t>(mesh) < mesh_primitives.size()) {
+                for (const PrimitiveRef& primitive : mesh_primitives[mesh]) {
+                    out.emplace_back(std::vector<TransformsByType>{ chain }, primitive.index_count, 0, program, *primitive.vao, primitive.draw_type, std::vector<const Texture*>{});
+                }
+            }
+
+            const Json& children{ node["children"] };
+            for (std::size_t c = 0; c < children.size(); ++c) {
+                const int64_t child{ children[c].index_or(-1) };
+                if (child >= 0 && static_cast<std::size_t>(child) < visited.size()) {
+                    add_node(doc, static_cast<std::size_t>(child), chain, node_tracks, mesh_primitives, program, visited, depth + 1, out);
+                }
+            }
+
+            chain.erase(chain.begin() + static_cast<std::ptrdiff_t>(chain_size), chain.end());
+        }
+    }
+
+    bool load_glb(const char* path, const Program& program, GltfModel& model, const GltfLoadOptions& options) {
+        const MappedFile file{ path };
+        if (!file.is_open()) {
+            return false;
+        }
+
+        // header, then a json chunk and an optional binary one
+        const char* data{ file.data() };
+        if (file.size() < 20 || read_u32(data) != glb_magic || read_u32(data + 4) != 2 || read_u32(data + 8) > file.size()) {
+            std::cerr << "not a glb 2.0 file: " << path << '\n';
+            return false;
+        }
+        const std::size_t total_size{ read_u32(data + 8) };
+        const std::size_t json_size{ read_u32(data + 12) };
+        if (read_u32(data + 16) != glb_chunk_json || json_size > total_size - 20) {
+            std::cerr << "glb without a json chunk: " << path << '\n';
+            return false;
+        }
+        const char* json_begin{ data + 20 };
+
+        std::span<const uint8_t> bin;
+        const std::size_t bin_header{ 20 + json_size };
+        if (bin_header + 8 <= total_size && read_u32(data + bin_header + 4) == glb_chunk_bin) {
+            const std::size_t bin_size{ read_u32(data + bin_header) };
+            if (bin_size > total_size - bin_header - 8) {
+                std::cerr << "glb binary chunk out of the file: " << path << '\n';
+                return false;
+            }
+            bin = { reinterpret_cast<const uint8_t*>(data + bin_header + 8), bin_size };
+        }
+
+        Json doc;
+        if (!JsonParser{ json_begin, json_begin + json_size }.parse(doc) || doc.type != Json::Type::OBJECT) {
+            std::cerr << "glb with invalid json: " << path << '\n';
+            return false;
+        }
+
+        model = GltfModel{};
+
+        std::vector<std::array<float, 4>> base_colors;
+        const Json& materials{ doc["materials"] };
+        for (std::size_t m = 0; m < materials.size(); ++m) {
+            const Json& factor{ materials[m]["pbrMetallicRoughness"]["baseColorFactor"] };
+            base_colors.push_back({
+                static_cast<float>(factor[0].number_or(1.0)),
+                static_cast<float>(factor[1].number_or(1.0)),
+                static_cast<float>(factor[2].number_or(1.0)),
+                static_cast<float>(factor[3].number_or(1.0)),
+            });
+        }
+
+        const Json& meshes{ doc["meshes"] };
+        std::vector<std::vector<PrimitiveRef>> mesh_primitives(meshes.size());
+        for (std::size_t m = 0; m < meshes.size(); ++m) {
+            const Json& primitives{ meshes[m]["primitives"] };
+            for (std::size_t p = 0; p < primitives.size(); ++p) {
+                PrimitiveRef primitive;
+                if (build_primitive(doc, bin, primitives[p], base_colors, program, options, model, primitive)) {
+                    mesh_primitives[m].push_back(primitive);
+                }
+            }
+        }
+
+        const std::size_t node_count{ doc["nodes"].size() };
+        std::vector<NodeTracks> node_tracks(node_count);
+        const Json& animations{ doc["animations"] };
+        for (std::size_t a = 0; a < animations.size(); ++a) {
+            model.animation_names.emplace_back(animations[a]["name"].string);
+        }
+        if (options.animation >= 0 && static_cast<std::size_t>(options.animation) < animations.size()) {
+            load_animation(doc, bin, animations[options.animation], options.loop, node_tracks);
+        }
+
+        // roots of the default scene, or every node nobody lists as a child
+        std::vector<std::size_t> roots;
+        const Json& scene{ doc["scenes"][static_cast<std::size_t>(doc["scene"].index_or(0))] };
+        if (scene.has("nodes")) {
+            for (std::size_t n = 0; n < scene["nodes"].size(); ++n) {
+                const int64_t node{ scene["nodes"][n].index_or(-1) };
+                if (node >= 0 && static_cast<std::size_t>(node) < node_count) {
+                    roots.push_back(static_cast<std::size_t>(node));
+                }
+            }
+        }
+        else {
+            std::vector<uint8_t> is_child(node_count, 0);
+            for (std::size_t n = 0; n < node_count; ++n) {
+                const Json& children{ doc["nodes"][n]["children"] };
+                for (std::size_t c = 0; c < children.size(); ++c) {
+                    const int64_t child{ children[c].index_or(-1) };
+                    if (child >= 0 && static_cast<std::size_t>(child) < node_count) {
+                        is_child[child] = 1;
+                    }
+                }
+            }
+            for (std::size_t n = 0; n < node_count; ++n) {
+                if (!is_child[n]) {
+                    roots.push_back(n);
+                }
+            }
+        }
+
+        std::vector<uint8_t> visited(node_count, 0);
+        for (std::size_t root : roots) {
+            std::vector<TransformsByType> chain;
+            std::vector<GeometryObjectPrimitive> primitives;
+            add_node(doc, root, chain, node_tracks, mesh_primitives, program, visited, 0, primitives);
+            if (!primitives.empty()) {
+                model.objects.emplace_back(std::move(primitives));
+            }
+        }
+
+        return true;
+    }
+}
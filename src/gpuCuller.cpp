@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include "gpuCuller.hpp"
+#include "geometryObject.hpp"
+#include "renderer.hpp"
+#include "utils.hpp"
+
+namespace my_gl {
+    bool GpuCuller::is_supported() {
+        return GLEW_VERSION_4_3;
+    }
+
+    GpuCuller::GpuCuller(const char* cull_shader_path)
+        : _cull_program{ create_compute_program(cull_shader_path) }
+        , _compact{ static_cast<bool>(GLEW_VERSION_4_6 || GLEW_ARB_indirect_parameters) }
+    {
+        _frustum_planes_loc = glGetUniformLocation(_cull_program, "u_frustum_planes");
+        _object_count_loc = glGetUniformLocation(_cull_program, "u_object_count");
+        _compact_loc = glGetUniformLocation(_cull_program, "u_compact");
+    }
+
+    GpuCuller::~GpuCuller() {
+        delete_buffers();
+        glDeleteProgram(_cull_program);
+    }
+
+    void GpuCuller::delete_buffers() {
+        const GLuint buffers[]{ _objects_buffer, _commands_buffer, _draw_counts_buffer, _bucket_offsets_buffer, _object_ids_buffer };
+        glDeleteBuffers(static_cast<GLsizei>(std::size(buffers)), buffers);
+
+        _objects_buffer = 0;
+        _commands_buffer = 0;
+        _draw_counts_buffer = 0;
+        _bucket_offsets_buffer = 0;
+        _object_ids_buffer = 0;
+    }
+
+    void GpuCuller::build(const std::vector<GeometryObjectPrimitive*>& primitives, const std::vector<const Program*>& indirect_programs) {
+        delete_buffers();
+        _primitives.clear();
+        _objects.clear();
+        _buckets.clear();
+        _stats = Stats{};
+
+        if (primitives.empty()) {
+            return;
+        }
+
+        // bucket members get consecutive command slots
+        std::vector<uint32_t> order(primitives.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+            if (indirect_programs[lhs] != indirect_programs[rhs]) {
+                return indirect_programs[lhs] < indirect_programs[rhs];
+            }
+            if (primitives[lhs]->get_vao().get_id() != primitives[rhs]->get_vao().get_id()) {
+                return primitives[lhs]->get_vao().get_id() < primitives[rhs]->get_vao().get_id();
+            }
+            return primitives[lhs]->get_texture_slot().texture_unit < primitives[rhs]->get_texture_slot().texture_unit;
+        });
+
+        _primitives.reserve(primitives.size());
+        _objects.resize(primitives.size());
+
+        for (uint32_t slot = 0; slot < order.size(); ++slot) {
+            GeometryObjectPrimitive* primitive{ primitives[order[slot]] };
+            const Program* program{ indirect_programs[order[slot]] };
+
+            // arena meshes share one vao, so they share a bucket too, and so do layers of one texture array
+            const TextureSlot& texture_slot{ primitive->get_texture_slot() };
+            if (_buckets.empty() || _buckets.back().program != program || _buckets.back().vao->get_id() != primitive->get_vao().get_id()
+                || _buckets.back().texture_unit != texture_slot.texture_unit)
+            {
+                _buckets.push_back({ program, &primitive->get_vao(), texture_slot.texture_unit, slot, 0 });
+            }
+            ++_buckets.back().command_count;
+
+            // object id == slot, so commands of a bucket and its objects line up
+            _primitives.push_back(primitive);
+            _objects[slot].draw[2] = static_cast<uint32_t>(_buckets.size() - 1);
+            _objects[slot].draw[3] = static_cast<uint32_t>(primitive->get_vao().get_base_vertex());
+            _objects[slot].texture_transform[0] = texture_slot.uv_scale[0];
+            _objects[slot].texture_transform[1] = texture_slot.uv_scale[1];
+            _objects[slot].texture_transform[2] = texture_slot.uv_offset[0];
+            _objects[slot].texture_transform[3] = texture_slot.uv_offset[1];
+            _objects[slot].texture[0] = texture_slot.layer;
+        }
+
+        std::vector<uint32_t> bucket_offsets;
+        for (const Bucket& bucket : _buckets) {
+            bucket_offsets.push_back(bucket.first_command);
+        }
+        std::vector<uint32_t> object_ids(_objects.size());
+        std::iota(object_ids.begin(), object_ids.end(), 0u);
+
+        glCreateBuffers(1, &_objects_buffer);
+        glNamedBufferData(_objects_buffer, sizeof(GpuObject) * _objects.size(), nullptr, GL_DYNAMIC_DRAW);
+        glCreateBuffers(1, &_commands_buffer);
+        glNamedBufferData(_commands_buffer, sizeof(DrawCommand) * _objects.size(), nullptr, GL_DYNAMIC_COPY);
+        glCreateBuffers(1, &_draw_counts_buffer);
+        glNamedBufferData(_draw_counts_buffer, sizeof(uint32_t) * _buckets.size(), nullptr, GL_DYNAMIC_COPY);
+        glCreateBuffers(1, &_bucket_offsets_buffer);
+        glNamedBufferData(_bucket_offsets_buffer, sizeof(uint32_t) * bucket_offsets.size(), bucket_offsets.data(), GL_STATIC_DRAW);
+        glCreateBuffers(1, &_object_ids_buffer);
+        glNamedBufferData(_object_ids_buffer, sizeof(uint32_t) * object_ids.size(), object_ids.data(), GL_STATIC_DRAW);
+
+        // one instance per command, the attribute is fetched at base_instance == object id
+        for (const Bucket& bucket : _buckets) {
+            bucket.vao->bind();
+            glBindBuffer(GL_ARRAY_BUFFER, _object_ids_buffer);
+            glEnableVertexAttribArray(object_id_location);
+            glVertexAttribIPointer(object_id_location, 1, GL_UNSIGNED_INT, 0, nullptr);
+            glVertexAttribDivisor(object_id_location, 1);
+            bucket.vao->un_bind();
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        _stats.objects = static_cast<uint32_t>(_objects.size());
+        _stats.buckets = static_cast<uint32_t>(_buckets.size());
+    }
+
+    void GpuCuller::render(const math::Matrix44<float>& view_mat, const math::Matrix44<float>& view_proj_mat) {
+        if (_primitives.empty()) {
+            return;
+        }
+
+        for (std::size_t id = 0; id < _primitives.size(); ++id) {
+            const GeometryObjectPrimitive& primitive{ *_primitives[id] };
+            GpuObject& object{ _objects[id] };
+            const math::Aabb& bounds{ primitive.get_world_bounds() };
+
+            std::memcpy(object.model_mat, primitive.get_curr_model_mat().data(), sizeof(object.model_mat));
+            for (int c = 0; c < 3; ++c) {
+                object.bounds_min[c] = bounds.min[c];
+                object.bounds_max[c] = bounds.max[c];
+            }
+            object.bounds_min[3] = 1.0f;
+            object.bounds_max[3] = 1.0f;
+            const meshes::Dequantize& dequantize{ primitive.get_vao().get_dequantize() };
+            for (int c = 0; c < 3; ++c) {
+                object.dequantize_scale[c] = dequantize.scale[c];
+                object.dequantize_offset[c] = dequantize.offset[c];
+            }
+            object.dequantize_scale[3] = 1.0f;
+            object.dequantize_offset[3] = 0.0f;
+            // current lod range
+            object.draw[0] = static_cast<uint32_t>(primitive.get_draw_index_count());
+            object.draw[1] = static_cast<uint32_t>(primitive.get_vao().get_first_index() + primitive.get_draw_byte_offset() / sizeof(uint32_t));
+        }
+        glNamedBufferSubData(_objects_buffer, 0, sizeof(GpuObject) * _objects.size(), _objects.data());
+
+        if (_compact) {
+            glClearNamedBufferData(_draw_counts_buffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        }
+
+        const math::Frustum frustum{ view_proj_mat };
+        float planes[math::Frustum::COUNT * 4];
+        for (int p = 0; p < math::Frustum::COUNT; ++p) {
+            std::memcpy(&planes[p * 4], frustum.planes[p].n, sizeof(float) * 3);
+            planes[p * 4 + 3] = frustum.planes[p].d;
+        }
+
+        glUseProgram(_cull_program);
+        glUniform4fv(_frustum_planes_loc, math::Frustum::COUNT, planes);
+        glUniform1ui(_object_count_loc, static_cast<GLuint>(_objects.size()));
+        glUniform1i(_compact_loc, _compact);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _objects_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _commands_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, _draw_counts_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, _bucket_offsets_buffer);
+        glDispatchCompute((static_cast<GLuint>(_objects.size()) + 63) / 64, 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        glUseProgram(0);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _commands_buffer);
+        if (_compact) {
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, _draw_counts_buffer);
+        }
+
+        _stats.multi_draws = 0;
+        for (std::size_t b = 0; b < _buckets.size(); ++b) {
+            const Bucket& bucket{ _buckets[b] };
+            bucket.program->use();
+
+            const Uniform* view_unif{ bucket.program->get_uniform("u_view_mat") };
+            const Uniform* view_proj_unif{ bucket.program->get_uniform("u_view_proj_mat") };
+            if (view_unif) {
+                glUniformMatrix4fv(view_unif->location, 1, true, view_mat.data());
+            }
+            if (view_proj_unif) {
+                glUniformMatrix4fv(view_proj_unif->location, 1, true, view_proj_mat.data());
+            }
+            const Uniform* texture_array_unif{ bucket.program->get_uniform("u_texture_array") };
+            if (texture_array_unif && bucket.texture_unit >= 0) {
+                glUniform1i(texture_array_unif->location, bucket.texture_unit);
+            }
+
+            bucket.vao->bind();
+            const void* first_command{ reinterpret_cast<const void*>(bucket.first_command * sizeof(DrawCommand)) };
+            if (_compact) {
+                // glew only loads the ARB entry point when the driver advertises the extension, 4.6 has it in core
+                const GLintptr draw_count{ static_cast<GLintptr>(b * sizeof(uint32_t)) };
+                if (GLEW_VERSION_4_6) {
+                    glMultiDrawElementsIndirectCount(GL_TRIANGLES, bucket.vao->get_index_type(), first_command, draw_count, static_cast<GLsizei>(bucket.command_count), 0);
+                }
+                else {
+                    glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, bucket.vao->get_index_type(), first_command, draw_count, static_cast<GLsizei>(bucket.command_count), 0);
+                }
+            }
+            else {
+                // culled commands carry instance_count 0
+                glMultiDrawElementsIndirect(GL_TRIANGLES, bucket.vao->get_index_type(), first_command, static_cast<GLsizei>(bucket.command_count), 0);
+            }
+            bucket.vao->un_bind();
+            bucket.program->un_use();
+            ++_stats.multi_draws;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (_compact) {
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+        }
+    }
+
+    uint32_t GpuCuller::read_back_visible_count() const {
+        if (_primitives.empty()) {
+            return 0;
+        }
+
+        uint32_t visible{ 0 };
+        if (_compact) {
+            std::vector<uint32_t> counts(_buckets.size());
+            glGetNamedBufferSubData(_draw_counts_buffer, 0, sizeof(uint32_t) * counts.size(), counts.data());
+            visible = std::accumulate(counts.begin(), counts.end(), 0u);
+        }
+        else {
+            std::vector<DrawCommand> commands(_objects.size());
+            glGetNamedBufferSubData(_commands_buffer, 0, sizeof(DrawCommand) * commands.size(), commands.data());
+            for (const DrawCommand& command : commands) {
+                visible += command.instance_count;
+            }
+        }
+        return visible;
+    }
+}
@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include "hash.hpp"
+#include "mappedFile.hpp"
+
+namespace my_gl {
+    namespace {
+        uint64_t mix(uint64_t word) {
+            word *= 0xBF58476D1CE4E5B9ull;
+            word = std::rotl(word, 31);
+            return word * 0x94D049BB133111EBull;
+        }
+    }
+
+    uint64_t hash_bytes(const void* data, std::size_t size, uint64_t seed) {
+        const uint8_t* p{ static_cast<const uint8_t*>(data) };
+        // four independent lanes keep several multiplies in flight
+        uint64_t lanes[4]{ seed + 0x9E3779B97F4A7C15ull, seed ^ 0xC2B2AE3D27D4EB4Full, seed - 0x165667B19E3779F9ull, ~seed };
+        std::size_t remaining{ size };
+        for (; remaining >= 32; remaining -= 32, p += 32) {
+            for (int l = 0; l < 4; ++l) {
+                uint64_t word;
+                std::memcpy(&word, p + l * 8, sizeof(word));
+                lanes[l] = std::rotl(lanes[l] ^ mix(word), 27) * 5 + 0x52DCE729;
+            }
+        }
+
+        uint64_t h{ std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18) };
+        for (; remaining > 0; ) {
+            uint64_t word{ 0 };
+            const std::size_t bytes{ std::min<std::size_t>(remaining, 8) };
+            std::memcpy(&word, p, bytes);
+            h = std::rotl(h ^ mix(word), 27) * 5 + 0x52DCE729;
+            p += bytes;
+            remaining -= bytes;
+        }
+
+        // splitmix finalizer, the size keeps prefixes of zeros apart
+        h ^= size;
+        h ^= h >> 30;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 27;
+        h *= 0x94D049BB133111EBull;
+        return h ^ (h >> 31);
+    }
+
+    uint64_t hash_file(const char* path, uint64_t seed) {
+        const MappedFile file{ path };
+        if (!file.is_open()) {
+            return 0;
+        }
+        return hash_bytes(file.data(), file.size(), seed);
+    }
+}
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include "ktxFile.hpp"
+
+namespace my_gl {
+    namespace {
+        constexpr uint8_t ktx2_identifier[12]{ 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+        constexpr std::string_view source_hash_key{ "my_gl.source_hash" };
+        constexpr std::string_view writer_key{ "KTXwriter" };
+        constexpr std::string_view writer_name{ "my_gl" };
+
+        constexpr KtxFormat ktx_formats[]{
+            { 9,    GL_R8,                                  GL_RED,     1,  1,  1 },
+            { 16,   GL_RG8,                                 GL_RG,      2,  1,  2 },
+            { 23,   GL_RGB8,                                GL_RGB,     3,  1,  3 },
+            { 29,   GL_SRGB8,                               GL_RGB,     3,  1,  3 },
+            { 37,   GL_RGBA8,                               GL_RGBA,    4,  1,  4 },
+            { 43,   GL_SRGB8_ALPHA8,                        GL_RGBA,    4,  1,  4 },
+            { 131,  GL_COMPRESSED_RGB_S3TC_DXT1_EXT,        0,          8,  4,  3 },
+            { 137,  GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,       0,          16, 4,  4 },
+            { 139,  GL_COMPRESSED_RED_RGTC1,                0,          8,  4,  1 },
+            { 141,  GL_COMPRESSED_RG_RGTC2,                 0,          16, 4,  2 },
+            { 145,  GL_COMPRESSED_RGBA_BPTC_UNORM,          0,          16, 4,  4 },
+            { 147,  GL_COMPRESSED_RGB8_ETC2,                0,          8,  4,  3 },
+        };
+
+        // Khronos data format descriptor values, one basic block per file
+        enum DfdModel : uint8_t {
+            DFD_MODEL_RGBSDA = 1,
+            DFD_MODEL_BC1A = 128,
+            DFD_MODEL_BC3 = 130,
+            DFD_MODEL_BC4 = 131,
+            DFD_MODEL_BC5 = 132,
+            DFD_MODEL_BC7 = 134,
+            DFD_MODEL_ETC2 = 161,
+        };
+
+        constexpr uint8_t dfd_primaries_bt709{ 1 };
+        constexpr uint8_t dfd_transfer_linear{ 1 };
+        constexpr uint8_t dfd_transfer_srgb{ 2 };
+        // sample qualifier: the alpha of srgb formats stays linear
+        constexpr uint8_t dfd_sample_linear{ 0x10 };
+
+        struct DfdSample {
+            uint16_t    bit_offset;
+            uint8_t     bit_length;
+            uint8_t     channel;
+        };
+
+        struct DfdInfo {
+            uint8_t     model;
+            bool        srgb;
+            uint32_t    sample_count;
+            DfdSample   samples[4];
+        };
+
+        DfdInfo dfd_info(uint32_t vk_format) {
+            switch (vk_format) {
+            case 9:     return { DFD_MODEL_RGBSDA, false, 1, { { 0, 8, 0 } } };
+            case 16:    return { DFD_MODEL_RGBSDA, false, 2, { { 0, 8, 0 }, { 8, 8, 1 } } };
+            case 23:    return { DFD_MODEL_RGBSDA, false, 3, { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 } } };
+            case 29:    return { DFD_MODEL_RGBSDA, true, 3, { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 } } };
+            case 37:    return { DFD_MODEL_RGBSDA, false, 4, { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, 15 } } };
+            case 43:    return { DFD_MODEL_RGBSDA, true, 4, { { 0, 8, 0 }, { 8, 8, 1 }, { 16, 8, 2 }, { 24, 8, 15 | dfd_sample_linear } } };
+            case 131:   return { DFD_MODEL_BC1A, false, 1, { { 0, 64, 0 } } };
+            case 137:   return { DFD_MODEL_BC3, false, 2, { { 0, 64, 15 }, { 64, 64, 0 } } };
+            case 139:   return { DFD_MODEL_BC4, false, 1, { { 0, 64, 0 } } };
+            case 141:   return { DFD_MODEL_BC5, false, 2, { { 0, 64, 0 }, { 64, 64, 1 } } };
+            case 145:   return { DFD_MODEL_BC7, false, 1, { { 0, 128, 0 } } };
+            default:    return { DFD_MODEL_ETC2, false, 1, { { 0, 64, 2 } } };
+            }
+        }
+
+        struct Header {
+            uint8_t     identifier[12];
+            uint32_t    vk_format;
+            uint32_t    type_size;
+            uint32_t    pixel_width;
+            uint32_t    pixel_height;
+            uint32_t    pixel_depth;
+            uint32_t    layer_count;
+            uint32_t    face_count;
+            uint32_t    level_count;
+            uint32_t    supercompression_scheme;
+            uint32_t    dfd_byte_offset;
+            uint32_t    dfd_byte_length;
+            uint32_t    kvd_byte_offset;
+            uint32_t    kvd_byte_length;
+            uint64_t    sgd_byte_offset;
+            uint64_t    sgd_byte_length;
+        };
+
+        struct LevelIndex {
+            uint64_t    byte_offset;
+            uint64_t    byte_length;
+            uint64_t    uncompressed_byte_length;
+        };
+
+        static_assert(sizeof(Header) == 80 && sizeof(LevelIndex) == 24, "KTX2 records are written as laid out in memory");
+
+        std::size_t align_up(std::size_t value, std::size_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        std::vector<uint8_t> make_dfd(const KtxFormat& format) {
+            const DfdInfo info{ dfd_info(format.vk_format) };
+            const uint32_t block_size{ 24 + 16 * info.sample_count };
+            const uint8_t block_dimension{ static_cast<uint8_t>(format.block_size - 1) };
+
+            std::vector<uint32_t> words{
+                4 + block_size,
+                0,
+                2u | (block_size << 16),
+                static_cast<uint32_t>(info.model | (dfd_primaries_bt709 << 8) | ((info.srgb ? dfd_transfer_srgb : dfd_transfer_linear) << 16)),
+                static_cast<uint32_t>(block_dimension | (block_dimension << 8)),
+                format.block_bytes,
+                0,
+            };
+            for (uint32_t s = 0; s < info.sample_count; ++s) {
+                const DfdSample& sample{ info.samples[s] };
+                words.push_back(sample.bit_offset | ((sample.bit_length - 1u) << 16) | (static_cast<uint32_t>(sample.channel) << 24));
+                words.push_back(0);
+                words.push_back(0);
+                // normalized 8 bit channels span [0, 255], compressed ones the whole 32 bit range
+                words.push_back(format.block_size == 1 ? 255u : 0xFFFFFFFFu);
+            }
+
+            std::vector<uint8_t> bytes(words.size() * sizeof(uint32_t));
+            std::memcpy(bytes.data(), words.data(), bytes.size());
+            return bytes;
+        }
+
+        void append_key_value(std::vector<uint8_t>& kvd, std::string_view key, const void* value, std::size_t value_size) {
+            const uint32_t length{ static_cast<uint32_t>(key.size() + 1 + value_size) };
+            const std::size_t start{ kvd.size() };
+            kvd.resize(align_up(start + sizeof(length) + length, 4));
+            std::memcpy(kvd.data() + start, &length, sizeof(length));
+            std::memcpy(kvd.data() + start + sizeof(length), key.data(), key.size());
+            std::memcpy(kvd.data() + start + sizeof(length) + key.size() + 1, value, value_size);
+        }
+    }
+
+    bool is_ktx2_path(std::string_view path) {
+        return path.ends_with(".ktx2");
+    }
+
+    const KtxFormat* find_ktx_format(uint32_t vk_format) {
+        for (const KtxFormat& format : ktx_formats) {
+            if (format.vk_format == vk_format) {
+                return &format;
+            }
+        }
+        return nullptr;
+    }
+
+    std::size_t ktx_level_bytes(const KtxFormat& format, uint32_t width, uint32_t height) {
+        const std::size_t blocks_x{ (width + format.block_size - 1) / format.block_size };
+        const std::size_t blocks_y{ (height + format.block_size - 1) / format.block_size };
+        return blocks_x * blocks_y * format.block_bytes;
+    }
+
+    bool write_ktx2(
+        const char*                                 path,
+        uint32_t                                    vk_format,
+        uint32_t                                    width,
+        uint32_t                                    height,
+        const std::vector<std::vector<uint8_t>>&    levels,
+        uint64_t                                    source_hash
+    ) {
+        const KtxFormat* format{ find_ktx_format(vk_format) };
+        if (!format || width == 0 || height == 0 || levels.empty()) {
+            std::cerr << "nothing to write as ktx2: " << path << '\n';
+            return false;
+        }
+        for (std::size_t i = 0; i < levels.size(); ++i) {
+            if (levels[i].size() != ktx_level_bytes(*format, std::max(width >> i, 1u), std::max(height >> i, 1u))) {
+                std::cerr << "mip level " << i << " doesn't match its size, no ktx2 written: " << path << '\n';
+                return false;
+            }
+        }
+
+        const std::vector<uint8_t> dfd{ make_dfd(*format) };
+        std::vector<uint8_t> kvd;
+        append_key_value(kvd, writer_key, writer_name.data(), writer_name.size() + 1);
+        append_key_value(kvd, source_hash_key, &source_hash, sizeof(source_hash));
+
+        Header header{};
+        std::memcpy(header.identifier, ktx2_identifier, sizeof(header.identifier));
+        header.vk_format = vk_format;
+        header.type_size = 1;
+        header.pixel_width = width;
+        header.pixel_height = height;
+        header.face_count = 1;
+        header.level_count = static_cast<uint32_t>(levels.size());
+        header.dfd_byte_offset = static_cast<uint32_t>(sizeof(Header) + levels.size() * sizeof(LevelIndex));
+        header.dfd_byte_length = static_cast<uint32_t>(dfd.size());
+        header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+        header.kvd_byte_length = static_cast<uint32_t>(kvd.size());
+
+        // the smallest level comes first in the file, every one aligned to lcm(block bytes, 4)
+        const std::size_t alignment{ std::lcm<std::size_t>(format->block_bytes, 4) };
+        std::vector<LevelIndex> level_index(levels.size());
+        std::size_t offset{ header.kvd_byte_offset + header.kvd_byte_length };
+        for (std::size_t i = levels.size(); i-- > 0; ) {
+            offset = align_up(offset, alignment);
+            level_index[i] = { offset, levels[i].size(), levels[i].size() };
+            offset += levels[i].size();
+        }
+
+        // written next to the target and renamed over it, like mesh caches
+        const std::string temp_path{ std::string{ path } + ".tmp" };
+        {
+            std::ofstream out{ temp_path, std::ios::binary | std::ios::trunc };
+            if (!out) {
+                std::cerr << "can't write ktx2: " << temp_path << '\n';
+                return false;
+            }
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(level_index.data()), static_cast<std::streamsize>(level_index.size() * sizeof(LevelIndex)));
+            out.write(reinterpret_cast<const char*>(dfd.data()), static_cast<std::streamsize>(dfd.size()));
+            out.write(reinterpret_cast<const char*>(kvd.data()), static_cast<std::streamsize>(kvd.size()));
+
+            std::size_t written{ header.kvd_byte_offset + header.kvd_byte_length };
+            const char zeros[16]{};
+            for (std::size_t i = levels.size(); i-- > 0; ) {
+                out.write(zeros, static_cast<std::streamsize>(level_index[i].byte_offset - written));
+                out.write(reinterpret_cast<const char*>(levels[i].data()), static_cast<std::streamsize>(levels[i].size()));
+                written = level_index[i].byte_offset + levels[i].size();
+            }
+            if (!out) {
+                std::cerr << "can't write ktx2: " << temp_path << '\n';
+                return false;
+            }
+        }
+
+        if (std::rename(temp_path.c_str(), path) != 0) {
+            std::cerr << "can't move ktx2 into place: " << path << '\n';
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    KtxFile::KtxFile(const char* path)
+        : _file{ path }
+    {
+        if (!_file.is_open()) {
+            return;
+        }
+        const auto data{ reinterpret_cast<const uint8_t*>(_file.data()) };
+        const std::size_t size{ _file.size() };
+
+        Header header;
+        if (size < sizeof(header)) {
+            std::cerr << "not a ktx2 file: " << path << '\n';
+            return;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.identifier, ktx2_identifier, sizeof(ktx2_identifier)) != 0) {
+            std::cerr << "not a ktx2 file: " << path << '\n';
+            return;
+        }
+
+        const KtxFormat* format{ find_ktx_format(header.vk_format) };
+        // a level count of 0 asks the loader to generate the mips, only the base level is stored
+        const uint32_t level_count{ std::max(header.level_count, 1u) };
+        if (!format || header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1
+            || header.face_count != 1 || header.supercompression_scheme != 0 || level_count > 32) {
+            std::cerr << "unsupported ktx2 (format " << header.vk_format << ", only plain 2d textures load): " << path << '\n';
+            return;
+        }
+        if (size < sizeof(Header) + level_count * sizeof(LevelIndex)) {
+            std::cerr << "broken ktx2: " << path << '\n';
+            return;
+        }
+
+        for (uint32_t i = 0; i < level_count; ++i) {
+            LevelIndex level;
+            std::memcpy(&level, data + sizeof(Header) + i * sizeof(LevelIndex), sizeof(level));
+            const std::size_t expected{ ktx_level_bytes(*format, std::max(header.pixel_width >> i, 1u), std::max(header.pixel_height >> i, 1u)) };
+            if (level.byte_length != expected || level.byte_offset > size || level.byte_length > size - level.byte_offset) {
+                std::cerr << "broken ktx2 mip level " << i << ": " << path << '\n';
+                _levels.clear();
+                return;
+            }
+            _levels.push_back({ data + level.byte_offset, static_cast<std::size_t>(level.byte_length) });
+        }
+
+        // the source hash is optional, a broken key/value block just leaves it 0
+        if (header.kvd_byte_offset <= size && header.kvd_byte_length <= size - header.kvd_byte_offset) {
+            const uint8_t* kvd{ data + header.kvd_byte_offset };
+            std::size_t at{ 0 };
+            while (at + sizeof(uint32_t) <= header.kvd_byte_length) {
+                uint32_t length;
+                std::memcpy(&length, kvd + at, sizeof(length));
+                at += sizeof(length);
+                if (length > header.kvd_byte_length - at) {
+                    break;
+                }
+                const std::string_view entry{ reinterpret_cast<const char*>(kvd + at), length };
+                if (entry.size() == source_hash_key.size() + 1 + sizeof(_source_hash) && entry.starts_with(source_hash_key) && entry[source_hash_key.size()] == '\0') {
+                    std::memcpy(&_source_hash, entry.data() + source_hash_key.size() + 1, sizeof(_source_hash));
+                }
+                at = align_up(at + length, 4);
+            }
+        }
+
+        _format = format;
+        _width = header.pixel_width;
+        _height = header.pixel_height;
+    }
+}
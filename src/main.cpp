@@ -2,7 +2,9 @@
 #include <GLFW/glfw3.h>
 #include <chrono>
 #include <ctime>
+#include <memory>
 #include "animation.hpp"
+#include "assetCache.hpp"
 #include "math.hpp"
 #include "matrix.hpp"
 #include "sharedTypes.hpp"
@@ -12,26 +14,88 @@
 #include "renderer.hpp"
 #include "geometryObject.hpp"
 #include "texture.hpp"
+#include "textureArrays.hpp"
+#include "textureStreamer.hpp"
 #include "globals.hpp"
 #include "camera.hpp"
 #include "meshes.hpp"
+#include "meshArena.hpp"
+#include "meshCache.hpp"
+#include "meshLod.hpp"
+#include "meshOptimize.hpp"
+#include "parametricMeshes.hpp"
 #include "userDefinedObjects.hpp"
+#include "programCache.hpp"
+#include "shaderWatcher.hpp"
 
 int main() {
     my_gl::Window window{ my_gl::init_window() };
 
-    constexpr uint16_t texture_offset{ sizeof(float) * 3 * 4 * 6 };
-    constexpr uint16_t color_offset{ texture_offset + sizeof(float) * 2 * 4 * 6 };
-    constexpr uint16_t normal_offset{ color_offset + sizeof(float) * 3 * 4 * 6 };
+    // interleaved vertices, a vertex fetch touches one cache line instead of one per planar block
+    // and packed: 16 bit positions, half uvs, 8 bit colors, 10 bit normals
+    const auto& vertex_format{ my_gl::meshes::cube_mesh_format_packed };
+    const auto vertex_layout{ my_gl::meshes::make_vertex_layout(vertex_format, my_gl::meshes::VertexLayoutType::INTERLEAVED) };
+    const std::size_t cube_vertex_count{ my_gl::meshes::cube_mesh.vertices.size() / my_gl::meshes::floats_per_vertex(vertex_format) };
 
+    // flat color, cheap to build; stands in for programs still compiling
+    my_gl::Program light_shader{
+        "shaders/vertShaderLight.glsl",
+        "shaders/fragShaderLight.glsl",
+        my_gl::make_attributes(vertex_layout, cube_vertex_count, { "a_pos" }),
+        {
+            { .name = "u_mvp_mat" },
+            { .name = "u_color" }
+        }
+    };
+
+    // compiles in the background, the first frames draw it with the light shader
     my_gl::Program world_shader{
         "shaders/vertShader.glsl",
         "shaders/fragShader.glsl",
+        my_gl::make_attributes(vertex_layout, cube_vertex_count, { "a_pos", "a_color", "a_normal" }),
+        {
+            { .name = "u_mvp_mat" },
+            { .name = "u_model_view_mat" },
+            { .name = "u_normal_mat" },
+            { .name = "u_light_color" },
+            { .name = "u_light_pos" },
+            { .name = "u_view_pos" },
+        },
+        light_shader
+    };
+
+    // flat color for the gpu culler's draws, reads its object buffer like the lit one it stands in for
+    my_gl::Program light_shader_indirect{
+        "shaders/vertShaderIndirect.glsl",
+        "shaders/fragShaderLight.glsl",
+        my_gl::make_attributes(vertex_layout, cube_vertex_count, { "a_pos" }),
+        {
+            { .name = "u_view_proj_mat" },
+            { .name = "u_color" }
+        }
+    };
+
+    // same lighting, model matrices come from the gpu culler's object buffer
+    // compiles in the background as well, the culled draws are flat until it's done
+    my_gl::Program world_shader_indirect{
+        "shaders/vertShaderIndirect.glsl",
+        "shaders/fragShader.glsl",
+        my_gl::make_attributes(vertex_layout, cube_vertex_count, { "a_pos", "a_color", "a_normal" }),
         {
-            { .name = "a_pos", .gl_type = GL_FLOAT, .count = 3, .byte_stride = 0, .byte_offset = 0 },
-            { .name = "a_color", .gl_type = GL_FLOAT, .count = 3, .byte_stride = 0, .byte_offset = color_offset },
-            { .name = "a_normal", .gl_type = GL_FLOAT, .count = 3, .byte_stride = 0, .byte_offset = normal_offset },
+            { .name = "u_view_mat" },
+            { .name = "u_view_proj_mat" },
+            { .name = "u_light_color" },
+            { .name = "u_light_pos" },
+            { .name = "u_view_pos" },
         },
+        light_shader_indirect
+    };
+
+    // lit like the world shader, texels come from the layer of the primitive's texture slot
+    my_gl::Program array_shader{
+        "shaders/vertShaderArray.glsl",
+        "shaders/fragShaderArray.glsl",
+        my_gl::make_attributes(vertex_layout, cube_vertex_count, { "a_pos", "a_color", "a_normal", "a_tex" }),
         {
             { .name = "u_mvp_mat" },
             { .name = "u_model_view_mat" },
@@ -39,20 +103,47 @@ int main() {
             { .name = "u_light_color" },
             { .name = "u_light_pos" },
             { .name = "u_view_pos" },
-        }
+            { .name = "u_texture_array" },
+            { .name = "u_texture_layer" },
+            { .name = "u_texture_transform" },
+        },
+        light_shader
     };
 
-    my_gl::Program light_shader{
-        "shaders/vertShaderLight.glsl",
-        "shaders/fragShaderLight.glsl",
+    // the gpu culler's version, layer and uv transform come with the object
+    my_gl::Program array_shader_indirect{
+        "shaders/vertShaderIndirectArray.glsl",
+        "shaders/fragShaderArray.glsl",
+        my_gl::make_attributes(vertex_layout, cube_vertex_count, { "a_pos", "a_color", "a_normal", "a_tex" }),
         {
-            { .name = "a_pos", .gl_type = GL_FLOAT, .count = 3, .byte_stride = 0, .byte_offset = 0 },
+            { .name = "u_view_mat" },
+            { .name = "u_view_proj_mat" },
+            { .name = "u_light_color" },
+            { .name = "u_light_pos" },
+            { .name = "u_view_pos" },
+            { .name = "u_texture_array" },
         },
+        light_shader_indirect
+    };
+
+    // shaders and images asked for twice are loaded once
+    my_gl::AssetCache asset_cache;
+
+    // lit, texels from the bound sampler2D
+    const auto texture_shader{ asset_cache.program(
+        "shaders/vertShaderTextureLit.glsl",
+        "shaders/fragShaderTextureLit.glsl",
+        my_gl::make_attributes(vertex_layout, cube_vertex_count, { "a_pos", "a_color", "a_normal", "a_tex" }),
         {
             { .name = "u_mvp_mat" },
-            { .name = "u_color" }
+            { .name = "u_model_view_mat" },
+            { .name = "u_normal_mat" },
+            { .name = "u_light_color" },
+            { .name = "u_light_pos" },
+            { .name = "u_view_pos" },
+            { .name = "u_texture" },
         }
-    };
+    ) };
 
 // move this to object to dynamically assign uniform value,
 //this would be overwritten if specified more textures than uniforms
@@ -61,16 +152,75 @@ int main() {
     //    { "res/mine_green.jpg", program2, program2.get_uniform("u_tex_data2"), 1, GL_TEXTURE1 },
     //};
 
+    // every shader reads from the same buffers
+    my_gl::MeshArena mesh_arena{
+        vertex_format,
+        vertex_layout.type,
+        { &world_shader, &world_shader_indirect, &light_shader, &array_shader, &array_shader_indirect, texture_shader.get() }
+    };
+
+    // same cube, one copy in the arena
     my_gl::VertexArray vertex_arr_world{
         my_gl::meshes::cube_mesh,
-        world_shader
+        mesh_arena
     };
 
     my_gl::VertexArray vertex_arr_light{
         my_gl::meshes::cube_mesh,
-        light_shader
+        mesh_arena
+    };
+
+    my_gl::VertexArray vertex_arr_poster{
+        my_gl::meshes::plane_mesh,
+        mesh_arena
     };
 
+    // white, the texture alone colors it
+    const my_gl::meshes::Mesh block_mesh{ my_gl::meshes::make_mesh({ .shape = my_gl::meshes::ParametricShape::BOX }) };
+    my_gl::VertexArray vertex_arr_block{
+        block_mesh,
+        mesh_arena
+    };
+
+    // fine enough that distance matters: the renderer draws one of its lods, picked per frame by screen size
+    const my_gl::meshes::ParametricMesh sphere_shape{
+        .shape = my_gl::meshes::ParametricShape::SPHERE,
+        .segments_u = 96,
+        .segments_v = 48,
+        .color = { 0.3f, 0.6f, 1.0f }
+    };
+    // built, optimized and simplified on the first launch only, later ones map the result
+    const char* const sphere_cache_path{ "res/sphere.mglc" };
+    const uint64_t sphere_hash{ my_gl::hash_bytes(&sphere_shape, sizeof(sphere_shape)) };
+    my_gl::MeshCacheInfo sphere_info;
+    std::unique_ptr<my_gl::VertexArray> vertex_arr_sphere{ my_gl::load_mesh_cache(
+        sphere_cache_path,
+        sphere_hash,
+        { &world_shader, &world_shader_indirect, &light_shader },
+        &sphere_info
+    ) };
+    std::vector<my_gl::meshes::LodLevel> sphere_lods{ std::move(sphere_info.lods) };
+    if (!vertex_arr_sphere) {
+        my_gl::meshes::Mesh sphere_mesh{ my_gl::meshes::make_mesh(sphere_shape) };
+        const std::size_t index_count{ sphere_mesh.indices.size() };
+        // rows of quads miss the vertex cache on every row, reordered the sphere transforms a third fewer vertices
+        my_gl::meshes::optimize_mesh(sphere_mesh, my_gl::meshes::cube_mesh_format, 0, index_count);
+        sphere_lods = my_gl::meshes::build_lod_chain(sphere_mesh, 0, index_count);
+        // collapses scatter the triangle order the coarser levels inherit
+        for (std::size_t lod = 1; lod < sphere_lods.size(); ++lod) {
+            my_gl::meshes::optimize_vertex_cache(sphere_mesh, sphere_lods[lod].buffer_byte_offset, sphere_lods[lod].index_count);
+        }
+        my_gl::write_mesh_cache(sphere_cache_path, sphere_hash, sphere_mesh, vertex_format, vertex_layout, sphere_lods);
+        vertex_arr_sphere = std::make_unique<my_gl::VertexArray>(
+            sphere_mesh,
+            vertex_format,
+            vertex_layout,
+            std::vector<const my_gl::Program*>{ &world_shader, &world_shader_indirect, &light_shader }
+        );
+    }
+    // level 0 is the whole sphere
+    const std::size_t sphere_index_count{ sphere_lods.front().index_count };
+
     // transformations
     std::vector<my_gl::TransformsByType> world_transforms = {
         {
@@ -118,6 +268,16 @@ int main() {
         }
     };
 
+    std::vector<my_gl::TransformsByType> sphere_transforms = {
+        {
+            my_gl::math::TransformationType::TRANSLATION,
+            {
+                my_gl::math::Transformation<float>::translation({ -1.5f, -0.5f, -2.0f }),
+            },
+            {}
+        }
+    };
+
     // primitives
     std::vector<my_gl::GeometryObjectPrimitive> primitives = {
         // world cube
@@ -139,8 +299,116 @@ int main() {
             vertex_arr_light,
             GL_TRIANGLES,
             {}
+        },
+        // sphere
+        {
+            std::move(sphere_transforms),
+            sphere_index_count,
+            0,
+            world_shader,
+            *vertex_arr_sphere,
+            GL_TRIANGLES,
+            {}
         }
     };
+    primitives.back().set_lods(std::move(sphere_lods));
+
+    // the blocks are one size, so they are layers of one array: no texture binds between their draws
+    const std::vector<std::string> block_paths{
+        "res/mine_red.jpg",
+        "res/mine_green.jpg",
+        "res/mine_amethist.jpg",
+        "res/mine_grass.jpg",
+    };
+    my_gl::TextureArrays block_textures{ block_paths, 1 };
+    for (std::size_t block = 0; block < block_paths.size(); ++block) {
+        std::vector<my_gl::TransformsByType> block_transforms = {
+            {
+                my_gl::math::TransformationType::TRANSLATION,
+                {
+                    my_gl::math::Transformation<float>::translation({ -3.0f + 2.0f * static_cast<float>(block), -1.5f, -3.0f }),
+                },
+                {}
+            }
+        };
+        primitives.emplace_back(
+            std::move(block_transforms),
+            block_mesh.indices.size(),
+            0,
+            array_shader,
+            vertex_arr_block,
+            GL_TRIANGLES,
+            std::vector<const my_gl::Texture*>{}
+        );
+        primitives.back().set_texture_slot(block_textures.slot(block));
+    }
+
+    // both posters ask the cache for the same image, the second request shares the first one's texture
+    const float poster_xs[]{ -2.5f, 2.5f };
+    std::vector<my_gl::Texture> poster_textures;
+    for (std::size_t poster = 0; poster < std::size(poster_xs); ++poster) {
+        poster_textures.push_back(asset_cache.texture(
+            "res/face.png",
+            *texture_shader,
+            texture_shader->get_uniform("u_texture"),
+            0,
+            GL_TEXTURE0
+        ));
+    }
+    for (std::size_t poster = 0; poster < poster_textures.size(); ++poster) {
+        std::vector<my_gl::TransformsByType> poster_transforms = {
+            {
+                my_gl::math::TransformationType::TRANSLATION,
+                {
+                    my_gl::math::Transformation<float>::translation({ poster_xs[poster], 0.5f, -4.0f }),
+                    // stood up from the xz plane, facing the camera
+                    my_gl::math::Transformation<float>::rotation(90.0f, my_gl::math::Global::AXIS::X),
+                    my_gl::math::Transformation<float>::scaling({ 1.5f, 1.0f, 1.5f }),
+                },
+                {}
+            }
+        };
+        primitives.emplace_back(
+            std::move(poster_transforms),
+            my_gl::meshes::plane_mesh_shape.index_count(),
+            0,
+            *texture_shader,
+            vertex_arr_poster,
+            GL_TRIANGLES,
+            std::vector<const my_gl::Texture*>{ &poster_textures[poster] }
+        );
+    }
+
+    // the floor's finer mips stream in as the camera gets close to it, the coarse tail is there from the start
+    my_gl::TextureStreamer texture_streamer;
+    const my_gl::Texture floor_texture{
+        "res/brick_wall.jpg",
+        texture_streamer,
+        *texture_shader,
+        texture_shader->get_uniform("u_texture"),
+        0,
+        GL_TEXTURE0
+    };
+    std::vector<my_gl::TransformsByType> floor_transforms = {
+        {
+            my_gl::math::TransformationType::TRANSLATION,
+            {
+                my_gl::math::Transformation<float>::translation({ 0.0f, -2.0f, -4.0f }),
+                my_gl::math::Transformation<float>::scaling({ 8.0f, 1.0f, 8.0f }),
+            },
+            {}
+        }
+    };
+    primitives.emplace_back(
+        std::move(floor_transforms),
+        my_gl::meshes::plane_mesh_shape.index_count(),
+        0,
+        *texture_shader,
+        vertex_arr_poster,
+        GL_TRIANGLES,
+        std::vector<const my_gl::Texture*>{ &floor_texture }
+    );
+    primitives.back().set_uv_density(my_gl::uv_density(my_gl::meshes::plane_mesh, my_gl::meshes::cube_mesh_format));
 
     // camera
     auto view_mat{ my_gl::globals::camera.get_view_mat() };
@@ -154,8 +422,21 @@ int main() {
         std::move(view_mat),
         std::move(proj_mat),
     };
+    renderer.set_indirect_program(world_shader, world_shader_indirect);
+    renderer.set_indirect_program(array_shader, array_shader_indirect);
+    renderer.set_texture_streamer(&texture_streamer);
+    // static primitives sharing program and textures end up in a few world space batches
+    renderer.bake_static_batches(mesh_arena, {
+        { &vertex_arr_world, my_gl::meshes::cube_mesh },
+        { &vertex_arr_light, my_gl::meshes::cube_mesh },
+        { &vertex_arr_block, block_mesh },
+    });
 
     world_shader.set_uniform_value("u_light_color", 1.0f, 1.0f, 1.0f);
+    world_shader_indirect.set_uniform_value("u_light_color", 1.0f, 1.0f, 1.0f);
+    array_shader.set_uniform_value("u_light_color", 1.0f, 1.0f, 1.0f);
+    array_shader_indirect.set_uniform_value("u_light_color", 1.0f, 1.0f, 1.0f);
+    texture_shader->set_uniform_value("u_light_color", 1.0f, 1.0f, 1.0f);
 
     my_gl::math::Vec3<float> light_pos_view_coords{ renderer._view_mat * my_gl::globals::light_pos };
 
@@ -177,7 +458,27 @@ int main() {
         my_gl::globals::camera.camera_pos[1],
         my_gl::globals::camera.camera_pos[2]
     );
+    array_shader.set_uniform_value("u_light_pos",
+        my_gl::globals::light_pos[0],
+        my_gl::globals::light_pos[1],
+        my_gl::globals::light_pos[2]
+    );
+    array_shader.set_uniform_value("u_view_pos",
+        my_gl::globals::camera.camera_pos[0],
+        my_gl::globals::camera.camera_pos[1],
+        my_gl::globals::camera.camera_pos[2]
+    );
     light_shader.set_uniform_value("u_color", 1.0f, 1.0f, 1.0f);
+    light_shader_indirect.set_uniform_value("u_color", 1.0f, 1.0f, 1.0f);
+
+    // edits of shaders/*.glsl show up a few frames later
+    my_gl::ShaderWatcher shader_watcher;
+    shader_watcher.watch(world_shader);
+    shader_watcher.watch(world_shader_indirect);
+    shader_watcher.watch(light_shader);
+    shader_watcher.watch(light_shader_indirect);
+    shader_watcher.watch(array_shader);
+    shader_watcher.watch(array_shader_indirect);
 
     bool is_rendering_started{false};
     glfwSwapInterval(1);
@@ -219,16 +520,65 @@ int main() {
             my_gl::globals::camera.camera_pos[2]
         );
 
+        world_shader_indirect.set_uniform_value("u_light_pos",
+            my_gl::globals::light_pos[0],
+            my_gl::globals::light_pos[1],
+            my_gl::globals::light_pos[2]
+        );
+        world_shader_indirect.set_uniform_value("u_view_pos",
+            my_gl::globals::camera.camera_pos[0],
+            my_gl::globals::camera.camera_pos[1],
+            my_gl::globals::camera.camera_pos[2]
+        );
+
+        array_shader.set_uniform_value("u_light_pos",
+            my_gl::globals::light_pos[0],
+            my_gl::globals::light_pos[1],
+            my_gl::globals::light_pos[2]
+        );
+        array_shader.set_uniform_value("u_view_pos",
+            my_gl::globals::camera.camera_pos[0],
+            my_gl::globals::camera.camera_pos[1],
+            my_gl::globals::camera.camera_pos[2]
+        );
+
+        array_shader_indirect.set_uniform_value("u_light_pos",
+            my_gl::globals::light_pos[0],
+            my_gl::globals::light_pos[1],
+            my_gl::globals::light_pos[2]
+        );
+        array_shader_indirect.set_uniform_value("u_view_pos",
+            my_gl::globals::camera.camera_pos[0],
+            my_gl::globals::camera.camera_pos[1],
+            my_gl::globals::camera.camera_pos[2]
+        );
+
+        texture_shader->set_uniform_value("u_light_pos",
+            my_gl::globals::light_pos[0],
+            my_gl::globals::light_pos[1],
+            my_gl::globals::light_pos[2]
+        );
+        texture_shader->set_uniform_value("u_view_pos",
+            my_gl::globals::camera.camera_pos[0],
+            my_gl::globals::camera.camera_pos[1],
+            my_gl::globals::camera.camera_pos[2]
+        );
+
         float time_0to1 = my_gl::math::Global::map_duration_to01(renderer.get_curr_rendering_duration());
         renderer.render(time_0to1);
+        // the renderer requested the mips its visible primitives sample
+        texture_streamer.update();
 
         glfwSwapBuffers(window.ptr_raw());
         glfwPollEvents();
+        shader_watcher.update();
 
         my_gl::Duration_sec frame_duration{ std::chrono::steady_clock::now() - start_frame };
         renderer.update_time(frame_duration);
         my_gl::globals::delta_time = frame_duration.count();
     }
 
+    // the worker's context goes away with the window
+    my_gl::ProgramCache::shared().stop_worker();
     return 0;
 }
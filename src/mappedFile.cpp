@@ -0,0 +1,70 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <utility>
+#include "mappedFile.hpp"
+
+namespace my_gl {
+    MappedFile::MappedFile(const char* path) {
+        const int fd{ ::open(path, O_RDONLY) };
+        if (fd < 0) {
+            std::cerr << "can't open file: " << path << '\n';
+            return;
+        }
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0) {
+            std::cerr << "can't stat file: " << path << '\n';
+            ::close(fd);
+            return;
+        }
+
+        _size = static_cast<std::size_t>(info.st_size);
+        if (_size > 0) {
+            void* mapping{ ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0) };
+            if (mapping == MAP_FAILED) {
+                std::cerr << "can't map file: " << path << '\n';
+                _size = 0;
+                ::close(fd);
+                return;
+            }
+            // readers split files into chunks and touch all of them at once
+            ::madvise(mapping, _size, MADV_WILLNEED);
+            _data = static_cast<const char*>(mapping);
+        }
+        // the mapping keeps the file alive
+        ::close(fd);
+        _open = true;
+    }
+
+    MappedFile::MappedFile(MappedFile&& rhs) noexcept
+        : _data{ std::exchange(rhs._data, nullptr) }
+        , _size{ std::exchange(rhs._size, 0) }
+        , _open{ std::exchange(rhs._open, false) }
+    {}
+
+    MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept {
+        if (this != &rhs) {
+            close();
+            _data = std::exchange(rhs._data, nullptr);
+            _size = std::exchange(rhs._size, 0);
+            _open = std::exchange(rhs._open, false);
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    void MappedFile::close() {
+        if (_data) {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+        _data = nullptr;
+        _size = 0;
+        _open = false;
+    }
+}
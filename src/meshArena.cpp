@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "meshArena.hpp"
+#include "hash.hpp"
+#include "renderer.hpp"
+
+namespace my_gl {
+    // RangeAllocator
+    RangeAllocator::RangeAllocator(uint32_t capacity)
+        : _free{ { 0, capacity } }
+        , _capacity{ capacity }
+    {}
+
+    uint32_t RangeAllocator::allocate(uint32_t size) {
+        if (size == 0) {
+            return invalid_offset;
+        }
+
+        for (auto it{ _free.begin() }; it != _free.end(); ++it) {
+            if (it->size < size) {
+                continue;
+            }
+
+            const uint32_t offset{ it->offset };
+            it->offset += size;
+            it->size -= size;
+            if (it->size == 0) {
+                _free.erase(it);
+            }
+            _used += size;
+            return offset;
+        }
+
+        return invalid_offset;
+    }
+
+    void RangeAllocator::free(uint32_t offset, uint32_t size) {
+        if (size == 0) {
+            return;
+        }
+
+        auto next{ std::lower_bound(_free.begin(), _free.end(), offset, [](const Block& block, uint32_t off) {
+            return block.offset < off;
+        }) };
+        _used -= size;
+
+        const bool merge_prev{ next != _free.begin() && std::prev(next)->offset + std::prev(next)->size == offset };
+        const bool merge_next{ next != _free.end() && offset + size == next->offset };
+
+        if (merge_prev && merge_next) {
+            std::prev(next)->size += size + next->size;
+            _free.erase(next);
+        }
+        else if (merge_prev) {
+            std::prev(next)->size += size;
+        }
+        else if (merge_next) {
+            next->offset = offset;
+            next->size += size;
+        }
+        else {
+            _free.insert(next, { offset, size });
+        }
+    }
+
+    // MeshArena
+    MeshArena::MeshArena(
+        const std::vector<meshes::VertexElement>&   format,
+        meshes::VertexLayoutType                    layout_type,
+        const std::vector<const Program*>&          programs,
+        uint32_t                                    vertex_capacity,
+        uint32_t                                    index_capacity,
+        GLenum                                      index_type
+    )
+        : _format{ format }
+        , _layout{ meshes::make_vertex_layout(format, layout_type) }
+        , _programs{ programs }
+        , _floats_per_vertex{ meshes::floats_per_vertex(format) }
+        , _index_type{ index_type }
+        , _vertex_alloc{ vertex_capacity }
+        , _index_alloc{ index_capacity }
+    {
+        glCreateVertexArrays(1, &_vao_id);
+        glBindVertexArray(_vao_id);
+
+        glCreateBuffers(1, &_vbo_id);
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo_id);
+        glBufferData(GL_ARRAY_BUFFER, _layout.vertex_byte_size() * vertex_capacity, nullptr, GL_STATIC_DRAW);
+
+        glCreateBuffers(1, &_ibo_id);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo_id);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, meshes::index_type_size(_index_type) * index_capacity, nullptr, GL_STATIC_DRAW);
+
+        // the byte offsets of the program attributes describe a single mesh, the arena layout replaces them
+        for (const auto* program : programs) {
+            for (const auto& [name, attr] : program->get_attrs()) {
+                const meshes::LayoutElement* element{ _layout.find(name) };
+                if (!element) {
+                    std::cerr << "mesh arena has no element for attribute: " << attr.name << "\nnothing was set\n";
+                    continue;
+                }
+
+                const std::size_t byte_offset{ _layout.stream_byte_offset(element->stream, vertex_capacity) + element->byte_offset };
+                glEnableVertexAttribArray(attr.location);
+                glVertexAttribPointer(attr.location, element->attrib_count, element->gl_type, element->normalized, _layout.stream_strides[element->stream], reinterpret_cast<void*>(byte_offset));
+            }
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    MeshArena::~MeshArena() {
+        glDeleteVertexArrays(1, &_vao_id);
+        glDeleteBuffers(1, &_vbo_id);
+        glDeleteBuffers(1, &_ibo_id);
+    }
+
+    const MeshArena::Entry* MeshArena::acquire(meshes::MeshView mesh) {
+        if (_floats_per_vertex == 0 || _format[0].count != 3 || mesh.indices.empty() || mesh.vertices.size() % _floats_per_vertex != 0) {
+            std::cerr << "mesh doesn't match the layout of the mesh arena\n";
+            return nullptr;
+        }
+
+        const uint32_t vertex_count{ static_cast<uint32_t>(mesh.vertices.size() / _floats_per_vertex) };
+        const uint32_t index_count{ static_cast<uint32_t>(mesh.indices.size()) };
+        if (meshes::index_type_size(meshes::select_index_type(vertex_count)) > meshes::index_type_size(_index_type)) {
+            std::cerr << "mesh has too many vertices for the index type of the mesh arena, vertices: " << vertex_count << '\n';
+            return nullptr;
+        }
+        const uint64_t hash{ hash_bytes(mesh.indices.data(), sizeof(uint32_t) * index_count, hash_bytes(mesh.vertices.data(), sizeof(float) * mesh.vertices.size())) };
+
+        // a hash match only counts with the same positions and indices
+        auto [first, last]{ _entries.equal_range(hash) };
+        for (auto it{ first }; it != last; ++it) {
+            Entry& entry{ *it->second };
+            if (entry.vertex_count == vertex_count
+                && std::equal(entry.indices.begin(), entry.indices.end(), mesh.indices.begin(), mesh.indices.end())
+                && std::equal(entry.positions.begin(), entry.positions.end(), mesh.vertices.begin()))
+            {
+                ++entry.references;
+                return &entry;
+            }
+        }
+
+        const uint32_t base_vertex{ _vertex_alloc.allocate(vertex_count) };
+        if (base_vertex == RangeAllocator::invalid_offset) {
+            std::cerr << "mesh arena is out of vertex space, vertices requested: " << vertex_count << '\n';
+            return nullptr;
+        }
+        const uint32_t first_index{ _index_alloc.allocate(index_count) };
+        if (first_index == RangeAllocator::invalid_offset) {
+            _vertex_alloc.free(base_vertex, vertex_count);
+            std::cerr << "mesh arena is out of index space, indices requested: " << index_count << '\n';
+            return nullptr;
+        }
+
+        meshes::Dequantize dequantize;
+        const std::vector<uint8_t> converted{ meshes::convert_vertices(mesh.vertices, _format, _layout, &dequantize) };
+        for (std::size_t stream = 0; stream < _layout.stream_strides.size(); ++stream) {
+            const std::size_t stride{ _layout.stream_strides[stream] };
+            glNamedBufferSubData(
+                _vbo_id,
+                _layout.stream_byte_offset(stream, _vertex_alloc.capacity()) + stride * base_vertex,
+                stride * vertex_count,
+                converted.data() + _layout.stream_byte_offset(stream, vertex_count)
+            );
+        }
+        const std::vector<uint8_t> gpu_indices{ meshes::encode_indices(mesh.indices, _index_type) };
+        glNamedBufferSubData(_ibo_id, meshes::index_type_size(_index_type) * first_index, gpu_indices.size(), gpu_indices.data());
+
+        auto entry{ std::make_unique<Entry>(Entry{
+            .hash = hash,
+            .base_vertex = base_vertex,
+            .vertex_count = vertex_count,
+            .first_index = first_index,
+            .index_count = index_count,
+            .references = 1,
+            .dequantize = dequantize,
+            .positions = std::vector<float>(mesh.vertices.begin(), mesh.vertices.begin() + vertex_count * 3),
+            .indices = std::vector<uint32_t>(mesh.indices.begin(), mesh.indices.end()),
+            .meshlets = {},
+        }) };
+        entry->meshlets = meshes::build_meshlets(entry->positions.data(), vertex_count, entry->indices.data(), index_count);
+
+        return _entries.emplace(hash, std::move(entry))->second.get();
+    }
+
+    void MeshArena::release(const Entry* entry) {
+        if (!entry) {
+            return;
+        }
+
+        auto [first, last]{ _entries.equal_range(entry->hash) };
+        for (auto it{ first }; it != last; ++it) {
+            if (it->second.get() != entry) {
+                continue;
+            }
+            if (--it->second->references == 0) {
+                _vertex_alloc.free(entry->base_vertex, entry->vertex_count);
+                _index_alloc.free(entry->first_index, entry->index_count);
+                _entries.erase(it);
+            }
+            return;
+        }
+    }
+
+    MeshArena::Stats MeshArena::get_stats() const {
+        Stats stats{
+            .unique_meshes = static_cast<uint32_t>(_entries.size()),
+            .vertices_used = _vertex_alloc.used(),
+            .indices_used = _index_alloc.used(),
+        };
+        for (const auto& [hash, entry] : _entries) {
+            stats.references += entry->references;
+        }
+        return stats;
+    }
+}
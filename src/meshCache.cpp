@@ -0,0 +1,382 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include "meshCache.hpp"
+#include "mappedFile.hpp"
+#include "meshCodec.hpp"
+#include "meshWeld.hpp"
+#include "meshlets.hpp"
+
+namespace my_gl {
+    namespace {
+        constexpr char mesh_cache_magic[4]{ 'M', 'G', 'L', 'C' };
+        // bump whenever a record or the section order changes
+        constexpr uint32_t mesh_cache_version{ 2 };
+        constexpr std::size_t section_alignment{ 16 };
+        constexpr std::size_t max_attribute_name{ 32 };
+        // vertices, positions and cpu indices hold meshCodec streams, the gpu indices are narrowed on load
+        constexpr uint32_t compressed_flag{ 1 };
+
+        struct Section {
+            uint64_t    offset;
+            uint64_t    size;
+        };
+
+        struct Header {
+            char        magic[4];
+            uint32_t    version;
+            uint64_t    source_hash;
+            uint64_t    vertex_count;
+            uint64_t    index_count;
+            // of the gpu vertices once decoded
+            uint64_t    vertex_bytes;
+            uint32_t    index_type;
+            uint32_t    attribute_count;
+            uint32_t    flags;
+            uint32_t    padding;
+            float       bounds_min[3];
+            float       bounds_max[3];
+            float       dequantize_offset[3];
+            float       dequantize_scale[3];
+            Section     attributes;
+            Section     vertices;
+            Section     indices;
+            Section     positions;
+            Section     cpu_indices;
+            Section     lods;
+            Section     meshlets;
+        };
+
+        struct AttributeRecord {
+            char        name[max_attribute_name];
+            uint32_t    gl_type;
+            uint32_t    byte_offset;
+            uint16_t    count;
+            uint16_t    byte_stride;
+            uint8_t     normalized;
+            uint8_t     padding[3];
+        };
+
+        struct LodRecord {
+            uint64_t    buffer_byte_offset;
+            uint64_t    index_count;
+            float       error;
+            uint32_t    padding;
+        };
+
+        static_assert(std::is_trivially_copyable_v<meshes::Meshlet> && sizeof(meshes::Meshlet) == 13 * sizeof(float), "meshlets are stored as they are in memory");
+
+        std::size_t align_up(std::size_t value) {
+            return (value + section_alignment - 1) & ~(section_alignment - 1);
+        }
+
+        class CacheWriter {
+        public:
+            explicit CacheWriter(std::ofstream& out)
+                : _out{ out }
+            {}
+
+            Section write(const void* data, std::size_t size) {
+                static constexpr char zeros[section_alignment]{};
+                _out.write(zeros, static_cast<std::streamsize>(align_up(_offset) - _offset));
+                _offset = align_up(_offset);
+
+                const Section section{ _offset, size };
+                _out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                _offset += size;
+                return section;
+            }
+
+        private:
+            std::ofstream&  _out;
+            std::size_t     _offset{ sizeof(Header) };
+        };
+
+        bool is_valid(const Section& section, std::size_t file_size) {
+            return section.offset % section_alignment == 0 && section.offset <= file_size && section.size <= file_size - section.offset;
+        }
+    }
+
+    bool write_mesh_cache(
+        const char*                                 path,
+        uint64_t                                    source_hash,
+        const meshes::Mesh&                         mesh,
+        const std::vector<meshes::VertexElement>&   format,
+        const meshes::VertexLayout&                 layout,
+        const std::vector<meshes::LodLevel>&        lods,
+        bool                                        compress
+    ) {
+        const std::size_t floats_per_vertex{ meshes::floats_per_vertex(format) };
+        if (floats_per_vertex == 0 || mesh.vertices.size() % floats_per_vertex != 0) {
+            std::cerr << "mesh doesn't match its format, no cache written: " << path << '\n';
+            return false;
+        }
+        const std::size_t vertex_count{ mesh.vertices.size() / floats_per_vertex };
+
+        Header header{};
+        std::memcpy(header.magic, mesh_cache_magic, sizeof(header.magic));
+        header.version = mesh_cache_version;
+        header.source_hash = source_hash;
+        header.vertex_count = vertex_count;
+        header.index_count = mesh.indices.size();
+        header.flags = compress ? compressed_flag : 0;
+
+        // what the gpu gets, in the exact bytes VertexArray would upload
+        meshes::Dequantize dequantize;
+        const std::vector<uint8_t> gpu_vertices{ meshes::convert_vertices(mesh.vertices, format, layout, &dequantize) };
+        header.vertex_bytes = gpu_vertices.size();
+        std::copy_n(dequantize.offset, 3, header.dequantize_offset);
+        std::copy_n(dequantize.scale, 3, header.dequantize_scale);
+
+        const std::size_t referenced{ mesh.indices.empty() ? 0 : static_cast<std::size_t>(*std::max_element(mesh.indices.begin(), mesh.indices.end())) + 1 };
+        if (referenced > vertex_count) {
+            std::cerr << "mesh indices out of range, no cache written: " << path << '\n';
+            return false;
+        }
+        header.index_type = meshes::select_index_type(referenced);
+        // compressed caches narrow the decoded cpu indices on load instead
+        const std::vector<uint8_t> gpu_indices{ compress ? std::vector<uint8_t>{} : meshes::encode_indices(mesh.indices, header.index_type) };
+
+        std::vector<const char*> names;
+        for (const meshes::VertexElement& element : format) {
+            names.push_back(element.name);
+        }
+        std::vector<AttributeRecord> attribute_records;
+        for (const Attribute& attribute : make_attributes(layout, vertex_count, names)) {
+            AttributeRecord record{};
+            std::strncpy(record.name, attribute.name, max_attribute_name - 1);
+            record.gl_type = attribute.gl_type;
+            record.byte_offset = attribute.byte_offset;
+            record.count = attribute.count;
+            record.byte_stride = attribute.byte_stride;
+            record.normalized = attribute.normalized;
+            attribute_records.push_back(record);
+        }
+        header.attribute_count = static_cast<uint32_t>(attribute_records.size());
+
+        // positions lead the planar vertices
+        const float* positions{ mesh.vertices.data() };
+        math::Aabb bounds;
+        for (std::size_t v = 0; v < vertex_count; ++v) {
+            bounds.expand(positions + v * 3);
+        }
+        std::copy_n(bounds.min, 3, header.bounds_min);
+        std::copy_n(bounds.max, 3, header.bounds_max);
+
+        const std::vector<meshes::Meshlet> meshlets{ meshes::build_meshlets(positions, vertex_count, mesh.indices.data(), mesh.indices.size()) };
+
+        std::vector<uint8_t> encoded_vertices;
+        std::vector<uint8_t> encoded_positions;
+        std::vector<uint8_t> encoded_indices;
+        if (compress) {
+            encoded_vertices = meshes::encode_vertex_buffer(gpu_vertices, layout.stream_strides, vertex_count);
+            encoded_positions = meshes::encode_vertex_stream(reinterpret_cast<const uint8_t*>(positions), vertex_count, 3 * sizeof(float));
+            encoded_indices = meshes::encode_index_stream(mesh.indices);
+        }
+
+        std::vector<LodRecord> lod_records;
+        for (const meshes::LodLevel& lod : lods) {
+            lod_records.push_back({ lod.buffer_byte_offset, lod.index_count, lod.error, 0 });
+        }
+
+        // written next to the target and renamed over it, a crash never leaves a half written cache behind
+        const std::string temp_path{ std::string{ path } + ".tmp" };
+        {
+            std::ofstream out{ temp_path, std::ios::binary | std::ios::trunc };
+            if (!out) {
+                std::cerr << "can't write mesh cache: " << temp_path << '\n';
+                return false;
+            }
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            CacheWriter writer{ out };
+            header.attributes = writer.write(attribute_records.data(), attribute_records.size() * sizeof(AttributeRecord));
+            if (compress) {
+                header.vertices = writer.write(encoded_vertices.data(), encoded_vertices.size());
+                header.indices = writer.write(nullptr, 0);
+                header.positions = writer.write(encoded_positions.data(), encoded_positions.size());
+                header.cpu_indices = writer.write(encoded_indices.data(), encoded_indices.size());
+            }
+            else {
+                header.vertices = writer.write(gpu_vertices.data(), gpu_vertices.size());
+                header.indices = writer.write(gpu_indices.data(), gpu_indices.size());
+                header.positions = writer.write(positions, vertex_count * 3 * sizeof(float));
+                header.cpu_indices = writer.write(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+            }
+            header.lods = writer.write(lod_records.data(), lod_records.size() * sizeof(LodRecord));
+            header.meshlets = writer.write(meshlets.data(), meshlets.size() * sizeof(meshes::Meshlet));
+
+            // section table is known only now
+            out.seekp(0);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            if (!out) {
+                std::cerr << "can't write mesh cache: " << temp_path << '\n';
+                return false;
+            }
+        }
+
+        if (std::rename(temp_path.c_str(), path) != 0) {
+            std::cerr << "can't move mesh cache into place: " << path << '\n';
+            std::remove(temp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    std::unique_ptr<VertexArray> load_mesh_cache(
+        const char*                                 path,
+        uint64_t                                    source_hash,
+        const std::vector<const Program*>&          programs,
+        MeshCacheInfo*                              info
+    ) {
+        const auto start{ std::chrono::steady_clock::now() };
+
+        // a missing cache is the normal first run, not an error
+        std::error_code error;
+        if (!std::filesystem::exists(path, error)) {
+            return nullptr;
+        }
+        const MappedFile file{ path };
+        if (!file.is_open() || file.size() < sizeof(Header)) {
+            return nullptr;
+        }
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, mesh_cache_magic, sizeof(header.magic)) != 0 || header.version != mesh_cache_version || header.source_hash != source_hash) {
+            return nullptr;
+        }
+
+        const std::size_t size{ file.size() };
+        const bool valid_index_type{ header.index_type == GL_UNSIGNED_BYTE || header.index_type == GL_UNSIGNED_SHORT || header.index_type == GL_UNSIGNED_INT };
+        const bool compressed{ (header.flags & compressed_flag) != 0 };
+        // counts size what gets allocated before decoding, packed streams can't expand beyond these ratios
+        const bool valid_sizes{ compressed
+            ? header.indices.size == 0 && header.vertex_bytes <= header.vertices.size * 64
+                && header.vertex_count <= header.positions.size * 8 && header.index_count <= header.cpu_indices.size * 16
+            : header.positions.size == header.vertex_count * 3 * sizeof(float) && header.cpu_indices.size == header.index_count * sizeof(uint32_t)
+                && header.indices.size == header.index_count * meshes::index_type_size(header.index_type) && header.vertices.size == header.vertex_bytes };
+        if (!valid_index_type || !valid_sizes
+            || !is_valid(header.attributes, size) || !is_valid(header.vertices, size) || !is_valid(header.indices, size)
+            || !is_valid(header.positions, size) || !is_valid(header.cpu_indices, size) || !is_valid(header.lods, size) || !is_valid(header.meshlets, size)
+            || header.attributes.size != header.attribute_count * sizeof(AttributeRecord)
+            || header.lods.size % sizeof(LodRecord) != 0 || header.meshlets.size % sizeof(meshes::Meshlet) != 0) {
+            std::cerr << "broken mesh cache: " << path << '\n';
+            return nullptr;
+        }
+
+        const auto* bytes{ reinterpret_cast<const uint8_t*>(file.data()) };
+        const auto* attribute_records{ reinterpret_cast<const AttributeRecord*>(bytes + header.attributes.offset) };
+        std::vector<Attribute> attributes;
+        for (uint32_t a = 0; a < header.attribute_count; ++a) {
+            const AttributeRecord& record{ attribute_records[a] };
+            if (!std::memchr(record.name, '\0', max_attribute_name) || record.byte_offset >= header.vertex_bytes) {
+                std::cerr << "broken mesh cache: " << path << '\n';
+                return nullptr;
+            }
+            // names point into the mapping, they are only looked up while the vertex array is created
+            attributes.push_back({
+                .name = record.name,
+                .gl_type = record.gl_type,
+                .count = record.count,
+                .byte_stride = record.byte_stride,
+                .byte_offset = record.byte_offset,
+                .normalized = record.normalized != 0,
+            });
+        }
+
+        meshes::Mesh cpu_mesh;
+        cpu_mesh.vertices.resize(header.vertex_count * 3);
+        cpu_mesh.indices.resize(header.index_count);
+        std::vector<uint8_t> decoded_vertices;
+        std::vector<uint8_t> decoded_indices;
+        double decode_ms{ 0.0 };
+        if (compressed) {
+            const auto decode_start{ std::chrono::steady_clock::now() };
+            decoded_vertices.resize(header.vertex_bytes);
+            const bool decoded{
+                meshes::decode_vertex_buffer({ bytes + header.vertices.offset, header.vertices.size }, header.vertex_count, decoded_vertices.data(), decoded_vertices.size())
+                && meshes::decode_vertex_stream({ bytes + header.positions.offset, header.positions.size }, header.vertex_count, 3 * sizeof(float), reinterpret_cast<uint8_t*>(cpu_mesh.vertices.data()))
+                && meshes::decode_index_stream({ bytes + header.cpu_indices.offset, header.cpu_indices.size }, header.index_count, cpu_mesh.indices.data())
+            };
+            if (!decoded) {
+                std::cerr << "broken mesh cache: " << path << '\n';
+                return nullptr;
+            }
+            decode_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - decode_start).count();
+        }
+        else {
+            std::memcpy(cpu_mesh.vertices.data(), bytes + header.positions.offset, header.positions.size);
+            std::memcpy(cpu_mesh.indices.data(), bytes + header.cpu_indices.offset, header.cpu_indices.size);
+        }
+        // culling indexes positions with these, one pass is cheap next to trusting a corrupt file
+        if (std::any_of(cpu_mesh.indices.begin(), cpu_mesh.indices.end(), [&header](uint32_t index) { return index >= header.vertex_count; })) {
+            std::cerr << "broken mesh cache: " << path << '\n';
+            return nullptr;
+        }
+
+        std::vector<meshes::Meshlet> meshlets(header.meshlets.size / sizeof(meshes::Meshlet));
+        std::memcpy(meshlets.data(), bytes + header.meshlets.offset, header.meshlets.size);
+        // draws and culling walk these ranges of the indices, which already stay inside the vertices
+        std::vector<meshes::LodLevel> lods;
+        for (std::size_t l = 0; l < header.lods.size / sizeof(LodRecord); ++l) {
+            LodRecord record;
+            std::memcpy(&record, bytes + header.lods.offset + l * sizeof(LodRecord), sizeof(record));
+            lods.push_back({ record.buffer_byte_offset, record.index_count, record.error });
+        }
+        const auto in_indices{ [&header](uint64_t first, uint64_t count) { return first <= header.index_count && count <= header.index_count - first; } };
+        const bool valid_meshlets{ std::all_of(meshlets.begin(), meshlets.end(), [&in_indices](const meshes::Meshlet& meshlet) {
+            return in_indices(meshlet.index_offset, meshlet.index_count);
+        }) };
+        // lod offsets count 32 bit cpu indices like every other index byte offset
+        const bool valid_lods{ std::all_of(lods.begin(), lods.end(), [&in_indices](const meshes::LodLevel& lod) {
+            return lod.buffer_byte_offset % sizeof(uint32_t) == 0 && in_indices(lod.buffer_byte_offset / sizeof(uint32_t), lod.index_count);
+        }) };
+        if (!valid_meshlets || !valid_lods) {
+            std::cerr << "broken mesh cache: " << path << '\n';
+            return nullptr;
+        }
+
+        if (compressed) {
+            decoded_indices = meshes::encode_indices(cpu_mesh.indices, header.index_type);
+        }
+        const std::span<const uint8_t> gpu_vertices{ compressed ? std::span<const uint8_t>{ decoded_vertices } : std::span<const uint8_t>{ bytes + header.vertices.offset, header.vertices.size } };
+        const std::span<const uint8_t> gpu_indices{ compressed ? std::span<const uint8_t>{ decoded_indices } : std::span<const uint8_t>{ bytes + header.indices.offset, header.indices.size } };
+
+        meshes::Dequantize dequantize;
+        std::copy_n(header.dequantize_offset, 3, dequantize.offset);
+        std::copy_n(header.dequantize_scale, 3, dequantize.scale);
+
+        auto vao{ std::make_unique<VertexArray>(
+            std::vector<std::span<const uint8_t>>{ gpu_vertices },
+            attributes,
+            gpu_indices,
+            static_cast<GLenum>(header.index_type),
+            std::move(cpu_mesh),
+            programs,
+            std::move(meshlets),
+            dequantize
+        ) };
+
+        if (info) {
+            info->source_hash = header.source_hash;
+            info->file_bytes = size;
+            info->vertex_count = header.vertex_count;
+            info->index_count = header.index_count;
+            info->compressed = compressed;
+            std::copy_n(header.bounds_min, 3, info->bounds.min);
+            std::copy_n(header.bounds_max, 3, info->bounds.max);
+            info->lods = std::move(lods);
+            info->decode_ms = decode_ms;
+            info->load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        return vao;
+    }
+}
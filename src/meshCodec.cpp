@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include "meshCodec.hpp"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            constexpr uint8_t       vertex_stream_tag{ 0xA1 };
+            constexpr uint8_t       index_stream_tag{ 0xB1 };
+            constexpr std::size_t   group_size{ 16 };
+            constexpr std::size_t   max_stride{ 256 };
+            constexpr std::size_t   max_block_vertices{ 256 };
+            // whole groups and whole triangles
+            constexpr std::size_t   index_block{ 240 };
+
+            enum GroupMode : uint8_t {
+                GROUP_ZERO,
+                GROUP_BITS2,
+                GROUP_BITS4,
+                GROUP_RAW,
+            };
+
+            constexpr std::size_t group_data_size[4]{ 0, 4, 8, 16 };
+
+            // the columns of a block stay within 8 KB so they are still in L1 when they get interleaved
+            std::size_t block_vertices(std::size_t stride) {
+                return std::clamp<std::size_t>((8192 / stride) & ~(group_size - 1), group_size, max_block_vertices);
+            }
+
+            uint8_t zigzag8(uint8_t delta) {
+                return static_cast<uint8_t>((delta << 1) ^ (static_cast<int8_t>(delta) >> 7));
+            }
+
+            uint32_t zigzag32(uint32_t delta) {
+                return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+            }
+
+            uint32_t unzigzag32(uint32_t value) {
+                return (value >> 1) ^ (0u - (value & 1));
+            }
+
+            void encode_column(const uint8_t* column, std::size_t groups, std::vector<uint8_t>& out) {
+                const std::size_t header_offset{ out.size() };
+                out.resize(out.size() + (groups + 3) / 4, 0);
+
+                for (std::size_t g = 0; g < groups; ++g) {
+                    const uint8_t* values{ column + g * group_size };
+                    const uint8_t max{ *std::max_element(values, values + group_size) };
+                    const GroupMode mode{ max == 0 ? GROUP_ZERO : max < 4 ? GROUP_BITS2 : max < 16 ? GROUP_BITS4 : GROUP_RAW };
+                    out[header_offset + g / 4] |= static_cast<uint8_t>(mode << (g % 4 * 2));
+
+                    // value i sits at bit (i * bits) % 8 of byte (i * bits) / 8
+                    if (mode == GROUP_BITS2) {
+                        for (std::size_t i = 0; i < group_size; i += 4) {
+                            out.push_back(static_cast<uint8_t>(values[i] | values[i + 1] << 2 | values[i + 2] << 4 | values[i + 3] << 6));
+                        }
+                    }
+                    else if (mode == GROUP_BITS4) {
+                        for (std::size_t i = 0; i < group_size; i += 2) {
+                            out.push_back(static_cast<uint8_t>(values[i] | values[i + 1] << 4));
+                        }
+                    }
+                    else if (mode == GROUP_RAW) {
+                        out.insert(out.end(), values, values + group_size);
+                    }
+                }
+            }
+
+            // 'column' gets the bytes of 'groups * 16' vertices, 'carry' is the byte of the vertex before them
+            // without 'accumulate' the stored bytes come out as they are, for columns that were never delta coded
+            // nullptr if the column runs past 'end'
+            const uint8_t* decode_column(const uint8_t* data, const uint8_t* end, std::size_t groups, uint8_t carry, bool accumulate, uint8_t* column) {
+                const uint8_t* header{ data };
+                const std::size_t header_size{ (groups + 3) / 4 };
+                if (static_cast<std::size_t>(end - data) < header_size) {
+                    return nullptr;
+                }
+                data += header_size;
+
+                // bounds are checked once per column, groups then load without looking
+                std::size_t data_size{ 0 };
+                for (std::size_t g = 0; g < groups; ++g) {
+                    data_size += group_data_size[(header[g / 4] >> (g % 4 * 2)) & 3];
+                }
+                if (static_cast<std::size_t>(end - data) < data_size) {
+                    return nullptr;
+                }
+
+                for (std::size_t g = 0; g < groups; ++g) {
+                    const GroupMode mode{ static_cast<GroupMode>((header[g / 4] >> (g % 4 * 2)) & 3) };
+                    uint8_t* values{ column + g * group_size };
+#if defined(__SSE2__)
+                    if (mode == GROUP_ZERO) {
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm_set1_epi8(static_cast<char>(carry)));
+                        continue;
+                    }
+
+                    const __m128i low2{ _mm_set1_epi8(0x03) };
+                    const __m128i low4{ _mm_set1_epi8(0x0F) };
+                    __m128i packed;
+                    if (mode == GROUP_RAW) {
+                        packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+                    }
+                    else {
+                        // split bytes into nibbles, for 2 bit groups the nibbles once more
+                        int32_t word32;
+                        std::memcpy(&word32, data, sizeof(word32));
+                        const __m128i bytes{ mode == GROUP_BITS4 ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)) : _mm_cvtsi32_si128(word32) };
+                        packed = _mm_unpacklo_epi8(_mm_and_si128(bytes, low4), _mm_and_si128(_mm_srli_epi16(bytes, 4), low4));
+                        if (mode == GROUP_BITS2) {
+                            packed = _mm_unpacklo_epi8(_mm_and_si128(packed, low2), _mm_and_si128(_mm_srli_epi16(packed, 2), low2));
+                        }
+                    }
+                    data += group_data_size[mode];
+                    if (!accumulate) {
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(values), packed);
+                        continue;
+                    }
+
+                    // undo the zigzag, then a prefix sum over the 16 deltas in four shifted adds
+                    __m128i deltas{ _mm_xor_si128(
+                        _mm_and_si128(_mm_srli_epi16(packed, 1), _mm_set1_epi8(0x7F)),
+                        _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(packed, _mm_set1_epi8(1)))
+                    ) };
+                    deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 1));
+                    deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 2));
+                    deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 4));
+                    deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 8));
+                    const __m128i result{ _mm_add_epi8(deltas, _mm_set1_epi8(static_cast<char>(carry))) };
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(values), result);
+                    carry = static_cast<uint8_t>(_mm_extract_epi16(result, 7) >> 8);
+#else
+                    uint8_t packed[group_size]{};
+                    if (mode == GROUP_BITS2) {
+                        for (std::size_t i = 0; i < group_size; ++i) {
+                            packed[i] = (data[i / 4] >> (i % 4 * 2)) & 3;
+                        }
+                    }
+                    else if (mode == GROUP_BITS4) {
+                        for (std::size_t i = 0; i < group_size; ++i) {
+                            packed[i] = (data[i / 2] >> (i % 2 * 4)) & 15;
+                        }
+                    }
+                    else if (mode == GROUP_RAW) {
+                        std::memcpy(packed, data, group_size);
+                    }
+                    data += group_data_size[mode];
+                    if (!accumulate) {
+                        std::memcpy(values, packed, group_size);
+                        continue;
+                    }
+
+                    for (std::size_t i = 0; i < group_size; ++i) {
+                        carry = static_cast<uint8_t>(carry + ((packed[i] >> 1) ^ (0u - (packed[i] & 1))));
+                        values[i] = carry;
+                    }
+#endif
+                }
+                return data;
+            }
+
+            // columns[k * column_stride + v] is byte k of vertex v, written to out[v * stride + k]
+            void interleave_columns(const uint8_t* columns, std::size_t column_stride, std::size_t vertex_count, std::size_t stride, uint8_t* out) {
+                std::size_t k{ 0 };
+#if defined(__SSE2__)
+                // four columns at a time become one 32 bit word per vertex
+                for (; k + 4 <= stride; k += 4) {
+                    const uint8_t* column{ columns + k * column_stride };
+                    for (std::size_t first = 0; first < vertex_count; first += group_size) {
+                        const __m128i c0{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + first)) };
+                        const __m128i c1{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + column_stride + first)) };
+                        const __m128i c2{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + column_stride * 2 + first)) };
+                        const __m128i c3{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + column_stride * 3 + first)) };
+                        const __m128i c01_low{ _mm_unpacklo_epi8(c0, c1) };
+                        const __m128i c01_high{ _mm_unpackhi_epi8(c0, c1) };
+                        const __m128i c23_low{ _mm_unpacklo_epi8(c2, c3) };
+                        const __m128i c23_high{ _mm_unpackhi_epi8(c2, c3) };
+
+                        alignas(16) uint32_t words[group_size];
+                        _mm_store_si128(reinterpret_cast<__m128i*>(words), _mm_unpacklo_epi16(c01_low, c23_low));
+                        _mm_store_si128(reinterpret_cast<__m128i*>(words + 4), _mm_unpackhi_epi16(c01_low, c23_low));
+                        _mm_store_si128(reinterpret_cast<__m128i*>(words + 8), _mm_unpacklo_epi16(c01_high, c23_high));
+                        _mm_store_si128(reinterpret_cast<__m128i*>(words + 12), _mm_unpackhi_epi16(c01_high, c23_high));
+
+                        const std::size_t count{ std::min(group_size, vertex_count - first) };
+                        uint8_t* dst{ out + first * stride + k };
+                        for (std::size_t v = 0; v < count; ++v, dst += stride) {
+                            std::memcpy(dst, words + v, sizeof(uint32_t));
+                        }
+                    }
+                }
+#endif
+                for (; k < stride; ++k) {
+                    const uint8_t* column{ columns + k * column_stride };
+                    for (std::size_t v = 0; v < vertex_count; ++v) {
+                        out[v * stride + k] = column[v];
+                    }
+                }
+            }
+
+            void append_u32(std::vector<uint8_t>& out, uint32_t value) {
+                const std::size_t offset{ out.size() };
+                out.resize(offset + sizeof(value));
+                std::memcpy(out.data() + offset, &value, sizeof(value));
+            }
+        }
+
+        std::vector<uint8_t> encode_vertex_stream(const uint8_t* vertices, std::size_t vertex_count, std::size_t stride) {
+            if (stride == 0 || stride > max_stride) {
+                return {};
+            }
+            std::vector<uint8_t> out{ vertex_stream_tag };
+
+            const std::size_t block{ block_vertices(stride) };
+            uint8_t previous[max_stride]{};
+            uint8_t column[max_block_vertices];
+
+            for (std::size_t first = 0; first < vertex_count; first += block) {
+                const std::size_t count{ std::min(block, vertex_count - first) };
+                const std::size_t groups{ (count + group_size - 1) / group_size };
+
+                for (std::size_t k = 0; k < stride; ++k) {
+                    uint8_t last{ previous[k] };
+                    // the padding past the last vertex repeats it, zero deltas cost nothing
+                    for (std::size_t v = 0; v < groups * group_size; ++v) {
+                        const uint8_t byte{ v < count ? vertices[(first + v) * stride + k] : last };
+                        column[v] = zigzag8(static_cast<uint8_t>(byte - last));
+                        last = byte;
+                    }
+                    previous[k] = last;
+                    encode_column(column, groups, out);
+                }
+            }
+            return out;
+        }
+
+        bool decode_vertex_stream(std::span<const uint8_t> encoded, std::size_t vertex_count, std::size_t stride, uint8_t* out) {
+            if (stride == 0 || stride > max_stride || encoded.empty() || encoded[0] != vertex_stream_tag) {
+                return false;
+            }
+
+            const std::size_t block{ block_vertices(stride) };
+            uint8_t previous[max_stride]{};
+            std::vector<uint8_t> columns(stride * block);
+
+            const uint8_t* data{ encoded.data() + 1 };
+            const uint8_t* end{ encoded.data() + encoded.size() };
+            for (std::size_t first = 0; first < vertex_count; first += block) {
+                const std::size_t count{ std::min(block, vertex_count - first) };
+                const std::size_t groups{ (count + group_size - 1) / group_size };
+
+                for (std::size_t k = 0; k < stride; ++k) {
+                    uint8_t* column{ columns.data() + k * block };
+                    data = decode_column(data, end, groups, previous[k], true, column);
+                    if (!data) {
+                        return false;
+                    }
+                    previous[k] = column[count - 1];
+                }
+                interleave_columns(columns.data(), block, count, stride, out + first * stride);
+            }
+            return data == end;
+        }
+
+        std::vector<uint8_t> encode_index_stream(std::span<const uint32_t> indices) {
+            // the 32 bit zigzagged deltas go through the vertex column packing, minus its own delta step
+            std::vector<uint8_t> out{ index_stream_tag };
+            out.reserve(indices.size() + 1);
+
+            const std::size_t block{ index_block };
+            uint8_t columns[sizeof(uint32_t)][index_block];
+            uint32_t first{ 0 };
+            for (std::size_t start = 0; start < indices.size(); start += block) {
+                const std::size_t count{ std::min(block, indices.size() - start) };
+                const std::size_t groups{ (count + group_size - 1) / group_size };
+
+                for (std::size_t i = 0; i < groups * group_size; ++i) {
+                    uint32_t value{ 0 };
+                    if (i < count) {
+                        value = zigzag32(indices[start + i] - first);
+                        if ((start + i) % 3 == 0) {
+                            first = indices[start + i];
+                        }
+                    }
+                    for (std::size_t k = 0; k < sizeof(uint32_t); ++k) {
+                        columns[k][i] = static_cast<uint8_t>(value >> (k * 8));
+                    }
+                }
+                for (std::size_t k = 0; k < sizeof(uint32_t); ++k) {
+                    encode_column(columns[k], groups, out);
+                }
+            }
+            return out;
+        }
+
+        bool decode_index_stream(std::span<const uint8_t> encoded, std::size_t index_count, uint32_t* out) {
+            if (encoded.empty() || encoded[0] != index_stream_tag) {
+                return false;
+            }
+
+            const std::size_t block{ index_block };
+            uint8_t columns[sizeof(uint32_t) * index_block];
+            const uint8_t* data{ encoded.data() + 1 };
+            const uint8_t* end{ encoded.data() + encoded.size() };
+            uint32_t first{ 0 };
+            for (std::size_t start = 0; start < index_count; start += block) {
+                const std::size_t count{ std::min(block, index_count - start) };
+                const std::size_t groups{ (count + group_size - 1) / group_size };
+
+                for (std::size_t k = 0; k < sizeof(uint32_t); ++k) {
+                    data = decode_column(data, end, groups, 0, false, columns + k * block);
+                    if (!data) {
+                        return false;
+                    }
+                }
+                uint32_t* indices{ out + start };
+                interleave_columns(columns, block, count, sizeof(uint32_t), reinterpret_cast<uint8_t*>(indices));
+
+                // blocks are a multiple of 3 long, triangles never straddle two
+                std::size_t i{ 0 };
+                for (; i + 3 <= count; i += 3) {
+                    first += unzigzag32(indices[i]);
+                    indices[i] = first;
+                    indices[i + 1] = first + unzigzag32(indices[i + 1]);
+                    indices[i + 2] = first + unzigzag32(indices[i + 2]);
+                }
+                for (; i < count; ++i) {
+                    indices[i] = first + unzigzag32(indices[i]);
+                    if (i % 3 == 0) {
+                        first = indices[i];
+                    }
+                }
+            }
+            return data == end;
+        }
+
+        std::vector<uint8_t> encode_vertex_buffer(std::span<const uint8_t> converted, std::span<const uint16_t> stream_strides, std::size_t vertex_count) {
+            // stream count, then stride and encoded size per stream, then the streams
+            std::vector<uint8_t> out;
+            append_u32(out, static_cast<uint32_t>(stream_strides.size()));
+            const std::size_t table_offset{ out.size() };
+            out.resize(out.size() + stream_strides.size() * 2 * sizeof(uint32_t));
+
+            std::size_t offset{ 0 };
+            for (std::size_t s = 0; s < stream_strides.size(); ++s) {
+                const std::size_t stride{ stream_strides[s] };
+                if (offset + stride * vertex_count > converted.size()) {
+                    return {};
+                }
+                const std::vector<uint8_t> stream{ encode_vertex_stream(converted.data() + offset, vertex_count, stride) };
+                if (stream.empty()) {
+                    return {};
+                }
+                const uint32_t entry[2]{ static_cast<uint32_t>(stride), static_cast<uint32_t>(stream.size()) };
+                std::memcpy(out.data() + table_offset + s * sizeof(entry), entry, sizeof(entry));
+                out.insert(out.end(), stream.begin(), stream.end());
+                offset += stride * vertex_count;
+            }
+            return out;
+        }
+
+        bool decode_vertex_buffer(std::span<const uint8_t> encoded, std::size_t vertex_count, uint8_t* out, std::size_t out_size) {
+            uint32_t stream_count;
+            if (encoded.size() < sizeof(stream_count)) {
+                return false;
+            }
+            std::memcpy(&stream_count, encoded.data(), sizeof(stream_count));
+            if (stream_count > (encoded.size() - sizeof(stream_count)) / (2 * sizeof(uint32_t))) {
+                return false;
+            }
+
+            const uint8_t* table{ encoded.data() + sizeof(stream_count) };
+            std::size_t data_offset{ sizeof(stream_count) + stream_count * 2 * sizeof(uint32_t) };
+            std::size_t out_offset{ 0 };
+            for (uint32_t s = 0; s < stream_count; ++s) {
+                uint32_t entry[2];
+                std::memcpy(entry, table + s * sizeof(entry), sizeof(entry));
+                const std::size_t stride{ entry[0] };
+                const std::size_t stream_size{ entry[1] };
+                if (stride == 0 || vertex_count > (out_size - out_offset) / stride || stream_size > encoded.size() - data_offset) {
+                    return false;
+                }
+                if (!decode_vertex_stream(encoded.subspan(data_offset, stream_size), vertex_count, stride, out + out_offset)) {
+                    return false;
+                }
+                data_offset += stream_size;
+                out_offset += stride * vertex_count;
+            }
+            return data_offset == encoded.size() && out_offset == out_size;
+        }
+
+        MeshCodecStats measure_mesh_codec(const Mesh& mesh, const std::vector<VertexElement>& format, const VertexLayout& layout, int repeats) {
+            MeshCodecStats stats;
+            const std::size_t floats{ floats_per_vertex(format) };
+            if (floats == 0) {
+                return stats;
+            }
+            const std::size_t vertex_count{ mesh.vertices.size() / floats };
+
+            const std::vector<uint8_t> converted{ convert_vertices(mesh.vertices, format, layout) };
+            const std::vector<uint8_t> vertices{ encode_vertex_buffer(converted, layout.stream_strides, vertex_count) };
+            const std::vector<uint8_t> indices{ encode_index_stream(mesh.indices) };
+            stats.raw_bytes = converted.size() + mesh.indices.size() * sizeof(uint32_t);
+            stats.encoded_bytes = vertices.size() + indices.size();
+            stats.ratio = stats.encoded_bytes > 0 ? static_cast<double>(stats.raw_bytes) / static_cast<double>(stats.encoded_bytes) : 0.0;
+
+            // best of the repeats, the first one also pays for faulting the output in
+            std::vector<uint8_t> decoded_vertices(converted.size());
+            std::vector<uint32_t> decoded_indices(mesh.indices.size());
+            double best_ms{ std::numeric_limits<double>::max() };
+            for (int r = 0; r < std::max(repeats, 1); ++r) {
+                const auto start{ std::chrono::steady_clock::now() };
+                decode_vertex_buffer(vertices, vertex_count, decoded_vertices.data(), decoded_vertices.size());
+                decode_index_stream(indices, decoded_indices.size(), decoded_indices.data());
+                best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            stats.decode_ms = best_ms;
+            stats.decode_gb_per_s = best_ms > 0.0 ? static_cast<double>(stats.raw_bytes) / (best_ms * 1e6) : 0.0;
+            return stats;
+        }
+    }
+}
@@ -0,0 +1,396 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <unordered_map>
+#include "meshLod.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            // symmetric 4x4 matrix, only the upper triangle is stored
+            struct Quadric {
+                double  a00{ 0.0 }, a01{ 0.0 }, a02{ 0.0 }, a03{ 0.0 };
+                double  a11{ 0.0 }, a12{ 0.0 }, a13{ 0.0 };
+                double  a22{ 0.0 }, a23{ 0.0 };
+                double  a33{ 0.0 };
+                double  weight{ 0.0 };
+
+                // plane a*x + b*y + c*z + d = 0 with a unit normal
+                void add_plane(double a, double b, double c, double d, double w) {
+                    a00 += w * a * a; a01 += w * a * b; a02 += w * a * c; a03 += w * a * d;
+                    a11 += w * b * b; a12 += w * b * c; a13 += w * b * d;
+                    a22 += w * c * c; a23 += w * c * d;
+                    a33 += w * d * d;
+                    weight += w;
+                }
+
+                void add(const Quadric& rhs) {
+                    a00 += rhs.a00; a01 += rhs.a01; a02 += rhs.a02; a03 += rhs.a03;
+                    a11 += rhs.a11; a12 += rhs.a12; a13 += rhs.a13;
+                    a22 += rhs.a22; a23 += rhs.a23;
+                    a33 += rhs.a33;
+                    weight += rhs.weight;
+                }
+
+                // area weighted mean of the squared distances to the accumulated planes
+                double error(const float* p) const {
+                    const double x{ p[0] };
+                    const double y{ p[1] };
+                    const double z{ p[2] };
+                    const double e{
+                        a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                        + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                        + a22 * z * z + 2.0 * a23 * z
+                        + a33
+                    };
+                    return weight > 0.0 ? std::abs(e) / weight : 0.0;
+                }
+            };
+
+            struct Collapse {
+                uint32_t    from;
+                uint32_t    to;
+                float       geometric_error;
+                float       cost;
+            };
+
+            class Simplifier {
+            public:
+                Simplifier(const std::vector<float>& vertices, std::size_t vertex_count, const LodOptions& options)
+                    : _vertices{ vertices }
+                    , _vertex_count{ vertex_count }
+                    , _options{ options }
+                {}
+
+                void init(const std::vector<uint32_t>& indices);
+                // collapses edges until 'indices' is at most target_count long or no collapse stays under max_error
+                // returns the largest deviation introduced so far
+                float simplify(std::vector<uint32_t>& indices, std::size_t target_count);
+
+            private:
+                const float* position(uint32_t vertex) const { return &_vertices[static_cast<std::size_t>(vertex) * 3]; }
+                double  attrib_distance_sq(uint32_t lhs, uint32_t rhs) const;
+                bool    flips(uint32_t from, uint32_t to, const std::vector<uint32_t>& indices) const;
+                void    build_adjacency(const std::vector<uint32_t>& indices);
+
+                const std::vector<float>&   _vertices;
+                std::size_t                 _vertex_count;
+                const LodOptions&           _options;
+                // first vertex with the same position, collapses work on welded positions
+                std::vector<uint32_t>       _position_ids;
+                std::vector<uint8_t>        _locked;
+                std::vector<Quadric>        _quadrics;
+                // vertex -> triangles, CSR
+                std::vector<uint32_t>       _adjacency_offsets;
+                std::vector<uint32_t>       _adjacency;
+                double                      _max_error_sq{ 0.0 };
+            };
+
+            void Simplifier::init(const std::vector<uint32_t>& indices) {
+                // weld by exact position
+                std::vector<uint32_t> order(_vertex_count);
+                std::iota(order.begin(), order.end(), 0u);
+                std::sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs) {
+                    return std::lexicographical_compare(position(lhs), position(lhs) + 3, position(rhs), position(rhs) + 3);
+                });
+
+                _position_ids.assign(_vertex_count, 0);
+                _locked.assign(_vertex_count, 0);
+
+                for (std::size_t i = 0; i < order.size(); ) {
+                    std::size_t group_end{ i + 1 };
+                    while (group_end < order.size() && std::equal(position(order[i]), position(order[i]) + 3, position(order[group_end]))) {
+                        ++group_end;
+                    }
+                    for (std::size_t j = i; j < group_end; ++j) {
+                        _position_ids[order[j]] = order[i];
+                    }
+                    // attribute seam, collapsing it would tear the uv/normal discontinuity open
+                    if (group_end - i > 1) {
+                        _locked[order[i]] = 1;
+                    }
+                    i = group_end;
+                }
+
+                // open borders and non-manifold edges keep their silhouette
+                std::unordered_map<uint64_t, uint32_t> edge_uses;
+                for (std::size_t t = 0; t < indices.size(); t += 3) {
+                    for (int k = 0; k < 3; ++k) {
+                        const uint64_t a{ _position_ids[indices[t + k]] };
+                        const uint64_t b{ _position_ids[indices[t + (k + 1) % 3]] };
+                        if (a != b) {
+                            ++edge_uses[std::min(a, b) << 32 | std::max(a, b)];
+                        }
+                    }
+                }
+                for (const auto& [edge, uses] : edge_uses) {
+                    if (uses != 2) {
+                        _locked[edge >> 32] = 1;
+                        _locked[edge & 0xFFFFFFFF] = 1;
+                    }
+                }
+
+                _quadrics.assign(_vertex_count, Quadric{});
+                for (std::size_t t = 0; t < indices.size(); t += 3) {
+                    const float* p0{ position(indices[t]) };
+                    const float* p1{ position(indices[t + 1]) };
+                    const float* p2{ position(indices[t + 2]) };
+
+                    const double e1[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                    const double e2[3]{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                    double n[3]{
+                        e1[1] * e2[2] - e1[2] * e2[1],
+                        e1[2] * e2[0] - e1[0] * e2[2],
+                        e1[0] * e2[1] - e1[1] * e2[0],
+                    };
+                    const double len{ std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) };
+                    if (len == 0.0) {
+                        continue;
+                    }
+                    n[0] /= len;
+                    n[1] /= len;
+                    n[2] /= len;
+                    const double d{ -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]) };
+
+                    for (int k = 0; k < 3; ++k) {
+                        _quadrics[_position_ids[indices[t + k]]].add_plane(n[0], n[1], n[2], d, len * 0.5);
+                    }
+                }
+            }
+
+            double Simplifier::attrib_distance_sq(uint32_t lhs, uint32_t rhs) const {
+                double sum{ 0.0 };
+                std::size_t block_start{ _vertex_count * 3 };
+
+                for (uint16_t count : _options.attrib_counts) {
+                    for (uint16_t c = 0; c < count; ++c) {
+                        const double d{ _vertices[block_start + lhs * count + c] - _vertices[block_start + rhs * count + c] };
+                        sum += d * d;
+                    }
+                    block_start += _vertex_count * count;
+                }
+
+                return sum;
+            }
+
+            void Simplifier::build_adjacency(const std::vector<uint32_t>& indices) {
+                _adjacency_offsets.assign(_vertex_count + 1, 0);
+                for (uint32_t index : indices) {
+                    ++_adjacency_offsets[index + 1];
+                }
+                for (std::size_t v = 0; v < _vertex_count; ++v) {
+                    _adjacency_offsets[v + 1] += _adjacency_offsets[v];
+                }
+
+                _adjacency.resize(indices.size());
+                std::vector<uint32_t> fill{ _adjacency_offsets.begin(), _adjacency_offsets.end() - 1 };
+                for (std::size_t i = 0; i < indices.size(); ++i) {
+                    _adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+                }
+            }
+
+            bool Simplifier::flips(uint32_t from, uint32_t to, const std::vector<uint32_t>& indices) const {
+                for (uint32_t a = _adjacency_offsets[from]; a < _adjacency_offsets[from + 1]; ++a) {
+                    const uint32_t* tri{ &indices[static_cast<std::size_t>(_adjacency[a]) * 3] };
+
+                    bool collapses_away{ false };
+                    for (int k = 0; k < 3; ++k) {
+                        collapses_away |= _position_ids[tri[k]] == _position_ids[to];
+                    }
+                    if (collapses_away) {
+                        continue;
+                    }
+
+                    const float* before[3]{ position(tri[0]), position(tri[1]), position(tri[2]) };
+                    const float* after[3]{ before[0], before[1], before[2] };
+                    for (int k = 0; k < 3; ++k) {
+                        if (tri[k] == from) {
+                            after[k] = position(to);
+                        }
+                    }
+
+                    auto normal{ [](const float* const* p, float* n) {
+                        const float e1[3]{ p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+                        const float e2[3]{ p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+                        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+                        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+                        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+                    } };
+
+                    float n_before[3];
+                    float n_after[3];
+                    normal(before, n_before);
+                    normal(after, n_after);
+
+                    if (n_before[0] * n_after[0] + n_before[1] * n_after[1] + n_before[2] * n_after[2] <= 0.0f) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            float Simplifier::simplify(std::vector<uint32_t>& indices, std::size_t target_count) {
+                const double max_error_sq{ static_cast<double>(_options.max_error) * _options.max_error };
+                std::vector<Collapse> collapses;
+                std::vector<uint32_t> collapse_to(_vertex_count);
+                std::vector<uint8_t> touched(_vertex_count);
+
+                while (indices.size() > target_count) {
+                    build_adjacency(indices);
+
+                    collapses.clear();
+                    for (std::size_t t = 0; t < indices.size(); t += 3) {
+                        for (int k = 0; k < 3; ++k) {
+                            const uint32_t a{ indices[t + k] };
+                            const uint32_t b{ indices[t + (k + 1) % 3] };
+                            if (_position_ids[a] == _position_ids[b]) {
+                                continue;
+                            }
+                            if (!_locked[_position_ids[a]]) {
+                                collapses.push_back({ a, b, 0.0f, 0.0f });
+                            }
+                            if (!_locked[_position_ids[b]]) {
+                                collapses.push_back({ b, a, 0.0f, 0.0f });
+                            }
+                        }
+                    }
+
+                    std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+                        return lhs.from != rhs.from ? lhs.from < rhs.from : lhs.to < rhs.to;
+                    });
+                    collapses.erase(std::unique(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+                        return lhs.from == rhs.from && lhs.to == rhs.to;
+                    }), collapses.end());
+
+                    for (Collapse& collapse : collapses) {
+                        Quadric merged{ _quadrics[_position_ids[collapse.from]] };
+                        merged.add(_quadrics[_position_ids[collapse.to]]);
+                        const double geometric{ merged.error(position(collapse.to)) };
+                        collapse.geometric_error = static_cast<float>(geometric);
+                        collapse.cost = static_cast<float>(geometric + _options.attrib_weight * attrib_distance_sq(collapse.from, collapse.to));
+                    }
+                    std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) {
+                        return lhs.cost < rhs.cost;
+                    });
+
+                    // independent collapses only: neither end nor anything around 'from' changed earlier in this pass
+                    std::iota(collapse_to.begin(), collapse_to.end(), 0u);
+                    std::fill(touched.begin(), touched.end(), 0);
+                    std::size_t removed{ 0 };
+                    bool collapsed_any{ false };
+
+                    for (const Collapse& collapse : collapses) {
+                        if (collapse.geometric_error > max_error_sq) {
+                            continue;
+                        }
+                        const uint32_t from_pos{ _position_ids[collapse.from] };
+                        const uint32_t to_pos{ _position_ids[collapse.to] };
+                        if (touched[from_pos] || touched[to_pos] || flips(collapse.from, collapse.to, indices)) {
+                            continue;
+                        }
+
+                        collapse_to[collapse.from] = collapse.to;
+                        _quadrics[to_pos].add(_quadrics[from_pos]);
+                        _max_error_sq = std::max(_max_error_sq, static_cast<double>(collapse.geometric_error));
+                        collapsed_any = true;
+
+                        for (uint32_t a = _adjacency_offsets[collapse.from]; a < _adjacency_offsets[collapse.from + 1]; ++a) {
+                            const uint32_t* tri{ &indices[static_cast<std::size_t>(_adjacency[a]) * 3] };
+                            bool has_to{ false };
+                            for (int k = 0; k < 3; ++k) {
+                                touched[_position_ids[tri[k]]] = 1;
+                                has_to |= _position_ids[tri[k]] == to_pos;
+                            }
+                            removed += has_to ? 3 : 0;
+                        }
+
+                        if (indices.size() - removed <= target_count) {
+                            break;
+                        }
+                    }
+
+                    if (!collapsed_any) {
+                        break;
+                    }
+
+                    std::size_t write{ 0 };
+                    for (std::size_t t = 0; t < indices.size(); t += 3) {
+                        const uint32_t a{ collapse_to[indices[t]] };
+                        const uint32_t b{ collapse_to[indices[t + 1]] };
+                        const uint32_t c{ collapse_to[indices[t + 2]] };
+                        if (_position_ids[a] == _position_ids[b] || _position_ids[b] == _position_ids[c] || _position_ids[a] == _position_ids[c]) {
+                            continue;
+                        }
+                        indices[write++] = a;
+                        indices[write++] = b;
+                        indices[write++] = c;
+                    }
+                    indices.resize(write);
+                }
+
+                return static_cast<float>(std::sqrt(_max_error_sq));
+            }
+        }
+
+        std::vector<LodLevel> build_lod_chain(Mesh& mesh, std::size_t buffer_byte_offset, std::size_t index_count, const LodOptions& options) {
+            std::vector<LodLevel> levels{ { buffer_byte_offset, index_count, 0.0f } };
+
+            std::size_t floats_per_vertex{ 3 };
+            for (uint16_t count : options.attrib_counts) {
+                floats_per_vertex += count;
+            }
+            const std::size_t first{ buffer_byte_offset / sizeof(uint32_t) };
+
+            if (mesh.vertices.size() % floats_per_vertex != 0) {
+                std::cerr << "lod: vertex data doesn't match the attribute layout, no levels were built\n";
+                return levels;
+            }
+            if (index_count % 3 != 0 || first + index_count > mesh.indices.size()) {
+                std::cerr << "lod: index range is not a triangle list inside the mesh, no levels were built\n";
+                return levels;
+            }
+
+            const std::size_t vertex_count{ mesh.vertices.size() / floats_per_vertex };
+            std::vector<uint32_t> indices{ mesh.indices.begin() + first, mesh.indices.begin() + first + index_count };
+            for (uint32_t index : indices) {
+                if (index >= vertex_count) {
+                    std::cerr << "lod: index " << index << " is out of range, no levels were built\n";
+                    return levels;
+                }
+            }
+
+            Simplifier simplifier{ mesh.vertices, vertex_count, options };
+            simplifier.init(indices);
+
+            for (uint32_t level = 1; level < options.max_levels; ++level) {
+                const std::size_t prev_count{ indices.size() };
+                const std::size_t target_count{ static_cast<std::size_t>(prev_count * options.reduction) / 3 * 3 };
+                const float error{ simplifier.simplify(indices, target_count) };
+
+                // a level that barely saves anything only costs index memory
+                if (indices.empty() || indices.size() * 10 > prev_count * 9) {
+                    break;
+                }
+
+                levels.push_back({ mesh.indices.size() * sizeof(uint32_t), indices.size(), error });
+                mesh.indices.insert(mesh.indices.end(), indices.begin(), indices.end());
+            }
+
+            return levels;
+        }
+
+        uint32_t select_lod(const std::vector<LodLevel>& levels, uint32_t curr_level, float px_per_unit, float threshold_px, float hysteresis) {
+            uint32_t selected{ 0 };
+
+            for (uint32_t level = 1; level < levels.size(); ++level) {
+                const float limit_px{ level > curr_level ? threshold_px * (1.0f - hysteresis) : threshold_px };
+                if (levels[level].error * px_per_unit <= limit_px) {
+                    selected = level;
+                }
+            }
+
+            return selected;
+        }
+    }
+}
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include "meshOptimize.hpp"
+#include "vertexLayout.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            // scoring cache of Forsyth's algorithm, larger than any real fifo so the order suits all of them
+            constexpr uint32_t forsyth_cache_size{ 32 };
+            constexpr uint32_t overdraw_resolution{ 256 };
+
+            float forsyth_vertex_score(int32_t cache_position, uint32_t remaining_triangles) {
+                if (remaining_triangles == 0) {
+                    return -1.0f;
+                }
+
+                float score{ 0.0f };
+                if (cache_position >= 0) {
+                    // the last triangle's vertices get a fixed score so the next one doesn't just reuse its edge
+                    if (cache_position < 3) {
+                        score = 0.75f;
+                    }
+                    else {
+                        const float scale{ 1.0f / (forsyth_cache_size - 3) };
+                        score = std::pow(1.0f - (cache_position - 3) * scale, 1.5f);
+                    }
+                }
+                // vertices with few triangles left are finished first so they leave the working set
+                return score + 2.0f / std::sqrt(static_cast<float>(remaining_triangles));
+            }
+
+            uint32_t max_vertex(const uint32_t* indices, std::size_t index_count) {
+                uint32_t max{ 0 };
+                for (std::size_t i = 0; i < index_count; ++i) {
+                    max = std::max(max, indices[i]);
+                }
+                return index_count > 0 ? max + 1 : 0;
+            }
+
+            bool get_range(const Mesh& mesh, std::size_t buffer_byte_offset, std::size_t index_count, std::size_t& first, std::size_t& count) {
+                first = buffer_byte_offset / sizeof(uint32_t);
+                if (first >= mesh.indices.size()) {
+                    return false;
+                }
+                count = std::min(index_count, mesh.indices.size() - first);
+                count -= count % 3;
+                return count > 0;
+            }
+
+            struct Vec3 {
+                float x, y, z;
+            };
+
+            Vec3 load_position(const float* positions, uint32_t index) {
+                return { positions[index * 3], positions[index * 3 + 1], positions[index * 3 + 2] };
+            }
+        }
+
+        MeshQuality analyze_vertex_cache(const uint32_t* indices, std::size_t index_count, uint32_t cache_size) {
+            MeshQuality quality;
+            if (index_count < 3 || cache_size == 0) {
+                return quality;
+            }
+
+            const uint32_t vertex_count{ max_vertex(indices, index_count) };
+            // a vertex is in the fifo while fewer than cache_size misses happened after its own
+            std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+            std::vector<bool> used(vertex_count, false);
+            uint32_t timestamp{ cache_size + 1 };
+            uint32_t unique{ 0 };
+
+            for (std::size_t i = 0; i < index_count; ++i) {
+                const uint32_t index{ indices[i] };
+                if (!used[index]) {
+                    used[index] = true;
+                    ++unique;
+                }
+                if (timestamp - cache_timestamps[index] > cache_size) {
+                    cache_timestamps[index] = timestamp++;
+                }
+            }
+
+            const uint32_t misses{ timestamp - (cache_size + 1) };
+            quality.acmr = static_cast<float>(misses) / static_cast<float>(index_count / 3);
+            quality.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+            return quality;
+        }
+
+        float analyze_overdraw(const float* positions, const uint32_t* indices, std::size_t index_count) {
+            if (index_count < 3) {
+                return 0.0f;
+            }
+
+            const uint32_t vertex_count{ max_vertex(indices, index_count) };
+            float min[3]{ positions[0], positions[1], positions[2] };
+            float max[3]{ positions[0], positions[1], positions[2] };
+            for (uint32_t v = 0; v < vertex_count; ++v) {
+                for (int c = 0; c < 3; ++c) {
+                    min[c] = std::min(min[c], positions[v * 3 + c]);
+                    max[c] = std::max(max[c], positions[v * 3 + c]);
+                }
+            }
+
+            constexpr float far{ std::numeric_limits<float>::max() };
+            std::vector<float> depth(overdraw_resolution * overdraw_resolution);
+            std::vector<float> projected(vertex_count * 3);
+            uint64_t shaded{ 0 };
+            uint64_t covered{ 0 };
+
+            for (int view = 0; view < 6; ++view) {
+                const int axis{ view / 2 };
+                const float sign{ view % 2 == 0 ? 1.0f : -1.0f };
+                const int u_axis{ (axis + 1) % 3 };
+                const int v_axis{ (axis + 2) % 3 };
+                const float u_scale{ (overdraw_resolution - 1) / std::max(max[u_axis] - min[u_axis], 1e-6f) };
+                const float v_scale{ (overdraw_resolution - 1) / std::max(max[v_axis] - min[v_axis], 1e-6f) };
+
+                // looking down the axis from the 'sign' side: larger coordinates are closer
+                for (uint32_t v = 0; v < vertex_count; ++v) {
+                    projected[v * 3] = (positions[v * 3 + u_axis] - min[u_axis]) * u_scale;
+                    projected[v * 3 + 1] = (positions[v * 3 + v_axis] - min[v_axis]) * v_scale;
+                    projected[v * 3 + 2] = -sign * positions[v * 3 + axis];
+                }
+                std::fill(depth.begin(), depth.end(), far);
+
+                for (std::size_t i = 0; i + 2 < index_count; i += 3) {
+                    const float* a{ &projected[indices[i] * 3] };
+                    const float* b{ &projected[indices[i + 1] * 3] };
+                    const float* c{ &projected[indices[i + 2] * 3] };
+
+                    // counter clockwise triangles facing the viewer have positive area on the +axis side
+                    const float area{ (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) };
+                    if (area * sign <= 0.0f) {
+                        continue;
+                    }
+
+                    const int x0{ std::max(0, static_cast<int>(std::floor(std::min({ a[0], b[0], c[0] })))) };
+                    const int y0{ std::max(0, static_cast<int>(std::floor(std::min({ a[1], b[1], c[1] })))) };
+                    const int x1{ std::min<int>(overdraw_resolution - 1, static_cast<int>(std::ceil(std::max({ a[0], b[0], c[0] })))) };
+                    const int y1{ std::min<int>(overdraw_resolution - 1, static_cast<int>(std::ceil(std::max({ a[1], b[1], c[1] })))) };
+
+                    for (int y = y0; y <= y1; ++y) {
+                        for (int x = x0; x <= x1; ++x) {
+                            const float px{ x + 0.5f };
+                            const float py{ y + 0.5f };
+                            // barycentrics, all the same sign as the area inside the triangle
+                            const float w0{ ((b[0] - px) * (c[1] - py) - (b[1] - py) * (c[0] - px)) / area };
+                            const float w1{ ((c[0] - px) * (a[1] - py) - (c[1] - py) * (a[0] - px)) / area };
+                            const float w2{ 1.0f - w0 - w1 };
+                            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                                continue;
+                            }
+
+                            const float z{ w0 * a[2] + w1 * b[2] + w2 * c[2] };
+                            float& stored{ depth[y * overdraw_resolution + x] };
+                            if (z < stored) {
+                                if (stored == far) {
+                                    ++covered;
+                                }
+                                stored = z;
+                                ++shaded;
+                            }
+                        }
+                    }
+                }
+            }
+
+            return covered > 0 ? static_cast<float>(shaded) / static_cast<float>(covered) : 0.0f;
+        }
+
+        void optimize_vertex_cache(Mesh& mesh, std::size_t buffer_byte_offset, std::size_t index_count) {
+            std::size_t first, count;
+            if (!get_range(mesh, buffer_byte_offset, index_count, first, count)) {
+                return;
+            }
+
+            uint32_t* indices{ mesh.indices.data() + first };
+            const uint32_t triangle_count{ static_cast<uint32_t>(count / 3) };
+            const uint32_t vertex_count{ max_vertex(indices, count) };
+
+            // vertex -> triangles still to emit, each vertex owns a slice of 'adjacency'
+            std::vector<uint32_t> remaining(vertex_count, 0);
+            for (std::size_t i = 0; i < count; ++i) {
+                ++remaining[indices[i]];
+            }
+            std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+            std::partial_sum(remaining.begin(), remaining.end(), adjacency_offsets.begin() + 1);
+            std::vector<uint32_t> adjacency(count);
+            {
+                std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+                for (uint32_t t = 0; t < triangle_count; ++t) {
+                    for (int k = 0; k < 3; ++k) {
+                        adjacency[fill[indices[t * 3 + k]]++] = t;
+                    }
+                }
+            }
+
+            std::vector<int32_t> cache_positions(vertex_count, -1);
+            std::vector<float> vertex_scores(vertex_count);
+            for (uint32_t v = 0; v < vertex_count; ++v) {
+                vertex_scores[v] = forsyth_vertex_score(-1, remaining[v]);
+            }
+
+            std::vector<float> triangle_scores(triangle_count);
+            std::vector<bool> emitted(triangle_count, false);
+            uint32_t best_triangle{ 0 };
+            for (uint32_t t = 0; t < triangle_count; ++t) {
+                triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+                if (triangle_scores[t] > triangle_scores[best_triangle]) {
+                    best_triangle = t;
+                }
+            }
+
+            std::vector<uint32_t> reordered;
+            reordered.reserve(count);
+            std::vector<uint32_t> cache;
+            std::vector<uint32_t> next_cache;
+            cache.reserve(forsyth_cache_size + 3);
+            next_cache.reserve(forsyth_cache_size + 3);
+            uint32_t dead_end_cursor{ 0 };
+
+            for (uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count) {
+                const uint32_t* triangle{ indices + best_triangle * 3 };
+                reordered.insert(reordered.end(), triangle, triangle + 3);
+                emitted[best_triangle] = true;
+
+                // the emitted triangle's vertices go to the front, the rest shift back
+                next_cache.assign(triangle, triangle + 3);
+                for (uint32_t vertex : cache) {
+                    if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+                        next_cache.push_back(vertex);
+                    }
+                }
+
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t vertex{ triangle[k] };
+                    uint32_t* slice{ adjacency.data() + adjacency_offsets[vertex] };
+                    uint32_t* found{ std::find(slice, slice + remaining[vertex], best_triangle) };
+                    std::swap(*found, slice[remaining[vertex] - 1]);
+                    --remaining[vertex];
+                }
+
+                for (std::size_t p = 0; p < next_cache.size(); ++p) {
+                    const uint32_t vertex{ next_cache[p] };
+                    cache_positions[vertex] = p < forsyth_cache_size ? static_cast<int32_t>(p) : -1;
+                }
+
+                // only triangles around the touched vertices change their score
+                float best_score{ -1.0f };
+                for (uint32_t vertex : next_cache) {
+                    const float score{ forsyth_vertex_score(cache_positions[vertex], remaining[vertex]) };
+                    const float delta{ score - vertex_scores[vertex] };
+                    vertex_scores[vertex] = score;
+
+                    const uint32_t* slice{ adjacency.data() + adjacency_offsets[vertex] };
+                    for (uint32_t a = 0; a < remaining[vertex]; ++a) {
+                        const uint32_t t{ slice[a] };
+                        triangle_scores[t] += delta;
+                        if (triangle_scores[t] > best_score) {
+                            best_score = triangle_scores[t];
+                            best_triangle = t;
+                        }
+                    }
+                }
+
+                if (next_cache.size() > forsyth_cache_size) {
+                    next_cache.resize(forsyth_cache_size);
+                }
+                std::swap(cache, next_cache);
+
+                if (best_score < 0.0f) {
+                    // dead end, nothing around the cache is left: continue with the next triangle in the old order
+                    while (dead_end_cursor < triangle_count && emitted[dead_end_cursor]) {
+                        ++dead_end_cursor;
+                    }
+                    best_triangle = dead_end_cursor;
+                }
+            }
+
+            std::copy(reordered.begin(), reordered.end(), indices);
+        }
+
+        void optimize_overdraw(Mesh& mesh, std::size_t buffer_byte_offset, std::size_t index_count, float threshold, uint32_t cache_size) {
+            std::size_t first, count;
+            if (!get_range(mesh, buffer_byte_offset, index_count, first, count) || cache_size == 0) {
+                return;
+            }
+
+            uint32_t* indices{ mesh.indices.data() + first };
+            const float* positions{ mesh.vertices.data() };
+            const uint32_t triangle_count{ static_cast<uint32_t>(count / 3) };
+            const uint32_t vertex_count{ max_vertex(indices, count) };
+
+            // a triangle missing on all three vertices restarts the cache, cutting there costs nothing
+            std::vector<uint32_t> cluster_starts;
+            {
+                std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+                uint32_t timestamp{ cache_size + 1 };
+                for (uint32_t t = 0; t < triangle_count; ++t) {
+                    int misses{ 0 };
+                    for (int k = 0; k < 3; ++k) {
+                        const uint32_t index{ indices[t * 3 + k] };
+                        if (timestamp - cache_timestamps[index] > cache_size) {
+                            cache_timestamps[index] = timestamp++;
+                            ++misses;
+                        }
+                    }
+                    if (t == 0 || misses == 3) {
+                        cluster_starts.push_back(t);
+                    }
+                }
+            }
+            if (cluster_starts.size() < 2) {
+                return;
+            }
+            cluster_starts.push_back(triangle_count);
+
+            // area weighted centroid and normal of every cluster and of the whole range
+            const std::size_t cluster_count{ cluster_starts.size() - 1 };
+            std::vector<Vec3> cluster_centroids(cluster_count, Vec3{ 0.0f, 0.0f, 0.0f });
+            std::vector<Vec3> cluster_normals(cluster_count, Vec3{ 0.0f, 0.0f, 0.0f });
+            Vec3 mesh_centroid{ 0.0f, 0.0f, 0.0f };
+            float mesh_area{ 0.0f };
+
+            for (std::size_t c = 0; c < cluster_count; ++c) {
+                float cluster_area{ 0.0f };
+                for (uint32_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t) {
+                    const Vec3 a{ load_position(positions, indices[t * 3]) };
+                    const Vec3 b{ load_position(positions, indices[t * 3 + 1]) };
+                    const Vec3 d{ load_position(positions, indices[t * 3 + 2]) };
+                    const Vec3 e0{ b.x - a.x, b.y - a.y, b.z - a.z };
+                    const Vec3 e1{ d.x - a.x, d.y - a.y, d.z - a.z };
+                    const Vec3 n{ e0.y * e1.z - e0.z * e1.y, e0.z * e1.x - e0.x * e1.z, e0.x * e1.y - e0.y * e1.x };
+                    const float area{ std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z) };
+
+                    cluster_centroids[c].x += (a.x + b.x + d.x) * area;
+                    cluster_centroids[c].y += (a.y + b.y + d.y) * area;
+                    cluster_centroids[c].z += (a.z + b.z + d.z) * area;
+                    cluster_normals[c].x += n.x;
+                    cluster_normals[c].y += n.y;
+                    cluster_normals[c].z += n.z;
+                    cluster_area += area;
+                }
+
+                mesh_centroid.x += cluster_centroids[c].x;
+                mesh_centroid.y += cluster_centroids[c].y;
+                mesh_centroid.z += cluster_centroids[c].z;
+                mesh_area += cluster_area;
+
+                const float inv_area{ cluster_area > 0.0f ? 1.0f / (3.0f * cluster_area) : 0.0f };
+                cluster_centroids[c] = { cluster_centroids[c].x * inv_area, cluster_centroids[c].y * inv_area, cluster_centroids[c].z * inv_area };
+            }
+            if (mesh_area <= 0.0f) {
+                return;
+            }
+            const float inv_mesh_area{ 1.0f / (3.0f * mesh_area) };
+            mesh_centroid = { mesh_centroid.x * inv_mesh_area, mesh_centroid.y * inv_mesh_area, mesh_centroid.z * inv_mesh_area };
+
+            // clusters far out along their own normal occlude the rest of the mesh from most directions
+            std::vector<float> sort_keys(cluster_count);
+            for (std::size_t c = 0; c < cluster_count; ++c) {
+                const Vec3& n{ cluster_normals[c] };
+                const float length{ std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z) };
+                const Vec3 offset{ cluster_centroids[c].x - mesh_centroid.x, cluster_centroids[c].y - mesh_centroid.y, cluster_centroids[c].z - mesh_centroid.z };
+                sort_keys[c] = length > 0.0f ? (offset.x * n.x + offset.y * n.y + offset.z * n.z) / length : 0.0f;
+            }
+
+            std::vector<uint32_t> order(cluster_count);
+            std::iota(order.begin(), order.end(), 0u);
+            std::stable_sort(order.begin(), order.end(), [&sort_keys](uint32_t lhs, uint32_t rhs) {
+                return sort_keys[lhs] > sort_keys[rhs];
+            });
+
+            std::vector<uint32_t> reordered;
+            reordered.reserve(count);
+            for (uint32_t c : order) {
+                reordered.insert(reordered.end(), indices + cluster_starts[c] * 3, indices + cluster_starts[c + 1] * 3);
+            }
+
+            const float cache_acmr{ analyze_vertex_cache(indices, count, cache_size).acmr };
+            const float reordered_acmr{ analyze_vertex_cache(reordered.data(), count, cache_size).acmr };
+            if (reordered_acmr <= cache_acmr * threshold) {
+                std::copy(reordered.begin(), reordered.end(), indices);
+            }
+        }
+
+        void optimize_vertex_fetch(Mesh& mesh, const std::vector<VertexElement>& format) {
+            const std::size_t floats{ floats_per_vertex(format) };
+            if (floats == 0 || mesh.vertices.size() % floats != 0) {
+                return;
+            }
+            const std::size_t vertex_count{ mesh.vertices.size() / floats };
+
+            // old vertex -> new vertex, in order of first use
+            std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+            uint32_t next{ 0 };
+            for (uint32_t index : mesh.indices) {
+                if (index < vertex_count && remap[index] == UINT32_MAX) {
+                    remap[index] = next++;
+                }
+            }
+            for (uint32_t& target : remap) {
+                if (target == UINT32_MAX) {
+                    target = next++;
+                }
+            }
+
+            std::vector<float> reordered(mesh.vertices.size());
+            std::size_t block{ 0 };
+            for (const VertexElement& element : format) {
+                for (std::size_t v = 0; v < vertex_count; ++v) {
+                    std::copy_n(
+                        mesh.vertices.data() + block + v * element.count,
+                        element.count,
+                        reordered.data() + block + remap[v] * element.count
+                    );
+                }
+                block += element.count * vertex_count;
+            }
+            mesh.vertices = std::move(reordered);
+
+            for (uint32_t& index : mesh.indices) {
+                if (index < vertex_count) {
+                    index = remap[index];
+                }
+            }
+        }
+
+        MeshOptimizeReport optimize_mesh(Mesh& mesh, const std::vector<VertexElement>& format, std::size_t buffer_byte_offset, std::size_t index_count, const MeshOptimizeOptions& options) {
+            MeshOptimizeReport report;
+            std::size_t first, count;
+            if (format.empty() || format[0].count != 3 || !get_range(mesh, buffer_byte_offset, index_count, first, count)) {
+                return report;
+            }
+
+            report.before = analyze_vertex_cache(mesh.indices.data() + first, count, options.cache_size);
+            report.before.overdraw = analyze_overdraw(mesh.vertices.data(), mesh.indices.data() + first, count);
+
+            optimize_vertex_cache(mesh, buffer_byte_offset, count);
+            if (options.optimize_overdraw) {
+                optimize_overdraw(mesh, buffer_byte_offset, count, options.overdraw_threshold, options.cache_size);
+            }
+            optimize_vertex_fetch(mesh, format);
+
+            report.after = analyze_vertex_cache(mesh.indices.data() + first, count, options.cache_size);
+            report.after.overdraw = analyze_overdraw(mesh.vertices.data(), mesh.indices.data() + first, count);
+            return report;
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include "meshWeld.hpp"
+#include "vertexLayout.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            uint64_t hash_cell(int64_t x, int64_t y, int64_t z) {
+                uint64_t hash{ static_cast<uint64_t>(x) * 0x9E3779B97F4A7C15ull };
+                hash ^= static_cast<uint64_t>(y) * 0xC2B2AE3D27D4EB4Full + (hash << 6) + (hash >> 2);
+                hash ^= static_cast<uint64_t>(z) * 0x165667B19E3779F9ull + (hash << 6) + (hash >> 2);
+                return hash;
+            }
+
+            int64_t cell_coord(float value, float tolerance) {
+                if (tolerance <= 0.0f) {
+                    // exact welding hashes the bits, -0 and 0 are the same position
+                    const float normalized{ value == 0.0f ? 0.0f : value };
+                    uint32_t bits;
+                    std::memcpy(&bits, &normalized, sizeof(bits));
+                    return bits;
+                }
+                return static_cast<int64_t>(std::floor(value / tolerance));
+            }
+        }
+
+        std::size_t weld_vertices(Mesh& mesh, const std::vector<VertexElement>& format, const WeldOptions& options) {
+            const std::size_t floats{ floats_per_vertex(format) };
+            if (floats == 0 || format[0].count != 3 || mesh.vertices.size() % floats != 0) {
+                return floats == 0 ? 0 : mesh.vertices.size() / floats;
+            }
+            const std::size_t vertex_count{ mesh.vertices.size() / floats };
+
+            // offset of every block in the planar data
+            std::vector<std::size_t> block_offsets;
+            std::size_t block{ 0 };
+            for (const VertexElement& element : format) {
+                block_offsets.push_back(block);
+                block += element.count * vertex_count;
+            }
+
+            auto matches{ [&](std::size_t lhs, std::size_t rhs) {
+                for (std::size_t e = 0; e < format.size(); ++e) {
+                    const float tolerance{ e == 0 ? options.position_tolerance : options.attribute_tolerance };
+                    const float* a{ mesh.vertices.data() + block_offsets[e] + lhs * format[e].count };
+                    const float* b{ mesh.vertices.data() + block_offsets[e] + rhs * format[e].count };
+                    for (uint16_t c = 0; c < format[e].count; ++c) {
+                        if (!(std::abs(a[c] - b[c]) <= tolerance)) {
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            } };
+
+            // cells as big as the position tolerance: a match is in the same or a neighbouring cell
+            const int reach{ options.position_tolerance > 0.0f ? 1 : 0 };
+            std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+            cells.reserve(vertex_count);
+            std::vector<uint32_t> remap(vertex_count);
+            std::vector<uint32_t> kept;
+
+            for (std::size_t v = 0; v < vertex_count; ++v) {
+                const float* position{ mesh.vertices.data() + v * 3 };
+                const int64_t cx{ cell_coord(position[0], options.position_tolerance) };
+                const int64_t cy{ cell_coord(position[1], options.position_tolerance) };
+                const int64_t cz{ cell_coord(position[2], options.position_tolerance) };
+
+                bool welded{ false };
+                for (int dx = -reach; dx <= reach && !welded; ++dx) {
+                    for (int dy = -reach; dy <= reach && !welded; ++dy) {
+                        for (int dz = -reach; dz <= reach && !welded; ++dz) {
+                            auto it{ cells.find(hash_cell(cx + dx, cy + dy, cz + dz)) };
+                            if (it == cells.end()) {
+                                continue;
+                            }
+                            for (uint32_t candidate : it->second) {
+                                if (matches(v, candidate)) {
+                                    remap[v] = remap[candidate];
+                                    welded = true;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                if (!welded) {
+                    remap[v] = static_cast<uint32_t>(kept.size());
+                    kept.push_back(static_cast<uint32_t>(v));
+                    cells[hash_cell(cx, cy, cz)].push_back(static_cast<uint32_t>(v));
+                }
+            }
+
+            if (kept.size() == vertex_count) {
+                return vertex_count;
+            }
+
+            std::vector<float> welded_vertices;
+            welded_vertices.reserve(kept.size() * floats);
+            for (std::size_t e = 0; e < format.size(); ++e) {
+                for (uint32_t v : kept) {
+                    const float* src{ mesh.vertices.data() + block_offsets[e] + v * format[e].count };
+                    welded_vertices.insert(welded_vertices.end(), src, src + format[e].count);
+                }
+            }
+            mesh.vertices = std::move(welded_vertices);
+
+            for (uint32_t& index : mesh.indices) {
+                if (index < vertex_count) {
+                    index = remap[index];
+                }
+            }
+
+            return kept.size();
+        }
+
+        GLenum select_index_type(std::size_t vertex_count) {
+            if (vertex_count <= UINT8_MAX + 1) {
+                return GL_UNSIGNED_BYTE;
+            }
+            if (vertex_count <= UINT16_MAX + 1) {
+                return GL_UNSIGNED_SHORT;
+            }
+            return GL_UNSIGNED_INT;
+        }
+
+        std::size_t index_type_size(GLenum index_type) {
+            switch (index_type) {
+            case GL_UNSIGNED_BYTE:  return sizeof(uint8_t);
+            case GL_UNSIGNED_SHORT: return sizeof(uint16_t);
+            default:                return sizeof(uint32_t);
+            }
+        }
+
+        std::vector<uint8_t> encode_indices(std::span<const uint32_t> indices, GLenum index_type) {
+            std::vector<uint8_t> encoded(indices.size() * index_type_size(index_type));
+
+            switch (index_type) {
+            case GL_UNSIGNED_BYTE:
+                std::transform(indices.begin(), indices.end(), encoded.begin(), [](uint32_t index) {
+                    return static_cast<uint8_t>(index);
+                });
+                break;
+            case GL_UNSIGNED_SHORT:
+                for (std::size_t i = 0; i < indices.size(); ++i) {
+                    const uint16_t index{ static_cast<uint16_t>(indices[i]) };
+                    std::memcpy(encoded.data() + i * sizeof(index), &index, sizeof(index));
+                }
+                break;
+            default:
+                std::memcpy(encoded.data(), indices.data(), encoded.size());
+                break;
+            }
+
+            return encoded;
+        }
+    }
+}
@@ -39,7 +39,7 @@ namespace my_gl {
 #define TEX_MIDDLE_BOT     0.5f, 0.0f
 #define TEX_RIGHT_BOT      1.0f, 0.0f
 
-        std::vector<float> cube_vertices = {
+        constexpr StaticMesh<24, 36> cube_mesh{ {
             // POSITIONS
             // front
             LEFT_TOP_NEAR,  LEFT_BOT_NEAR,  RIGHT_BOT_NEAR, RIGHT_TOP_NEAR,
@@ -78,17 +78,27 @@ namespace my_gl {
             NORMAL_LEFT,        NORMAL_LEFT,        NORMAL_LEFT,        NORMAL_LEFT,
             NORMAL_TOP,         NORMAL_TOP,         NORMAL_TOP,         NORMAL_TOP,
             NORMAL_BOTTOM,      NORMAL_BOTTOM,      NORMAL_BOTTOM,      NORMAL_BOTTOM,
-        };
-
-        std::vector<uint16_t> cube_indeces = {
+        }, {
             0, 1, 2,        0, 2, 3,
             4, 6, 5,        4, 7, 6,
             8, 9, 10,       9, 11, 10,
             12, 14, 13,     13, 14, 15,
             16, 17, 18,     17, 19, 18,
             20, 22, 21,     21, 22, 23
+        } };
+
+        const std::vector<VertexElement> cube_mesh_format{
+            { .name = "a_pos", .count = 3 },
+            { .name = "a_tex", .count = 2 },
+            { .name = "a_color", .count = 3 },
+            { .name = "a_normal", .count = 3 },
         };
 
-        Mesh cube_mesh{ std::move(cube_vertices), std::move(cube_indeces) };
+        const std::vector<VertexElement> cube_mesh_format_packed{
+            { .name = "a_pos", .count = 3, .encoding = VertexEncoding::UNORM16_BOUNDS },
+            { .name = "a_tex", .count = 2, .encoding = VertexEncoding::HALF_FLOAT },
+            { .name = "a_color", .count = 3, .encoding = VertexEncoding::UNORM8 },
+            { .name = "a_normal", .count = 3, .encoding = VertexEncoding::SNORM10_PACKED },
+        };
     }
 }
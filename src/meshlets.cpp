@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+#include "meshlets.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            void compute_meshlet_bounds(Meshlet& meshlet, const float* positions, std::size_t position_count, const uint32_t* indices) {
+                const uint32_t* first{ indices + meshlet.index_offset };
+                auto valid_triangle{ [position_count](const uint32_t* tri) {
+                    return tri[0] < position_count && tri[1] < position_count && tri[2] < position_count;
+                } };
+
+                // sphere around the box center, loose but cheap
+                float box_min[3]{ INFINITY, INFINITY, INFINITY };
+                float box_max[3]{ -INFINITY, -INFINITY, -INFINITY };
+                for (uint32_t i = 0; i < meshlet.index_count; ++i) {
+                    if (first[i] >= position_count) {
+                        continue;
+                    }
+                    const float* p{ positions + first[i] * 3 };
+                    for (int c = 0; c < 3; ++c) {
+                        box_min[c] = std::min(box_min[c], p[c]);
+                        box_max[c] = std::max(box_max[c], p[c]);
+                    }
+                }
+
+                float radius_sq{ 0.0f };
+                for (int c = 0; c < 3; ++c) {
+                    meshlet.center[c] = box_min[c] <= box_max[c] ? (box_min[c] + box_max[c]) * 0.5f : 0.0f;
+                }
+                for (uint32_t i = 0; i < meshlet.index_count; ++i) {
+                    if (first[i] >= position_count) {
+                        continue;
+                    }
+                    const float* p{ positions + first[i] * 3 };
+                    const float d[3]{ p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+                    radius_sq = std::max(radius_sq, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                }
+                meshlet.radius = std::sqrt(radius_sq);
+
+                // normal cone: average normal as the axis, the widest deviation from it as the angle
+                // one normal per triangle, zero for the ones that can't contribute
+                std::vector<float> normals(meshlet.index_count, 0.0f);
+                float axis[3]{ 0.0f, 0.0f, 0.0f };
+                bool has_normals{ false };
+
+                for (uint32_t i = 0; i < meshlet.index_count; i += 3) {
+                    const uint32_t* tri{ first + i };
+                    if (!valid_triangle(tri)) {
+                        continue;
+                    }
+                    const float* p0{ positions + tri[0] * 3 };
+                    const float* p1{ positions + tri[1] * 3 };
+                    const float* p2{ positions + tri[2] * 3 };
+                    const float e1[3]{ p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                    const float e2[3]{ p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                    float n[3]{
+                        e1[1] * e2[2] - e1[2] * e2[1],
+                        e1[2] * e2[0] - e1[0] * e2[2],
+                        e1[0] * e2[1] - e1[1] * e2[0],
+                    };
+                    const float len{ std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) };
+                    if (len == 0.0f) {
+                        continue;
+                    }
+                    for (int c = 0; c < 3; ++c) {
+                        normals[i + c] = n[c] / len;
+                        axis[c] += normals[i + c];
+                    }
+                    has_normals = true;
+                }
+
+                meshlet.cone_cutoff = 1.0f;
+                for (int c = 0; c < 3; ++c) {
+                    meshlet.cone_axis[c] = 0.0f;
+                    meshlet.cone_apex[c] = meshlet.center[c];
+                }
+
+                const float axis_len{ std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]) };
+                if (!has_normals || axis_len == 0.0f) {
+                    return;
+                }
+                for (int c = 0; c < 3; ++c) {
+                    axis[c] /= axis_len;
+                }
+
+                float min_dp{ 1.0f };
+                for (std::size_t n = 0; n < normals.size(); n += 3) {
+                    if (normals[n] != 0.0f || normals[n + 1] != 0.0f || normals[n + 2] != 0.0f) {
+                        min_dp = std::min(min_dp, normals[n] * axis[0] + normals[n + 1] * axis[1] + normals[n + 2] * axis[2]);
+                    }
+                }
+                // wider than ~84 degrees, the cone would almost never reject anything
+                if (min_dp <= 0.1f) {
+                    return;
+                }
+
+                // move the apex back along the axis until every triangle plane has it on its back side
+                float max_t{ 0.0f };
+                for (uint32_t i = 0; i < meshlet.index_count; i += 3) {
+                    const float* normal{ &normals[i] };
+                    if (normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f) {
+                        continue;
+                    }
+
+                    const float* p0{ positions + first[i] * 3 };
+                    const float dc[3]{ meshlet.center[0] - p0[0], meshlet.center[1] - p0[1], meshlet.center[2] - p0[2] };
+                    const float dn{ dc[0] * normal[0] + dc[1] * normal[1] + dc[2] * normal[2] };
+                    const float dp{ axis[0] * normal[0] + axis[1] * normal[1] + axis[2] * normal[2] };
+                    max_t = std::max(max_t, dn / dp);
+                }
+
+                for (int c = 0; c < 3; ++c) {
+                    meshlet.cone_axis[c] = axis[c];
+                    meshlet.cone_apex[c] = meshlet.center[c] - axis[c] * max_t;
+                }
+                meshlet.cone_cutoff = std::sqrt(1.0f - min_dp * min_dp);
+            }
+        }
+
+        std::vector<Meshlet> build_meshlets(const float* positions, std::size_t position_count, const uint32_t* indices, std::size_t index_count) {
+            std::vector<Meshlet> meshlets;
+            if (index_count < 3) {
+                return meshlets;
+            }
+
+            // last meshlet every vertex was counted for
+            std::vector<uint32_t> vertex_meshlet(static_cast<std::size_t>(*std::max_element(indices, indices + index_count)) + 1, UINT32_MAX);
+            Meshlet curr{ .index_offset = 0, .index_count = 0 };
+            uint32_t curr_vertices{ 0 };
+
+            for (std::size_t i = 0; i + 2 < index_count; i += 3) {
+                const uint32_t meshlet_id{ static_cast<uint32_t>(meshlets.size()) };
+                uint32_t new_vertices{ 0 };
+                for (int k = 0; k < 3; ++k) {
+                    // repeated corners inside one triangle count once
+                    const bool repeated{ (k > 0 && indices[i + k] == indices[i]) || (k > 1 && indices[i + k] == indices[i + 1]) };
+                    new_vertices += vertex_meshlet[indices[i + k]] != meshlet_id && !repeated;
+                }
+
+                if (curr.index_count > 0 && (curr_vertices + new_vertices > meshlet_max_vertices || curr.index_count / 3 + 1 > meshlet_max_triangles)) {
+                    meshlets.push_back(curr);
+                    curr = Meshlet{ .index_offset = static_cast<uint32_t>(i), .index_count = 0 };
+                    curr_vertices = 0;
+                }
+
+                const uint32_t curr_id{ static_cast<uint32_t>(meshlets.size()) };
+                for (int k = 0; k < 3; ++k) {
+                    if (vertex_meshlet[indices[i + k]] != curr_id) {
+                        vertex_meshlet[indices[i + k]] = curr_id;
+                        ++curr_vertices;
+                    }
+                }
+                curr.index_count += 3;
+            }
+            meshlets.push_back(curr);
+
+            for (Meshlet& meshlet : meshlets) {
+                compute_meshlet_bounds(meshlet, positions, position_count, indices);
+            }
+
+            return meshlets;
+        }
+    }
+}
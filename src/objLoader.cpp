@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include "objLoader.hpp"
+#include "mappedFile.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            constexpr int64_t missing_index{ INT64_MIN };
+            constexpr uint32_t invalid_vertex{ UINT32_MAX };
+            // a few chunks per thread even out chunks of denser lines, tiny files stay in one
+            constexpr uint32_t chunks_per_thread{ 4 };
+            constexpr std::size_t min_chunk_bytes{ 1 << 20 };
+
+            constexpr double powers_of_ten[]{
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+            };
+
+            struct Corner {
+                // v, vt, vn: 0 based, relative to the counts the chunk had parsed so far when the bit is set
+                int64_t     index[3];
+                uint8_t     relative;
+            };
+
+            struct MaterialRun {
+                std::string_view    name;
+                std::size_t         first_corner;
+                uint32_t            material;
+            };
+
+            struct VertexKey {
+                uint32_t    v;
+                uint32_t    vt;
+                uint32_t    vn;
+                uint32_t    material;
+
+                bool operator==(const VertexKey& rhs) const = default;
+            };
+
+            // open addressing over an external key list, ids are positions in that list
+            class KeyTable {
+            public:
+                explicit KeyTable(std::size_t expected_keys) {
+                    std::size_t capacity{ 16 };
+                    while (capacity < expected_keys * 2) {
+                        capacity <<= 1;
+                    }
+                    _slots.assign(capacity, invalid_vertex);
+                }
+
+                uint32_t insert(const VertexKey& key, std::vector<VertexKey>& keys) {
+                    if ((keys.size() + 1) * 2 > _slots.size()) {
+                        grow(keys);
+                    }
+
+                    const std::size_t mask{ _slots.size() - 1 };
+                    for (std::size_t slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+                        if (_slots[slot] == invalid_vertex) {
+                            _slots[slot] = static_cast<uint32_t>(keys.size());
+                            keys.push_back(key);
+                            return _slots[slot];
+                        }
+                        if (keys[_slots[slot]] == key) {
+                            return _slots[slot];
+                        }
+                    }
+                }
+
+            private:
+                static std::size_t hash(const VertexKey& key) {
+                    uint64_t h{ key.v * 0x9E3779B97F4A7C15ull };
+                    h ^= (static_cast<uint64_t>(key.vt) << 32 | key.vn) * 0xC2B2AE3D27D4EB4Full;
+                    h ^= key.material * 0x165667B19E3779F9ull;
+                    return static_cast<std::size_t>(h ^ (h >> 29));
+                }
+
+                void grow(const std::vector<VertexKey>& keys) {
+                    _slots.assign(_slots.size() * 2, invalid_vertex);
+                    const std::size_t mask{ _slots.size() - 1 };
+                    for (uint32_t id = 0; id < keys.size(); ++id) {
+                        std::size_t slot{ hash(keys[id]) & mask };
+                        while (_slots[slot] != invalid_vertex) {
+                            slot = (slot + 1) & mask;
+                        }
+                        _slots[slot] = id;
+                    }
+                }
+
+                std::vector<uint32_t>   _slots;
+            };
+
+            struct Chunk {
+                const char*                     begin;
+                const char*                     end;
+                std::vector<float>              positions;
+                std::vector<float>              texcoords;
+                std::vector<float>              normals;
+                // triangles, 3 corners each
+                std::vector<Corner>             corners;
+                std::vector<MaterialRun>        material_runs;
+                std::vector<std::string_view>   mtllibs;
+
+                // merge state
+                std::size_t                     bases[3]{ 0, 0, 0 };
+                uint32_t                        start_material{ 0 };
+                std::vector<uint32_t>           corner_vertices;
+                std::vector<VertexKey>          unique_keys;
+                std::vector<uint32_t>           remap;
+                std::size_t                     valid_corners{ 0 };
+                std::size_t                     first_index{ 0 };
+                // (material, first valid corner) every time the material changes
+                std::vector<std::pair<uint32_t, std::size_t>> material_starts;
+            };
+
+            bool is_space(char c) {
+                return c == ' ' || c == '\t' || c == '\r';
+            }
+
+            bool is_digit(char c) {
+                return c >= '0' && c <= '9';
+            }
+
+            const char* skip_spaces(const char* p, const char* end) {
+                while (p < end && is_space(*p)) {
+                    ++p;
+                }
+                return p;
+            }
+
+            // decimal and scientific notation, nullptr without a digit
+            // 19 significant digits go through one double operation, plenty for a float
+            const char* parse_float(const char* p, const char* end, float& value) {
+                p = skip_spaces(p, end);
+                bool negative{ false };
+                if (p < end && (*p == '-' || *p == '+')) {
+                    negative = *p == '-';
+                    ++p;
+                }
+
+                uint64_t mantissa{ 0 };
+                int digits{ 0 };
+                int exponent{ 0 };
+                bool any_digit{ false };
+                for (; p < end && is_digit(*p); ++p) {
+                    any_digit = true;
+                    if (digits < 19) {
+                        mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                        digits += mantissa != 0;
+                    }
+                    else {
+                        ++exponent;
+                    }
+                }
+                if (p < end && *p == '.') {
+                    for (++p; p < end && is_digit(*p); ++p) {
+                        any_digit = true;
+                        if (digits < 19) {
+                            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                            digits += mantissa != 0;
+                            --exponent;
+                        }
+                    }
+                }
+                if (!any_digit) {
+                    return nullptr;
+                }
+
+                if (p < end && (*p == 'e' || *p == 'E')) {
+                    const char* q{ p + 1 };
+                    bool negative_exponent{ false };
+                    if (q < end && (*q == '-' || *q == '+')) {
+                        negative_exponent = *q == '-';
+                        ++q;
+                    }
+                    if (q < end && is_digit(*q)) {
+                        int explicit_exponent{ 0 };
+                        for (; q < end && is_digit(*q); ++q) {
+                            explicit_exponent = std::min(explicit_exponent * 10 + (*q - '0'), 9999);
+                        }
+                        exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+                        p = q;
+                    }
+                }
+
+                double result{ static_cast<double>(mantissa) };
+                if (exponent >= 0 && exponent <= 22) {
+                    result *= powers_of_ten[exponent];
+                }
+                else if (exponent < 0 && exponent >= -22) {
+                    result /= powers_of_ten[-exponent];
+                }
+                else {
+                    result *= std::pow(10.0, exponent);
+                }
+                value = static_cast<float>(negative ? -result : result);
+                return p;
+            }
+
+            const char* parse_int(const char* p, const char* end, int64_t& value) {
+                bool negative{ false };
+                if (p < end && (*p == '-' || *p == '+')) {
+                    negative = *p == '-';
+                    ++p;
+                }
+                if (p >= end || !is_digit(*p)) {
+                    return nullptr;
+                }
+                int64_t result{ 0 };
+                for (; p < end && is_digit(*p); ++p) {
+                    result = result * 10 + (*p - '0');
+                }
+                value = negative ? -result : result;
+                return p;
+            }
+
+            void parse_floats(const char* p, const char* end, std::vector<float>& out, int count) {
+                for (int c = 0; c < count; ++c) {
+                    float value{ 0.0f };
+                    const char* next{ p ? parse_float(p, end, value) : nullptr };
+                    out.push_back(next ? value : 0.0f);
+                    p = next;
+                }
+            }
+
+            std::string_view trimmed(const char* p, const char* end) {
+                p = skip_spaces(p, end);
+                while (end > p && is_space(end[-1])) {
+                    --end;
+                }
+                return { p, static_cast<std::size_t>(end - p) };
+            }
+
+            bool starts_with_word(const char* p, const char* end, std::string_view word) {
+                return static_cast<std::size_t>(end - p) > word.size()
+                    && std::memcmp(p, word.data(), word.size()) == 0
+                    && is_space(p[word.size()]);
+            }
+
+            void parse_face(const char* p, const char* end, Chunk& chunk) {
+                const std::size_t counts[3]{ chunk.positions.size() / 3, chunk.texcoords.size() / 2, chunk.normals.size() / 3 };
+                Corner first{};
+                Corner previous{};
+                int corner_count{ 0 };
+
+                while (true) {
+                    p = skip_spaces(p, end);
+                    if (p >= end) {
+                        break;
+                    }
+
+                    Corner corner{ { missing_index, missing_index, missing_index }, 0 };
+                    for (int k = 0; k < 3; ++k) {
+                        int64_t value;
+                        const char* next{ parse_int(p, end, value) };
+                        if (next) {
+                            if (value == 0) {
+                                // 0 is no index in obj, the face is broken
+                                return;
+                            }
+                            if (value > 0) {
+                                corner.index[k] = value - 1;
+                            }
+                            else {
+                                corner.index[k] = static_cast<int64_t>(counts[k]) + value;
+                                corner.relative |= static_cast<uint8_t>(1 << k);
+                            }
+                            p = next;
+                        }
+                        else if (k == 0) {
+                            return;
+                        }
+                        if (k == 2 || p >= end || *p != '/') {
+                            break;
+                        }
+                        ++p;
+                    }
+                    // junk after the corner ends the face
+                    if (p < end && !is_space(*p)) {
+                        break;
+                    }
+
+                    // fan triangulation
+                    if (corner_count == 0) {
+                        first = corner;
+                    }
+                    else if (corner_count >= 2) {
+                        chunk.corners.push_back(first);
+                        chunk.corners.push_back(previous);
+                        chunk.corners.push_back(corner);
+                    }
+                    previous = corner;
+                    ++corner_count;
+                }
+            }
+
+            void parse_chunk(Chunk& chunk) {
+                const char* p{ chunk.begin };
+                while (p < chunk.end) {
+                    const char* line_end{ static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(chunk.end - p))) };
+                    if (!line_end) {
+                        line_end = chunk.end;
+                    }
+
+                    p = skip_spaces(p, line_end);
+                    if (line_end - p >= 2) {
+                        if (p[0] == 'v' && is_space(p[1])) {
+                            parse_floats(p + 2, line_end, chunk.positions, 3);
+                        }
+                        else if (p[0] == 'v' && p[1] == 't' && line_end - p > 2 && is_space(p[2])) {
+                            parse_floats(p + 3, line_end, chunk.texcoords, 2);
+                        }
+                        else if (p[0] == 'v' && p[1] == 'n' && line_end - p > 2 && is_space(p[2])) {
+                            parse_floats(p + 3, line_end, chunk.normals, 3);
+                        }
+                        else if (p[0] == 'f' && is_space(p[1])) {
+                            parse_face(p + 2, line_end, chunk);
+                        }
+                        else if (starts_with_word(p, line_end, "usemtl")) {
+                            chunk.material_runs.push_back({ trimmed(p + 6, line_end), chunk.corners.size(), 0 });
+                        }
+                        else if (starts_with_word(p, line_end, "mtllib")) {
+                            chunk.mtllibs.push_back(trimmed(p + 6, line_end));
+                        }
+                    }
+
+                    p = line_end + 1;
+                }
+            }
+
+            std::string directory_of(std::string_view path) {
+                const std::size_t slash{ path.find_last_of('/') };
+                return slash == std::string_view::npos ? std::string{} : std::string{ path.substr(0, slash + 1) };
+            }
+
+            void load_mtl(const std::string& path, std::vector<ObjMaterial>& materials, const std::unordered_map<std::string_view, uint32_t>& ids) {
+                const MappedFile file{ path.c_str() };
+                if (!file.is_open()) {
+                    return;
+                }
+
+                ObjMaterial* current{ nullptr };
+                const char* p{ file.data() };
+                const char* end{ p + file.size() };
+                while (p < end) {
+                    const char* line_end{ static_cast<const char*>(std::memchr(p, '\n', static_cast<std::size_t>(end - p))) };
+                    if (!line_end) {
+                        line_end = end;
+                    }
+
+                    p = skip_spaces(p, line_end);
+                    if (starts_with_word(p, line_end, "newmtl")) {
+                        auto it{ ids.find(trimmed(p + 6, line_end)) };
+                        // materials no face uses are skipped
+                        current = it != ids.end() ? &materials[it->second] : nullptr;
+                    }
+                    else if (current && starts_with_word(p, line_end, "Kd")) {
+                        const char* q{ p + 2 };
+                        for (int c = 0; c < 3 && q; ++c) {
+                            q = parse_float(q, line_end, current->diffuse[c]);
+                        }
+                    }
+                    else if (current && starts_with_word(p, line_end, "map_Kd")) {
+                        // options may come first, the file name is the last word
+                        const std::string_view rest{ trimmed(p + 6, line_end) };
+                        const std::size_t space{ rest.find_last_of(" \t") };
+                        current->diffuse_map = std::string{ space == std::string_view::npos ? rest : rest.substr(space + 1) };
+                    }
+
+                    p = line_end + 1;
+                }
+            }
+
+            double elapsed_ms(std::chrono::steady_clock::time_point since) {
+                return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+            }
+        }
+
+        bool load_obj(const char* path, ObjModel& model, ThreadPool& pool, ObjLoadStats* stats) {
+            const auto start{ std::chrono::steady_clock::now() };
+            const MappedFile file{ path };
+            if (!file.is_open()) {
+                return false;
+            }
+
+            // line aligned chunks
+            const std::size_t max_chunks{ static_cast<std::size_t>(pool.size() + 1) * chunks_per_thread };
+            const std::size_t chunk_count{ std::clamp<std::size_t>(file.size() / min_chunk_bytes, 1, max_chunks) };
+            std::vector<Chunk> chunks(chunk_count);
+            const char* const file_end{ file.data() + file.size() };
+            const char* chunk_begin{ file.data() };
+            for (std::size_t c = 0; c < chunk_count; ++c) {
+                const char* chunk_end{ file_end };
+                if (c + 1 < chunk_count) {
+                    chunk_end = std::max(chunk_begin, file.data() + file.size() * (c + 1) / chunk_count);
+                    const void* newline{ chunk_end < file_end ? std::memchr(chunk_end, '\n', static_cast<std::size_t>(file_end - chunk_end)) : nullptr };
+                    chunk_end = newline ? static_cast<const char*>(newline) + 1 : file_end;
+                }
+                chunks[c].begin = chunk_begin;
+                chunks[c].end = chunk_end;
+                chunk_begin = chunk_end;
+            }
+
+            pool.parallel_for(static_cast<uint32_t>(chunk_count), [&chunks](uint32_t c) {
+                parse_chunk(chunks[c]);
+            });
+            const double parse_ms{ elapsed_ms(start) };
+            const auto merge_start{ std::chrono::steady_clock::now() };
+
+            // absolute indices: counts of the chunks before, material ids in order of first use
+            model = ObjModel{};
+            model.materials.push_back({});
+            std::unordered_map<std::string_view, uint32_t> material_ids{ { std::string_view{}, 0u } };
+            std::size_t totals[3]{ 0, 0, 0 };
+            uint32_t current_material{ 0 };
+            for (Chunk& chunk : chunks) {
+                chunk.bases[0] = totals[0];
+                chunk.bases[1] = totals[1];
+                chunk.bases[2] = totals[2];
+                totals[0] += chunk.positions.size() / 3;
+                totals[1] += chunk.texcoords.size() / 2;
+                totals[2] += chunk.normals.size() / 3;
+
+                chunk.start_material = current_material;
+                for (MaterialRun& run : chunk.material_runs) {
+                    auto [it, inserted]{ material_ids.try_emplace(run.name, static_cast<uint32_t>(model.materials.size())) };
+                    if (inserted) {
+                        model.materials.push_back({ .name = std::string{ run.name }, .diffuse_map = {} });
+                    }
+                    run.material = it->second;
+                    current_material = run.material;
+                }
+            }
+
+            // corners -> chunk local vertices
+            pool.parallel_for(static_cast<uint32_t>(chunk_count), [&chunks, &totals](uint32_t c) {
+                Chunk& chunk{ chunks[c] };
+                KeyTable table{ chunk.corners.size() / 4 };
+                chunk.corner_vertices.assign(chunk.corners.size(), invalid_vertex);
+                chunk.material_starts.push_back({ chunk.start_material, 0 });
+
+                std::size_t run{ 0 };
+                for (std::size_t t = 0; t < chunk.corners.size(); t += 3) {
+                    while (run < chunk.material_runs.size() && chunk.material_runs[run].first_corner <= t) {
+                        chunk.material_starts.push_back({ chunk.material_runs[run].material, chunk.valid_corners });
+                        ++run;
+                    }
+
+                    VertexKey keys[3];
+                    bool valid{ true };
+                    for (int k = 0; k < 3 && valid; ++k) {
+                        const Corner& corner{ chunk.corners[t + k] };
+                        uint32_t resolved[3];
+                        for (int i = 0; i < 3; ++i) {
+                            int64_t index{ corner.index[i] };
+                            if (index == missing_index) {
+                                resolved[i] = invalid_vertex;
+                                // a position is required
+                                valid = valid && i != 0;
+                                continue;
+                            }
+                            if (corner.relative & (1 << i)) {
+                                index += static_cast<int64_t>(chunk.bases[i]);
+                            }
+                            if (index < 0 || static_cast<std::size_t>(index) >= totals[i]) {
+                                valid = false;
+                                break;
+                            }
+                            resolved[i] = static_cast<uint32_t>(index);
+                        }
+                        keys[k] = { resolved[0], resolved[1], resolved[2], chunk.material_starts.back().first };
+                    }
+                    if (!valid) {
+                        continue;
+                    }
+
+                    for (int k = 0; k < 3; ++k) {
+                        chunk.corner_vertices[t + k] = table.insert(keys[k], chunk.unique_keys);
+                    }
+                    chunk.valid_corners += 3;
+                }
+            });
+
+            // chunk local -> global vertices, chunks in order so vertices keep file order
+            std::vector<VertexKey> vertex_keys;
+            {
+                std::size_t local_vertices{ 0 };
+                for (const Chunk& chunk : chunks) {
+                    local_vertices += chunk.unique_keys.size();
+                }
+                KeyTable table{ local_vertices };
+                vertex_keys.reserve(local_vertices);
+
+                std::size_t index_count{ 0 };
+                for (Chunk& chunk : chunks) {
+                    chunk.remap.resize(chunk.unique_keys.size());
+                    for (std::size_t k = 0; k < chunk.unique_keys.size(); ++k) {
+                        chunk.remap[k] = table.insert(chunk.unique_keys[k], vertex_keys);
+                    }
+                    chunk.first_index = index_count;
+                    index_count += chunk.valid_corners;
+                }
+                model.mesh.indices.resize(index_count);
+            }
+
+            pool.parallel_for(static_cast<uint32_t>(chunk_count), [&chunks, &model](uint32_t c) {
+                const Chunk& chunk{ chunks[c] };
+                uint32_t* out{ model.mesh.indices.data() + chunk.first_index };
+                for (uint32_t local : chunk.corner_vertices) {
+                    if (local != invalid_vertex) {
+                        *out++ = chunk.remap[local];
+                    }
+                }
+            });
+
+            // material runs -> groups, empty runs vanish and equal neighbours merge
+            for (const Chunk& chunk : chunks) {
+                for (std::size_t s = 0; s < chunk.material_starts.size(); ++s) {
+                    const auto [material, first]{ chunk.material_starts[s] };
+                    const std::size_t last{ s + 1 < chunk.material_starts.size() ? chunk.material_starts[s + 1].second : chunk.valid_corners };
+                    if (last == first) {
+                        continue;
+                    }
+                    if (!model.groups.empty() && model.groups.back().material == material) {
+                        model.groups.back().index_count += last - first;
+                    }
+                    else {
+                        model.groups.push_back({ material, sizeof(uint32_t) * (chunk.first_index + first), last - first });
+                    }
+                }
+            }
+
+            // every mtllib once, relative to the obj
+            const std::string directory{ directory_of(path) };
+            std::vector<std::string_view> mtllibs;
+            for (const Chunk& chunk : chunks) {
+                for (std::string_view mtllib : chunk.mtllibs) {
+                    if (std::find(mtllibs.begin(), mtllibs.end(), mtllib) == mtllibs.end()) {
+                        mtllibs.push_back(mtllib);
+                        load_mtl(directory + std::string{ mtllib }, model.materials, material_ids);
+                    }
+                }
+            }
+
+            // planar blocks, attributes gathered straight from the chunk that parsed them
+            const std::size_t vertex_count{ vertex_keys.size() };
+            model.mesh.vertices.assign(vertex_count * 11, 0.0f);
+            float* positions{ model.mesh.vertices.data() };
+            float* texcoords{ positions + vertex_count * 3 };
+            float* colors{ texcoords + vertex_count * 2 };
+            float* normals{ colors + vertex_count * 3 };
+
+            auto locate{ [&chunks](int kind, uint32_t index, const float*& src, int width) {
+                auto it{ std::upper_bound(chunks.begin(), chunks.end(), index, [kind](uint32_t value, const Chunk& chunk) {
+                    return value < chunk.bases[kind];
+                }) };
+                // chunks without any element of this kind share the next one's base and are stepped over
+                const Chunk& chunk{ *std::prev(it) };
+                const std::vector<float>& data{ kind == 0 ? chunk.positions : kind == 1 ? chunk.texcoords : chunk.normals };
+                src = data.data() + (index - chunk.bases[kind]) * width;
+            } };
+
+            bool missing_normals{ false };
+            constexpr uint32_t vertices_per_job{ 1 << 16 };
+            pool.parallel_for(static_cast<uint32_t>((vertex_count + vertices_per_job - 1) / vertices_per_job), [&](uint32_t job) {
+                const std::size_t first{ static_cast<std::size_t>(job) * vertices_per_job };
+                const std::size_t last{ std::min(first + vertices_per_job, vertex_count) };
+                for (std::size_t v = first; v < last; ++v) {
+                    const VertexKey& key{ vertex_keys[v] };
+                    const float* src;
+                    locate(0, key.v, src, 3);
+                    std::copy_n(src, 3, positions + v * 3);
+                    if (key.vt != invalid_vertex) {
+                        locate(1, key.vt, src, 2);
+                        std::copy_n(src, 2, texcoords + v * 2);
+                    }
+                    std::copy_n(model.materials[key.material].diffuse, 3, colors + v * 3);
+                    if (key.vn != invalid_vertex) {
+                        locate(2, key.vn, src, 3);
+                        std::copy_n(src, 3, normals + v * 3);
+                    }
+                }
+            });
+            for (const VertexKey& key : vertex_keys) {
+                if (key.vn == invalid_vertex) {
+                    missing_normals = true;
+                    break;
+                }
+            }
+
+            // area weighted face normals for vertices the file gave none
+            if (missing_normals) {
+                const std::vector<uint32_t>& indices{ model.mesh.indices };
+                for (std::size_t i = 0; i + 2 < indices.size(); i += 3) {
+                    const float* a{ positions + indices[i] * 3 };
+                    const float* b{ positions + indices[i + 1] * 3 };
+                    const float* c{ positions + indices[i + 2] * 3 };
+                    const float e0[3]{ b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                    const float e1[3]{ c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+                    const float n[3]{ e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0] };
+                    for (int k = 0; k < 3; ++k) {
+                        const uint32_t vertex{ indices[i + k] };
+                        if (vertex_keys[vertex].vn == invalid_vertex) {
+                            normals[vertex * 3] += n[0];
+                            normals[vertex * 3 + 1] += n[1];
+                            normals[vertex * 3 + 2] += n[2];
+                        }
+                    }
+                }
+                for (std::size_t v = 0; v < vertex_count; ++v) {
+                    if (vertex_keys[v].vn != invalid_vertex) {
+                        continue;
+                    }
+                    float* n{ normals + v * 3 };
+                    const float length{ std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) };
+                    for (int c = 0; length > 0.0f && c < 3; ++c) {
+                        n[c] /= length;
+                    }
+                }
+            }
+
+            if (stats) {
+                std::size_t corners{ 0 };
+                for (const Chunk& chunk : chunks) {
+                    corners += chunk.corners.size();
+                }
+                const double total_ms{ elapsed_ms(start) };
+                *stats = {
+                    .file_bytes = file.size(),
+                    .chunks = static_cast<uint32_t>(chunk_count),
+                    .corners = corners,
+                    .vertices = vertex_count,
+                    .parse_ms = parse_ms,
+                    .merge_ms = elapsed_ms(merge_start),
+                    .mb_per_s = total_ms > 0.0 ? file.size() / (total_ms * 1000.0) : 0.0,
+                };
+            }
+
+            return true;
+        }
+    }
+}
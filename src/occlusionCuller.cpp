@@ -0,0 +1,347 @@
+#include <algorithm>
+#include <cmath>
+#include "occlusionCuller.hpp"
+#include "threadPool.hpp"
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace my_gl {
+    namespace {
+        // vertices closer than this to the eye plane make a triangle/box unusable for projection
+        constexpr float min_clip_w{ 1e-4f };
+
+        void transform_point(const math::Matrix44<float>& m, const float* p, float* out) {
+            for (int r = 0; r < 4; ++r) {
+                out[r] = m.at(r, 0) * p[0] + m.at(r, 1) * p[1] + m.at(r, 2) * p[2] + m.at(r, 3);
+            }
+        }
+    }
+
+    OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height, ThreadPool* pool)
+        : _pool{ pool }
+        , _width{ (std::max(width, 1u) + tile_size * bin_cols - 1) / (tile_size * bin_cols) * (tile_size * bin_cols) }
+        , _height{ (std::max(height, 1u) + tile_size * bin_rows - 1) / (tile_size * bin_rows) * (tile_size * bin_rows) }
+        , _tiles_x{ _width / tile_size }
+        , _tiles_y{ _height / tile_size }
+        , _depth(_width * _height, 1.0f)
+        , _tile_max_depth(_tiles_x * _tiles_y, 1.0f)
+        , _bins(bin_cols * bin_rows)
+    {}
+
+    void OcclusionCuller::begin_frame(const math::Matrix44<float>& view_proj) {
+        _view_proj = view_proj;
+        _occluders.clear();
+        _triangles.clear();
+        for (auto& bin : _bins) {
+            bin.clear();
+        }
+        _stats = Stats{};
+    }
+
+    void OcclusionCuller::add_occluder(
+        const math::Matrix44<float>&    model_mat,
+        const float*                    positions,
+        const uint32_t*                 indices,
+        uint32_t                        index_count
+    )
+    {
+        _occluders.push_back(Occluder{
+            .model_mat = model_mat,
+            .positions = positions,
+            .indices = indices,
+            .index_count = index_count
+        });
+    }
+
+    void OcclusionCuller::setup_triangles(const Occluder& occluder, std::vector<Triangle>& out) const {
+        const math::Matrix44<float> mvp{ _view_proj * occluder.model_mat };
+
+        for (uint32_t i = 0; i + 2 < occluder.index_count; i += 3) {
+            float clip[3][4];
+            bool  behind{ false };
+
+            for (int v = 0; v < 3; ++v) {
+                transform_point(mvp, occluder.positions + occluder.indices[i + v] * 3, clip[v]);
+                behind |= clip[v][3] < min_clip_w;
+            }
+
+            // not drawing an occluder is always safe, so near plane crossings are dropped instead of clipped
+            if (behind) {
+                continue;
+            }
+
+            Triangle tri;
+            float z[3];
+            for (int v = 0; v < 3; ++v) {
+                const float inv_w{ 1.0f / clip[v][3] };
+                tri.x[v] = (clip[v][0] * inv_w * 0.5f + 0.5f) * _width;
+                tri.y[v] = (clip[v][1] * inv_w * 0.5f + 0.5f) * _height;
+                z[v] = clip[v][2] * inv_w * 0.5f + 0.5f;
+            }
+
+            float area{ (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]) };
+            if (std::abs(area) < 1e-8f) {
+                continue;
+            }
+            // both windings are drawn, the nearer surface wins anyway
+            if (area < 0.0f) {
+                std::swap(tri.x[1], tri.x[2]);
+                std::swap(tri.y[1], tri.y[2]);
+                std::swap(z[1], z[2]);
+                area = -area;
+            }
+
+            const float inv_area{ 1.0f / area };
+            tri.z_a = ((z[1] - z[0]) * (tri.y[2] - tri.y[0]) - (z[2] - z[0]) * (tri.y[1] - tri.y[0])) * inv_area;
+            tri.z_b = ((z[2] - z[0]) * (tri.x[1] - tri.x[0]) - (z[1] - z[0]) * (tri.x[2] - tri.x[0])) * inv_area;
+            tri.z_c = z[0] - tri.z_a * tri.x[0] - tri.z_b * tri.y[0];
+
+            tri.min_x = std::max(0, static_cast<int32_t>(std::floor(std::min({ tri.x[0], tri.x[1], tri.x[2] }))));
+            tri.min_y = std::max(0, static_cast<int32_t>(std::floor(std::min({ tri.y[0], tri.y[1], tri.y[2] }))));
+            tri.max_x = std::min(static_cast<int32_t>(_width) - 1, static_cast<int32_t>(std::ceil(std::max({ tri.x[0], tri.x[1], tri.x[2] }))));
+            tri.max_y = std::min(static_cast<int32_t>(_height) - 1, static_cast<int32_t>(std::ceil(std::max({ tri.y[0], tri.y[1], tri.y[2] }))));
+
+            if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) {
+                continue;
+            }
+
+            out.push_back(tri);
+        }
+    }
+
+    void OcclusionCuller::rasterize() {
+        _stats.occluders = static_cast<uint32_t>(_occluders.size());
+
+        // transform & set up in parallel, one output list per occluder
+        std::vector<std::vector<Triangle>> per_occluder(_occluders.size());
+        auto setup{ [&](uint32_t i) { setup_triangles(_occluders[i], per_occluder[i]); } };
+        if (_pool) {
+            _pool->parallel_for(static_cast<uint32_t>(_occluders.size()), setup);
+        }
+        else {
+            for (uint32_t i = 0; i < _occluders.size(); ++i) {
+                setup(i);
+            }
+        }
+
+        for (const auto& triangles : per_occluder) {
+            _triangles.insert(_triangles.end(), triangles.begin(), triangles.end());
+        }
+        _stats.triangles_rasterized = static_cast<uint32_t>(_triangles.size());
+
+        // bin by bounding rectangle
+        for (uint32_t t = 0; t < _triangles.size(); ++t) {
+            const Triangle& tri{ _triangles[t] };
+            const uint32_t bin_x0{ tri.min_x / tile_size * bin_cols / _tiles_x };
+            const uint32_t bin_x1{ tri.max_x / tile_size * bin_cols / _tiles_x };
+            const uint32_t bin_y0{ tri.min_y / tile_size * bin_rows / _tiles_y };
+            const uint32_t bin_y1{ tri.max_y / tile_size * bin_rows / _tiles_y };
+
+            for (uint32_t by = bin_y0; by <= bin_y1; ++by) {
+                for (uint32_t bx = bin_x0; bx <= bin_x1; ++bx) {
+                    _bins[by * bin_cols + bx].push_back(t);
+                }
+            }
+        }
+
+        // bins cover disjoint pixels, so every bin can be rasterized independently
+        auto raster{ [this](uint32_t bin) { rasterize_bin(bin); } };
+        if (_pool) {
+            _pool->parallel_for(bin_cols * bin_rows, raster);
+        }
+        else {
+            for (uint32_t bin = 0; bin < bin_cols * bin_rows; ++bin) {
+                raster(bin);
+            }
+        }
+    }
+
+    void OcclusionCuller::rasterize_bin(uint32_t bin) {
+        const uint32_t bx{ bin % bin_cols };
+        const uint32_t by{ bin / bin_cols };
+
+        // bin edges fall on tile edges, i.e. on multiples of 4 pixels for the SIMD loop
+        const uint32_t tile_x0{ _tiles_x * bx / bin_cols };
+        const uint32_t tile_x1{ _tiles_x * (bx + 1) / bin_cols };
+        const uint32_t tile_y0{ _tiles_y * by / bin_rows };
+        const uint32_t tile_y1{ _tiles_y * (by + 1) / bin_rows };
+
+        const int32_t clip_min_x{ static_cast<int32_t>(tile_x0 * tile_size) };
+        const int32_t clip_max_x{ static_cast<int32_t>(tile_x1 * tile_size) - 1 };
+        const int32_t clip_min_y{ static_cast<int32_t>(tile_y0 * tile_size) };
+        const int32_t clip_max_y{ static_cast<int32_t>(tile_y1 * tile_size) - 1 };
+
+        for (int32_t y = clip_min_y; y <= clip_max_y; ++y) {
+            std::fill(_depth.begin() + y * _width + clip_min_x, _depth.begin() + y * _width + clip_max_x + 1, 1.0f);
+        }
+
+        for (uint32_t t : _bins[bin]) {
+            rasterize_triangle(_triangles[t], clip_min_x, clip_min_y, clip_max_x, clip_max_y);
+        }
+
+        for (uint32_t ty = tile_y0; ty < tile_y1; ++ty) {
+            for (uint32_t tx = tile_x0; tx < tile_x1; ++tx) {
+                float max_depth{ 0.0f };
+                for (uint32_t y = ty * tile_size; y < (ty + 1) * tile_size; ++y) {
+                    const float* row{ &_depth[y * _width + tx * tile_size] };
+                    max_depth = std::max(max_depth, *std::max_element(row, row + tile_size));
+                }
+                _tile_max_depth[ty * _tiles_x + tx] = max_depth;
+            }
+        }
+    }
+
+    void OcclusionCuller::rasterize_triangle(
+        const Triangle& tri,
+        int32_t         clip_min_x,
+        int32_t         clip_min_y,
+        int32_t         clip_max_x,
+        int32_t         clip_max_y
+    )
+    {
+        const int32_t min_x{ std::max(tri.min_x, clip_min_x) };
+        const int32_t max_x{ std::min(tri.max_x, clip_max_x) };
+        const int32_t min_y{ std::max(tri.min_y, clip_min_y) };
+        const int32_t max_y{ std::min(tri.max_y, clip_max_y) };
+        if (min_x > max_x || min_y > max_y) {
+            return;
+        }
+
+        // edge i goes from vertex i to vertex i + 1, e(x, y) = a * x + b * y + c >= 0 inside
+        float edge_a[3];
+        float edge_b[3];
+        float edge_c[3];
+        for (int e = 0; e < 3; ++e) {
+            const int next{ (e + 1) % 3 };
+            edge_a[e] = tri.y[e] - tri.y[next];
+            edge_b[e] = tri.x[next] - tri.x[e];
+            edge_c[e] = (tri.y[next] - tri.y[e]) * tri.x[e] - (tri.x[next] - tri.x[e]) * tri.y[e];
+        }
+
+        const int32_t start_x{ min_x & ~3 };
+
+#if defined(__SSE2__)
+        const __m128 lane_offsets{ _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f) };
+        const __m128 min_px{ _mm_set1_ps(static_cast<float>(min_x)) };
+        const __m128 max_px{ _mm_set1_ps(static_cast<float>(max_x) + 1.0f) };
+        const __m128 zero{ _mm_setzero_ps() };
+
+        for (int32_t y = min_y; y <= max_y; ++y) {
+            const float py{ static_cast<float>(y) + 0.5f };
+            float* row{ &_depth[y * _width] };
+
+            const __m128 e0_row{ _mm_set1_ps(edge_b[0] * py + edge_c[0]) };
+            const __m128 e1_row{ _mm_set1_ps(edge_b[1] * py + edge_c[1]) };
+            const __m128 e2_row{ _mm_set1_ps(edge_b[2] * py + edge_c[2]) };
+            const __m128 z_row{ _mm_set1_ps(tri.z_b * py + tri.z_c) };
+
+            for (int32_t x = start_x; x <= max_x; x += 4) {
+                const __m128 px{ _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lane_offsets) };
+
+                __m128 inside{ _mm_and_ps(_mm_cmpgt_ps(px, min_px), _mm_cmplt_ps(px, max_px)) };
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edge_a[0])), e0_row), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edge_a[1])), e1_row), zero));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(edge_a[2])), e2_row), zero));
+                if (_mm_movemask_ps(inside) == 0) {
+                    continue;
+                }
+
+                const __m128 z{ _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(tri.z_a)), z_row) };
+                const __m128 old_depth{ _mm_loadu_ps(row + x) };
+                const __m128 new_depth{ _mm_min_ps(old_depth, z) };
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, new_depth), _mm_andnot_ps(inside, old_depth)));
+            }
+        }
+#else
+        for (int32_t y = min_y; y <= max_y; ++y) {
+            const float py{ static_cast<float>(y) + 0.5f };
+            float* row{ &_depth[y * _width] };
+
+            for (int32_t x = start_x; x <= max_x; ++x) {
+                const float px{ static_cast<float>(x) + 0.5f };
+                if (x < min_x
+                    || edge_a[0] * px + edge_b[0] * py + edge_c[0] < 0.0f
+                    || edge_a[1] * px + edge_b[1] * py + edge_c[1] < 0.0f
+                    || edge_a[2] * px + edge_b[2] * py + edge_c[2] < 0.0f)
+                {
+                    continue;
+                }
+                row[x] = std::min(row[x], tri.z_a * px + tri.z_b * py + tri.z_c);
+            }
+        }
+#endif
+    }
+
+    bool OcclusionCuller::is_visible(const math::Aabb& world_bounds) {
+        ++_stats.objects_tested;
+
+        if (_triangles.empty() || world_bounds.is_empty()) {
+            return true;
+        }
+
+        float min_sx{ static_cast<float>(_width) };
+        float min_sy{ static_cast<float>(_height) };
+        float max_sx{ 0.0f };
+        float max_sy{ 0.0f };
+        float min_depth{ 1.0f };
+
+        for (int corner = 0; corner < 8; ++corner) {
+            const float p[3]{
+                (corner & 1) ? world_bounds.max[0] : world_bounds.min[0],
+                (corner & 2) ? world_bounds.max[1] : world_bounds.min[1],
+                (corner & 4) ? world_bounds.max[2] : world_bounds.min[2],
+            };
+            float clip[4];
+            transform_point(_view_proj, p, clip);
+
+            // box reaches behind the eye, projected rectangle is unbounded
+            if (clip[3] < min_clip_w) {
+                return true;
+            }
+
+            const float inv_w{ 1.0f / clip[3] };
+            const float sx{ (clip[0] * inv_w * 0.5f + 0.5f) * _width };
+            const float sy{ (clip[1] * inv_w * 0.5f + 0.5f) * _height };
+            min_sx = std::min(min_sx, sx);
+            max_sx = std::max(max_sx, sx);
+            min_sy = std::min(min_sy, sy);
+            max_sy = std::max(max_sy, sy);
+            min_depth = std::min(min_depth, clip[2] * inv_w * 0.5f + 0.5f);
+        }
+
+        const int32_t x0{ std::max(0, static_cast<int32_t>(std::floor(min_sx))) };
+        const int32_t y0{ std::max(0, static_cast<int32_t>(std::floor(min_sy))) };
+        const int32_t x1{ std::min(static_cast<int32_t>(_width) - 1, static_cast<int32_t>(std::ceil(max_sx))) };
+        const int32_t y1{ std::min(static_cast<int32_t>(_height) - 1, static_cast<int32_t>(std::ceil(max_sy))) };
+
+        if (x0 > x1 || y0 > y1 || min_depth <= 0.0f) {
+            return true;
+        }
+
+        for (int32_t ty = y0 / static_cast<int32_t>(tile_size); ty <= y1 / static_cast<int32_t>(tile_size); ++ty) {
+            for (int32_t tx = x0 / static_cast<int32_t>(tile_size); tx <= x1 / static_cast<int32_t>(tile_size); ++tx) {
+                // whole tile is nearer than the object
+                if (_tile_max_depth[ty * _tiles_x + tx] < min_depth) {
+                    continue;
+                }
+
+                const int32_t px0{ std::max(x0, tx * static_cast<int32_t>(tile_size)) };
+                const int32_t px1{ std::min(x1, (tx + 1) * static_cast<int32_t>(tile_size) - 1) };
+                const int32_t py0{ std::max(y0, ty * static_cast<int32_t>(tile_size)) };
+                const int32_t py1{ std::min(y1, (ty + 1) * static_cast<int32_t>(tile_size) - 1) };
+
+                for (int32_t y = py0; y <= py1; ++y) {
+                    for (int32_t x = px0; x <= px1; ++x) {
+                        if (_depth[y * _width + x] >= min_depth) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        ++_stats.objects_occluded;
+        return false;
+    }
+}
@@ -0,0 +1,190 @@
+#include "occlusionQueries.hpp"
+#include "geometryObject.hpp"
+#include "meshes.hpp"
+#include "renderer.hpp"
+
+namespace my_gl {
+    // QueryPool
+    QueryPool::~QueryPool() {
+        if (!_all.empty()) {
+            glDeleteQueries(static_cast<GLsizei>(_all.size()), _all.data());
+        }
+    }
+
+    GLuint QueryPool::acquire() {
+        if (_free.empty()) {
+            // grow in batches, query objects are cheap but glGen* calls are not free
+            constexpr GLsizei batch_size{ 32 };
+            GLuint ids[batch_size];
+            glGenQueries(batch_size, ids);
+            _all.insert(_all.end(), ids, ids + batch_size);
+            _free.insert(_free.end(), ids, ids + batch_size);
+        }
+
+        GLuint query{ _free.back() };
+        _free.pop_back();
+        return query;
+    }
+
+    void QueryPool::release(GLuint query) {
+        _free.push_back(query);
+    }
+
+    // OcclusionQueries
+    OcclusionQueries::OcclusionQueries()
+        : _bounds_program{
+            "shaders/vertShaderLight.glsl",
+            "shaders/fragShaderLight.glsl",
+            {
+                { .name = "a_pos", .gl_type = GL_FLOAT, .count = 3, .byte_stride = 0, .byte_offset = 0 },
+            },
+            {
+                { .name = "u_mvp_mat" },
+            }
+        }
+        , _bounds_vao{ meshes::cube_mesh, _bounds_program }
+        // the conservative variant may answer from coarse depth, which is all we need
+        , _query_target{ static_cast<GLenum>((GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility) ? GL_ANY_SAMPLES_PASSED_CONSERVATIVE : GL_ANY_SAMPLES_PASSED) }
+    {}
+
+    void OcclusionQueries::begin_frame(const math::Matrix44<float>& view_proj_mat) {
+        _view_proj_mat = view_proj_mat;
+        _deferred.clear();
+        _stats = Stats{};
+        ++_frame;
+    }
+
+    void OcclusionQueries::release_query(Entry& entry) {
+        if (entry.query != 0) {
+            _pool.release(entry.query);
+            entry.query = 0;
+        }
+    }
+
+    bool OcclusionQueries::reaches_near_plane(const math::Aabb& box) const {
+        for (int corner = 0; corner < 8; ++corner) {
+            const float p[3]{
+                (corner & 1) ? box.max[0] : box.min[0],
+                (corner & 2) ? box.max[1] : box.min[1],
+                (corner & 4) ? box.max[2] : box.min[2],
+            };
+            const float clip_z{ _view_proj_mat.at(2, 0) * p[0] + _view_proj_mat.at(2, 1) * p[1] + _view_proj_mat.at(2, 2) * p[2] + _view_proj_mat.at(2, 3) };
+            const float clip_w{ _view_proj_mat.at(3, 0) * p[0] + _view_proj_mat.at(3, 1) * p[1] + _view_proj_mat.at(3, 2) * p[2] + _view_proj_mat.at(3, 3) };
+            if (clip_w <= 0.0f || clip_z < -clip_w) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void OcclusionQueries::render(
+        GeometryObjectPrimitive&        primitive,
+        uint32_t                        id,
+        const math::Matrix44<float>&    view_mat,
+        const math::Matrix44<float>&    view_proj_mat,
+        float                           time_0to1
+    )
+    {
+        if (id >= _entries.size()) {
+            _entries.resize(id + 1);
+        }
+
+        Entry& entry{ _entries[id] };
+        ++_stats.tracked;
+
+        // results from before the object left the view say nothing about now
+        const bool seen_last_frame{ entry.last_frame + 1 == _frame };
+        entry.last_frame = _frame;
+        if (!seen_last_frame) {
+            release_query(entry);
+            entry.visible = true;
+        }
+
+        // the proxy box would be clipped away with the camera inside it
+        if (reaches_near_plane(primitive.get_world_bounds())) {
+            release_query(entry);
+            entry.visible = true;
+            primitive.render(view_mat, view_proj_mat, time_0to1);
+            return;
+        }
+
+        if (entry.query != 0) {
+            GLuint available{ GL_FALSE };
+            glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+            if (available) {
+                GLuint samples_passed{ 0 };
+                glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &samples_passed);
+                entry.visible = samples_passed != 0;
+                release_query(entry);
+            }
+            else if (!entry.visible) {
+                // result still in flight, let the gpu decide without stalling us
+                glBeginConditionalRender(entry.query, GL_QUERY_NO_WAIT);
+                primitive.render(view_mat, view_proj_mat, time_0to1);
+                glEndConditionalRender();
+                ++_stats.conditional_draws;
+                return;
+            }
+            else {
+                primitive.render(view_mat, view_proj_mat, time_0to1);
+                return;
+            }
+        }
+
+        if (entry.visible) {
+            entry.query = _pool.acquire();
+            glBeginQuery(_query_target, entry.query);
+            primitive.render(view_mat, view_proj_mat, time_0to1);
+            glEndQuery(_query_target);
+            ++_stats.queries_issued;
+        }
+        else {
+            _deferred.emplace_back(id, primitive.get_world_bounds());
+            ++_stats.draws_skipped;
+        }
+    }
+
+    void OcclusionQueries::end_frame() {
+        if (_deferred.empty()) {
+            return;
+        }
+
+        // proxies only test depth, they must not leave anything behind
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+
+        _bounds_program.use();
+        _bounds_vao.bind();
+        const Uniform* mvp_unif{ _bounds_program.get_uniform("u_mvp_mat") };
+
+        for (const auto& [id, box] : _deferred) {
+            // unit cube of the mesh is centered at the origin
+            auto model_mat{ math::Matrix44<float>::identity_new() };
+            for (int axis = 0; axis < 3; ++axis) {
+                model_mat.at(axis, axis) = box.extent(axis);
+                model_mat.at(axis, 3) = box.center(axis);
+            }
+            const math::Matrix44<float> mvp_mat{ _view_proj_mat * model_mat };
+
+            if (mvp_unif) {
+                glUniformMatrix4fv(mvp_unif->location, 1, true, mvp_mat.data());
+            }
+
+            Entry& entry{ _entries[id] };
+            entry.query = _pool.acquire();
+            glBeginQuery(_query_target, entry.query);
+            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(_bounds_vao.get_ibo_size()), _bounds_vao.get_index_type(), nullptr);
+            glEndQuery(_query_target);
+            ++_stats.queries_issued;
+        }
+
+        _bounds_vao.un_bind();
+        _bounds_program.un_use();
+
+        glEnable(GL_CULL_FACE);
+        glDepthMask(GL_TRUE);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+}
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <limits>
+#include "parametricMeshes.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            // below this many vertices waking the workers costs more than the rows
+            constexpr std::size_t parallel_vertex_count{ 16384 };
+        }
+
+        constexpr ParametricStaticMesh<sphere_mesh_shape>      sphere_mesh{ make_static_mesh<sphere_mesh_shape>() };
+        constexpr ParametricStaticMesh<cylinder_mesh_shape>    cylinder_mesh{ make_static_mesh<cylinder_mesh_shape>() };
+        constexpr ParametricStaticMesh<torus_mesh_shape>       torus_mesh{ make_static_mesh<torus_mesh_shape>() };
+        constexpr ParametricStaticMesh<plane_mesh_shape>       plane_mesh{ make_static_mesh<plane_mesh_shape>() };
+
+        Mesh make_mesh(const ParametricMesh& shape, ThreadPool& pool) {
+            if (shape.segments_u == 0 || shape.segments_v == 0) {
+                std::cerr << "parametric mesh needs at least one segment each way\n";
+                return {};
+            }
+            // the patch offsets are 32 bit, check the counts before computing them
+            const uint64_t grid_vertices{ (static_cast<uint64_t>(shape.segments_u) + 1) * (static_cast<uint64_t>(shape.segments_v) + 1) };
+            if (grid_vertices * shape.patch_count() > std::numeric_limits<uint32_t>::max() / 6) {
+                std::cerr << "parametric mesh too large for 32 bit indices, segments: " << shape.segments_u << " x " << shape.segments_v << '\n';
+                return {};
+            }
+
+            Mesh mesh;
+            mesh.vertices.resize(shape.vertex_count() * 11);
+            mesh.indices.resize(shape.index_count());
+
+            const uint32_t rows{ shape.row_count() };
+            if (shape.vertex_count() < parallel_vertex_count) {
+                for (uint32_t row = 0; row < rows; ++row) {
+                    shape.write_row(row, mesh.vertices.data(), mesh.indices.data());
+                }
+            }
+            else {
+                pool.parallel_for(rows, [&shape, &mesh](uint32_t row) {
+                    shape.write_row(row, mesh.vertices.data(), mesh.indices.data());
+                });
+            }
+            return mesh;
+        }
+    }
+}
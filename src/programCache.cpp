@@ -0,0 +1,681 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include "programCache.hpp"
+#include "hash.hpp"
+#include "mappedFile.hpp"
+#include "utils.hpp"
+
+namespace my_gl {
+    namespace {
+        constexpr char program_cache_magic[4]{ 'M', 'G', 'L', 'P' };
+        // bump whenever the header or the key changes
+        constexpr uint32_t program_cache_version{ 1 };
+
+        struct Header {
+            char        magic[4];
+            uint32_t    version;
+            uint64_t    key;
+            uint32_t    binary_format;
+            uint32_t    binary_size;
+        };
+
+        double elapsed_ms(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        bool is_linked(GLuint program) {
+            GLint link_status;
+            glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+            return link_status == GL_TRUE;
+        }
+
+        void print_link_log(GLuint program) {
+            GLint info_log_length;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
+
+            auto info_log{ std::make_unique_for_overwrite<char[]>(info_log_length + 1) };
+            glGetProgramInfoLog(program, info_log_length, nullptr, info_log.get());
+            info_log[info_log_length] = '\0';
+
+            std::cout << "Error when linking a program:\n" << info_log.get() << '\n';
+        }
+
+        bool is_name_char(char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        void skip_spaces(std::string_view text, std::size_t& at) {
+            while (at < text.size() && (text[at] == ' ' || text[at] == '\t' || text[at] == '\r' || text[at] == '\n')) {
+                ++at;
+            }
+        }
+
+        // the identifier starting at 'at', 'at' moved past it
+        std::string_view read_name(std::string_view text, std::size_t& at) {
+            skip_spaces(text, at);
+            const std::size_t start{ at };
+            while (at < text.size() && is_name_char(text[at])) {
+                ++at;
+            }
+            return text.substr(start, at - start);
+        }
+
+        // components of one location of a uniform type copy_uniform_values handles, 0 for the rest
+        // 'is_int' for types read and written as ints: ints, bools and samplers
+        int uniform_components(GLenum type, bool& is_int) {
+            is_int = false;
+            switch (type) {
+            case GL_FLOAT:              return 1;
+            case GL_FLOAT_VEC2:         return 2;
+            case GL_FLOAT_VEC3:         return 3;
+            case GL_FLOAT_VEC4:         return 4;
+            case GL_FLOAT_MAT3:         return 9;
+            case GL_FLOAT_MAT4:         return 16;
+            }
+
+            is_int = true;
+            switch (type) {
+            case GL_INT:
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_3D:
+            case GL_SAMPLER_CUBE:
+            case GL_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_2D_SHADOW:  return 1;
+            case GL_INT_VEC2:
+            case GL_BOOL_VEC2:          return 2;
+            case GL_INT_VEC3:
+            case GL_BOOL_VEC3:          return 3;
+            case GL_INT_VEC4:
+            case GL_BOOL_VEC4:          return 4;
+            }
+            return 0;
+        }
+
+        // name (without a trailing "[0]") to type and array size of the active uniforms of 'program'
+        std::unordered_map<std::string, std::pair<GLenum, GLint>> active_uniforms(GLuint program) {
+            std::unordered_map<std::string, std::pair<GLenum, GLint>> uniforms;
+            GLint count{ 0 };
+            GLint max_length{ 0 };
+            glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+            glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+            std::string name(static_cast<std::size_t>(std::max(max_length, 1)), '\0');
+            for (GLint u = 0; u < count; ++u) {
+                GLsizei length{ 0 };
+                GLint size{ 0 };
+                GLenum type{ 0 };
+                glGetActiveUniform(program, static_cast<GLuint>(u), max_length, &length, &size, &type, name.data());
+                std::string_view active_name{ name.data(), static_cast<std::size_t>(length) };
+                if (active_name.ends_with("[0]")) {
+                    active_name.remove_suffix(3);
+                }
+                uniforms.emplace(std::string{ active_name }, std::pair{ type, size });
+            }
+            return uniforms;
+        }
+    }
+
+    std::string load_shader_source(const char* path, const std::vector<std::string>& defines) {
+        const MappedFile file{ path };
+        if (!file.is_open()) {
+            return {};
+        }
+
+        std::string source{ file.view() };
+        if (defines.empty()) {
+            return source;
+        }
+
+        // #version has to stay the first directive
+        std::size_t insert_at{ 0 };
+        int next_line{ 1 };
+        const std::size_t version{ source.find("#version") };
+        if (version != std::string::npos) {
+            const std::size_t line_end{ source.find('\n', version) };
+            insert_at = line_end == std::string::npos ? source.size() : line_end + 1;
+            next_line = 2 + static_cast<int>(std::count(source.begin(), source.begin() + static_cast<std::ptrdiff_t>(version), '\n'));
+        }
+
+        std::string lines{ insert_at == source.size() && !source.empty() && source.back() != '\n' ? "\n" : "" };
+        for (const std::string& define : defines) {
+            lines += "#define " + define + '\n';
+        }
+        lines += "#line " + std::to_string(next_line) + '\n';
+        source.insert(insert_at, lines);
+        return source;
+    }
+
+    std::vector<std::pair<std::string, GLint>> explicit_attribute_locations(std::string_view vertex_source) {
+        std::vector<std::pair<std::string, GLint>> locations;
+        std::size_t at{ 0 };
+        while ((at = vertex_source.find("layout", at)) != std::string_view::npos) {
+            if (at > 0 && is_name_char(vertex_source[at - 1])) {
+                at += 6;
+                continue;
+            }
+            at += 6;
+            skip_spaces(vertex_source, at);
+            if (at >= vertex_source.size() || vertex_source[at] != '(') {
+                continue;
+            }
+            const std::size_t close{ vertex_source.find(')', at) };
+            if (close == std::string_view::npos) {
+                break;
+            }
+
+            // layout(location = N) in [qualifiers] type name;
+            const std::string_view qualifiers{ vertex_source.substr(at + 1, close - at - 1) };
+            const std::size_t location_at{ qualifiers.find("location") };
+            at = close + 1;
+            if (location_at == std::string_view::npos || read_name(vertex_source, at) != "in") {
+                continue;
+            }
+            const std::size_t equals{ qualifiers.find('=', location_at) };
+            if (equals == std::string_view::npos) {
+                continue;
+            }
+            const GLint location{ std::atoi(std::string{ qualifiers.substr(equals + 1) }.c_str()) };
+
+            std::string_view name;
+            for (std::string_view word{ read_name(vertex_source, at) }; !word.empty(); word = read_name(vertex_source, at)) {
+                name = word;
+            }
+            if (!name.empty()) {
+                locations.emplace_back(std::string{ name }, location);
+            }
+        }
+        return locations;
+    }
+
+    void copy_uniform_values(GLuint from, GLuint to) {
+        const auto from_uniforms{ active_uniforms(from) };
+        for (const auto& [name, type_size] : active_uniforms(to)) {
+            const auto source{ from_uniforms.find(name) };
+            bool is_int;
+            const int components{ uniform_components(type_size.first, is_int) };
+            if (source == from_uniforms.end() || source->second.first != type_size.first || components == 0) {
+                continue;
+            }
+
+            const GLint elements{ std::min(type_size.second, source->second.second) };
+            for (GLint e = 0; e < elements; ++e) {
+                const std::string element{ type_size.second > 1 ? name + '[' + std::to_string(e) + ']' : name };
+                const GLint from_location{ glGetUniformLocation(from, element.c_str()) };
+                const GLint to_location{ glGetUniformLocation(to, element.c_str()) };
+                if (from_location < 0 || to_location < 0) {
+                    continue;
+                }
+
+                if (is_int) {
+                    GLint value[4];
+                    glGetUniformiv(from, from_location, value);
+                    switch (components) {
+                    case 1: glProgramUniform1iv(to, to_location, 1, value); break;
+                    case 2: glProgramUniform2iv(to, to_location, 1, value); break;
+                    case 3: glProgramUniform3iv(to, to_location, 1, value); break;
+                    case 4: glProgramUniform4iv(to, to_location, 1, value); break;
+                    }
+                    continue;
+                }
+
+                GLfloat value[16];
+                glGetUniformfv(from, from_location, value);
+                switch (components) {
+                case 1: glProgramUniform1fv(to, to_location, 1, value); break;
+                case 2: glProgramUniform2fv(to, to_location, 1, value); break;
+                case 3: glProgramUniform3fv(to, to_location, 1, value); break;
+                case 4: glProgramUniform4fv(to, to_location, 1, value); break;
+                case 9: glProgramUniformMatrix3fv(to, to_location, 1, GL_FALSE, value); break;
+                case 16: glProgramUniformMatrix4fv(to, to_location, 1, GL_FALSE, value); break;
+                }
+            }
+        }
+    }
+
+    // the thread build_async hands its builds to without the parallel compile extension, on a context of its own
+    struct ProgramCache::Worker {
+        struct Job {
+            GLuint                      program;
+            std::vector<GLenum>         types;
+            std::vector<std::string>    sources;
+            std::vector<std::string>    paths;
+            bool                        retrievable;
+        };
+
+        std::thread                             thread;
+        std::mutex                              mutex;
+        std::condition_variable                 wake;
+        std::deque<Job>                         jobs;
+        // fences of finished jobs, signaled once the linked program is visible to every context
+        std::unordered_map<GLuint, GLsync>      done;
+        bool                                    stop{ false };
+        // run by stop_worker once the thread joined
+        std::function<void()>                   destroy_context;
+
+        void run(const std::function<void()>& make_context_current, const std::function<void()>& release_context) {
+            make_context_current();
+            for (;;) {
+                Job job;
+                {
+                    std::unique_lock lock{ mutex };
+                    wake.wait(lock, [this] { return stop || !jobs.empty(); });
+                    if (jobs.empty()) {
+                        // done[] fences may not have been waited on, everything is complete for whoever reads it next
+                        glFinish();
+                        if (release_context) {
+                            release_context();
+                        }
+                        return;
+                    }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+
+                std::vector<GLuint> shaders;
+                for (std::size_t s = 0; s < job.types.size(); ++s) {
+                    shaders.push_back(compile_shader(job.types[s], job.sources[s].c_str(), job.paths[s].c_str()));
+                    glAttachShader(job.program, shaders.back());
+                }
+                if (job.retrievable) {
+                    glProgramParameteri(job.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+                }
+                glLinkProgram(job.program);
+                for (const GLuint shader : shaders) {
+                    glDetachShader(job.program, shader);
+                    glDeleteShader(shader);
+                }
+
+                const GLsync fence{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+                glFlush();
+                std::lock_guard lock{ mutex };
+                done[job.program] = fence;
+            }
+        }
+    };
+
+    ProgramCache::ProgramCache(std::string directory)
+        : _directory{ std::move(directory) }
+    {}
+
+    // the contexts may be gone by now, no gl here; stop_worker wraps up properly
+    ProgramCache::~ProgramCache() {
+        if (_worker) {
+            join_worker();
+        }
+    }
+
+    ProgramCache& ProgramCache::shared() {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    bool ProgramCache::is_enabled() {
+        if (_binary_formats < 0) {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &_binary_formats);
+        }
+        return !_directory.empty() && _binary_formats > 0;
+    }
+
+    uint64_t ProgramCache::driver_hash() {
+        if (_driver_hash == 0) {
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+                const char* value{ reinterpret_cast<const char*>(glGetString(name)) };
+                const std::string_view text{ value ? value : "" };
+                _driver_hash = hash_bytes(text.data(), text.size() + 1, _driver_hash);
+            }
+        }
+        return _driver_hash;
+    }
+
+    uint64_t ProgramCache::key(const std::vector<ShaderSource>& stages) {
+        uint64_t key{ hash_bytes(&program_cache_version, sizeof(program_cache_version), driver_hash()) };
+        for (const ShaderSource& stage : stages) {
+            key = hash_bytes(&stage.type, sizeof(stage.type), key);
+            key = hash_bytes(stage.source.data(), stage.source.size(), key);
+        }
+        return key;
+    }
+
+    std::string ProgramCache::binary_path(uint64_t key) const {
+        char name[24];
+        std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+        return _directory + '/' + name;
+    }
+
+    GLuint ProgramCache::build(const std::vector<ShaderSource>& stages) {
+        const GLuint program{ glCreateProgram() };
+        const bool cached{ is_enabled() };
+        const uint64_t program_key{ cached ? key(stages) : 0 };
+
+        if (cached) {
+            const auto start{ std::chrono::steady_clock::now() };
+            const bool loaded{ load(program, program_key) };
+            _stats.load_ms += elapsed_ms(start);
+            if (loaded) {
+                ++_stats.hits;
+                return program;
+            }
+            ++_stats.misses;
+        }
+
+        const auto start{ std::chrono::steady_clock::now() };
+        std::vector<GLuint> shaders;
+        for (const ShaderSource& stage : stages) {
+            shaders.push_back(compile_shader(stage.type, stage.source.c_str(), stage.path));
+            glAttachShader(program, shaders.back());
+        }
+        if (cached) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program);
+
+        const bool linked{ is_linked(program) };
+        if (!linked) {
+            print_link_log(program);
+        }
+
+        for (const GLuint shader : shaders) {
+            glDetachShader(program, shader);
+            glDeleteShader(shader);
+        }
+        _stats.compile_ms += elapsed_ms(start);
+
+        if (cached && linked) {
+            store(program, program_key);
+        }
+        return program;
+    }
+
+    GLuint ProgramCache::build_async(const std::vector<ShaderSource>& stages) {
+        const bool parallel{ has_parallel_compile() };
+        if (!parallel && !_worker) {
+            return build(stages);
+        }
+
+        const bool cached{ is_enabled() };
+        const uint64_t program_key{ cached ? key(stages) : 0 };
+        const GLuint program{ glCreateProgram() };
+        if (cached) {
+            const auto start{ std::chrono::steady_clock::now() };
+            const bool loaded{ load(program, program_key) };
+            _stats.load_ms += elapsed_ms(start);
+            if (loaded) {
+                ++_stats.hits;
+                return program;
+            }
+            ++_stats.misses;
+        }
+        ++_stats.async_builds;
+
+        Pending pending{ .key = program_key, .shaders = {}, .types = {}, .paths = {}, .on_worker = !parallel };
+        for (const ShaderSource& stage : stages) {
+            pending.types.push_back(stage.type);
+            pending.paths.emplace_back(stage.path);
+        }
+
+        if (!parallel) {
+            Worker::Job job{ .program = program, .types = pending.types, .sources = {}, .paths = pending.paths, .retrievable = cached };
+            for (const ShaderSource& stage : stages) {
+                job.sources.push_back(stage.source);
+            }
+            {
+                std::lock_guard lock{ _worker->mutex };
+                _worker->jobs.push_back(std::move(job));
+            }
+            _worker->wake.notify_one();
+            _pending.emplace(program, std::move(pending));
+            _stats.pending = static_cast<uint32_t>(_pending.size());
+            return program;
+        }
+
+        if (!_compiler_threads_set) {
+            // as many threads as the driver likes, the default may be none
+            if (GLEW_KHR_parallel_shader_compile) {
+                glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+            }
+            else {
+                glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            }
+            _compiler_threads_set = true;
+        }
+
+        // nothing here waits: no status is queried until GL_COMPLETION_STATUS_KHR says the link is done
+        for (const ShaderSource& stage : stages) {
+            const GLchar* source{ stage.source.c_str() };
+            const GLuint shader{ glCreateShader(stage.type) };
+            glShaderSource(shader, 1, &source, nullptr);
+            glCompileShader(shader);
+            glAttachShader(program, shader);
+            pending.shaders.push_back(shader);
+        }
+        if (cached) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program);
+        _pending.emplace(program, std::move(pending));
+        _stats.pending = static_cast<uint32_t>(_pending.size());
+        return program;
+    }
+
+    bool ProgramCache::is_ready(GLuint program) {
+        const auto pending{ _pending.find(program) };
+        if (pending == _pending.end()) {
+            return true;
+        }
+
+        if (pending->second.on_worker) {
+            GLsync fence{ nullptr };
+            {
+                std::lock_guard lock{ _worker->mutex };
+                const auto done{ _worker->done.find(program) };
+                if (done == _worker->done.end()) {
+                    return false;
+                }
+                fence = done->second;
+            }
+            const GLenum status{ glClientWaitSync(fence, 0, 0) };
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                return false;
+            }
+            glDeleteSync(fence);
+            std::lock_guard lock{ _worker->mutex };
+            _worker->done.erase(program);
+        }
+        else {
+            GLint completed{ GL_FALSE };
+            glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed != GL_TRUE) {
+                return false;
+            }
+        }
+
+        finish(program, pending->second);
+        _pending.erase(pending);
+        _stats.pending = static_cast<uint32_t>(_pending.size());
+        return true;
+    }
+
+    void ProgramCache::finish(GLuint program, Pending& pending) {
+        // the worker printed its compile logs already and deleted its shaders
+        for (std::size_t s = 0; s < pending.shaders.size(); ++s) {
+            GLint compile_status;
+            glGetShaderiv(pending.shaders[s], GL_COMPILE_STATUS, &compile_status);
+            if (compile_status == GL_FALSE) {
+                print_shader_log(pending.shaders[s], pending.types[s], pending.paths[s].c_str());
+            }
+            glDetachShader(program, pending.shaders[s]);
+            glDeleteShader(pending.shaders[s]);
+        }
+
+        if (!is_linked(program)) {
+            print_link_log(program);
+            return;
+        }
+        if (pending.key != 0) {
+            store(program, pending.key);
+        }
+    }
+
+    void ProgramCache::cancel(GLuint program) {
+        const auto pending{ _pending.find(program) };
+        if (pending != _pending.end()) {
+            // nobody uses what it builds, finish must not store a binary for it
+            pending->second.key = 0;
+            if (pending->second.on_worker) {
+                // the worker may still be linking it, waiting for the job is the simple way to let go of it
+                while (!is_ready(program)) {
+                    std::this_thread::yield();
+                }
+            }
+            else {
+                for (const GLuint shader : pending->second.shaders) {
+                    glDeleteShader(shader);
+                }
+                _pending.erase(pending);
+                _stats.pending = static_cast<uint32_t>(_pending.size());
+            }
+        }
+        glDeleteProgram(program);
+    }
+
+    void ProgramCache::start_worker(
+        std::function<void()>   make_context_current,
+        std::function<void()>   release_context,
+        std::function<void()>   destroy_context
+    ) {
+        if (_worker) {
+            return;
+        }
+        _worker = std::make_unique<Worker>();
+        _worker->destroy_context = std::move(destroy_context);
+        _worker->thread = std::thread{ [worker = _worker.get(), make_context_current = std::move(make_context_current), release_context = std::move(release_context)] {
+            worker->run(make_context_current, release_context);
+        } };
+    }
+
+    void ProgramCache::stop_worker() {
+        if (!_worker) {
+            return;
+        }
+        join_worker();
+
+        // the worker drained its queue before stopping, what it built is wrapped up here
+        for (auto pending{ _pending.begin() }; pending != _pending.end();) {
+            if (!pending->second.on_worker) {
+                ++pending;
+                continue;
+            }
+            const auto done{ _worker->done.find(pending->first) };
+            if (done != _worker->done.end()) {
+                glDeleteSync(done->second);
+            }
+            finish(pending->first, pending->second);
+            pending = _pending.erase(pending);
+        }
+        _stats.pending = static_cast<uint32_t>(_pending.size());
+        if (_worker->destroy_context) {
+            _worker->destroy_context();
+        }
+        _worker.reset();
+    }
+
+    void ProgramCache::join_worker() {
+        {
+            std::lock_guard lock{ _worker->mutex };
+            _worker->stop = true;
+        }
+        _worker->wake.notify_one();
+        _worker->thread.join();
+    }
+
+    bool ProgramCache::has_parallel_compile() {
+        return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+    }
+
+    bool ProgramCache::load(GLuint program, uint64_t key) {
+        // a miss is the normal first run, not worth the mapping's error message
+        const std::string path{ binary_path(key) };
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error)) {
+            return false;
+        }
+        const MappedFile file{ path.c_str() };
+        if (!file.is_open() || file.size() < sizeof(Header)) {
+            return false;
+        }
+
+        Header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, program_cache_magic, sizeof(program_cache_magic)) != 0 || header.version != program_cache_version
+            || header.key != key || file.size() - sizeof(Header) < header.binary_size)
+        {
+            return false;
+        }
+
+        glProgramBinary(program, header.binary_format, file.data() + sizeof(Header), static_cast<GLsizei>(header.binary_size));
+        if (is_linked(program)) {
+            return true;
+        }
+
+        // a driver is free to refuse binaries of an older build of itself, the new one is stored after compiling
+        ++_stats.rejected;
+        std::remove(path.c_str());
+        return false;
+    }
+
+    void ProgramCache::store(GLuint program, uint64_t key) {
+        GLint binary_size{ 0 };
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+        if (binary_size <= 0) {
+            return;
+        }
+
+        std::vector<char> binary(static_cast<std::size_t>(binary_size));
+        GLenum binary_format{ 0 };
+        glGetProgramBinary(program, binary_size, nullptr, &binary_format, binary.data());
+        Header header{
+            .magic = {},
+            .version = program_cache_version,
+            .key = key,
+            .binary_format = binary_format,
+            .binary_size = static_cast<uint32_t>(binary_size)
+        };
+        std::memcpy(header.magic, program_cache_magic, sizeof(program_cache_magic));
+
+        std::error_code error;
+        std::filesystem::create_directories(_directory, error);
+
+        // written next to the target and renamed over it, like mesh caches
+        const std::string path{ binary_path(key) };
+        const std::string temp_path{ path + ".tmp" };
+        {
+            std::ofstream out{ temp_path, std::ios::binary | std::ios::trunc };
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+            if (!out) {
+                std::cerr << "can't write program binary: " << temp_path << '\n';
+                return;
+            }
+        }
+
+        if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+            std::cerr << "can't move program binary into place: " << path << '\n';
+            std::remove(temp_path.c_str());
+            return;
+        }
+        ++_stats.written;
+    }
+}
@@ -1,9 +1,21 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <tuple>
+#include <utility>
 #include "renderer.hpp"
 #include "utils.hpp"
 #include "geometryObject.hpp"
+#include "globals.hpp"
+#include "gpuCuller.hpp"
 #include "matrix.hpp"
+#include "occlusionQueries.hpp"
+#include "programCache.hpp"
+#include "textureStreamer.hpp"
 #include "sharedTypes.hpp"
+#include "threadPool.hpp"
 
 my_gl::Program::Program(
     const char*                         vertex_shader_path,
@@ -11,6 +23,8 @@ my_gl::Program::Program(
     std::vector<my_gl::Attribute>&&     attribs
 )
     : _program_id{ my_gl::create_program(vertex_shader_path, fragment_shader_path) }
+    , _vertex_path{ vertex_shader_path }
+    , _fragment_path{ fragment_shader_path }
 {
     // set attributes
     for (my_gl::Attribute& attrib : attribs) {
@@ -26,6 +40,8 @@ my_gl::Program::Program(
     std::vector<my_gl::Uniform>&&       unifs
 )
     : _program_id{ my_gl::create_program(vertex_shader_path, fragment_shader_path) }
+    , _vertex_path{ vertex_shader_path }
+    , _fragment_path{ fragment_shader_path }
 {
     // set attributes
     for (my_gl::Attribute& attrib : attribs) {
@@ -37,9 +53,180 @@ my_gl::Program::Program(
     }
 }
 
+// built in the background
+my_gl::Program::Program(
+    const char*                         vertex_shader_path,
+    const char*                         fragment_shader_path,
+    std::vector<my_gl::Attribute>&&     attribs,
+    std::vector<my_gl::Uniform>&&       unifs,
+    const my_gl::Program&               fallback
+)
+    : _fallback{ &fallback }
+    , _vertex_path{ vertex_shader_path }
+    , _fragment_path{ fragment_shader_path }
+{
+    std::string vertex_source{ my_gl::load_shader_source(vertex_shader_path) };
+    std::string fragment_source{ my_gl::load_shader_source(fragment_shader_path) };
+    if (vertex_source.empty() || fragment_source.empty()) {
+        std::cerr << "shader source load error from " << (vertex_source.empty() ? vertex_shader_path : fragment_shader_path) << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+
+    const auto locations{ my_gl::explicit_attribute_locations(vertex_source) };
+    for (my_gl::Attribute& attrib : attribs) {
+        const auto location{ std::find_if(locations.begin(), locations.end(), [&](const auto& named) { return named.first == attrib.name; }) };
+        if (location == locations.end()) {
+            std::cerr << "attribute name: " << attrib.name << " has no layout(location = N) in: " << vertex_shader_path << "\nnothing was set\n";
+            continue;
+        }
+        attrib.location = location->second;
+        _attrs[attrib.name] = std::move(attrib);
+    }
+
+    // looked up once it linked
+    for (my_gl::Uniform& unif : unifs) {
+        _unifs[unif.name] = std::move(unif);
+    }
+
+    _building_id = my_gl::ProgramCache::shared().build_async({
+        { .type = GL_VERTEX_SHADER, .source = std::move(vertex_source), .path = vertex_shader_path },
+        { .type = GL_FRAGMENT_SHADER, .source = std::move(fragment_source), .path = fragment_shader_path },
+    });
+    // a binary from the cache, or no way to build in the background, is ready now
+    update();
+}
+
+my_gl::Program::Program(Program&& rhs) noexcept
+    : _attrs{ std::move(rhs._attrs) }
+    , _unifs{ std::move(rhs._unifs) }
+    , _program_id{ std::exchange(rhs._program_id, 0) }
+    , _building_id{ std::exchange(rhs._building_id, 0) }
+    , _fallback{ std::exchange(rhs._fallback, nullptr) }
+    , _vertex_path{ std::move(rhs._vertex_path) }
+    , _fragment_path{ std::move(rhs._fragment_path) }
+    , _deferred_uniforms{ std::move(rhs._deferred_uniforms) }
+{}
+
+my_gl::Program& my_gl::Program::operator=(Program&& rhs) noexcept {
+    if (this != &rhs) {
+        destroy();
+        _attrs = std::move(rhs._attrs);
+        _unifs = std::move(rhs._unifs);
+        _program_id = std::exchange(rhs._program_id, 0);
+        _building_id = std::exchange(rhs._building_id, 0);
+        _fallback = std::exchange(rhs._fallback, nullptr);
+        _vertex_path = std::move(rhs._vertex_path);
+        _fragment_path = std::move(rhs._fragment_path);
+        _deferred_uniforms = std::move(rhs._deferred_uniforms);
+    }
+    return *this;
+}
+
 my_gl::Program::~Program() {
     un_use();
+    destroy();
+}
+
+void my_gl::Program::destroy() {
+    if (_building_id != 0) {
+        my_gl::ProgramCache::shared().cancel(_building_id);
+        _building_id = 0;
+    }
     glDeleteProgram(_program_id);
+    _program_id = 0;
+}
+
+bool my_gl::Program::reload() {
+    std::string vertex_source{ my_gl::load_shader_source(_vertex_path.c_str()) };
+    std::string fragment_source{ my_gl::load_shader_source(_fragment_path.c_str()) };
+    if (vertex_source.empty() || fragment_source.empty()) {
+        std::cerr << "shader source load error from " << (vertex_source.empty() ? _vertex_path : _fragment_path) << '\n';
+        return false;
+    }
+
+    // a newer edit wins over a rebuild still running
+    if (_building_id != 0) {
+        my_gl::ProgramCache::shared().cancel(_building_id);
+    }
+    _building_id = my_gl::ProgramCache::shared().build_async({
+        { .type = GL_VERTEX_SHADER, .source = std::move(vertex_source), .path = _vertex_path.c_str() },
+        { .type = GL_FRAGMENT_SHADER, .source = std::move(fragment_source), .path = _fragment_path.c_str() },
+    });
+    return true;
+}
+
+bool my_gl::Program::update() {
+    if (_building_id == 0 || !my_gl::ProgramCache::shared().is_ready(_building_id)) {
+        return false;
+    }
+
+    const GLuint built{ std::exchange(_building_id, 0) };
+    GLint link_status;
+    glGetProgramiv(built, GL_LINK_STATUS, &link_status);
+    if (link_status != GL_TRUE) {
+        std::cerr << "program of: " << _vertex_path << ", " << _fragment_path << " failed to build, "
+            << (_program_id != 0 ? "the previous one stays\n" : "its fallback stays\n");
+        glDeleteProgram(built);
+        return false;
+    }
+
+    if (_program_id != 0) {
+        // a reload, uniforms keep their values and entries missing from the new shaders keep their names
+        my_gl::copy_uniform_values(_program_id, built);
+        glDeleteProgram(_program_id);
+        _program_id = built;
+        for (auto& [name, unif] : _unifs) {
+            unif.location = glGetUniformLocation(_program_id, unif.name);
+        }
+        return true;
+    }
+
+    _program_id = built;
+    auto unifs{ std::move(_unifs) };
+    _unifs.clear();
+    for (auto& [name, unif] : unifs) {
+        this->set_uniform_location(unif);
+    }
+
+    for (const DeferredUniform& deferred : _deferred_uniforms) {
+        const GLint location{ glGetUniformLocation(_program_id, deferred.name.c_str()) };
+        switch (deferred.type) {
+        case GL_INT:
+            glProgramUniform1i(_program_id, location, deferred.int_value);
+            break;
+        case GL_FLOAT:
+            glProgramUniform1f(_program_id, location, deferred.values[0]);
+            break;
+        case GL_FLOAT_VEC3:
+            glProgramUniform3fv(_program_id, location, 1, deferred.values);
+            break;
+        case GL_FLOAT_VEC4:
+            glProgramUniform4fv(_program_id, location, 1, deferred.values);
+            break;
+        case GL_FLOAT_MAT4:
+            glProgramUniformMatrix4fv(_program_id, location, 1, true, deferred.values);
+            break;
+        }
+    }
+    _deferred_uniforms.clear();
+    return true;
+}
+
+void my_gl::Program::defer_uniform_value(std::string_view unif_name, GLenum type, int32_t int_value, const float* values) const {
+    if (!is_on_fallback() || _building_id == 0) {
+        return;
+    }
+
+    auto deferred{ std::find_if(_deferred_uniforms.begin(), _deferred_uniforms.end(), [&](const DeferredUniform& unif) { return unif.name == unif_name; }) };
+    if (deferred == _deferred_uniforms.end()) {
+        deferred = _deferred_uniforms.insert(_deferred_uniforms.end(), DeferredUniform{ .name = std::string{ unif_name }, .type = type });
+    }
+    deferred->type = type;
+    deferred->int_value = int_value;
+    if (values) {
+        const int count{ type == GL_FLOAT_MAT4 ? 16 : type == GL_FLOAT_VEC4 ? 4 : type == GL_FLOAT_VEC3 ? 3 : 1 };
+        std::copy(values, values + count, deferred->values);
+    }
 }
 
 const my_gl::Attribute* const my_gl::Program::get_attrib(std::string_view attrib_name) const {
@@ -53,6 +240,9 @@ const my_gl::Attribute* const my_gl::Program::get_attrib(std::string_view attrib
 }
 
 const my_gl::Uniform* const my_gl::Program::get_uniform(std::string_view unif_name) const {
+    if (is_on_fallback()) {
+        return _fallback->get_uniform(unif_name);
+    }
     auto unif{ _unifs.find(unif_name) };
     if (unif != _unifs.end() ) {
         return &(unif->second);
@@ -103,6 +293,7 @@ void my_gl::Program::set_uniform_location(my_gl::Uniform& unif) {
 }
 
 void  my_gl::Program::set_uniform_value(std::string_view unif_name, int32_t val) const {
+    defer_uniform_value(unif_name, GL_INT, val, nullptr);
     use();
     const Uniform* unif{ get_uniform(unif_name) };
     if (!unif) {
@@ -113,6 +304,7 @@ void  my_gl::Program::set_uniform_value(std::string_view unif_name, int32_t val)
 }
 
 void my_gl::Program::set_uniform_value(std::string_view unif_name, float val) const {
+    defer_uniform_value(unif_name, GL_FLOAT, 0, &val);
     use();
     const Uniform* unif{ get_uniform(unif_name) };
     if (!unif) {
@@ -123,6 +315,8 @@ void my_gl::Program::set_uniform_value(std::string_view unif_name, float val) co
 }
 
 void my_gl::Program::set_uniform_value(std::string_view unif_name, float val1, float val2, float val3) const {
+    const float values[3]{ val1, val2, val3 };
+    defer_uniform_value(unif_name, GL_FLOAT_VEC3, 0, values);
     use();
     const Uniform* unif{ get_uniform(unif_name) };
     if (!unif) {
@@ -132,7 +326,20 @@ void my_gl::Program::set_uniform_value(std::string_view unif_name, float val1, f
     un_use();
 }
 
+void my_gl::Program::set_uniform_value(std::string_view unif_name, float val1, float val2, float val3, float val4) const {
+    const float values[4]{ val1, val2, val3, val4 };
+    defer_uniform_value(unif_name, GL_FLOAT_VEC4, 0, values);
+    use();
+    const Uniform* unif{ get_uniform(unif_name) };
+    if (!unif) {
+        return;
+    }
+    glUniform4f(unif->location, val1, val2, val3, val4);
+    un_use();
+}
+
 void my_gl::Program::set_uniform_value(std::string_view unif_name, const float* matrix_val) const {
+    defer_uniform_value(unif_name, GL_FLOAT_MAT4, 0, matrix_val);
     use();
     const Uniform* unif{ get_uniform(unif_name) };
     if (!unif) {
@@ -150,6 +357,31 @@ const std::unordered_map<std::string_view, my_gl::Uniform>& my_gl::Program::get_
     return _unifs;
 } 
 
+std::vector<my_gl::Attribute> my_gl::make_attributes(const meshes::VertexLayout& layout, std::size_t vertex_count, const std::vector<const char*>& names) {
+    std::vector<Attribute> attrs;
+
+    for (const char* name : names) {
+        const meshes::LayoutElement* element{ layout.find(name) };
+        if (!element) {
+            std::cerr << "vertex layout has no element for attribute: " << name << "\nnothing was set\n";
+            continue;
+        }
+
+        const std::size_t byte_offset{ layout.stream_byte_offset(element->stream, vertex_count) + element->byte_offset };
+
+        attrs.push_back({
+            .name = name,
+            .gl_type = element->gl_type,
+            .count = element->attrib_count,
+            .byte_stride = layout.stream_strides[element->stream],
+            .byte_offset = static_cast<uint32_t>(byte_offset),
+            .normalized = element->normalized,
+        });
+    }
+
+    return attrs;
+}
+
 // VertexArray
 my_gl::VertexArray::VertexArray(
     meshes::Mesh&& mesh,
@@ -162,13 +394,13 @@ my_gl::VertexArray::VertexArray(
 }
 
 my_gl::VertexArray::VertexArray(
-    const meshes::Mesh& mesh,
+    meshes::MeshView    mesh,
     const Program&      program
 )
-    : _vbo_data{ mesh.vertices }
-    , _ibo_data{ mesh.indices }
+    : _vbo_data{ copy_positions(mesh) }
+    , _ibo_data{ mesh.indices.begin(), mesh.indices.end() }
 {
-    init(program);
+    init(program, { reinterpret_cast<const uint8_t*>(mesh.vertices.data()), mesh.vertices.size_bytes() });
 }
 
 my_gl::VertexArray::VertexArray(
@@ -182,62 +414,370 @@ my_gl::VertexArray::VertexArray(
 }
 
 my_gl::VertexArray::VertexArray(
-    const meshes::Mesh& mesh,
+    meshes::MeshView mesh,
     const std::vector<const Program*>& programs
 )
-    : _vbo_data{ mesh.vertices }
-    , _ibo_data{ mesh.indices }
+    : _vbo_data{ copy_positions(mesh) }
+    , _ibo_data{ mesh.indices.begin(), mesh.indices.end() }
 {
-    init(programs);
+    init(programs, { reinterpret_cast<const uint8_t*>(mesh.vertices.data()), mesh.vertices.size_bytes() });
 }
 
 my_gl::VertexArray::VertexArray(
     const std::vector<meshes::Mesh>& meshes,
+    const std::vector<meshes::VertexElement>& format,
     const std::vector<const Program*>& programs
 )
 {
-    combine_meshes(meshes);
+    combine_meshes(meshes, format);
     init(programs);
 }
 
-void my_gl::VertexArray::combine_meshes(const std::vector<meshes::Mesh>& meshes) {
+my_gl::VertexArray::VertexArray(
+    meshes::MeshView                            mesh,
+    const std::vector<meshes::VertexElement>&   format,
+    const meshes::VertexLayout&                 layout,
+    const std::vector<const Program*>&          programs
+)
+    : _vbo_data{ copy_positions(mesh) }
+    , _ibo_data{ mesh.indices.begin(), mesh.indices.end() }
+{
+    init(programs, meshes::convert_vertices(mesh.vertices, format, layout, &_dequantize));
+}
+
+my_gl::VertexArray::VertexArray(
+    const std::vector<std::span<const uint8_t>>&    vertex_ranges,
+    const std::vector<Attribute>&                   attributes,
+    std::span<const uint8_t>                        index_bytes,
+    GLenum                                          index_type,
+    meshes::Mesh&&                                  cpu_mesh,
+    const std::vector<const Program*>&              programs,
+    std::vector<meshes::Meshlet>&&                  meshlets,
+    const meshes::Dequantize&                       dequantize
+)
+    : _vbo_data{ std::move(cpu_mesh.vertices) }
+    , _ibo_data{ std::move(cpu_mesh.indices) }
+    , _meshlets{ std::move(meshlets) }
+    , _dequantize{ dequantize }
+{
+    if (_meshlets.empty()) {
+        build_meshlets();
+    }
+
+    // vao
+    glCreateVertexArrays(1, &_vao_id);
+    glBindVertexArray(_vao_id);
+
+    // vertex data, no intermediate copy of the ranges
+    std::size_t vertex_byte_size{ 0 };
+    for (const auto& range : vertex_ranges) {
+        vertex_byte_size += range.size();
+    }
+    glCreateBuffers(1, &_vbo_id);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo_id);
+    glBufferData(GL_ARRAY_BUFFER, vertex_byte_size, nullptr, GL_STATIC_DRAW);
+    std::size_t range_byte_offset{ 0 };
+    for (const auto& range : vertex_ranges) {
+        glBufferSubData(GL_ARRAY_BUFFER, range_byte_offset, range.size(), range.data());
+        range_byte_offset += range.size();
+    }
+
+    // indices
+    if (index_bytes.empty()) {
+        upload_indices();
+    }
+    else {
+        _index_type = index_type;
+        glCreateBuffers(1, &_ibo_id);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo_id);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_bytes.size(), index_bytes.data(), GL_STATIC_DRAW);
+    }
+
+    for (const my_gl::Attribute& attr_ref : attributes) {
+        for (const auto* program : programs) {
+            const my_gl::Attribute* program_attr{ program->get_attrib(attr_ref.name) };
+            if (!program_attr) {
+                continue;
+            }
+
+            glEnableVertexAttribArray(program_attr->location);
+            glVertexAttribPointer(program_attr->location, attr_ref.count, attr_ref.gl_type, attr_ref.normalized, attr_ref.byte_stride, reinterpret_cast<void*>(static_cast<std::size_t>(attr_ref.byte_offset)));
+        }
+    }
+
+    // unbind
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    release_shadow_copy();
+}
+
+my_gl::VertexArray::VertexArray(
+    meshes::MeshView    mesh,
+    MeshArena&          arena
+)
+    : _arena{ &arena }
+    , _arena_entry{ arena.acquire(mesh) }
+    , _vao_id{ arena.get_vao_id() }
+{
+    if (_arena_entry) {
+        return;
+    }
+
+    // acquire said why, a vertex array bound to the arena's vao without a range would draw nothing
+    _arena = nullptr;
+    _vao_id = 0;
+    init(mesh, arena);
+}
+
+my_gl::VertexArray::VertexArray(VertexArray&& rhs) noexcept
+    : _vbo_data{ std::move(rhs._vbo_data) }
+    , _ibo_data{ std::move(rhs._ibo_data) }
+    , _meshlets{ std::move(rhs._meshlets) }
+    , _dequantize{ rhs._dequantize }
+    , _arena{ std::exchange(rhs._arena, nullptr) }
+    , _arena_entry{ std::exchange(rhs._arena_entry, nullptr) }
+    , _vao_id{ std::exchange(rhs._vao_id, 0) }
+    , _vbo_id{ std::exchange(rhs._vbo_id, 0) }
+    , _ibo_id{ std::exchange(rhs._ibo_id, 0) }
+    , _index_type{ rhs._index_type }
+{}
+
+my_gl::VertexArray& my_gl::VertexArray::operator=(VertexArray&& rhs) noexcept {
+    if (this != &rhs) {
+        destroy();
+        _vbo_data = std::move(rhs._vbo_data);
+        _ibo_data = std::move(rhs._ibo_data);
+        _meshlets = std::move(rhs._meshlets);
+        _dequantize = rhs._dequantize;
+        _arena = std::exchange(rhs._arena, nullptr);
+        _arena_entry = std::exchange(rhs._arena_entry, nullptr);
+        _vao_id = std::exchange(rhs._vao_id, 0);
+        _vbo_id = std::exchange(rhs._vbo_id, 0);
+        _ibo_id = std::exchange(rhs._ibo_id, 0);
+        _index_type = rhs._index_type;
+    }
+    return *this;
+}
+
+void my_gl::VertexArray::combine_meshes(const std::vector<meshes::Mesh>& meshes, const std::vector<meshes::VertexElement>& format) {
+    const std::size_t floats_per_vertex{ meshes::floats_per_vertex(format) };
+    if (floats_per_vertex == 0) {
+        std::cerr << "can't combine meshes without a vertex format\n";
+        return;
+    }
+
     size_t vbo_data_size{0};
     size_t ibo_data_size{0};
+    std::vector<std::size_t> vertex_counts;
+    vertex_counts.reserve(meshes.size());
 
     for (const meshes::Mesh& mesh : meshes) {
         vbo_data_size += mesh.vertices.size();
         ibo_data_size += mesh.indices.size();
+        vertex_counts.push_back(mesh.vertices.size() / floats_per_vertex);
     }
 
     _vbo_data.reserve(vbo_data_size);
     _ibo_data.reserve(ibo_data_size);
 
-    for (const meshes::Mesh& mesh : meshes) {
-        _vbo_data.insert(_vbo_data.end(), mesh.vertices.begin(), mesh.vertices.end());
-        _ibo_data.insert(_ibo_data.end(), mesh.indices.begin(), mesh.indices.end());
+    // block e of the result is block e of every mesh in turn, positions stay the leading block
+    std::size_t block_offset{ 0 };
+    for (const meshes::VertexElement& element : format) {
+        for (std::size_t m = 0; m < meshes.size(); ++m) {
+            const auto block{ meshes[m].vertices.begin() + static_cast<std::ptrdiff_t>(block_offset * vertex_counts[m]) };
+            _vbo_data.insert(_vbo_data.end(), block, block + static_cast<std::ptrdiff_t>(element.count * vertex_counts[m]));
+        }
+        block_offset += element.count;
+    }
+
+    // indices of a mesh address its own vertices, rebase them past the vertices of the previous meshes
+    uint32_t base_vertex{ 0 };
+    for (std::size_t m = 0; m < meshes.size(); ++m) {
+        for (uint32_t index : meshes[m].indices) {
+            _ibo_data.push_back(base_vertex + index);
+        }
+        base_vertex += static_cast<uint32_t>(vertex_counts[m]);
+    }
+}
+
+my_gl::math::Aabb my_gl::VertexArray::compute_bounds(std::size_t index_byte_offset, std::size_t index_count) const {
+    math::Aabb bounds;
+    const std::size_t first{ index_byte_offset / sizeof(uint32_t) };
+    const auto positions{ get_positions() };
+    const auto indices{ get_indices() };
+    const std::size_t last{ std::min(first + index_count, indices.size()) };
+
+    for (std::size_t i = first; i < last; ++i) {
+        const std::size_t pos_index{ static_cast<std::size_t>(indices[i]) * 3 };
+        if (pos_index + 2 < positions.size()) {
+            bounds.expand(&positions[pos_index]);
+        }
+    }
+
+    return bounds;
+}
+
+void my_gl::VertexArray::build_meshlets() {
+    // positions lead the vbo, see compute_bounds
+    _meshlets = meshes::build_meshlets(_vbo_data.data(), _vbo_data.size() / 3, _ibo_data.data(), _ibo_data.size());
+}
+
+void my_gl::VertexArray::upload_indices() {
+    // the gl copy only needs enough bits for the vertices actually referenced
+    const std::size_t vertex_count{ _ibo_data.empty() ? 0 : static_cast<std::size_t>(*std::max_element(_ibo_data.begin(), _ibo_data.end())) + 1 };
+    _index_type = meshes::select_index_type(vertex_count);
+    const std::vector<uint8_t> gpu_indices{ meshes::encode_indices(_ibo_data, _index_type) };
+
+    glCreateBuffers(1, &_ibo_id);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, gpu_indices.size(), gpu_indices.data(), GL_STATIC_DRAW);
+}
+
+std::vector<float> my_gl::VertexArray::copy_positions(meshes::MeshView mesh) {
+    const std::size_t position_count{ mesh.indices.empty() ? 0 : static_cast<std::size_t>(*std::max_element(mesh.indices.begin(), mesh.indices.end())) + 1 };
+    const auto positions{ mesh.vertices.first(std::min(mesh.vertices.size(), position_count * 3)) };
+    return { positions.begin(), positions.end() };
+}
+
+void my_gl::VertexArray::release_shadow_copy() {
+    // only the leading positions block is read back (bounds, cpu occlusion), everything past it goes
+    if (_ibo_data.empty()) {
+        _vbo_data.clear();
+    }
+    else {
+        const std::size_t position_count{ static_cast<std::size_t>(*std::max_element(_ibo_data.begin(), _ibo_data.end())) + 1 };
+        _vbo_data.resize(std::min(_vbo_data.size(), position_count * 3));
+    }
+    _vbo_data.shrink_to_fit();
+}
+
+my_gl::math::Matrix44<float> my_gl::VertexArray::get_dequantize_mat() const {
+    const meshes::Dequantize& dequantize{ get_dequantize() };
+    auto mat{ math::Matrix44<float>::identity_new() };
+    for (int axis = 0; axis < 3; ++axis) {
+        mat.at(axis, axis) = dequantize.scale[axis];
+        mat.at(axis, 3) = dequantize.offset[axis];
+    }
+    return mat;
+}
+
+std::span<const float> my_gl::VertexArray::get_positions() const {
+    if (_arena_entry) {
+        return _arena_entry->positions;
     }
+    return _vbo_data;
+}
+
+std::span<const uint32_t> my_gl::VertexArray::get_indices() const {
+    if (_arena_entry) {
+        return _arena_entry->indices;
+    }
+    return _ibo_data;
+}
+
+std::span<const my_gl::meshes::Meshlet> my_gl::VertexArray::get_meshlets(std::size_t index_byte_offset, std::size_t index_count) const {
+    const std::size_t first{ index_byte_offset / sizeof(uint32_t) };
+    const std::size_t last{ first + index_count };
+    const auto& meshlets{ get_meshlets() };
+
+    auto begin{ std::upper_bound(meshlets.begin(), meshlets.end(), first, [](std::size_t index, const meshes::Meshlet& meshlet) {
+        return index < meshlet.index_offset + meshlet.index_count;
+    }) };
+    auto end{ std::lower_bound(begin, meshlets.end(), last, [](const meshes::Meshlet& meshlet, std::size_t index) {
+        return meshlet.index_offset < index;
+    }) };
+
+    return { begin, end };
 }
 
 my_gl::VertexArray::~VertexArray() {
+    destroy();
+}
+
+void my_gl::VertexArray::destroy() {
+    // the arena owns the gl objects
+    if (_arena) {
+        _arena->release(_arena_entry);
+        _arena = nullptr;
+        _arena_entry = nullptr;
+        _vao_id = 0;
+        return;
+    }
+
     glDeleteVertexArrays(1, &_vao_id);
     glDeleteBuffers(1, &_vbo_id);
     glDeleteBuffers(1, &_ibo_id);
+    _vao_id = 0;
+    _vbo_id = 0;
+    _ibo_id = 0;
 }
 
-void my_gl::VertexArray::init(const Program& program) {
+void my_gl::VertexArray::init(meshes::MeshView mesh, const MeshArena& arena) {
+    const std::size_t floats_per_vertex{ meshes::floats_per_vertex(arena.get_format()) };
+    if (floats_per_vertex == 0 || mesh.indices.empty() || mesh.vertices.size() % floats_per_vertex != 0) {
+        return;
+    }
+    const std::size_t vertex_count{ mesh.vertices.size() / floats_per_vertex };
+    const meshes::VertexLayout& layout{ arena.get_layout() };
+
+    _vbo_data = copy_positions(mesh);
+    _ibo_data.assign(mesh.indices.begin(), mesh.indices.end());
+    build_meshlets();
+
     // vao
     glCreateVertexArrays(1, &_vao_id);
     glBindVertexArray(_vao_id);
 
     // vertex data
+    const std::vector<uint8_t> gpu_vertices{ meshes::convert_vertices(mesh.vertices, arena.get_format(), layout, &_dequantize) };
     glCreateBuffers(1, &_vbo_id);
     glBindBuffer(GL_ARRAY_BUFFER, _vbo_id);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * _vbo_data.size(), _vbo_data.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, gpu_vertices.size(), gpu_vertices.data(), GL_STATIC_DRAW);
 
     // indices
-    glCreateBuffers(1, &_ibo_id);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * _ibo_data.size(), _ibo_data.data(), GL_STATIC_DRAW);
+    upload_indices();
+
+    // like the arena binds them, streams sized for this mesh instead of the arena capacity
+    for (const auto* program : arena.get_programs()) {
+        for (const auto& [name, attr] : program->get_attrs()) {
+            const meshes::LayoutElement* element{ layout.find(name) };
+            if (!element) {
+                continue;
+            }
+
+            const std::size_t byte_offset{ layout.stream_byte_offset(element->stream, vertex_count) + element->byte_offset };
+            glEnableVertexAttribArray(attr.location);
+            glVertexAttribPointer(attr.location, element->attrib_count, element->gl_type, element->normalized, layout.stream_strides[element->stream], reinterpret_cast<void*>(byte_offset));
+        }
+    }
+
+    // unbind
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    release_shadow_copy();
+}
+
+void my_gl::VertexArray::init(const Program& program, std::span<const uint8_t> gpu_vertices) {
+    build_meshlets();
+
+    // vao
+    glCreateVertexArrays(1, &_vao_id);
+    glBindVertexArray(_vao_id);
+
+    // vertex data
+    if (gpu_vertices.empty()) {
+        gpu_vertices = { reinterpret_cast<const uint8_t*>(_vbo_data.data()), sizeof(float) * _vbo_data.size() };
+    }
+    glCreateBuffers(1, &_vbo_id);
+    glBindBuffer(GL_ARRAY_BUFFER, _vbo_id);
+    glBufferData(GL_ARRAY_BUFFER, gpu_vertices.size(), gpu_vertices.data(), GL_STATIC_DRAW);
+
+    // indices
+    upload_indices();
 
     const auto& attrs{ program.get_attrs() };
 
@@ -245,7 +785,7 @@ void my_gl::VertexArray::init(const Program& program) {
         const my_gl::Attribute& attr_ref{ it->second };
 
         glEnableVertexAttribArray(attr_ref.location);
-        glVertexAttribPointer(attr_ref.location, attr_ref.count, attr_ref.gl_type, false, attr_ref.byte_stride, reinterpret_cast<void*>(attr_ref.byte_offset));
+        glVertexAttribPointer(attr_ref.location, attr_ref.count, attr_ref.gl_type, attr_ref.normalized, attr_ref.byte_stride, reinterpret_cast<void*>(attr_ref.byte_offset));
 
 #ifdef DEBUG
         printf("info: attribute '%s' successfully initialized, location: '%d'\n", attr_ref.name, attr_ref.location);
@@ -256,22 +796,27 @@ void my_gl::VertexArray::init(const Program& program) {
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    release_shadow_copy();
 }
 
-void my_gl::VertexArray::init(const std::vector<const Program*>& programs) {
+void my_gl::VertexArray::init(const std::vector<const Program*>& programs, std::span<const uint8_t> gpu_vertices) {
+    build_meshlets();
+
     // vao
     glCreateVertexArrays(1, &_vao_id);
     glBindVertexArray(_vao_id);
 
     // vertex data
+    if (gpu_vertices.empty()) {
+        gpu_vertices = { reinterpret_cast<const uint8_t*>(_vbo_data.data()), sizeof(float) * _vbo_data.size() };
+    }
     glCreateBuffers(1, &_vbo_id);
     glBindBuffer(GL_ARRAY_BUFFER, _vbo_id);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * _vbo_data.size(), _vbo_data.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, gpu_vertices.size(), gpu_vertices.data(), GL_STATIC_DRAW);
 
     // indices
-    glCreateBuffers(1, &_ibo_id);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo_id);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * _ibo_data.size(), _ibo_data.data(), GL_STATIC_DRAW);
+    upload_indices();
 
     for (const auto* program : programs) {
         const auto& attrs = program->get_attrs();
@@ -280,7 +825,7 @@ void my_gl::VertexArray::init(const std::vector<const Program*>& programs) {
             const my_gl::Attribute& attr_ref{ it->second };
 
             glEnableVertexAttribArray(attr_ref.location);
-            glVertexAttribPointer(attr_ref.location, attr_ref.count, attr_ref.gl_type, false, attr_ref.byte_stride, reinterpret_cast<void*>(attr_ref.byte_offset));
+            glVertexAttribPointer(attr_ref.location, attr_ref.count, attr_ref.gl_type, attr_ref.normalized, attr_ref.byte_stride, reinterpret_cast<void*>(attr_ref.byte_offset));
 
 #ifdef DEBUG
             printf("info: attribute '%s' successfully initialized, location: '%d'\n", attr_ref.name, attr_ref.location);
@@ -292,6 +837,8 @@ void my_gl::VertexArray::init(const std::vector<const Program*>& programs) {
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    release_shadow_copy();
 }
 
 // Renderer
@@ -305,17 +852,428 @@ my_gl::Renderer::Renderer(
     , _primitives{ std::move(primitives) }
     , _view_mat{ std::move(view_mat) }
     , _proj_mat{ std::move(proj_mat) }
-{}
+    , _occlusion_culler{ 256, 128, &ThreadPool::shared() }
+    , _occlusion_queries{ std::make_unique<OcclusionQueries>() }
+{
+    build_spatial_index();
+}
+
+// out of line, OcclusionQueries is incomplete in the header
+my_gl::Renderer::~Renderer() = default;
 
 void my_gl::Renderer::render(float time_0to1) {
     auto view_proj_mat{ _proj_mat * _view_mat };
 
-    for (auto& complex_obj : _complex_objs) {
-        complex_obj.render(_view_mat, view_proj_mat, time_0to1);
+    update_spatial_index();
+
+    const math::Frustum frustum{ view_proj_mat };
+    _visible_ids.clear();
+    _static_bvh.query_frustum(frustum, _visible_ids);
+    _dynamic_bvh.query_frustum(frustum, _visible_ids);
+
+    // before the gpu driven primitives leave the list: the compute pass draws their current lod
+    select_lods();
+
+    const bool gpu_driven{ gpu_driven_enabled && !_indirect_programs.empty() && GpuCuller::is_supported() };
+    if (gpu_driven) {
+        if (_gpu_driven_dirty || !_gpu_culler) {
+            build_gpu_driven();
+        }
+        // the compute pass culls these on its own
+        std::erase_if(_visible_ids, [this](uint32_t id) { return _gpu_driven[id] != 0; });
+    }
+
+    if (occlusion_culling_enabled) {
+        cull_occluded(view_proj_mat);
+    }
+
+    // keep submission order stable: complex objects first, then primitives
+    std::sort(_visible_ids.begin(), _visible_ids.end());
+
+    request_texture_mips();
+    cull_meshlets(frustum);
+
+    _occlusion_queries->begin_frame(view_proj_mat);
+
+    for (uint32_t id : _visible_ids) {
+        GeometryObjectPrimitive& primitive{ *_scene_primitives[id] };
+        // a query costs more than drawing a handful of triangles
+        if (primitive.get_vertices_count() >= gpu_occlusion_min_indices) {
+            _occlusion_queries->render(primitive, id, _view_mat, view_proj_mat, time_0to1);
+        }
+        else {
+            primitive.render(_view_mat, view_proj_mat, time_0to1);
+        }
+    }
+
+    if (gpu_driven) {
+        _gpu_culler->render(_view_mat, view_proj_mat);
+    }
+
+    _occlusion_queries->end_frame();
+}
+
+void my_gl::Renderer::set_indirect_program(const Program& program, const Program& indirect_program) {
+    _indirect_programs[&program] = &indirect_program;
+    _gpu_driven_dirty = true;
+}
+
+void my_gl::Renderer::build_gpu_driven() {
+    if (!_gpu_culler) {
+        _gpu_culler = std::make_unique<GpuCuller>();
+    }
+
+    std::vector<GeometryObjectPrimitive*> primitives;
+    std::vector<const Program*> indirect_programs;
+    _gpu_driven.assign(_scene_primitives.size(), 0);
+
+    for (uint32_t id = 0; id < _scene_primitives.size(); ++id) {
+        GeometryObjectPrimitive& primitive{ *_scene_primitives[id] };
+        auto indirect_program{ _indirect_programs.find(&primitive.get_program()) };
+
+        // textures are bound per draw, those primitives can't share a multi draw; packed texture slots are object data
+        if (indirect_program == _indirect_programs.end() || primitive.has_textures() || primitive.get_draw_type() != GL_TRIANGLES) {
+            continue;
+        }
+
+        primitives.push_back(&primitive);
+        indirect_programs.push_back(indirect_program->second);
+        _gpu_driven[id] = 1;
+    }
+
+    _gpu_culler->build(primitives, indirect_programs);
+    _gpu_driven_dirty = false;
+}
+
+std::size_t my_gl::Renderer::bake_static_batches(
+    MeshArena&                                                                  arena,
+    const std::vector<std::pair<const VertexArray*, meshes::MeshView>>&         sources,
+    const meshes::StaticBatchOptions&                                           options
+)
+{
+    // planar layout of the arena: positions first, normals by name
+    meshes::StaticBatchOptions batch_options{ options };
+    const auto& format{ arena.get_format() };
+    const std::size_t floats_per_vertex{ meshes::floats_per_vertex(format) };
+    if (floats_per_vertex == 0) {
+        std::cerr << "can't bake static batches into an arena without a vertex format\n";
+        return 0;
+    }
+    batch_options.attrib_counts.clear();
+    batch_options.normal_attrib = -1;
+    for (std::size_t s = 1; s < format.size(); ++s) {
+        if (std::string_view{ format[s].name } == "a_normal") {
+            batch_options.normal_attrib = static_cast<int32_t>(batch_options.attrib_counts.size());
+        }
+        batch_options.attrib_counts.push_back(format[s].count);
+    }
+
+    auto find_source{ [&sources](const VertexArray& vao) -> const meshes::MeshView* {
+        for (const auto& [source_vao, mesh] : sources) {
+            if (source_vao == &vao) {
+                return &mesh;
+            }
+        }
+        return nullptr;
+    } };
+
+    // occluders keep their own range for the cpu rasterizer, lods and other draw types don't survive merging
+    std::vector<uint32_t> candidates;
+    for (uint32_t i = 0; i < _primitives.size(); ++i) {
+        const GeometryObjectPrimitive& primitive{ _primitives[i] };
+        if (!primitive.is_animated() && !primitive.is_occluder() && primitive.get_lod_count() == 0
+            && primitive.get_draw_type() == GL_TRIANGLES && find_source(primitive.get_vao()))
+        {
+            candidates.push_back(i);
+        }
+    }
+
+    // one batch draws with one program and one set of textures, or one texture slot
+    auto slot_key{ [](const GeometryObjectPrimitive& primitive) {
+        const TextureSlot& slot{ primitive.get_texture_slot() };
+        return std::tuple{ slot.texture_unit, slot.layer, slot.uv_scale[0], slot.uv_scale[1], slot.uv_offset[0], slot.uv_offset[1] };
+    } };
+    std::stable_sort(candidates.begin(), candidates.end(), [this, &slot_key](uint32_t lhs, uint32_t rhs) {
+        const GeometryObjectPrimitive& l{ _primitives[lhs] };
+        const GeometryObjectPrimitive& r{ _primitives[rhs] };
+        if (&l.get_program() != &r.get_program()) {
+            return &l.get_program() < &r.get_program();
+        }
+        if (l.get_textures() != r.get_textures()) {
+            return l.get_textures() < r.get_textures();
+        }
+        return slot_key(l) < slot_key(r);
+    });
+
+    std::vector<uint8_t> baked(_primitives.size(), 0);
+    std::vector<GeometryObjectPrimitive> batches;
+    const std::size_t batch_vaos_before{ _batch_vaos.size() };
+
+    for (std::size_t group_first = 0; group_first < candidates.size();) {
+        const GeometryObjectPrimitive& head{ _primitives[candidates[group_first]] };
+        std::size_t group_last{ group_first + 1 };
+        while (group_last < candidates.size()
+            && &_primitives[candidates[group_last]].get_program() == &head.get_program()
+            && _primitives[candidates[group_last]].get_textures() == head.get_textures()
+            && _primitives[candidates[group_last]].get_texture_slot() == head.get_texture_slot())
+        {
+            ++group_last;
+        }
+
+        std::vector<math::Aabb> world_bounds;
+        std::vector<std::size_t> index_counts;
+        for (std::size_t c = group_first; c < group_last; ++c) {
+            world_bounds.push_back(_primitives[candidates[c]].get_world_bounds());
+            index_counts.push_back(_primitives[candidates[c]].get_vertices_count());
+        }
+
+        for (const std::vector<uint32_t>& chunk : meshes::split_static_batches(world_bounds, index_counts, batch_options)) {
+            // nothing to save on a lone primitive
+            if (chunk.size() < 2) {
+                continue;
+            }
+
+            std::vector<meshes::BatchInstance> instances;
+            bool fits_arena{ true };
+            for (uint32_t member : chunk) {
+                const GeometryObjectPrimitive& primitive{ _primitives[candidates[group_first + member]] };
+                const meshes::MeshView& mesh{ *find_source(primitive.get_vao()) };
+                fits_arena = fits_arena && mesh.vertices.size() % floats_per_vertex == 0;
+                instances.push_back({
+                    .mesh = mesh,
+                    .buffer_byte_offset = primitive.get_buffer_byte_offset(),
+                    .index_count = primitive.get_vertices_count(),
+                    .model_mat = primitive.get_curr_model_mat(),
+                });
+            }
+            // the batch is baked and stored in the arena format, sources in another one stay as they are
+            if (!fits_arena) {
+                std::cerr << "static batch sources don't match the arena format, " << chunk.size() << " primitives left unbatched\n";
+                continue;
+            }
+
+            const meshes::Mesh batch_mesh{ meshes::bake_static_batch(instances, batch_options) };
+            if (batch_mesh.indices.empty()) {
+                continue;
+            }
+            // a full arena gives the batch buffers of its own
+            auto vao{ std::make_unique<VertexArray>(batch_mesh, arena) };
+
+            for (uint32_t member : chunk) {
+                baked[candidates[group_first + member]] = 1;
+            }
+            batches.emplace_back(
+                std::vector<TransformsByType>{},
+                batch_mesh.indices.size(),
+                0,
+                head.get_program(),
+                *vao,
+                GL_TRIANGLES,
+                std::vector<const Texture*>{ head.get_textures() }
+            );
+            batches.back().set_texture_slot(head.get_texture_slot());
+            // the batch is in world space, its density is measured again rather than taken from one member
+            if (head.get_uv_density() > 0.0f) {
+                batches.back().set_uv_density(uv_density(batch_mesh, format));
+            }
+            _batch_vaos.push_back(std::move(vao));
+        }
+
+        group_first = group_last;
+    }
+
+    if (batches.empty()) {
+        return 0;
     }
 
+    std::vector<GeometryObjectPrimitive> primitives;
+    for (std::size_t i = 0; i < _primitives.size(); ++i) {
+        if (!baked[i]) {
+            primitives.push_back(std::move(_primitives[i]));
+        }
+    }
+    for (GeometryObjectPrimitive& batch : batches) {
+        primitives.push_back(std::move(batch));
+    }
+    _primitives = std::move(primitives);
+
+    // primitive pointers moved, everything indexing them starts over
+    build_spatial_index();
+    _gpu_driven_dirty = true;
+
+    return _batch_vaos.size() - batch_vaos_before;
+}
+
+void my_gl::Renderer::build_spatial_index() {
+    _scene_primitives.clear();
+
+    for (auto& complex_obj : _complex_objs) {
+        for (auto& primitive : complex_obj.get_primitives()) {
+            _scene_primitives.push_back(&primitive);
+        }
+    }
     for (auto& primitive : _primitives) {
-        primitive.render(_view_mat, view_proj_mat, time_0to1);
+        _scene_primitives.push_back(&primitive);
+    }
+
+    std::vector<uint32_t> static_ids;
+    _animated_ids.clear();
+    _scene_bounds.resize(_scene_primitives.size());
+
+    for (uint32_t id = 0; id < _scene_primitives.size(); ++id) {
+        _scene_bounds[id] = _scene_primitives[id]->get_world_bounds();
+        if (_scene_primitives[id]->is_animated()) {
+            _animated_ids.push_back(id);
+        }
+        else {
+            static_ids.push_back(id);
+        }
+    }
+
+    _static_bvh.build(_scene_bounds, static_ids);
+    // dynamic tree is built on the first update, once animated bounds are known
+    _dynamic_bvh = Bvh{};
+}
+
+void my_gl::Renderer::update_spatial_index() {
+    if (_animated_ids.empty()) {
+        return;
+    }
+
+    for (uint32_t id : _animated_ids) {
+        _scene_primitives[id]->update_model_mat();
+        _scene_bounds[id] = _scene_primitives[id]->get_world_bounds();
+    }
+
+    if (_dynamic_bvh.empty()) {
+        _dynamic_bvh.build(_scene_bounds, _animated_ids);
+    }
+    else {
+        _dynamic_bvh.update(_scene_bounds);
+    }
+}
+
+void my_gl::Renderer::cull_occluded(const math::Matrix44<float>& view_proj_mat) {
+    _occlusion_culler.begin_frame(view_proj_mat);
+
+    bool has_occluders{ false };
+    for (uint32_t id : _visible_ids) {
+        const GeometryObjectPrimitive& primitive{ *_scene_primitives[id] };
+        if (!primitive.is_occluder()) {
+            continue;
+        }
+
+        const VertexArray& vao{ primitive.get_vao() };
+        _occlusion_culler.add_occluder(
+            primitive.get_curr_model_mat(),
+            vao.get_vbo_data(),
+            vao.get_ibo_data() + primitive.get_buffer_byte_offset() / sizeof(uint32_t),
+            static_cast<uint32_t>(primitive.get_vertices_count())
+        );
+        has_occluders = true;
+    }
+
+    if (!has_occluders) {
+        return;
+    }
+
+    _occlusion_culler.rasterize();
+
+    // occluders are never tested, they would hide themselves
+    std::erase_if(_visible_ids, [this](uint32_t id) {
+        const GeometryObjectPrimitive& primitive{ *_scene_primitives[id] };
+        return !primitive.is_occluder() && !_occlusion_culler.is_visible(primitive.get_world_bounds());
+    });
+}
+
+float my_gl::Renderer::px_per_unit(const math::Aabb& bounds) const {
+    // the projection carries the camera's fov and aspect: 1 / tan(fov / 2) and that divided by aspect
+    // pixels are square, so the tighter of both axes is used
+    const float px_per_unit_at_unit_depth{ std::min(
+        _proj_mat.at(0, 0) * globals::window_props.width,
+        _proj_mat.at(1, 1) * globals::window_props.height
+    ) * 0.5f };
+
+    // nearest point of the bounding sphere decides, so a large object close by keeps its detail
+    const float center[3]{ bounds.center(0), bounds.center(1), bounds.center(2) };
+    const float radius{ 0.5f * std::sqrt(bounds.extent(0) * bounds.extent(0) + bounds.extent(1) * bounds.extent(1) + bounds.extent(2) * bounds.extent(2)) };
+    const float view_depth{ -(_view_mat.at(2, 0) * center[0] + _view_mat.at(2, 1) * center[1] + _view_mat.at(2, 2) * center[2] + _view_mat.at(2, 3)) };
+    const float nearest_depth{ view_depth - radius };
+
+    return nearest_depth > 1e-3f ? px_per_unit_at_unit_depth / nearest_depth : std::numeric_limits<float>::max();
+}
+
+void my_gl::Renderer::select_lods() {
+    for (uint32_t id : _visible_ids) {
+        GeometryObjectPrimitive& primitive{ *_scene_primitives[id] };
+        if (primitive.get_lod_count() < 2) {
+            continue;
+        }
+
+        primitive.select_lod(px_per_unit(primitive.get_world_bounds()), lod_threshold_px, lod_hysteresis);
+    }
+}
+
+void my_gl::Renderer::request_texture_mips() {
+    if (!_texture_streamer) {
+        return;
+    }
+
+    // occluded primitives are gone by now, what is left is what the frame samples
+    for (uint32_t id : _visible_ids) {
+        const GeometryObjectPrimitive& primitive{ *_scene_primitives[id] };
+        if (!primitive.has_textures() || primitive.get_uv_density() <= 0.0f) {
+            continue;
+        }
+
+        const float uv_per_px{ primitive.get_uv_per_px(px_per_unit(primitive.get_world_bounds())) };
+        for (const Texture* texture : primitive.get_textures()) {
+            _texture_streamer->request(*texture, uv_per_px);
+        }
+    }
+}
+
+void my_gl::Renderer::cull_meshlets(const math::Frustum& frustum) {
+    _meshlet_stats = meshes::MeshletCullStats{};
+
+    if (!meshlet_culling_enabled) {
+        for (uint32_t id : _visible_ids) {
+            _scene_primitives[id]->reset_meshlet_culling();
+        }
+        return;
+    }
+
+    // camera position is -R^T * t of the view matrix
+    float camera_pos[3];
+    for (int c = 0; c < 3; ++c) {
+        camera_pos[c] = -(_view_mat.at(0, c) * _view_mat.at(0, 3) + _view_mat.at(1, c) * _view_mat.at(1, 3) + _view_mat.at(2, c) * _view_mat.at(2, 3));
+    }
+
+    for (uint32_t id : _visible_ids) {
+        _scene_primitives[id]->cull_meshlets(frustum, camera_pos, _meshlet_stats);
+    }
+}
+
+my_gl::GeometryObjectPrimitive* my_gl::Renderer::pick(const math::Ray& ray, float t_max) const {
+    const Bvh::RayHit static_hit{ _static_bvh.raycast(ray, t_max) };
+    const Bvh::RayHit dynamic_hit{ _dynamic_bvh.raycast(ray, static_hit.item != Bvh::invalid_child ? static_hit.t : t_max) };
+
+    if (dynamic_hit.item != Bvh::invalid_child) {
+        return _scene_primitives[dynamic_hit.item];
+    }
+    if (static_hit.item != Bvh::invalid_child) {
+        return _scene_primitives[static_hit.item];
+    }
+    return nullptr;
+}
+
+void my_gl::Renderer::query_overlap(const math::Aabb& box, std::vector<GeometryObjectPrimitive*>& out) const {
+    std::vector<uint32_t> ids;
+    _static_bvh.query_overlap(box, ids);
+    _dynamic_bvh.query_overlap(box, ids);
+
+    for (uint32_t id : ids) {
+        out.push_back(_scene_primitives[id]);
     }
 }
 
@@ -0,0 +1,107 @@
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <iostream>
+#include "shaderWatcher.hpp"
+#include "renderer.hpp"
+
+namespace my_gl {
+    namespace {
+        bool is_same_file(const std::filesystem::path& lhs, const std::string& rhs) {
+            return lhs.lexically_normal() == std::filesystem::path{ rhs }.lexically_normal();
+        }
+    }
+
+    ShaderWatcher::ShaderWatcher(std::string directory)
+        : _directory{ std::move(directory) }
+    {
+        _fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_fd < 0) {
+            std::cerr << "can't start watching shaders, inotify_init1 failed\n";
+            return;
+        }
+
+        // editors either write the file in place or write a new one and move it over
+        _watch = ::inotify_add_watch(_fd, _directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (_watch < 0) {
+            std::cerr << "can't watch shader directory: " << _directory << '\n';
+        }
+    }
+
+    ShaderWatcher::~ShaderWatcher() {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    void ShaderWatcher::watch(Program& program) {
+        if (std::find(_programs.begin(), _programs.end(), &program) == _programs.end()) {
+            _programs.push_back(&program);
+        }
+    }
+
+    uint32_t ShaderWatcher::update() {
+        const std::vector<std::string> changes{ read_changes() };
+        for (const std::string& name : changes) {
+            const std::filesystem::path path{ std::filesystem::path{ _directory } / name };
+            bool watched{ false };
+            for (Program* program : _programs) {
+                if (!is_same_file(path, program->get_vertex_path()) && !is_same_file(path, program->get_fragment_path())) {
+                    continue;
+                }
+                watched = true;
+                if (program->reload()) {
+                    ++_stats.reloads;
+                }
+            }
+            _stats.changes += watched;
+        }
+
+        uint32_t swapped{ 0 };
+        for (Program* program : _programs) {
+            const bool was_building{ program->is_building() };
+            if (program->update()) {
+                ++swapped;
+            }
+            else if (was_building && !program->is_building()) {
+                ++_stats.failed;
+            }
+        }
+        _stats.swapped += swapped;
+        return swapped;
+    }
+
+    std::vector<std::string> ShaderWatcher::read_changes() {
+        std::vector<std::string> names;
+        if (_watch < 0) {
+            return names;
+        }
+
+        alignas(inotify_event) char buffer[4096];
+        for (;;) {
+            const ssize_t length{ ::read(_fd, buffer, sizeof(buffer)) };
+            if (length <= 0) {
+                if (length < 0 && errno != EAGAIN) {
+                    std::cerr << "can't read shader changes of: " << _directory << '\n';
+                }
+                break;
+            }
+
+            for (ssize_t at = 0; at < length;) {
+                const auto* event{ reinterpret_cast<const inotify_event*>(buffer + at) };
+                at += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+                if (event->len == 0) {
+                    continue;
+                }
+                // one save is often several events, each file is rebuilt once
+                std::string name{ event->name };
+                if (std::find(names.begin(), names.end(), name) == names.end()) {
+                    names.push_back(std::move(name));
+                }
+            }
+        }
+        return names;
+    }
+}
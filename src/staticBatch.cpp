@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "staticBatch.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            void split_chunk(
+                std::vector<uint32_t>::iterator         first,
+                std::vector<uint32_t>::iterator         last,
+                const std::vector<math::Aabb>&          world_bounds,
+                const std::vector<std::size_t>&         index_counts,
+                std::size_t                             max_indices,
+                float                                   max_extent,
+                std::vector<std::vector<uint32_t>>&     out
+            )
+            {
+                math::Aabb chunk_bounds;
+                std::size_t chunk_indices{ 0 };
+                for (auto it{ first }; it != last; ++it) {
+                    chunk_bounds.expand(world_bounds[*it]);
+                    chunk_indices += index_counts[*it];
+                }
+
+                int axis{ 0 };
+                for (int c = 1; c < 3; ++c) {
+                    if (chunk_bounds.extent(c) > chunk_bounds.extent(axis)) {
+                        axis = c;
+                    }
+                }
+
+                if (last - first == 1 || (chunk_indices <= max_indices && chunk_bounds.extent(axis) <= max_extent)) {
+                    out.emplace_back(first, last);
+                    return;
+                }
+
+                // median split on the longest axis keeps chunks compact for the frustum and occlusion tests
+                auto middle{ first + (last - first) / 2 };
+                std::nth_element(first, middle, last, [&world_bounds, axis](uint32_t lhs, uint32_t rhs) {
+                    return world_bounds[lhs].center(axis) < world_bounds[rhs].center(axis);
+                });
+
+                split_chunk(first, middle, world_bounds, index_counts, max_indices, max_extent, out);
+                split_chunk(middle, last, world_bounds, index_counts, max_indices, max_extent, out);
+            }
+        }
+
+        std::vector<std::vector<uint32_t>> split_static_batches(const std::vector<math::Aabb>& world_bounds, const std::vector<std::size_t>& index_counts, const StaticBatchOptions& options) {
+            std::vector<std::vector<uint32_t>> chunks;
+            if (world_bounds.empty()) {
+                return chunks;
+            }
+
+            std::vector<uint32_t> ids(world_bounds.size());
+            std::iota(ids.begin(), ids.end(), 0u);
+
+            // a chunk never references more vertices than it has indices, this keeps baked chunks on 16 bit indices
+            const std::size_t max_indices{ std::min<std::size_t>(options.max_indices, UINT16_MAX) };
+            split_chunk(ids.begin(), ids.end(), world_bounds, index_counts, max_indices, options.max_extent, chunks);
+
+            return chunks;
+        }
+
+        Mesh bake_static_batch(const std::vector<BatchInstance>& instances, const StaticBatchOptions& options) {
+            const std::size_t block_count{ options.attrib_counts.size() + 1 };
+            std::vector<uint16_t> block_counts{ 3 };
+            block_counts.insert(block_counts.end(), options.attrib_counts.begin(), options.attrib_counts.end());
+            const std::size_t floats_per_vertex{ std::accumulate(block_counts.begin(), block_counts.end(), std::size_t{ 0 }) };
+            const std::size_t normal_block{ options.normal_attrib >= 0 ? static_cast<std::size_t>(options.normal_attrib) + 1 : block_count };
+
+            std::vector<std::vector<float>> blocks(block_count);
+            Mesh batch;
+            uint32_t batch_vertices{ 0 };
+
+            for (const BatchInstance& instance : instances) {
+                const MeshView& mesh{ instance.mesh };
+                const std::size_t vertex_count{ mesh.vertices.size() / floats_per_vertex };
+
+                // normals go through the inverse transpose
+                math::Matrix44<float> normal_mat{ instance.model_mat };
+                normal_mat.invert();
+                normal_mat.transpose();
+
+                // source vertex -> batch vertex
+                std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+                const std::size_t first{ instance.buffer_byte_offset / sizeof(uint32_t) };
+                const std::size_t last{ std::min(first + instance.index_count, mesh.indices.size()) };
+
+                for (std::size_t i = first; i < last; ++i) {
+                    const uint32_t index{ mesh.indices[i] };
+                    if (index >= vertex_count) {
+                        continue;
+                    }
+
+                    if (remap[index] == UINT32_MAX) {
+                        remap[index] = batch_vertices++;
+
+                        const float* block{ mesh.vertices.data() };
+                        for (std::size_t b = 0; b < block_count; ++b) {
+                            const float* src{ block + index * block_counts[b] };
+                            if (b == 0 || b == normal_block) {
+                                const math::Matrix44<float>& m{ b == 0 ? instance.model_mat : normal_mat };
+                                const float w{ b == 0 ? 1.0f : 0.0f };
+                                float dst[3];
+                                for (int r = 0; r < 3; ++r) {
+                                    dst[r] = m.at(r, 0) * src[0] + m.at(r, 1) * src[1] + m.at(r, 2) * src[2] + m.at(r, 3) * w;
+                                }
+                                if (b == normal_block) {
+                                    const float len{ std::sqrt(dst[0] * dst[0] + dst[1] * dst[1] + dst[2] * dst[2]) };
+                                    for (int r = 0; len > 0.0f && r < 3; ++r) {
+                                        dst[r] /= len;
+                                    }
+                                }
+                                blocks[b].insert(blocks[b].end(), dst, dst + 3);
+                            }
+                            else {
+                                blocks[b].insert(blocks[b].end(), src, src + block_counts[b]);
+                            }
+                            block += block_counts[b] * vertex_count;
+                        }
+                    }
+                    batch.indices.push_back(remap[index]);
+                }
+            }
+
+            // back to planar: every block of all instances, one after another
+            batch.vertices.reserve(floats_per_vertex * batch_vertices);
+            for (const std::vector<float>& block : blocks) {
+                batch.vertices.insert(batch.vertices.end(), block.begin(), block.end());
+            }
+
+            return batch;
+        }
+    }
+}
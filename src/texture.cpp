@@ -1,9 +1,62 @@
 #define STB_IMAGE_IMPLEMENTATION
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <vector>
 #include "texture.hpp"
+#include "ktxFile.hpp"
+#include "textureCompression.hpp"
+#include "textureMips.hpp"
+#include "textureLoader.hpp"
+#include "textureStreamer.hpp"
 #include "renderer.hpp"
 
 namespace my_gl {
+    namespace {
+        GLenum internal_format(int color_channels) {
+            switch (color_channels) {
+            case 1:     return GL_R8;
+            case 2:     return GL_RG8;
+            case 3:     return GL_RGB8;
+            default:    return GL_RGBA8;
+            }
+        }
+
+        GLenum pixel_format(int color_channels) {
+            switch (color_channels) {
+            case 1:     return GL_RED;
+            case 2:     return GL_RG;
+            case 3:     return GL_RGB;
+            default:    return GL_RGBA;
+            }
+        }
+
+        bool uses_mipmaps(GLenum min_filter_option) {
+            return min_filter_option == GL_NEAREST_MIPMAP_NEAREST || min_filter_option == GL_NEAREST_MIPMAP_LINEAR
+                || min_filter_option == GL_LINEAR_MIPMAP_NEAREST || min_filter_option == GL_LINEAR_MIPMAP_LINEAR;
+        }
+
+        GLsizei full_mip_count(int width, int height) {
+            GLsizei levels{ 1 };
+            while ((std::max(width, height) >> levels) > 0) {
+                ++levels;
+            }
+            return levels;
+        }
+
+        // grey (+ alpha) images sample as grey instead of red (+ green)
+        void swizzle_grey(GLuint id, int color_channels) {
+            if (color_channels <= 2) {
+                const GLint swizzle[4]{ GL_RED, GL_RED, GL_RED, color_channels == 2 ? GL_GREEN : GL_ONE };
+                glTextureParameteriv(id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+            }
+        }
+    }
+
+    Texture::State::~State() {
+        glDeleteTextures(1, &id);
+    }
+
     Texture::Texture(
         const char* path,
         const Program& program,
@@ -18,65 +71,199 @@ namespace my_gl {
         : _texture_unit{ texture_unit }
         , _3d{ is_3d }
     {
-        glGenTextures(1, &_id);
+        init(program, sampler_uniform, sampler_uniform_value, wrap_option, min_filter_option, mag_filter_option);
 
-        // set texture unit
+        // mips made on the cpu once and cached, instead of glGenerateMipmap on every load
+        const std::string mips_path{ !_3d && _state->mipmapped && !is_ktx2_path(path)
+            ? generate_mips_cached(path, { .wrap = _state->repeats })
+            : std::string{} };
+        if (!mips_path.empty()) {
+            path = mips_path.c_str();
+        }
+
+        if (!_3d && is_ktx2_path(path)) {
+            const KtxFile file{ path };
+            if (file.is_valid()) {
+                store(*_state, file);
+            }
+            else {
+                std::cerr << "failed to load texture from path: " << path << '\n';
+            }
+            return;
+        }
+
+        int width, height, color_channels;
+        uint8_t* data{ stbi_load(path, &width, &height, &color_channels, 0) };
+
+        if (data) {
+            store(*_state, width, height, color_channels, data);
+            stbi_image_free(data);
+        }
+        else {
+            std::cerr << "failed to load texture from path: " << path << '\n';
+        }
+    }
+
+    Texture::Texture(
+        const char* path,
+        TextureLoader& loader,
+        const Program& program,
+        const Uniform* const sampler_uniform,
+        uint32_t sampler_uniform_value,
+        GLenum texture_unit,
+        GLenum wrap_option,
+        GLenum min_filter_option,
+        GLenum mag_filter_option
+    )
+        : _placeholder_id{ loader.placeholder_id() }
+        , _texture_unit{ texture_unit }
+        , _3d{ false }
+    {
+        init(program, sampler_uniform, sampler_uniform_value, wrap_option, min_filter_option, mag_filter_option);
+        loader.request(_state, path);
+    }
+
+    Texture::Texture(
+        const char* path,
+        TextureStreamer& streamer,
+        const Program& program,
+        const Uniform* const sampler_uniform,
+        uint32_t sampler_uniform_value,
+        GLenum texture_unit,
+        GLenum wrap_option,
+        GLenum min_filter_option,
+        GLenum mag_filter_option
+    )
+        : _placeholder_id{ streamer.placeholder_id() }
+        , _texture_unit{ texture_unit }
+        , _3d{ false }
+    {
+        init(program, sampler_uniform, sampler_uniform_value, wrap_option, min_filter_option, mag_filter_option);
+        streamer.add(_state, path);
+    }
+
+    Texture::Texture(
+        const Texture& texture,
+        const Program& program,
+        const Uniform* const sampler_uniform,
+        uint32_t sampler_uniform_value,
+        GLenum texture_unit
+    )
+        : _state{ texture._state }
+        , _placeholder_id{ texture._placeholder_id }
+        , _texture_unit{ texture_unit }
+        , _3d{ texture._3d }
+    {
         program.use();
         glUniform1i(sampler_uniform->location, sampler_uniform_value);
+    }
 
-        bind();
+    void Texture::init(const Program& program, const Uniform* const sampler_uniform, uint32_t sampler_uniform_value, GLenum wrap_option, GLenum min_filter_option, GLenum mag_filter_option) {
+        _state = std::make_shared<State>();
+        _state->target = _3d ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+        _state->mipmapped = uses_mipmaps(min_filter_option);
+        _state->repeats = wrap_option == GL_REPEAT;
+        glCreateTextures(_state->target, 1, &_state->id);
+
+        // set texture unit
+        program.use();
+        glUniform1i(sampler_uniform->location, sampler_uniform_value);
 
         // set options
-        if (!_3d) {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_option);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_option);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter_option);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter_option);
+        glTextureParameteri(_state->id, GL_TEXTURE_WRAP_S, wrap_option);
+        glTextureParameteri(_state->id, GL_TEXTURE_WRAP_T, wrap_option);
+        glTextureParameteri(_state->id, GL_TEXTURE_MIN_FILTER, min_filter_option);
+        glTextureParameteri(_state->id, GL_TEXTURE_MAG_FILTER, mag_filter_option);
+    }
+
+    void Texture::store(State& state, int width, int height, int color_channels, const void* pixels) {
+        const GLsizei levels{ state.mipmapped ? full_mip_count(width, height) : 1 };
+
+        // rows of 1 and 3 channel images aren't 4 byte aligned
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        if (state.target == GL_TEXTURE_3D) {
+            glTextureStorage3D(state.id, levels, internal_format(color_channels), width, height, 1);
+            glTextureSubImage3D(state.id, 0, 0, 0, 0, width, height, 1, pixel_format(color_channels), GL_UNSIGNED_BYTE, pixels);
         }
         else {
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, wrap_option);
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, wrap_option);
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, min_filter_option);
-            glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, mag_filter_option);
+            glTextureStorage2D(state.id, levels, internal_format(color_channels), width, height);
+            glTextureSubImage2D(state.id, 0, 0, 0, width, height, pixel_format(color_channels), GL_UNSIGNED_BYTE, pixels);
         }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        swizzle_grey(state.id, color_channels);
+        if (state.mipmapped) {
+            glGenerateTextureMipmap(state.id);
+        }
+
+        state.width = width;
+        state.height = height;
+        state.color_channels = color_channels;
+        state.resident = true;
+    }
+
+    void Texture::store(State& state, const KtxFile& file, bool staged, std::size_t staged_offset) {
+        const KtxFormat& format{ file.format() };
+        const int width{ static_cast<int>(file.width()) };
+        const int height{ static_cast<int>(file.height()) };
+
+        BlockFormat block_format{};
+        const bool compressed{ format.gl_pixel_format == 0 };
+        // find_block_format can't fail for compressed formats KtxFile accepts
+        const bool decompress{ compressed && find_block_format(format.vk_format, block_format) && !is_block_format_supported(block_format) };
+        // glGenerateMipmap can't write compressed levels
+        const bool generate{ state.mipmapped && file.level_count() == 1 && (!compressed || decompress) };
+        const GLsizei level_count{ !state.mipmapped ? 1 : generate ? full_mip_count(width, height) : static_cast<GLsizei>(file.level_count()) };
+        const GLsizei uploaded{ generate ? 1 : level_count };
 
-        _data = stbi_load(path, &_width, &_height, &_color_channels, 0);
-        
-        if (_data) {
-            // 2d texture
-            if (!_3d) {
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, _width, _height, 0, GL_RGB, GL_UNSIGNED_BYTE, _data);
-                glGenerateMipmap(GL_TEXTURE_2D);
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        glTextureStorage2D(state.id, level_count, decompress ? GL_RGBA8 : format.gl_internal_format, width, height);
+        std::vector<uint8_t> decompressed;
+        for (GLsizei level = 0; level < uploaded; ++level) {
+            const int level_width{ std::max(width >> level, 1) };
+            const int level_height{ std::max(height >> level, 1) };
+            std::span<const uint8_t> data{ file.level(static_cast<uint32_t>(level)) };
+            if (staged && !decompress) {
+                data = { reinterpret_cast<const uint8_t*>(staged_offset), data.size() };
+                staged_offset += data.size();
+            }
+            if (decompress) {
+                decompressed.resize(static_cast<std::size_t>(level_width) * level_height * 4);
+                decompress_blocks(data.data(), level_width, level_height, block_format, decompressed.data());
+                glTextureSubImage2D(state.id, level, 0, 0, level_width, level_height, GL_RGBA, GL_UNSIGNED_BYTE, decompressed.data());
+            }
+            else if (compressed) {
+                glCompressedTextureSubImage2D(state.id, level, 0, 0, level_width, level_height, format.gl_internal_format, static_cast<GLsizei>(data.size()), data.data());
             }
-            // 3d texture
             else {
-                glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB, _width, _height, _depth, 0, GL_RGB, GL_UNSIGNED_BYTE, _data);
-                glGenerateMipmap(GL_TEXTURE_3D);
+                glTextureSubImage2D(state.id, level, 0, 0, level_width, level_height, format.gl_pixel_format, GL_UNSIGNED_BYTE, data.data());
             }
-
-            stbi_image_free(_data);
         }
-        else {
-            std::cerr << "failed to load texture from path: " << path << '\n';
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        swizzle_grey(state.id, format.color_channels);
+        if (generate) {
+            glGenerateTextureMipmap(state.id);
         }
+
+        state.width = width;
+        state.height = height;
+        state.color_channels = format.color_channels;
+        state.resident = true;
     }
 
     void Texture::bind() const {
         glActiveTexture(_texture_unit);
-        if (!_3d) {
-            glBindTexture(GL_TEXTURE_2D, _id);
-        }
-        else {
-            glBindTexture(GL_TEXTURE_3D, _id);
-        }
+        glBindTexture(_state->target, _state->resident ? _state->id : _placeholder_id);
     }
 
     void Texture::un_bind() const {
-        if (!_3d) {
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
-        else {
-            glBindTexture(GL_TEXTURE_3D, 0);
-        }
+        glBindTexture(_state->target, 0);
     }
 }
@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <STB_IMG/stb_image.h>
+#include "ktxFile.hpp"
+#include "textureArrays.hpp"
+
+namespace my_gl {
+    namespace {
+        struct Image {
+            uint8_t*    pixels{ nullptr };
+            int         width{ 0 };
+            int         height{ 0 };
+            int         channels{ 0 };
+        };
+
+        // top left corner of an image's padded rect
+        struct Placement {
+            uint32_t    page;
+            uint32_t    x;
+            uint32_t    y;
+        };
+
+        GLenum internal_format(int channels) {
+            switch (channels) {
+            case 1:     return GL_R8;
+            case 2:     return GL_RG8;
+            case 3:     return GL_RGB8;
+            default:    return GL_RGBA8;
+            }
+        }
+
+        GLenum pixel_format(int channels) {
+            switch (channels) {
+            case 1:     return GL_RED;
+            case 2:     return GL_RG;
+            case 3:     return GL_RGB;
+            default:    return GL_RGBA;
+            }
+        }
+
+        bool uses_mipmaps(GLenum min_filter_option) {
+            return min_filter_option == GL_NEAREST_MIPMAP_NEAREST || min_filter_option == GL_NEAREST_MIPMAP_LINEAR
+                || min_filter_option == GL_LINEAR_MIPMAP_NEAREST || min_filter_option == GL_LINEAR_MIPMAP_LINEAR;
+        }
+
+        uint32_t mip_count(uint32_t size) {
+            uint32_t levels{ 1 };
+            while ((size >> levels) > 0) {
+                ++levels;
+            }
+            return levels;
+        }
+
+        uint32_t align_up(uint32_t value, uint32_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // shelves of padded rects, tallest first; returns the page count
+        uint32_t pack_shelves(const std::vector<Image>& images, const std::vector<uint32_t>& order, uint32_t page_size, uint32_t padding, uint32_t alignment, std::vector<Placement>& placements) {
+            uint32_t page{ 0 };
+            uint32_t shelf_y{ 0 };
+            uint32_t shelf_height{ 0 };
+            uint32_t cursor_x{ 0 };
+            for (uint32_t image : order) {
+                const uint32_t width{ align_up(static_cast<uint32_t>(images[image].width) + padding * 2, alignment) };
+                const uint32_t height{ align_up(static_cast<uint32_t>(images[image].height) + padding * 2, alignment) };
+                if (cursor_x + width > page_size) {
+                    shelf_y += shelf_height;
+                    shelf_height = 0;
+                    cursor_x = 0;
+                }
+                if (shelf_y + height > page_size) {
+                    ++page;
+                    shelf_y = 0;
+                    shelf_height = 0;
+                    cursor_x = 0;
+                }
+                placements[image] = { page, cursor_x, shelf_y };
+                cursor_x += width;
+                shelf_height = std::max(shelf_height, height);
+            }
+            return page + 1;
+        }
+
+        // 'image' at (x, y) of the page, surrounded by 'padding' texels of its edges or, wrapping, of the opposite edges
+        void blit_padded(const Image& image, uint8_t* page, uint32_t page_size, uint32_t x, uint32_t y, uint32_t padding, bool wrap) {
+            const int pad{ static_cast<int>(padding) };
+            const std::size_t channels{ static_cast<std::size_t>(image.channels) };
+            for (int py = -pad; py < image.height + pad; ++py) {
+                const int source_y{ wrap ? (py % image.height + image.height) % image.height : std::clamp(py, 0, image.height - 1) };
+                uint8_t* row{ page + ((y + py) * static_cast<std::size_t>(page_size) + x) * channels };
+                for (int px = -pad; px < image.width + pad; ++px) {
+                    const int source_x{ wrap ? (px % image.width + image.width) % image.width : std::clamp(px, 0, image.width - 1) };
+                    std::memcpy(row + px * static_cast<std::ptrdiff_t>(channels), image.pixels + (static_cast<std::size_t>(source_y) * image.width + source_x) * channels, channels);
+                }
+            }
+        }
+    }
+
+    TextureArrays::TextureArrays(const std::vector<std::string>& paths, GLuint first_unit, const TextureArrayOptions& options, ThreadPool& pool)
+        : _first_unit{ first_unit }
+        , _slots(paths.size())
+    {
+        _stats.images = static_cast<uint32_t>(paths.size());
+
+        std::vector<Image> images(paths.size());
+        pool.parallel_for(static_cast<uint32_t>(paths.size()), [&](uint32_t i) {
+            images[i].pixels = stbi_load(paths[i].c_str(), &images[i].width, &images[i].height, &images[i].channels, 0);
+        });
+
+        const bool mipmapped{ uses_mipmaps(options.min_filter_option) };
+        GLint max_layers{ 256 };
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+        auto create_array{ [&](uint32_t width, uint32_t height, uint32_t layers, uint32_t levels, int channels, GLenum wrap_option) {
+            GLuint id;
+            glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+            glTextureStorage3D(id, static_cast<GLsizei>(levels), internal_format(channels), static_cast<GLsizei>(width), static_cast<GLsizei>(height), static_cast<GLsizei>(layers));
+            glTextureParameteri(id, GL_TEXTURE_WRAP_S, wrap_option);
+            glTextureParameteri(id, GL_TEXTURE_WRAP_T, wrap_option);
+            glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, options.min_filter_option);
+            glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, options.mag_filter_option);
+            // grey (+ alpha) images sample as grey, like Texture does
+            if (channels <= 2) {
+                const GLint swizzle[4]{ GL_RED, GL_RED, GL_RED, channels == 2 ? GL_GREEN : GL_ONE };
+                glTextureParameteriv(id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+            }
+            _arrays.push_back(id);
+
+            std::size_t level_bytes{ static_cast<std::size_t>(width) * height * channels * layers };
+            for (uint32_t level = 0; level < levels; ++level, level_bytes /= 4) {
+                _stats.bytes += level_bytes;
+            }
+            _stats.layers += layers;
+            return static_cast<uint32_t>(_arrays.size() - 1);
+        } };
+
+        // 'path': the image file of a whole image layer, its chain comes from generate_mips_cached; atlas pages pass nullptr
+        auto upload_layer{ [&](uint32_t array, uint32_t layer, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t levels, int channels, const MipOptions& mip_options, const char* path) {
+            std::optional<KtxFile> cached;
+            if (levels > 1 && path) {
+                const std::string cached_path{ generate_mips_cached(path, mip_options, pool) };
+                if (!cached_path.empty()) {
+                    cached.emplace(cached_path.c_str());
+                }
+            }
+            // level 0 is the image itself: a chain decoded with another stbi flip setting doesn't match it
+            const std::size_t image_bytes{ static_cast<std::size_t>(width) * height * channels };
+            const bool from_cache{ cached && cached->is_valid() && cached->format().gl_pixel_format == pixel_format(channels)
+                && cached->width() == width && cached->height() == height && cached->level_count() == levels
+                && cached->level(0).size() == image_bytes && std::memcmp(cached->level(0).data(), pixels, image_bytes) == 0 };
+            const std::vector<std::vector<uint8_t>> chain{ levels > 1 && !from_cache
+                ? generate_mips(pixels, static_cast<int>(width), static_cast<int>(height), channels, mip_options, pool)
+                : std::vector<std::vector<uint8_t>>{} };
+            for (uint32_t level = 0; level < levels; ++level) {
+                glTextureSubImage3D(
+                    _arrays[array],
+                    static_cast<GLint>(level),
+                    0,
+                    0,
+                    static_cast<GLint>(layer),
+                    static_cast<GLsizei>(std::max(width >> level, 1u)),
+                    static_cast<GLsizei>(std::max(height >> level, 1u)),
+                    1,
+                    pixel_format(channels),
+                    GL_UNSIGNED_BYTE,
+                    from_cache ? cached->level(level).data() : chain.empty() ? pixels : chain[level].data()
+                );
+            }
+        } };
+
+        // (channels, width, height) -> images, a map keeps the array order independent of hashing
+        std::map<std::tuple<int, int, int>, std::vector<uint32_t>> groups;
+        for (uint32_t i = 0; i < images.size(); ++i) {
+            if (!images[i].pixels) {
+                std::cerr << "failed to load texture from path: " << paths[i] << '\n';
+                ++_stats.failed;
+                continue;
+            }
+            groups[{ images[i].channels, images[i].width, images[i].height }].push_back(i);
+        }
+
+        GLint alignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        // atlas mips stop where the padding shrinks to one texel, rects sit on multiples of that level's texel size
+        const uint32_t atlas_levels{ mipmapped ? mip_count(options.atlas_padding) : 1 };
+        const uint32_t rect_alignment{ 1u << (atlas_levels - 1) };
+
+        std::map<int, std::vector<uint32_t>> atlased;
+        for (const auto& [key, members] : groups) {
+            const auto [channels, width, height] = key;
+            const bool fits_atlas{ align_up(static_cast<uint32_t>(std::max(width, height)) + options.atlas_padding * 2, rect_alignment) <= options.atlas_size };
+            if (members.size() < options.min_array_layers && fits_atlas) {
+                atlased[channels].insert(atlased[channels].end(), members.begin(), members.end());
+                continue;
+            }
+
+            const uint32_t levels{ mipmapped ? mip_count(static_cast<uint32_t>(std::max(width, height))) : 1 };
+            for (std::size_t first = 0; first < members.size(); first += static_cast<std::size_t>(max_layers)) {
+                const uint32_t layers{ static_cast<uint32_t>(std::min(members.size() - first, static_cast<std::size_t>(max_layers))) };
+                const uint32_t array{ create_array(static_cast<uint32_t>(width), static_cast<uint32_t>(height), layers, levels, channels, options.wrap_option) };
+                for (uint32_t layer = 0; layer < layers; ++layer) {
+                    const uint32_t image{ members[first + layer] };
+                    upload_layer(array, layer, images[image].pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), levels, channels, options.mip_options, paths[image].c_str());
+                    _slots[image] = { .texture_unit = static_cast<int32_t>(_first_unit + array), .layer = layer };
+                }
+            }
+        }
+
+        uint64_t atlas_texels{ 0 };
+        uint64_t covered_texels{ 0 };
+        for (auto& [channels, members] : atlased) {
+            std::stable_sort(members.begin(), members.end(), [&images](uint32_t lhs, uint32_t rhs) {
+                return images[lhs].height > images[rhs].height;
+            });
+
+            // the smallest power of two page that takes everything, several pages of atlas_size otherwise
+            std::vector<Placement> placements(images.size());
+            uint32_t page_size{ std::min(256u, options.atlas_size) };
+            for (uint32_t image : members) {
+                const uint32_t largest{ static_cast<uint32_t>(std::max(images[image].width, images[image].height)) };
+                while (page_size < options.atlas_size && align_up(largest + options.atlas_padding * 2, rect_alignment) > page_size) {
+                    page_size = std::min(page_size * 2, options.atlas_size);
+                }
+            }
+            uint32_t pages{ pack_shelves(images, members, page_size, options.atlas_padding, rect_alignment, placements) };
+            while (pages > 1 && page_size < options.atlas_size) {
+                page_size = std::min(page_size * 2, options.atlas_size);
+                pages = pack_shelves(images, members, page_size, options.atlas_padding, rect_alignment, placements);
+            }
+
+            std::vector<std::vector<uint8_t>> page_pixels(pages, std::vector<uint8_t>(static_cast<std::size_t>(page_size) * page_size * channels, 0));
+            pool.parallel_for(static_cast<uint32_t>(members.size()), [&](uint32_t m) {
+                const uint32_t image{ members[m] };
+                const Placement& placement{ placements[image] };
+                blit_padded(images[image], page_pixels[placement.page].data(), page_size, placement.x + options.atlas_padding, placement.y + options.atlas_padding, options.atlas_padding, options.mip_options.wrap);
+            });
+
+            // rects don't wrap into each other, the padding already holds whatever should be sampled past an edge
+            MipOptions page_mip_options{ options.mip_options };
+            page_mip_options.wrap = false;
+            const uint32_t array{ create_array(page_size, page_size, pages, atlas_levels, channels, GL_CLAMP_TO_EDGE) };
+            for (uint32_t page = 0; page < pages; ++page) {
+                upload_layer(array, page, page_pixels[page].data(), page_size, page_size, atlas_levels, channels, page_mip_options, nullptr);
+            }
+
+            for (uint32_t image : members) {
+                const Placement& placement{ placements[image] };
+                _slots[image] = {
+                    .texture_unit = static_cast<int32_t>(_first_unit + array),
+                    .layer = placement.page,
+                    .uv_scale = { static_cast<float>(images[image].width) / page_size, static_cast<float>(images[image].height) / page_size },
+                    .uv_offset = { static_cast<float>(placement.x + options.atlas_padding) / page_size, static_cast<float>(placement.y + options.atlas_padding) / page_size },
+                };
+                covered_texels += static_cast<uint64_t>(images[image].width) * images[image].height;
+            }
+            atlas_texels += static_cast<uint64_t>(page_size) * page_size * pages;
+            _stats.atlased += static_cast<uint32_t>(members.size());
+            _stats.atlas_pages += pages;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+        for (Image& image : images) {
+            stbi_image_free(image.pixels);
+        }
+        _stats.arrays = static_cast<uint32_t>(_arrays.size());
+        _stats.atlas_occupancy = atlas_texels > 0 ? static_cast<float>(covered_texels) / atlas_texels : 0.0f;
+        bind();
+    }
+
+    TextureArrays::~TextureArrays() {
+        glDeleteTextures(static_cast<GLsizei>(_arrays.size()), _arrays.data());
+    }
+
+    void TextureArrays::bind() const {
+        for (std::size_t array = 0; array < _arrays.size(); ++array) {
+            glBindTextureUnit(_first_unit + static_cast<GLuint>(array), _arrays[array]);
+        }
+    }
+}
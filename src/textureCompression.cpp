@@ -0,0 +1,930 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <STB_IMG/stb_image.h>
+#include "textureCompression.hpp"
+#include "hash.hpp"
+#include "ktxFile.hpp"
+#include "textureMips.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace my_gl {
+    namespace {
+        // bump whenever an encoder changes its output, cached ktx2 files are rebuilt then
+        constexpr uint64_t compressor_version{ 2 };
+        constexpr int block_pixels{ 16 };
+
+        // index of the closest palette entry for every pixel (squared distance over rgb or rgba), returns the summed error
+        // 'count' is a multiple of 4
+        uint32_t nearest_indices(const uint8_t* pixels, int count, const uint8_t (*palette)[4], int palette_size, bool use_alpha, uint8_t* indices) {
+            uint32_t total{ 0 };
+#if defined(__SSE2__)
+            // four pixels against one palette entry per step, 16 bit differences squared and summed by madd
+            const __m128i zero{ _mm_setzero_si128() };
+            const __m128i mask{ use_alpha ? _mm_set1_epi32(-1) : _mm_set1_epi32(0x00FFFFFF) };
+            for (int i = 0; i < count; i += 4) {
+                const __m128i pixels4{ _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * 4)), mask) };
+                const __m128i lo{ _mm_unpacklo_epi8(pixels4, zero) };
+                const __m128i hi{ _mm_unpackhi_epi8(pixels4, zero) };
+
+                __m128i best{ _mm_set1_epi32(std::numeric_limits<int32_t>::max()) };
+                __m128i best_index{ zero };
+                for (int p = 0; p < palette_size; ++p) {
+                    int32_t entry;
+                    std::memcpy(&entry, palette[p], sizeof(entry));
+                    const __m128i color{ _mm_unpacklo_epi8(_mm_and_si128(_mm_set1_epi32(entry), mask), zero) };
+                    const __m128i diff_lo{ _mm_sub_epi16(lo, color) };
+                    const __m128i diff_hi{ _mm_sub_epi16(hi, color) };
+                    // (r² + g², b² + a²) per pixel, pairs summed across the two registers
+                    const __m128 sum_lo{ _mm_castsi128_ps(_mm_madd_epi16(diff_lo, diff_lo)) };
+                    const __m128 sum_hi{ _mm_castsi128_ps(_mm_madd_epi16(diff_hi, diff_hi)) };
+                    const __m128i distance{ _mm_add_epi32(
+                        _mm_castps_si128(_mm_shuffle_ps(sum_lo, sum_hi, _MM_SHUFFLE(2, 0, 2, 0))),
+                        _mm_castps_si128(_mm_shuffle_ps(sum_lo, sum_hi, _MM_SHUFFLE(3, 1, 3, 1)))
+                    ) };
+
+                    const __m128i closer{ _mm_cmplt_epi32(distance, best) };
+                    best = _mm_or_si128(_mm_and_si128(closer, distance), _mm_andnot_si128(closer, best));
+                    best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, best_index));
+                }
+
+                alignas(16) int32_t distances[4];
+                alignas(16) int32_t closest[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(distances), best);
+                _mm_store_si128(reinterpret_cast<__m128i*>(closest), best_index);
+                for (int k = 0; k < 4; ++k) {
+                    indices[i + k] = static_cast<uint8_t>(closest[k]);
+                    total += static_cast<uint32_t>(distances[k]);
+                }
+            }
+#else
+            const int channels{ use_alpha ? 4 : 3 };
+            for (int i = 0; i < count; ++i) {
+                uint32_t best{ std::numeric_limits<uint32_t>::max() };
+                for (int p = 0; p < palette_size; ++p) {
+                    uint32_t distance{ 0 };
+                    for (int c = 0; c < channels; ++c) {
+                        const int diff{ pixels[i * 4 + c] - palette[p][c] };
+                        distance += static_cast<uint32_t>(diff * diff);
+                    }
+                    if (distance < best) {
+                        best = distance;
+                        indices[i] = static_cast<uint8_t>(p);
+                    }
+                }
+                total += best;
+            }
+#endif
+            return total;
+        }
+
+        // principal axis of the block's colors through power iteration, 'channels' of 3 or 4
+        void principal_axis(const uint8_t* block, int channels, float* mean, float* axis) {
+            float covariance[4][4]{};
+            for (int c = 0; c < channels; ++c) {
+                mean[c] = 0.0f;
+                for (int i = 0; i < block_pixels; ++i) {
+                    mean[c] += block[i * 4 + c];
+                }
+                mean[c] /= block_pixels;
+            }
+            for (int i = 0; i < block_pixels; ++i) {
+                for (int a = 0; a < channels; ++a) {
+                    for (int b = a; b < channels; ++b) {
+                        covariance[a][b] += (block[i * 4 + a] - mean[a]) * (block[i * 4 + b] - mean[b]);
+                    }
+                }
+            }
+            for (int a = 0; a < channels; ++a) {
+                for (int b = 0; b < a; ++b) {
+                    covariance[a][b] = covariance[b][a];
+                }
+            }
+
+            // start from the channel that varies most, flat blocks fall back to the grey axis
+            int widest{ 0 };
+            for (int c = 1; c < channels; ++c) {
+                widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+            }
+            for (int c = 0; c < channels; ++c) {
+                axis[c] = covariance[widest][c];
+            }
+            for (int iteration = 0; iteration < 8; ++iteration) {
+                float next[4]{};
+                float length{ 0.0f };
+                for (int a = 0; a < channels; ++a) {
+                    for (int b = 0; b < channels; ++b) {
+                        next[a] += covariance[a][b] * axis[b];
+                    }
+                    length = std::max(length, std::fabs(next[a]));
+                }
+                if (length < 1e-6f) {
+                    for (int c = 0; c < channels; ++c) {
+                        axis[c] = 1.0f;
+                    }
+                    break;
+                }
+                for (int c = 0; c < channels; ++c) {
+                    axis[c] = next[c] / length;
+                }
+            }
+
+            float length{ 0.0f };
+            for (int c = 0; c < channels; ++c) {
+                length += axis[c] * axis[c];
+            }
+            length = std::sqrt(length);
+            for (int c = 0; c < channels; ++c) {
+                axis[c] /= length;
+            }
+        }
+
+        // colors at the two ends of the block's projection on its principal axis
+        void axis_endpoints(const uint8_t* block, int channels, float* low, float* high) {
+            float mean[4];
+            float axis[4];
+            principal_axis(block, channels, mean, axis);
+
+            float t_min{ std::numeric_limits<float>::max() };
+            float t_max{ std::numeric_limits<float>::lowest() };
+            for (int i = 0; i < block_pixels; ++i) {
+                float t{ 0.0f };
+                for (int c = 0; c < channels; ++c) {
+                    t += (block[i * 4 + c] - mean[c]) * axis[c];
+                }
+                t_min = std::min(t_min, t);
+                t_max = std::max(t_max, t);
+            }
+            for (int c = 0; c < channels; ++c) {
+                low[c] = std::clamp(mean[c] + axis[c] * t_min, 0.0f, 255.0f);
+                high[c] = std::clamp(mean[c] + axis[c] * t_max, 0.0f, 255.0f);
+            }
+        }
+
+        // endpoints minimizing the squared error of the block for fixed indices, weights[i] is how much of 'a' pixel i takes
+        // false when every pixel uses the same weight
+        bool least_squares_endpoints(const uint8_t* block, int channels, const float* weights, float* a, float* b) {
+            float aa{ 0.0f }, ab{ 0.0f }, bb{ 0.0f };
+            float ax[4]{}, bx[4]{};
+            for (int i = 0; i < block_pixels; ++i) {
+                const float wa{ weights[i] };
+                const float wb{ 1.0f - wa };
+                aa += wa * wa;
+                ab += wa * wb;
+                bb += wb * wb;
+                for (int c = 0; c < channels; ++c) {
+                    ax[c] += wa * block[i * 4 + c];
+                    bx[c] += wb * block[i * 4 + c];
+                }
+            }
+            const float determinant{ aa * bb - ab * ab };
+            if (std::fabs(determinant) < 1e-4f) {
+                return false;
+            }
+            for (int c = 0; c < channels; ++c) {
+                a[c] = std::clamp((bb * ax[c] - ab * bx[c]) / determinant, 0.0f, 255.0f);
+                b[c] = std::clamp((aa * bx[c] - ab * ax[c]) / determinant, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+        uint16_t pack_565(const float* color) {
+            const auto quantize{ [](float value, int max) { return static_cast<uint16_t>(std::lround(value * max / 255.0f)); } };
+            return static_cast<uint16_t>((quantize(color[0], 31) << 11) | (quantize(color[1], 63) << 5) | quantize(color[2], 31));
+        }
+
+        void unpack_565(uint16_t packed, uint8_t* color) {
+            const int r{ packed >> 11 };
+            const int g{ (packed >> 5) & 63 };
+            const int b{ packed & 31 };
+            color[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+            color[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+            color[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+            color[3] = 255;
+        }
+
+        // the 4 color palette, also what BC3 always uses
+        void bc1_palette(uint16_t c0, uint16_t c1, uint8_t (*palette)[4]) {
+            unpack_565(c0, palette[0]);
+            unpack_565(c1, palette[1]);
+            for (int c = 0; c < 4; ++c) {
+                palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c]) / 3);
+                palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c]) / 3);
+            }
+        }
+
+        void encode_bc1(const uint8_t* block, uint8_t* out) {
+            float low[3];
+            float high[3];
+            axis_endpoints(block, 3, low, high);
+            // pulled in by 1/16 of the range, the extremes are rarely worth a palette entry each
+            for (int c = 0; c < 3; ++c) {
+                const float inset{ (high[c] - low[c]) / 16.0f };
+                low[c] += inset;
+                high[c] -= inset;
+            }
+
+            uint16_t c0{ pack_565(high) };
+            uint16_t c1{ pack_565(low) };
+            uint8_t palette[4][4];
+            uint8_t indices[block_pixels];
+            bc1_palette(c0, c1, palette);
+            uint32_t error{ nearest_indices(block, block_pixels, palette, 4, false, indices) };
+
+            // two rounds of refitting the endpoints to the chosen indices
+            constexpr float weights_of[4]{ 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+            for (int round = 0; round < 2 && error > 0; ++round) {
+                float weights[block_pixels];
+                for (int i = 0; i < block_pixels; ++i) {
+                    weights[i] = weights_of[indices[i]];
+                }
+                float a[3];
+                float b[3];
+                if (!least_squares_endpoints(block, 3, weights, a, b)) {
+                    break;
+                }
+                const uint16_t refit0{ pack_565(a) };
+                const uint16_t refit1{ pack_565(b) };
+                uint8_t refit_indices[block_pixels];
+                bc1_palette(refit0, refit1, palette);
+                const uint32_t refit_error{ nearest_indices(block, block_pixels, palette, 4, false, refit_indices) };
+                if (refit_error >= error) {
+                    break;
+                }
+                c0 = refit0;
+                c1 = refit1;
+                error = refit_error;
+                std::memcpy(indices, refit_indices, sizeof(indices));
+            }
+
+            // c0 > c1 selects the 4 color mode, swapping the endpoints swaps index 0 with 1 and 2 with 3
+            if (c0 < c1) {
+                std::swap(c0, c1);
+                for (uint8_t& index : indices) {
+                    index ^= 1;
+                }
+            }
+            else if (c0 == c1) {
+                std::fill(std::begin(indices), std::end(indices), 0);
+            }
+
+            uint32_t bits{ 0 };
+            for (int i = 0; i < block_pixels; ++i) {
+                bits |= static_cast<uint32_t>(indices[i]) << (i * 2);
+            }
+            std::memcpy(out, &c0, sizeof(c0));
+            std::memcpy(out + 2, &c1, sizeof(c1));
+            std::memcpy(out + 4, &bits, sizeof(bits));
+        }
+
+        void decode_bc1(const uint8_t* in, uint8_t* block, bool always_four_colors) {
+            uint16_t c0;
+            uint16_t c1;
+            uint32_t bits;
+            std::memcpy(&c0, in, sizeof(c0));
+            std::memcpy(&c1, in + 2, sizeof(c1));
+            std::memcpy(&bits, in + 4, sizeof(bits));
+
+            uint8_t palette[4][4];
+            bc1_palette(c0, c1, palette);
+            if (c0 <= c1 && !always_four_colors) {
+                for (int c = 0; c < 3; ++c) {
+                    palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2);
+                    palette[3][c] = 0;
+                }
+                palette[3][3] = 0;
+            }
+            for (int i = 0; i < block_pixels; ++i) {
+                std::memcpy(block + i * 4, palette[(bits >> (i * 2)) & 3], 4);
+            }
+        }
+
+        // one channel of the rgba block, 8 interpolated values between its min and max
+        void encode_bc4(const uint8_t* block, int channel, uint8_t* out) {
+            int low{ 255 };
+            int high{ 0 };
+            for (int i = 0; i < block_pixels; ++i) {
+                low = std::min<int>(low, block[i * 4 + channel]);
+                high = std::max<int>(high, block[i * 4 + channel]);
+            }
+
+            // r0 > r1 selects the 8 value mode, value i of it lies (8 - i) / 7 of the way from r1 to r0
+            out[0] = static_cast<uint8_t>(high);
+            out[1] = static_cast<uint8_t>(low);
+            uint64_t bits{ 0 };
+            const int range{ high - low };
+            if (range > 0) {
+                for (int i = 0; i < block_pixels; ++i) {
+                    const int step{ ((block[i * 4 + channel] - low) * 14 + range) / (2 * range) };
+                    const uint64_t index{ step == 7 ? 0u : step == 0 ? 1u : static_cast<uint64_t>(8 - step) };
+                    bits |= index << (i * 3);
+                }
+            }
+            for (int b = 0; b < 6; ++b) {
+                out[2 + b] = static_cast<uint8_t>(bits >> (b * 8));
+            }
+        }
+
+        void decode_bc4(const uint8_t* in, uint8_t* block, int channel) {
+            const int r0{ in[0] };
+            const int r1{ in[1] };
+            int values[8]{ r0, r1 };
+            if (r0 > r1) {
+                for (int i = 2; i < 8; ++i) {
+                    values[i] = ((8 - i) * r0 + (i - 1) * r1) / 7;
+                }
+            }
+            else {
+                for (int i = 2; i < 6; ++i) {
+                    values[i] = ((6 - i) * r0 + (i - 1) * r1) / 5;
+                }
+                values[6] = 0;
+                values[7] = 255;
+            }
+
+            uint64_t bits{ 0 };
+            for (int b = 0; b < 6; ++b) {
+                bits |= static_cast<uint64_t>(in[2 + b]) << (b * 8);
+            }
+            for (int i = 0; i < block_pixels; ++i) {
+                block[i * 4 + channel] = static_cast<uint8_t>(values[(bits >> (i * 3)) & 7]);
+            }
+        }
+
+        class BitWriter {
+        public:
+            explicit BitWriter(uint8_t* out)
+                : _out{ out }
+            {}
+
+            void put(uint32_t value, int bits) {
+                for (int b = 0; b < bits; ++b, ++_position) {
+                    _out[_position / 8] |= static_cast<uint8_t>(((value >> b) & 1) << (_position % 8));
+                }
+            }
+
+        private:
+            uint8_t*    _out;
+            int         _position{ 0 };
+        };
+
+        class BitReader {
+        public:
+            explicit BitReader(const uint8_t* in)
+                : _in{ in }
+            {}
+
+            uint32_t get(int bits) {
+                uint32_t value{ 0 };
+                for (int b = 0; b < bits; ++b, ++_position) {
+                    value |= static_cast<uint32_t>((_in[_position / 8] >> (_position % 8)) & 1) << b;
+                }
+                return value;
+            }
+
+        private:
+            const uint8_t*  _in;
+            int             _position{ 0 };
+        };
+
+        constexpr int bc7_weights[16]{ 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        void bc7_palette(const uint8_t* e0, const uint8_t* e1, uint8_t (*palette)[4]) {
+            for (int i = 0; i < 16; ++i) {
+                for (int c = 0; c < 4; ++c) {
+                    palette[i][c] = static_cast<uint8_t>(((64 - bc7_weights[i]) * e0[c] + bc7_weights[i] * e1[c] + 32) >> 6);
+                }
+            }
+        }
+
+        struct Bc7Fit {
+            uint8_t     quantized[2][4];
+            uint8_t     p_bits[2];
+            uint8_t     indices[block_pixels];
+            uint32_t    error{ std::numeric_limits<uint32_t>::max() };
+        };
+
+        // 7 bit endpoints plus one shared lowest bit each, every p bit combination is tried
+        void fit_bc7_mode6(const uint8_t* block, const float* e0, const float* e1, Bc7Fit& best) {
+            for (uint8_t p0 = 0; p0 < 2; ++p0) {
+                for (uint8_t p1 = 0; p1 < 2; ++p1) {
+                    Bc7Fit fit{ .quantized = {}, .p_bits = { p0, p1 }, .indices = {} };
+                    uint8_t expanded[2][4];
+                    for (int c = 0; c < 4; ++c) {
+                        fit.quantized[0][c] = static_cast<uint8_t>(std::clamp(std::lround((e0[c] - p0) / 2.0f), 0l, 127l));
+                        fit.quantized[1][c] = static_cast<uint8_t>(std::clamp(std::lround((e1[c] - p1) / 2.0f), 0l, 127l));
+                        expanded[0][c] = static_cast<uint8_t>((fit.quantized[0][c] << 1) | p0);
+                        expanded[1][c] = static_cast<uint8_t>((fit.quantized[1][c] << 1) | p1);
+                    }
+                    uint8_t palette[16][4];
+                    bc7_palette(expanded[0], expanded[1], palette);
+                    fit.error = nearest_indices(block, block_pixels, palette, 16, true, fit.indices);
+                    if (fit.error < best.error) {
+                        best = fit;
+                    }
+                }
+            }
+        }
+
+        void encode_bc7(const uint8_t* block, uint8_t* out) {
+            float low[4];
+            float high[4];
+            axis_endpoints(block, 4, low, high);
+            Bc7Fit best;
+            fit_bc7_mode6(block, low, high, best);
+
+            // one refit of the endpoints to the chosen indices
+            float weights[block_pixels];
+            for (int i = 0; i < block_pixels; ++i) {
+                weights[i] = (64 - bc7_weights[best.indices[i]]) / 64.0f;
+            }
+            float a[4];
+            float b[4];
+            if (best.error > 0 && least_squares_endpoints(block, 4, weights, a, b)) {
+                fit_bc7_mode6(block, a, b, best);
+            }
+
+            // the msb of the first index is implied 0, swapping the endpoints mirrors every index
+            if (best.indices[0] & 8) {
+                std::swap(best.quantized[0], best.quantized[1]);
+                std::swap(best.p_bits[0], best.p_bits[1]);
+                for (uint8_t& index : best.indices) {
+                    index = static_cast<uint8_t>(15 - index);
+                }
+            }
+
+            std::memset(out, 0, 16);
+            BitWriter writer{ out };
+            // mode 6: six 0 bits, then a 1
+            writer.put(1u << 6, 7);
+            for (int c = 0; c < 4; ++c) {
+                writer.put(best.quantized[0][c], 7);
+                writer.put(best.quantized[1][c], 7);
+            }
+            writer.put(best.p_bits[0], 1);
+            writer.put(best.p_bits[1], 1);
+            writer.put(best.indices[0], 3);
+            for (int i = 1; i < block_pixels; ++i) {
+                writer.put(best.indices[i], 4);
+            }
+        }
+
+        void decode_bc7(const uint8_t* in, uint8_t* block) {
+            BitReader reader{ in };
+            if (reader.get(7) != (1u << 6)) {
+                std::memset(block, 0, block_pixels * 4);
+                return;
+            }
+            uint8_t endpoints[2][4];
+            for (int c = 0; c < 4; ++c) {
+                endpoints[0][c] = static_cast<uint8_t>(reader.get(7) << 1);
+                endpoints[1][c] = static_cast<uint8_t>(reader.get(7) << 1);
+            }
+            const uint32_t p0{ reader.get(1) };
+            const uint32_t p1{ reader.get(1) };
+            for (int c = 0; c < 4; ++c) {
+                endpoints[0][c] |= p0;
+                endpoints[1][c] |= p1;
+            }
+
+            uint8_t palette[16][4];
+            bc7_palette(endpoints[0], endpoints[1], palette);
+            for (int i = 0; i < block_pixels; ++i) {
+                std::memcpy(block + i * 4, palette[reader.get(i == 0 ? 3 : 4)], 4);
+            }
+        }
+
+        // rows: +a, +b, -a, -b for pixel index values 0 to 3
+        constexpr int etc_modifiers[8][4]{
+            { 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+            { 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 },
+        };
+
+        void etc_palette(const int* base, int table, uint8_t (*palette)[4]) {
+            for (int k = 0; k < 4; ++k) {
+                for (int c = 0; c < 3; ++c) {
+                    palette[k][c] = static_cast<uint8_t>(std::clamp(base[c] + etc_modifiers[table][k], 0, 255));
+                }
+                palette[k][3] = 0;
+            }
+        }
+
+        struct EtcSubBlock {
+            // 8 rgba pixels and where they sit, x * 4 + y as the pixel index bits are ordered
+            uint8_t     pixels[8 * 4];
+            int         positions[8];
+            uint8_t     indices[8];
+            int         table;
+            uint32_t    error;
+        };
+
+        void fit_etc_sub_block(const int* base, EtcSubBlock& sub) {
+            sub.error = std::numeric_limits<uint32_t>::max();
+            for (int table = 0; table < 8; ++table) {
+                uint8_t palette[4][4];
+                uint8_t indices[8];
+                etc_palette(base, table, palette);
+                const uint32_t error{ nearest_indices(sub.pixels, 8, palette, 4, false, indices) };
+                if (error < sub.error) {
+                    sub.error = error;
+                    sub.table = table;
+                    std::memcpy(sub.indices, indices, sizeof(indices));
+                }
+            }
+        }
+
+        // the ETC1 individual and differential modes, a valid subset of ETC2 RGB8
+        void encode_etc2_rgb(const uint8_t* block, uint8_t* out) {
+            uint64_t best_bits{ 0 };
+            uint32_t best_error{ std::numeric_limits<uint32_t>::max() };
+
+            for (int flip = 0; flip < 2; ++flip) {
+                // unflipped: left and right 2x4 halves, flipped: top and bottom 4x2 halves
+                EtcSubBlock subs[2];
+                float average[2][3]{};
+                int filled[2]{};
+                for (int y = 0; y < 4; ++y) {
+                    for (int x = 0; x < 4; ++x) {
+                        const int s{ flip ? y / 2 : x / 2 };
+                        EtcSubBlock& sub{ subs[s] };
+                        std::memcpy(sub.pixels + filled[s] * 4, block + (y * 4 + x) * 4, 4);
+                        sub.positions[filled[s]++] = x * 4 + y;
+                        for (int c = 0; c < 3; ++c) {
+                            average[s][c] += block[(y * 4 + x) * 4 + c] / 8.0f;
+                        }
+                    }
+                }
+
+                for (int differential = 0; differential < 2; ++differential) {
+                    int quantized[2][3];
+                    int base[2][3];
+                    bool representable{ true };
+                    for (int s = 0; s < 2; ++s) {
+                        for (int c = 0; c < 3; ++c) {
+                            if (differential) {
+                                quantized[s][c] = static_cast<int>(std::lround(average[s][c] * 31.0f / 255.0f));
+                                base[s][c] = (quantized[s][c] << 3) | (quantized[s][c] >> 2);
+                            }
+                            else {
+                                quantized[s][c] = static_cast<int>(std::lround(average[s][c] * 15.0f / 255.0f));
+                                base[s][c] = quantized[s][c] * 17;
+                            }
+                        }
+                    }
+                    // the second color is a 3 bit signed delta to the first one
+                    for (int c = 0; c < 3 && differential; ++c) {
+                        const int delta{ quantized[1][c] - quantized[0][c] };
+                        representable = representable && delta >= -4 && delta <= 3;
+                    }
+                    if (!representable) {
+                        continue;
+                    }
+
+                    fit_etc_sub_block(base[0], subs[0]);
+                    fit_etc_sub_block(base[1], subs[1]);
+                    const uint32_t error{ subs[0].error + subs[1].error };
+                    if (error >= best_error) {
+                        continue;
+                    }
+
+                    uint64_t bits{ 0 };
+                    for (int c = 0; c < 3; ++c) {
+                        if (differential) {
+                            bits |= static_cast<uint64_t>(quantized[0][c]) << (59 - c * 8);
+                            bits |= static_cast<uint64_t>((quantized[1][c] - quantized[0][c]) & 7) << (56 - c * 8);
+                        }
+                        else {
+                            bits |= static_cast<uint64_t>(quantized[0][c]) << (60 - c * 8);
+                            bits |= static_cast<uint64_t>(quantized[1][c]) << (56 - c * 8);
+                        }
+                    }
+                    bits |= static_cast<uint64_t>(subs[0].table) << 37;
+                    bits |= static_cast<uint64_t>(subs[1].table) << 34;
+                    bits |= static_cast<uint64_t>(differential) << 33;
+                    bits |= static_cast<uint64_t>(flip) << 32;
+                    for (const EtcSubBlock& sub : subs) {
+                        for (int i = 0; i < 8; ++i) {
+                            bits |= static_cast<uint64_t>(sub.indices[i] >> 1) << (16 + sub.positions[i]);
+                            bits |= static_cast<uint64_t>(sub.indices[i] & 1) << sub.positions[i];
+                        }
+                    }
+                    best_bits = bits;
+                    best_error = error;
+                }
+            }
+
+            // big endian
+            for (int b = 0; b < 8; ++b) {
+                out[b] = static_cast<uint8_t>(best_bits >> (56 - b * 8));
+            }
+        }
+
+        void decode_etc2_rgb(const uint8_t* in, uint8_t* block) {
+            uint64_t bits{ 0 };
+            for (int b = 0; b < 8; ++b) {
+                bits = (bits << 8) | in[b];
+            }
+            const bool differential{ ((bits >> 33) & 1) != 0 };
+            const bool flip{ ((bits >> 32) & 1) != 0 };
+
+            int base[2][3];
+            for (int c = 0; c < 3; ++c) {
+                if (differential) {
+                    const int first{ static_cast<int>((bits >> (59 - c * 8)) & 31) };
+                    const int delta{ static_cast<int>(((bits >> (56 - c * 8)) & 7) ^ 4) - 4 };
+                    const int second{ first + delta };
+                    // overflowing deltas select the ETC2 T, H and planar modes
+                    if (second < 0 || second > 31) {
+                        std::memset(block, 0, block_pixels * 4);
+                        return;
+                    }
+                    base[0][c] = (first << 3) | (first >> 2);
+                    base[1][c] = (second << 3) | (second >> 2);
+                }
+                else {
+                    base[0][c] = static_cast<int>((bits >> (60 - c * 8)) & 15) * 17;
+                    base[1][c] = static_cast<int>((bits >> (56 - c * 8)) & 15) * 17;
+                }
+            }
+            const int tables[2]{ static_cast<int>((bits >> 37) & 7), static_cast<int>((bits >> 34) & 7) };
+
+            for (int y = 0; y < 4; ++y) {
+                for (int x = 0; x < 4; ++x) {
+                    const int s{ flip ? y / 2 : x / 2 };
+                    const int position{ x * 4 + y };
+                    const int index{ static_cast<int>((((bits >> (16 + position)) & 1) << 1) | ((bits >> position) & 1)) };
+                    uint8_t* pixel{ block + (y * 4 + x) * 4 };
+                    for (int c = 0; c < 3; ++c) {
+                        pixel[c] = static_cast<uint8_t>(std::clamp(base[s][c] + etc_modifiers[tables[s]][index], 0, 255));
+                    }
+                    pixel[3] = 255;
+                }
+            }
+        }
+
+        void encode_block(const uint8_t* block, BlockFormat format, uint8_t* out) {
+            switch (format) {
+            case BlockFormat::BC1:
+                encode_bc1(block, out);
+                break;
+            case BlockFormat::BC3:
+                encode_bc4(block, 3, out);
+                encode_bc1(block, out + 8);
+                break;
+            case BlockFormat::BC4:
+                encode_bc4(block, 0, out);
+                break;
+            case BlockFormat::BC5:
+                encode_bc4(block, 0, out);
+                encode_bc4(block, 1, out + 8);
+                break;
+            case BlockFormat::BC7:
+                encode_bc7(block, out);
+                break;
+            case BlockFormat::ETC2_RGB:
+                encode_etc2_rgb(block, out);
+                break;
+            }
+        }
+
+        void decode_block(const uint8_t* in, BlockFormat format, uint8_t* block) {
+            // channels a format doesn't store
+            for (int i = 0; i < block_pixels; ++i) {
+                block[i * 4] = 0;
+                block[i * 4 + 1] = 0;
+                block[i * 4 + 2] = 0;
+                block[i * 4 + 3] = 255;
+            }
+            switch (format) {
+            case BlockFormat::BC1:
+                decode_bc1(in, block, false);
+                break;
+            case BlockFormat::BC3:
+                decode_bc1(in + 8, block, true);
+                decode_bc4(in, block, 3);
+                break;
+            case BlockFormat::BC4:
+                decode_bc4(in, block, 0);
+                break;
+            case BlockFormat::BC5:
+                decode_bc4(in, block, 0);
+                decode_bc4(in + 8, block, 1);
+                break;
+            case BlockFormat::BC7:
+                decode_bc7(in, block);
+                break;
+            case BlockFormat::ETC2_RGB:
+                decode_etc2_rgb(in, block);
+                break;
+            }
+        }
+
+        int stored_channels(BlockFormat format) {
+            switch (format) {
+            case BlockFormat::BC4:      return 1;
+            case BlockFormat::BC5:      return 2;
+            case BlockFormat::BC1:
+            case BlockFormat::ETC2_RGB: return 3;
+            default:                    return 4;
+            }
+        }
+
+        double psnr(const uint8_t* a, const uint8_t* b, std::size_t pixel_count, int channels) {
+            double squared{ 0.0 };
+            for (std::size_t i = 0; i < pixel_count; ++i) {
+                for (int c = 0; c < channels; ++c) {
+                    const double diff{ static_cast<double>(a[i * 4 + c]) - b[i * 4 + c] };
+                    squared += diff * diff;
+                }
+            }
+            const double mse{ squared / (static_cast<double>(pixel_count) * channels) };
+            return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+        }
+
+        double elapsed_ms(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    uint32_t block_format_vk(BlockFormat format) {
+        switch (format) {
+        case BlockFormat::BC1:      return 131;
+        case BlockFormat::BC3:      return 137;
+        case BlockFormat::BC4:      return 139;
+        case BlockFormat::BC5:      return 141;
+        case BlockFormat::BC7:      return 145;
+        default:                    return 147;
+        }
+    }
+
+    bool find_block_format(uint32_t vk_format, BlockFormat& format) {
+        for (const BlockFormat candidate : { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7, BlockFormat::ETC2_RGB }) {
+            if (block_format_vk(candidate) == vk_format) {
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char* block_format_name(BlockFormat format) {
+        switch (format) {
+        case BlockFormat::BC1:      return "bc1";
+        case BlockFormat::BC3:      return "bc3";
+        case BlockFormat::BC4:      return "bc4";
+        case BlockFormat::BC5:      return "bc5";
+        case BlockFormat::BC7:      return "bc7";
+        default:                    return "etc2";
+        }
+    }
+
+    std::size_t block_format_bytes(BlockFormat format) {
+        return find_ktx_format(block_format_vk(format))->block_bytes;
+    }
+
+    bool is_block_format_supported(BlockFormat format) {
+        switch (format) {
+        case BlockFormat::BC1:
+        case BlockFormat::BC3:      return GLEW_EXT_texture_compression_s3tc;
+        case BlockFormat::BC4:
+        case BlockFormat::BC5:      return GLEW_VERSION_3_0;
+        case BlockFormat::BC7:      return GLEW_VERSION_4_2 || GLEW_ARB_texture_compression_bptc;
+        default:                    return GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility;
+        }
+    }
+
+    BlockFormat default_block_format(int color_channels) {
+        switch (color_channels) {
+        case 1:     return BlockFormat::BC4;
+        case 2:     return BlockFormat::BC5;
+        case 3:     return BlockFormat::BC1;
+        default:    return BlockFormat::BC7;
+        }
+    }
+
+    std::vector<uint8_t> compress_blocks(const uint8_t* rgba, int width, int height, BlockFormat format, ThreadPool& pool) {
+        const int blocks_x{ (width + 3) / 4 };
+        const int blocks_y{ (height + 3) / 4 };
+        const std::size_t bytes{ block_format_bytes(format) };
+        std::vector<uint8_t> out(static_cast<std::size_t>(blocks_x) * blocks_y * bytes);
+
+        pool.parallel_for(static_cast<uint32_t>(blocks_y), [&](uint32_t block_y) {
+            alignas(16) uint8_t block[block_pixels * 4];
+            for (int block_x = 0; block_x < blocks_x; ++block_x) {
+                for (int y = 0; y < 4; ++y) {
+                    const int source_y{ std::min(static_cast<int>(block_y) * 4 + y, height - 1) };
+                    for (int x = 0; x < 4; ++x) {
+                        const int source_x{ std::min(block_x * 4 + x, width - 1) };
+                        std::memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<std::size_t>(source_y) * width + source_x) * 4, 4);
+                    }
+                }
+                encode_block(block, format, out.data() + (static_cast<std::size_t>(block_y) * blocks_x + block_x) * bytes);
+            }
+        });
+        return out;
+    }
+
+    void decompress_blocks(const uint8_t* blocks, int width, int height, BlockFormat format, uint8_t* rgba) {
+        const int blocks_x{ (width + 3) / 4 };
+        const int blocks_y{ (height + 3) / 4 };
+        const std::size_t bytes{ block_format_bytes(format) };
+
+        uint8_t block[block_pixels * 4];
+        for (int block_y = 0; block_y < blocks_y; ++block_y) {
+            for (int block_x = 0; block_x < blocks_x; ++block_x) {
+                decode_block(blocks + (static_cast<std::size_t>(block_y) * blocks_x + block_x) * bytes, format, block);
+                for (int y = 0; y < 4 && block_y * 4 + y < height; ++y) {
+                    for (int x = 0; x < 4 && block_x * 4 + x < width; ++x) {
+                        std::memcpy(rgba + ((static_cast<std::size_t>(block_y) * 4 + y) * width + block_x * 4 + x) * 4, block + (y * 4 + x) * 4, 4);
+                    }
+                }
+            }
+        }
+    }
+
+    std::string compressed_texture_path(const char* image_path, BlockFormat format) {
+        return std::string{ image_path } + '.' + block_format_name(format) + ".ktx2";
+    }
+
+    std::string compress_texture_cached(const char* image_path, BlockFormat format, ThreadPool& pool, TextureCompressionStats* stats) {
+        const std::string ktx_path{ compressed_texture_path(image_path, format) };
+        const uint64_t source_hash{ hash_file(image_path, compressor_version) };
+        if (source_hash == 0) {
+            std::cerr << "can't read image to compress: " << image_path << '\n';
+            return {};
+        }
+
+        std::error_code error;
+        if (std::filesystem::exists(ktx_path, error)) {
+            const KtxFile cached{ ktx_path.c_str() };
+            if (cached.is_valid() && cached.source_hash() == source_hash && cached.format().vk_format == block_format_vk(format)) {
+                return ktx_path;
+            }
+        }
+
+        int width, height, channels;
+        uint8_t* pixels{ stbi_load(image_path, &width, &height, &channels, 4) };
+        if (!pixels) {
+            std::cerr << "can't read image to compress: " << image_path << '\n';
+            return {};
+        }
+        // one and two channel formats hold data (height, normal maps) rather than colors
+        const MipOptions mip_options{ .srgb = format != BlockFormat::BC4 && format != BlockFormat::BC5 };
+        std::vector<std::vector<uint8_t>> levels{ generate_mips(pixels, width, height, 4, mip_options, pool) };
+        stbi_image_free(pixels);
+
+        const auto start{ std::chrono::steady_clock::now() };
+        for (std::size_t i = 0; i < levels.size(); ++i) {
+            levels[i] = compress_blocks(levels[i].data(), std::max(width >> i, 1), std::max(height >> i, 1), format, pool);
+        }
+        const double encode_ms{ elapsed_ms(start) };
+
+        if (!write_ktx2(ktx_path.c_str(), block_format_vk(format), static_cast<uint32_t>(width), static_cast<uint32_t>(height), levels, source_hash)) {
+            return {};
+        }
+        if (stats) {
+            *stats = measure_texture_compression(image_path, format, pool, 1);
+            stats->levels = static_cast<uint32_t>(levels.size());
+            stats->encode_ms = encode_ms;
+        }
+        return ktx_path;
+    }
+
+    TextureCompressionStats measure_texture_compression(const char* image_path, BlockFormat format, ThreadPool& pool, int repeats) {
+        TextureCompressionStats stats;
+        int width, height, channels;
+        uint8_t* pixels{ stbi_load(image_path, &width, &height, &channels, 4) };
+        if (!pixels || repeats < 1) {
+            stbi_image_free(pixels);
+            return stats;
+        }
+
+        std::vector<uint8_t> blocks;
+        const auto start{ std::chrono::steady_clock::now() };
+        for (int r = 0; r < repeats; ++r) {
+            blocks = compress_blocks(pixels, width, height, format, pool);
+        }
+        stats.encode_ms = elapsed_ms(start) / repeats;
+
+        const std::size_t pixel_count{ static_cast<std::size_t>(width) * height };
+        std::vector<uint8_t> decoded(pixel_count * 4);
+        decompress_blocks(blocks.data(), width, height, format, decoded.data());
+
+        stats.width = width;
+        stats.height = height;
+        stats.levels = 1;
+        stats.compressed_bytes = blocks.size();
+        stats.ratio = static_cast<double>(pixel_count * 4) / blocks.size();
+        stats.psnr_db = psnr(pixels, decoded.data(), pixel_count, stored_channels(format));
+        stats.megapixels_per_s = stats.encode_ms > 0.0 ? pixel_count / (stats.encode_ms * 1000.0) : 0.0;
+        stbi_image_free(pixels);
+        return stats;
+    }
+}
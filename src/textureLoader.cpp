@@ -0,0 +1,226 @@
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include "ktxFile.hpp"
+#include "textureLoader.hpp"
+#include "textureMips.hpp"
+
+namespace my_gl {
+    // outlives the loader while workers still decode into it
+    struct TextureLoader::Queue {
+        struct Decoded {
+            std::weak_ptr<Texture::State>   texture;
+            uint8_t*                        pixels{ nullptr };
+            int                             width{ 0 };
+            int                             height{ 0 };
+            int                             color_channels{ 0 };
+            // .ktx2 files (given or the cached mip chain) are mapped instead of decoded
+            std::unique_ptr<KtxFile>        ktx;
+            std::string                     path;
+        };
+
+        ~Queue() {
+            for (Decoded& entry : decoded) {
+                stbi_image_free(entry.pixels);
+            }
+        }
+
+        std::mutex                  mutex;
+        std::condition_variable     cv;
+        std::deque<Decoded>         decoded;
+    };
+
+    TextureLoader::TextureLoader(ThreadPool& pool, std::size_t staging_bytes)
+        : _pool{ pool }
+        , _queue{ std::make_shared<Queue>() }
+        , _staging_size{ staging_bytes }
+    {
+        const uint8_t grey[4]{ 128, 128, 128, 255 };
+        glCreateTextures(GL_TEXTURE_2D, 1, &_placeholder);
+        glTextureStorage2D(_placeholder, 1, GL_RGBA8, 1, 1);
+        glTextureSubImage2D(_placeholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTextureParameteri(_placeholder, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(_placeholder, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        if (_staging_size == 0) {
+            return;
+        }
+        // written by the cpu while the gpu reads older uploads out of it, fences keep the two apart
+        const GLbitfield flags{ GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT };
+        glCreateBuffers(1, &_staging);
+        glNamedBufferStorage(_staging, static_cast<GLsizeiptr>(_staging_size), nullptr, flags);
+        _staging_data = static_cast<uint8_t*>(glMapNamedBufferRange(_staging, 0, static_cast<GLsizeiptr>(_staging_size), flags));
+        if (!_staging_data) {
+            std::cerr << "failed to map the texture staging buffer, uploading from client memory\n";
+            _staging_size = 0;
+        }
+    }
+
+    TextureLoader::~TextureLoader() {
+        for (const InFlight& upload : _in_flight) {
+            glDeleteSync(upload.fence);
+        }
+        if (_staging_data) {
+            glUnmapNamedBuffer(_staging);
+        }
+        glDeleteBuffers(1, &_staging);
+        glDeleteTextures(1, &_placeholder);
+    }
+
+    void TextureLoader::request(const std::shared_ptr<Texture::State>& texture, const char* path) {
+        ++_pending;
+        ++_stats.requested;
+
+        // read here, the last reference to a texture must not go away on a worker
+        const bool cpu_mips{ texture->mipmapped && !is_ktx2_path(path) };
+        const MipOptions mip_options{ .wrap = texture->repeats };
+
+        _pool.submit([queue = _queue, texture = std::weak_ptr<Texture::State>{ texture }, path = std::string{ path }, cpu_mips, mip_options, &pool = _pool]() {
+            Queue::Decoded decoded{ .texture = texture, .ktx = nullptr, .path = path };
+            // the cached chain when there is one, the image and glGenerateMipmap otherwise
+            const std::string mips_path{ cpu_mips && !texture.expired() ? generate_mips_cached(path.c_str(), mip_options, pool) : std::string{} };
+            // textures dropped while queued aren't worth decoding
+            if (!texture.expired() && (!mips_path.empty() || is_ktx2_path(path))) {
+                decoded.ktx = std::make_unique<KtxFile>(mips_path.empty() ? path.c_str() : mips_path.c_str());
+            }
+            else if (!texture.expired()) {
+                decoded.pixels = stbi_load(path.c_str(), &decoded.width, &decoded.height, &decoded.color_channels, 0);
+            }
+            {
+                std::lock_guard<std::mutex> lock{ queue->mutex };
+                queue->decoded.push_back(std::move(decoded));
+            }
+            queue->cv.notify_one();
+        });
+    }
+
+    uint32_t TextureLoader::update(std::size_t byte_budget) {
+        // uploads the gpu is done with, keeps the list short
+        while (!_in_flight.empty() && glClientWaitSync(_in_flight.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+            glDeleteSync(_in_flight.front().fence);
+            _in_flight.pop_front();
+        }
+
+        uint32_t resident{ 0 };
+        std::size_t sent{ 0 };
+        while (sent < byte_budget) {
+            Queue::Decoded decoded;
+            {
+                std::lock_guard<std::mutex> lock{ _queue->mutex };
+                if (_queue->decoded.empty()) {
+                    break;
+                }
+                decoded = std::move(_queue->decoded.front());
+                _queue->decoded.pop_front();
+            }
+            --_pending;
+
+            const std::shared_ptr<Texture::State> texture{ decoded.texture.lock() };
+            if (!texture) {
+                stbi_image_free(decoded.pixels);
+                continue;
+            }
+            if (decoded.ktx && decoded.ktx->is_valid()) {
+                std::size_t size{ 0 };
+                for (uint32_t level = 0; level < decoded.ktx->level_count(); ++level) {
+                    size += decoded.ktx->level(level).size();
+                }
+                if (size <= _staging_size) {
+                    const std::size_t offset{ allocate(size) };
+                    std::size_t level_offset{ offset };
+                    for (uint32_t level = 0; level < decoded.ktx->level_count(); ++level) {
+                        std::memcpy(_staging_data + level_offset, decoded.ktx->level(level).data(), decoded.ktx->level(level).size());
+                        level_offset += decoded.ktx->level(level).size();
+                    }
+
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _staging);
+                    Texture::store(*texture, *decoded.ktx, true, offset);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                    _in_flight.push_back({ offset, offset + size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+                }
+                else {
+                    Texture::store(*texture, *decoded.ktx);
+                    ++_stats.unstaged;
+                }
+
+                sent += size;
+                ++resident;
+                ++_stats.uploaded;
+                _stats.uploaded_bytes += size;
+                continue;
+            }
+            if (!decoded.pixels) {
+                std::cerr << "failed to load texture from path: " << decoded.path << '\n';
+                ++_stats.failed;
+                continue;
+            }
+
+            const std::size_t size{ static_cast<std::size_t>(decoded.width) * decoded.height * decoded.color_channels };
+            if (size <= _staging_size) {
+                const std::size_t offset{ allocate(size) };
+                std::memcpy(_staging_data + offset, decoded.pixels, size);
+
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _staging);
+                Texture::store(*texture, decoded.width, decoded.height, decoded.color_channels, reinterpret_cast<const void*>(offset));
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                _in_flight.push_back({ offset, offset + size, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+            }
+            else {
+                Texture::store(*texture, decoded.width, decoded.height, decoded.color_channels, decoded.pixels);
+                ++_stats.unstaged;
+            }
+            stbi_image_free(decoded.pixels);
+
+            sent += size;
+            ++resident;
+            ++_stats.uploaded;
+            _stats.uploaded_bytes += size;
+        }
+        return resident;
+    }
+
+    void TextureLoader::finish() {
+        while (_pending > 0) {
+            {
+                std::unique_lock<std::mutex> lock{ _queue->mutex };
+                _queue->cv.wait(lock, [this]() { return !_queue->decoded.empty(); });
+            }
+            update(std::numeric_limits<std::size_t>::max());
+        }
+    }
+
+    std::size_t TextureLoader::allocate(std::size_t size) {
+        // a ring, an image that doesn't fit before the end starts over at the front
+        const std::size_t begin{ _staging_head + size <= _staging_size ? _staging_head : 0 };
+        retire(begin, size);
+        _staging_head = begin + size;
+        return begin;
+    }
+
+    void TextureLoader::retire(std::size_t begin, std::size_t size) {
+        std::size_t overlapping{ 0 };
+        for (std::size_t i = 0; i < _in_flight.size(); ++i) {
+            if (_in_flight[i].begin < begin + size && begin < _in_flight[i].end) {
+                overlapping = i + 1;
+            }
+        }
+        if (overlapping == 0) {
+            return;
+        }
+
+        // fences signal in submission order, the newest overlapping one covers every older upload
+        const GLsync fence{ _in_flight[overlapping - 1].fence };
+        if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+            ++_stats.staging_stalls;
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000) == GL_TIMEOUT_EXPIRED) {
+            }
+        }
+        for (std::size_t i = 0; i < overlapping; ++i) {
+            glDeleteSync(_in_flight.front().fence);
+            _in_flight.pop_front();
+        }
+    }
+}
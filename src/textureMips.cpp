@@ -0,0 +1,364 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <numbers>
+#include <STB_IMG/stb_image.h>
+#include "textureMips.hpp"
+#include "hash.hpp"
+#include "ktxFile.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace my_gl {
+    namespace {
+        // bump whenever the filtering changes its output, cached ktx2 files are rebuilt then
+        constexpr uint64_t mips_version{ 1 };
+        // R8, RG8, RGB8, RGBA8 unorm by channel count
+        constexpr uint32_t vk_formats[4]{ 9, 16, 23, 37 };
+
+        float srgb_to_linear(float value) {
+            return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        float linear_to_srgb(float value) {
+            return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        }
+
+        const std::array<float, 256>& srgb_decode_table() {
+            static const std::array<float, 256> table{ []() {
+                std::array<float, 256> values;
+                for (int i = 0; i < 256; ++i) {
+                    values[i] = srgb_to_linear(i / 255.0f);
+                }
+                return values;
+            }() };
+            return table;
+        }
+
+        // indexed by the linear value in 16 bit steps, fine enough that the darkest srgb codes stay apart
+        const std::array<uint8_t, 65536>& srgb_encode_table() {
+            static const std::array<uint8_t, 65536> table{ []() {
+                std::array<uint8_t, 65536> values;
+                for (int i = 0; i < 65536; ++i) {
+                    values[i] = static_cast<uint8_t>(std::lround(linear_to_srgb(i / 65535.0f) * 255.0f));
+                }
+                return values;
+            }() };
+            return table;
+        }
+
+        double bessel_i0(double x) {
+            double sum{ 1.0 };
+            double term{ 1.0 };
+            for (int k = 1; k < 32; ++k) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // radius in texels of the smaller level
+        float filter_support(MipFilter filter) {
+            switch (filter) {
+            case MipFilter::Box:        return 0.5f;
+            case MipFilter::Triangle:   return 1.0f;
+            case MipFilter::Mitchell:   return 2.0f;
+            default:                    return 3.0f;
+            }
+        }
+
+        float filter_weight(MipFilter filter, float x) {
+            x = std::abs(x);
+            switch (filter) {
+            case MipFilter::Triangle:
+                return std::max(1.0f - x, 0.0f);
+            case MipFilter::Mitchell: {
+                constexpr float b{ 1.0f / 3.0f };
+                constexpr float c{ 1.0f / 3.0f };
+                if (x < 1.0f) {
+                    return ((12.0f - 9.0f * b - 6.0f * c) * x * x * x + (-18.0f + 12.0f * b + 6.0f * c) * x * x + (6.0f - 2.0f * b)) / 6.0f;
+                }
+                if (x < 2.0f) {
+                    return ((-b - 6.0f * c) * x * x * x + (6.0f * b + 30.0f * c) * x * x + (-12.0f * b - 48.0f * c) * x + (8.0f * b + 24.0f * c)) / 6.0f;
+                }
+                return 0.0f;
+            }
+            case MipFilter::Kaiser: {
+                constexpr double alpha{ 4.0 };
+                const double width{ filter_support(filter) };
+                if (x >= width) {
+                    return 0.0f;
+                }
+                const double sinc{ x < 1e-6f ? 1.0 : std::sin(std::numbers::pi * x) / (std::numbers::pi * x) };
+                const double ratio{ x / width };
+                return static_cast<float>(sinc * bessel_i0(alpha * std::sqrt(1.0 - ratio * ratio)) / bessel_i0(alpha));
+            }
+            default:
+                return x <= 0.5f ? 1.0f : 0.0f;
+            }
+        }
+
+        // the taps of every texel of the smaller level along one axis, sources already clamped or wrapped
+        struct Taps {
+            std::vector<uint32_t>   first;
+            std::vector<uint32_t>   sources;
+            std::vector<float>      weights;
+
+            uint32_t count(int texel) const { return first[texel + 1] - first[texel]; }
+        };
+
+        Taps make_taps(int source_size, int size, const MipOptions& options) {
+            Taps taps;
+            taps.first.reserve(size + 1);
+            const float scale{ static_cast<float>(source_size) / size };
+            const float radius{ filter_support(options.filter) * scale };
+            for (int i = 0; i < size; ++i) {
+                taps.first.push_back(static_cast<uint32_t>(taps.sources.size()));
+                const float center{ (i + 0.5f) * scale };
+                const std::size_t begin{ taps.weights.size() };
+                float total{ 0.0f };
+                for (int j = static_cast<int>(std::floor(center - radius)); j <= static_cast<int>(std::ceil(center + radius)); ++j) {
+                    // the box filter covers source texels by area, point samples of it miss the edges of odd sizes
+                    const float weight{ options.filter == MipFilter::Box
+                        ? std::max(std::min(j + 1.0f, center + radius) - std::max(static_cast<float>(j), center - radius), 0.0f)
+                        : filter_weight(options.filter, (j + 0.5f - center) / scale) };
+                    if (weight == 0.0f) {
+                        continue;
+                    }
+                    const int source{ options.wrap ? (j % source_size + source_size) % source_size : std::clamp(j, 0, source_size - 1) };
+                    taps.sources.push_back(static_cast<uint32_t>(source));
+                    taps.weights.push_back(weight);
+                    total += weight;
+                }
+                for (std::size_t t = begin; t < taps.weights.size(); ++t) {
+                    taps.weights[t] /= total;
+                }
+            }
+            taps.first.push_back(static_cast<uint32_t>(taps.sources.size()));
+            return taps;
+        }
+
+        // 4 floats per texel: color in r, g, b (grey in r), alpha in a
+        struct Level {
+            int                 width;
+            int                 height;
+            std::vector<float>  texels;
+        };
+
+        int alpha_channel(int channels) {
+            return channels == 2 ? 1 : channels == 4 ? 3 : -1;
+        }
+
+        int color_channels(int channels) {
+            return channels == 2 ? 1 : std::min(channels, 3);
+        }
+
+        Level load_level(const uint8_t* pixels, int width, int height, int channels, const MipOptions& options) {
+            const std::array<float, 256>& decode{ srgb_decode_table() };
+            const int alpha{ alpha_channel(channels) };
+            const int colors{ color_channels(channels) };
+            Level level{ width, height, std::vector<float>(static_cast<std::size_t>(width) * height * 4, 0.0f) };
+            for (std::size_t i = 0; i < static_cast<std::size_t>(width) * height; ++i) {
+                const uint8_t* in{ pixels + i * channels };
+                float* out{ level.texels.data() + i * 4 };
+                out[3] = alpha < 0 ? 1.0f : in[alpha] / 255.0f;
+                const float weight{ options.alpha_weighted ? out[3] : 1.0f };
+                for (int c = 0; c < colors; ++c) {
+                    out[c] = (options.srgb ? decode[in[c]] : in[c] / 255.0f) * weight;
+                }
+            }
+            return level;
+        }
+
+        void store_rows(const Level& level, int first_row, int last_row, int channels, const MipOptions& options, uint8_t* pixels) {
+            const std::array<uint8_t, 65536>& encode{ srgb_encode_table() };
+            const int alpha{ alpha_channel(channels) };
+            const int colors{ color_channels(channels) };
+            for (std::size_t i = static_cast<std::size_t>(first_row) * level.width; i < static_cast<std::size_t>(last_row) * level.width; ++i) {
+                const float* in{ level.texels.data() + i * 4 };
+                uint8_t* out{ pixels + i * channels };
+                // alpha weighted color is divided back out, transparent texels have none left
+                const float weight{ options.alpha_weighted ? in[3] : 1.0f };
+                for (int c = 0; c < colors; ++c) {
+                    const float value{ weight > 0.0f ? std::clamp(in[c] / weight, 0.0f, 1.0f) : 0.0f };
+                    out[c] = options.srgb ? encode[static_cast<uint32_t>(value * 65535.0f + 0.5f)] : static_cast<uint8_t>(value * 255.0f + 0.5f);
+                }
+                if (alpha >= 0) {
+                    out[alpha] = static_cast<uint8_t>(in[3] * 255.0f + 0.5f);
+                }
+            }
+        }
+
+        // one row of 'source' filtered along x into 'out', taps.first.size() - 1 texels
+        void filter_row(const float* source, const Taps& taps, float* out) {
+            const int width{ static_cast<int>(taps.first.size()) - 1 };
+            for (int x = 0; x < width; ++x) {
+#if defined(__SSE2__)
+                __m128 sum{ _mm_setzero_ps() };
+                for (uint32_t t = taps.first[x]; t < taps.first[x + 1]; ++t) {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weights[t]), _mm_loadu_ps(source + taps.sources[t] * 4)));
+                }
+                _mm_storeu_ps(out + x * 4, sum);
+#else
+                float sum[4]{};
+                for (uint32_t t = taps.first[x]; t < taps.first[x + 1]; ++t) {
+                    for (int c = 0; c < 4; ++c) {
+                        sum[c] += taps.weights[t] * source[taps.sources[t] * 4 + c];
+                    }
+                }
+                std::copy(sum, sum + 4, out + x * 4);
+#endif
+            }
+        }
+
+        // out = sum of weights[t] * rows[t] over 'count' floats, clamped to [0, 1] against filter ringing
+        void filter_column(const float* const* rows, const float* weights, uint32_t tap_count, std::size_t count, float* out) {
+            std::size_t i{ 0 };
+#if defined(__SSE2__)
+            const __m128 zero{ _mm_setzero_ps() };
+            const __m128 one{ _mm_set1_ps(1.0f) };
+            for (; i + 4 <= count; i += 4) {
+                __m128 sum{ zero };
+                for (uint32_t t = 0; t < tap_count; ++t) {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+                }
+                _mm_storeu_ps(out + i, _mm_min_ps(_mm_max_ps(sum, zero), one));
+            }
+#endif
+            for (; i < count; ++i) {
+                float sum{ 0.0f };
+                for (uint32_t t = 0; t < tap_count; ++t) {
+                    sum += weights[t] * rows[t][i];
+                }
+                out[i] = std::clamp(sum, 0.0f, 1.0f);
+            }
+        }
+
+        // bands of rows per parallel_for item, a few per worker so uneven bands even out
+        uint32_t band_count(int rows, const ThreadPool& pool) {
+            return static_cast<uint32_t>(std::min(rows, static_cast<int>(pool.size() + 1) * 4));
+        }
+
+        int band_begin(int rows, uint32_t bands, uint32_t band) {
+            return static_cast<int>(static_cast<int64_t>(rows) * band / bands);
+        }
+
+        uint64_t options_seed(const MipOptions& options) {
+            return mips_version
+                | static_cast<uint64_t>(options.filter) << 8
+                | static_cast<uint64_t>(options.srgb) << 16
+                | static_cast<uint64_t>(options.alpha_weighted) << 17
+                | static_cast<uint64_t>(options.wrap) << 18;
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> generate_mips(
+        const uint8_t*      pixels,
+        int                 width,
+        int                 height,
+        int                 channels,
+        const MipOptions&   options,
+        ThreadPool&         pool
+    ) {
+        std::vector<std::vector<uint8_t>> levels;
+        if (!pixels || width <= 0 || height <= 0 || channels < 1 || channels > 4) {
+            return levels;
+        }
+        levels.emplace_back(pixels, pixels + static_cast<std::size_t>(width) * height * channels);
+
+        Level current{ load_level(pixels, width, height, channels, options) };
+        std::vector<float> rows;
+        bool first{ true };
+        while (current.width > 1 || current.height > 1) {
+            Level next{ std::max(current.width / 2, 1), std::max(current.height / 2, 1), {} };
+            next.texels.resize(static_cast<std::size_t>(next.width) * next.height * 4);
+            const Taps taps_x{ make_taps(current.width, next.width, options) };
+            const Taps taps_y{ make_taps(current.height, next.height, options) };
+
+            // the x pass of this level runs next to the 8 bit store of the previous one, both only read 'current'
+            rows.resize(static_cast<std::size_t>(current.height) * next.width * 4);
+            const uint32_t filter_bands{ band_count(current.height, pool) };
+            const uint32_t store_bands{ first ? 0u : band_count(current.height, pool) };
+            std::vector<uint8_t>& previous{ levels.back() };
+            pool.parallel_for(filter_bands + store_bands, [&](uint32_t band) {
+                if (band < filter_bands) {
+                    for (int y = band_begin(current.height, filter_bands, band); y < band_begin(current.height, filter_bands, band + 1); ++y) {
+                        filter_row(current.texels.data() + static_cast<std::size_t>(y) * current.width * 4, taps_x, rows.data() + static_cast<std::size_t>(y) * next.width * 4);
+                    }
+                    return;
+                }
+                band -= filter_bands;
+                store_rows(current, band_begin(current.height, store_bands, band), band_begin(current.height, store_bands, band + 1), channels, options, previous.data());
+            });
+
+            pool.parallel_for(band_count(next.height, pool), [&](uint32_t band) {
+                const uint32_t bands{ band_count(next.height, pool) };
+                std::vector<const float*> sources;
+                for (int y = band_begin(next.height, bands, band); y < band_begin(next.height, bands, band + 1); ++y) {
+                    sources.clear();
+                    for (uint32_t t = taps_y.first[y]; t < taps_y.first[y + 1]; ++t) {
+                        sources.push_back(rows.data() + static_cast<std::size_t>(taps_y.sources[t]) * next.width * 4);
+                    }
+                    filter_column(sources.data(), taps_y.weights.data() + taps_y.first[y], taps_y.count(y), static_cast<std::size_t>(next.width) * 4, next.texels.data() + static_cast<std::size_t>(y) * next.width * 4);
+                }
+            });
+
+            levels.emplace_back(static_cast<std::size_t>(next.width) * next.height * channels);
+            current = std::move(next);
+            first = false;
+        }
+        if (!first) {
+            store_rows(current, 0, current.height, channels, options, levels.back().data());
+        }
+        return levels;
+    }
+
+    std::string mipmapped_texture_path(const char* image_path) {
+        return std::string{ image_path } + ".mips.ktx2";
+    }
+
+    std::string generate_mips_cached(const char* image_path, const MipOptions& options, ThreadPool& pool, MipStats* stats) {
+        const std::string ktx_path{ mipmapped_texture_path(image_path) };
+        const uint64_t source_hash{ hash_file(image_path, options_seed(options)) };
+        if (source_hash == 0) {
+            std::cerr << "can't read image to mipmap: " << image_path << '\n';
+            return {};
+        }
+
+        std::error_code error;
+        if (std::filesystem::exists(ktx_path, error)) {
+            const KtxFile cached{ ktx_path.c_str() };
+            if (cached.is_valid() && cached.source_hash() == source_hash) {
+                return ktx_path;
+            }
+        }
+
+        int width, height, channels;
+        uint8_t* pixels{ stbi_load(image_path, &width, &height, &channels, 0) };
+        if (!pixels) {
+            std::cerr << "can't read image to mipmap: " << image_path << '\n';
+            return {};
+        }
+        const auto start{ std::chrono::steady_clock::now() };
+        const std::vector<std::vector<uint8_t>> levels{ generate_mips(pixels, width, height, channels, options, pool) };
+        const double generate_ms{ std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+        stbi_image_free(pixels);
+
+        if (!write_ktx2(ktx_path.c_str(), vk_formats[channels - 1], static_cast<uint32_t>(width), static_cast<uint32_t>(height), levels, source_hash)) {
+            return {};
+        }
+        if (stats) {
+            stats->width = width;
+            stats->height = height;
+            stats->levels = static_cast<uint32_t>(levels.size());
+            stats->generate_ms = generate_ms;
+            stats->megapixels_per_s = generate_ms > 0.0 ? static_cast<double>(width) * height / (generate_ms * 1000.0) : 0.0;
+        }
+        return ktx_path;
+    }
+}
@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include "ktxFile.hpp"
+#include "textureCompression.hpp"
+#include "textureMips.hpp"
+#include "textureStreamer.hpp"
+#include "vertexLayout.hpp"
+
+namespace my_gl {
+    namespace {
+        // mutable levels go through the bind point, the caller's binding is put back
+        class ScopedBind {
+        public:
+            explicit ScopedBind(GLuint id) {
+                glGetIntegerv(GL_TEXTURE_BINDING_2D, &_previous);
+                glGetIntegerv(GL_UNPACK_ALIGNMENT, &_alignment);
+                glBindTexture(GL_TEXTURE_2D, id);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            }
+            ScopedBind(const ScopedBind& rhs) = delete;
+            ScopedBind& operator=(const ScopedBind& rhs) = delete;
+            ~ScopedBind() {
+                glPixelStorei(GL_UNPACK_ALIGNMENT, _alignment);
+                glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(_previous));
+            }
+
+        private:
+            GLint   _previous{ 0 };
+            GLint   _alignment{ 4 };
+        };
+    }
+
+    float uv_density(
+        meshes::MeshView                            mesh,
+        const std::vector<meshes::VertexElement>&   format,
+        std::size_t                                 index_offset,
+        std::size_t                                 index_count,
+        std::string_view                            uv_name
+    ) {
+        const std::size_t floats{ meshes::floats_per_vertex(format) };
+        if (floats == 0 || mesh.vertices.size() < floats) {
+            return 0.0f;
+        }
+        const std::size_t vertex_count{ mesh.vertices.size() / floats };
+
+        // planar blocks, positions first
+        std::size_t uv_block{ 0 };
+        const meshes::VertexElement* uv_element{ nullptr };
+        for (const meshes::VertexElement& element : format) {
+            if (element.name == uv_name && element.count >= 2) {
+                uv_element = &element;
+                break;
+            }
+            uv_block += element.count * vertex_count;
+        }
+        if (!uv_element) {
+            return 0.0f;
+        }
+        const float* positions{ mesh.vertices.data() };
+        const float* uvs{ mesh.vertices.data() + uv_block };
+        const std::size_t uv_stride{ uv_element->count };
+
+        index_offset = std::min(index_offset, mesh.indices.size());
+        index_count = std::min(index_count, mesh.indices.size() - index_offset) / 3 * 3;
+
+        // summed before the ratio, so slivers don't outweigh the large triangles
+        double surface_area{ 0.0 };
+        double uv_area{ 0.0 };
+        for (std::size_t i = index_offset; i < index_offset + index_count; i += 3) {
+            const uint32_t a{ mesh.indices[i] };
+            const uint32_t b{ mesh.indices[i + 1] };
+            const uint32_t c{ mesh.indices[i + 2] };
+            if (a >= vertex_count || b >= vertex_count || c >= vertex_count) {
+                continue;
+            }
+
+            float e1[3];
+            float e2[3];
+            for (int k = 0; k < 3; ++k) {
+                e1[k] = positions[b * 3 + k] - positions[a * 3 + k];
+                e2[k] = positions[c * 3 + k] - positions[a * 3 + k];
+            }
+            const float cross[3]{ e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            surface_area += 0.5 * std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+            const float* uv_a{ uvs + a * uv_stride };
+            const float* uv_b{ uvs + b * uv_stride };
+            const float* uv_c{ uvs + c * uv_stride };
+            uv_area += 0.5 * std::abs((uv_b[0] - uv_a[0]) * (uv_c[1] - uv_a[1]) - (uv_c[0] - uv_a[0]) * (uv_b[1] - uv_a[1]));
+        }
+
+        if (surface_area <= 0.0 || uv_area <= 0.0) {
+            return 0.0f;
+        }
+        return static_cast<float>(std::sqrt(uv_area / surface_area));
+    }
+
+    // outlives the streamer while workers still read into it
+    struct TextureStreamer::Queue {
+        struct Prepared {
+            uint32_t                        entry;
+            std::shared_ptr<const KtxFile>  file;
+        };
+
+        struct Level {
+            uint32_t                entry;
+            uint32_t                level;
+            std::vector<uint8_t>    data;
+        };
+
+        std::mutex                  mutex;
+        std::condition_variable     cv;
+        std::deque<Prepared>        prepared;
+        std::deque<Level>           levels;
+    };
+
+    struct TextureStreamer::Entry {
+        std::weak_ptr<Texture::State>   texture;
+        const Texture::State*           key{ nullptr };
+        std::string                     path;
+        // shared with the reads in flight
+        std::shared_ptr<const KtxFile>  file;
+        GLenum                          internal_format{ 0 };
+        // the driver lacks the block format, levels are decompressed to rgba8 on the pool
+        bool                            decompress{ false };
+        BlockFormat                     block_format{};
+        // gpu bytes of every level
+        std::vector<std::size_t>        level_bytes;
+        uint32_t                        level_count{ 0 };
+        // first level of the resident tail
+        uint32_t                        tail_level{ 0 };
+        // finest resident level, level_count while nothing is
+        uint32_t                        base_level{ 0 };
+        // finest level asked for since the last update, level_count if none
+        uint32_t                        frame_level{ 0 };
+        bool                            requested{ false };
+        // finest level of the last update that had requests
+        uint32_t                        wanted_level{ 0 };
+        uint64_t                        last_request{ 0 };
+        bool                            ready{ false };
+        bool                            reading{ false };
+        bool                            released{ false };
+
+        std::size_t resident_bytes() const {
+            std::size_t bytes{ 0 };
+            for (uint32_t level = base_level; level < level_count; ++level) {
+                bytes += level_bytes[level];
+            }
+            return bytes;
+        }
+    };
+
+    TextureStreamer::TextureStreamer(std::size_t budget_bytes, ThreadPool& pool, int tail_size)
+        : _pool{ pool }
+        , _queue{ std::make_shared<Queue>() }
+        , _tail_size{ std::max(tail_size, 1) }
+    {
+        _stats.budget_bytes = budget_bytes;
+
+        const uint8_t grey[4]{ 128, 128, 128, 255 };
+        glCreateTextures(GL_TEXTURE_2D, 1, &_placeholder);
+        glTextureStorage2D(_placeholder, 1, GL_RGBA8, 1, 1);
+        glTextureSubImage2D(_placeholder, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+        glTextureParameteri(_placeholder, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(_placeholder, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    TextureStreamer::~TextureStreamer() {
+        glDeleteTextures(1, &_placeholder);
+    }
+
+    void TextureStreamer::add(const std::shared_ptr<Texture::State>& texture, const char* path) {
+        const uint32_t index{ static_cast<uint32_t>(_entries.size()) };
+        auto entry{ std::make_unique<Entry>() };
+        entry->texture = texture;
+        entry->key = texture.get();
+        entry->path = path;
+        _entries.push_back(std::move(entry));
+        // a new state can reuse the address of a released one that update didn't notice yet
+        _entry_of[texture.get()] = index;
+        ++_stats.pending_requests;
+
+        // read here, the last reference to a texture must not go away on a worker
+        const bool cpu_mips{ !is_ktx2_path(path) };
+        const MipOptions mip_options{ .wrap = texture->repeats };
+
+        _pool.submit([queue = _queue, texture = std::weak_ptr<Texture::State>{ texture }, path = std::string{ path }, index, cpu_mips, mip_options, &pool = _pool]() {
+            Queue::Prepared prepared{ .entry = index, .file = nullptr };
+            // levels are read one by one out of a file, images get their chain written next to them first
+            const std::string file_path{ cpu_mips && !texture.expired() ? generate_mips_cached(path.c_str(), mip_options, pool) : path };
+            if (!texture.expired() && !file_path.empty()) {
+                prepared.file = std::make_shared<KtxFile>(file_path.c_str());
+            }
+            {
+                std::lock_guard<std::mutex> lock{ queue->mutex };
+                queue->prepared.push_back(std::move(prepared));
+            }
+            queue->cv.notify_one();
+        });
+    }
+
+    void TextureStreamer::request(const Texture& texture, float uv_per_px) {
+        const auto found{ _entry_of.find(texture._state.get()) };
+        if (found == _entry_of.end()) {
+            return;
+        }
+
+        Entry& entry{ *_entries[found->second] };
+        entry.requested = true;
+        if (!entry.ready) {
+            return;
+        }
+
+        // texels one pixel covers, the level where that is about one texel; trilinear blends with the next coarser one
+        const std::shared_ptr<Texture::State> state{ entry.texture.lock() };
+        const float texels_per_px{ uv_per_px * static_cast<float>(std::max(state ? std::max(state->width, state->height) : 1, 1)) };
+        const float level{ std::floor(std::log2(std::max(texels_per_px, 1.0f)) + mip_bias) };
+        const uint32_t clamped{ static_cast<uint32_t>(std::clamp(level, 0.0f, static_cast<float>(entry.level_count - 1))) };
+        entry.frame_level = std::min(entry.frame_level, clamped);
+    }
+
+    void TextureStreamer::update(std::size_t byte_budget) {
+        ++_frame;
+        receive(byte_budget);
+
+        for (const std::unique_ptr<Entry>& entry : _entries) {
+            if (!entry->ready || entry->released) {
+                continue;
+            }
+            if (entry->requested) {
+                entry->wanted_level = std::min(entry->frame_level, entry->tail_level);
+                entry->last_request = _frame;
+            }
+            entry->requested = false;
+            entry->frame_level = entry->level_count;
+        }
+        plan();
+    }
+
+    void TextureStreamer::plan() {
+        _stats.textures = 0;
+        _stats.starved = 0;
+
+        // levels finer than 'target' can go, coarser ones than it are missing
+        std::vector<uint32_t> targets(_entries.size(), 0);
+        std::vector<uint32_t> loads;
+        std::vector<uint32_t> victims;
+        uint32_t reading{ 0 };
+        for (uint32_t i = 0; i < _entries.size(); ++i) {
+            Entry& entry{ *_entries[i] };
+            if (entry.released) {
+                continue;
+            }
+            if (entry.texture.expired()) {
+                // the state freed the gl texture and its levels with it
+                if (entry.ready) {
+                    _stats.resident_bytes -= entry.resident_bytes();
+                }
+                entry.file.reset();
+                entry.released = true;
+                const auto found{ _entry_of.find(entry.key) };
+                if (found != _entry_of.end() && found->second == i) {
+                    _entry_of.erase(found);
+                }
+                continue;
+            }
+
+            ++_stats.textures;
+            reading += entry.reading ? 1 : 0;
+            if (!entry.ready) {
+                continue;
+            }
+
+            targets[i] = _frame - entry.last_request <= keep_frames ? entry.wanted_level : entry.tail_level;
+            if (entry.base_level > targets[i] && !entry.reading) {
+                loads.push_back(i);
+            }
+            else if (entry.base_level < targets[i]) {
+                victims.push_back(i);
+            }
+        }
+
+        // the texture furthest from what the screen needs first
+        std::sort(loads.begin(), loads.end(), [this, &targets](uint32_t a, uint32_t b) {
+            return _entries[a]->base_level - targets[a] > _entries[b]->base_level - targets[b];
+        });
+        // unused longest first
+        std::sort(victims.begin(), victims.end(), [this](uint32_t a, uint32_t b) {
+            return _entries[a]->last_request < _entries[b]->last_request;
+        });
+
+        std::size_t victim{ 0 };
+        const auto make_room = [&](std::size_t bytes) {
+            while (_stats.resident_bytes + _reserved_bytes + bytes > _stats.budget_bytes && victim < victims.size()) {
+                Entry& entry{ *_entries[victims[victim]] };
+                if (entry.base_level < targets[victims[victim]]) {
+                    evict(entry);
+                }
+                else {
+                    ++victim;
+                }
+            }
+            return _stats.resident_bytes + _reserved_bytes + bytes <= _stats.budget_bytes;
+        };
+
+        // a lowered budget gives back what isn't needed even when nothing is loading
+        make_room(0);
+        for (uint32_t i : loads) {
+            Entry& entry{ *_entries[i] };
+            if (reading >= max_reads) {
+                break;
+            }
+            if (!make_room(entry.level_bytes[entry.base_level - 1])) {
+                ++_stats.starved;
+                continue;
+            }
+            read(i, entry.base_level - 1);
+            ++reading;
+        }
+    }
+
+    void TextureStreamer::finish() {
+        // one frame's requests, followed level by level without the frame advancing past them
+        update(std::numeric_limits<std::size_t>::max());
+        while (_stats.pending_requests > 0) {
+            {
+                std::unique_lock<std::mutex> lock{ _queue->mutex };
+                _queue->cv.wait(lock, [this]() { return !_queue->prepared.empty() || !_queue->levels.empty(); });
+            }
+            receive(std::numeric_limits<std::size_t>::max());
+            plan();
+        }
+    }
+
+    int TextureStreamer::resident_level(const Texture& texture) const {
+        const auto found{ _entry_of.find(texture._state.get()) };
+        if (found == _entry_of.end() || !_entries[found->second]->ready) {
+            return -1;
+        }
+        return static_cast<int>(_entries[found->second]->base_level);
+    }
+
+    void TextureStreamer::receive(std::size_t byte_budget) {
+        std::size_t sent{ 0 };
+        while (true) {
+            Queue::Prepared prepared;
+            {
+                std::lock_guard<std::mutex> lock{ _queue->mutex };
+                if (_queue->prepared.empty()) {
+                    break;
+                }
+                prepared = std::move(_queue->prepared.front());
+                _queue->prepared.pop_front();
+            }
+            --_stats.pending_requests;
+
+            Entry& entry{ *_entries[prepared.entry] };
+            const std::shared_ptr<Texture::State> texture{ entry.texture.lock() };
+            if (!texture) {
+                continue;
+            }
+            if (!prepared.file || !prepared.file->is_valid()) {
+                std::cerr << "failed to load texture from path: " << entry.path << '\n';
+                ++_stats.failed;
+                continue;
+            }
+
+            const KtxFile& file{ *prepared.file };
+            const KtxFormat& format{ file.format() };
+            // find_block_format can't fail for compressed formats KtxFile accepts
+            entry.decompress = format.gl_pixel_format == 0 && find_block_format(format.vk_format, entry.block_format) && !is_block_format_supported(entry.block_format);
+            entry.internal_format = entry.decompress ? GL_RGBA8 : format.gl_internal_format;
+            entry.file = prepared.file;
+            entry.level_count = texture->mipmapped ? file.level_count() : 1;
+            entry.level_bytes.resize(entry.level_count);
+            entry.tail_level = entry.level_count - 1;
+            for (uint32_t level = 0; level < entry.level_count; ++level) {
+                const uint32_t width{ std::max(file.width() >> level, 1u) };
+                const uint32_t height{ std::max(file.height() >> level, 1u) };
+                entry.level_bytes[level] = entry.decompress ? static_cast<std::size_t>(width) * height * 4 : file.level(level).size();
+                if (std::max(width, height) <= static_cast<uint32_t>(_tail_size)) {
+                    entry.tail_level = std::min(entry.tail_level, level);
+                }
+            }
+
+            // the tail is small, it goes up right away so the texture can be sampled from now on
+            glTextureParameteri(texture->id, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(entry.level_count - 1));
+            entry.base_level = entry.level_count;
+            std::vector<uint8_t> decompressed;
+            for (uint32_t level = entry.level_count; level-- > entry.tail_level;) {
+                std::span<const uint8_t> data{ file.level(level) };
+                if (entry.decompress) {
+                    decompressed.resize(entry.level_bytes[level]);
+                    decompress_blocks(data.data(), std::max(static_cast<int>(file.width() >> level), 1), std::max(static_cast<int>(file.height() >> level), 1), entry.block_format, decompressed.data());
+                    data = decompressed;
+                }
+                upload(entry, level, data);
+            }
+
+            if (format.color_channels <= 2) {
+                const GLint swizzle[4]{ GL_RED, GL_RED, GL_RED, format.color_channels == 2 ? GL_GREEN : GL_ONE };
+                glTextureParameteriv(texture->id, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+            }
+            texture->width = static_cast<int>(file.width());
+            texture->height = static_cast<int>(file.height());
+            texture->color_channels = format.color_channels;
+            texture->resident = true;
+            entry.wanted_level = entry.tail_level;
+            entry.frame_level = entry.level_count;
+            entry.ready = true;
+        }
+
+        while (sent < byte_budget) {
+            Queue::Level level;
+            {
+                std::lock_guard<std::mutex> lock{ _queue->mutex };
+                if (_queue->levels.empty()) {
+                    break;
+                }
+                level = std::move(_queue->levels.front());
+                _queue->levels.pop_front();
+            }
+            --_stats.pending_requests;
+
+            Entry& entry{ *_entries[level.entry] };
+            _reserved_bytes -= entry.level_bytes[level.level];
+            entry.reading = false;
+            // evicted in the meantime, or the texture is gone
+            if (entry.texture.expired() || level.level + 1 != entry.base_level) {
+                continue;
+            }
+
+            upload(entry, level.level, level.data);
+            sent += level.data.size();
+            ++_stats.streamed_levels;
+            _stats.uploaded_bytes += level.data.size();
+        }
+    }
+
+    void TextureStreamer::read(uint32_t entry_index, uint32_t level) {
+        Entry& entry{ *_entries[entry_index] };
+        entry.reading = true;
+        _reserved_bytes += entry.level_bytes[level];
+        ++_stats.pending_requests;
+
+        _pool.submit([queue = _queue, file = entry.file, entry_index, level, decompress = entry.decompress, block_format = entry.block_format]() {
+            // copying out of the mapping is where the file is actually read
+            const std::span<const uint8_t> stored{ file->level(level) };
+            Queue::Level read{ .entry = entry_index, .level = level, .data = {} };
+            if (decompress) {
+                const int width{ std::max(static_cast<int>(file->width() >> level), 1) };
+                const int height{ std::max(static_cast<int>(file->height() >> level), 1) };
+                read.data.resize(static_cast<std::size_t>(width) * height * 4);
+                decompress_blocks(stored.data(), width, height, block_format, read.data.data());
+            }
+            else {
+                read.data.assign(stored.begin(), stored.end());
+            }
+            {
+                std::lock_guard<std::mutex> lock{ queue->mutex };
+                queue->levels.push_back(std::move(read));
+            }
+            queue->cv.notify_one();
+        });
+    }
+
+    void TextureStreamer::upload(Entry& entry, uint32_t level, std::span<const uint8_t> data) {
+        const std::shared_ptr<Texture::State> texture{ entry.texture.lock() };
+        const KtxFormat& format{ entry.file->format() };
+        const GLsizei width{ std::max(static_cast<GLsizei>(entry.file->width() >> level), 1) };
+        const GLsizei height{ std::max(static_cast<GLsizei>(entry.file->height() >> level), 1) };
+        {
+            ScopedBind bind{ texture->id };
+            if (format.gl_pixel_format == 0 && !entry.decompress) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), entry.internal_format, width, height, 0, static_cast<GLsizei>(data.size()), data.data());
+            }
+            else {
+                glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), static_cast<GLint>(entry.internal_format), width, height, 0, entry.decompress ? GL_RGBA : format.gl_pixel_format, GL_UNSIGNED_BYTE, data.data());
+            }
+        }
+        // sampling never reaches below the base level, the finer undefined ones don't make the texture incomplete
+        glTextureParameteri(texture->id, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level));
+        entry.base_level = level;
+        _stats.resident_bytes += entry.level_bytes[level];
+    }
+
+    void TextureStreamer::evict(Entry& entry) {
+        const std::shared_ptr<Texture::State> texture{ entry.texture.lock() };
+        const uint32_t level{ entry.base_level };
+        // clamp first, then give the level's memory back by redefining it empty
+        glTextureParameteri(texture->id, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level + 1));
+        {
+            ScopedBind bind{ texture->id };
+            if (entry.file->format().gl_pixel_format == 0 && !entry.decompress) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), entry.internal_format, 0, 0, 0, 0, nullptr);
+            }
+            else {
+                glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), static_cast<GLint>(entry.internal_format), 0, 0, 0, entry.decompress ? GL_RGBA : entry.file->format().gl_pixel_format, GL_UNSIGNED_BYTE, nullptr);
+            }
+        }
+        entry.base_level = level + 1;
+        _stats.resident_bytes -= entry.level_bytes[level];
+        ++_stats.evicted_levels;
+    }
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "threadPool.hpp"
+
+namespace my_gl {
+    ThreadPool::ThreadPool(uint32_t thread_count) {
+        thread_count = std::max(thread_count, 1u);
+        _workers.reserve(thread_count);
+
+        for (uint32_t i = 0; i < thread_count; ++i) {
+            _workers.emplace_back([this]() { worker_loop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock{ _mutex };
+            _stopping = true;
+        }
+        _cv.notify_all();
+
+        for (std::thread& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()>&& job) {
+        {
+            std::lock_guard<std::mutex> lock{ _mutex };
+            _jobs.push_back(std::move(job));
+        }
+        _cv.notify_one();
+    }
+
+    void ThreadPool::parallel_for(uint32_t count, const std::function<void(uint32_t)>& fn) {
+        if (count == 0) {
+            return;
+        }
+        if (count == 1) {
+            fn(0);
+            return;
+        }
+
+        // helpers may still be queued after we return, so the shared state can't live on our stack
+        struct State {
+            std::function<void(uint32_t)>   fn;
+            std::atomic<uint32_t>           next{ 0 };
+            std::atomic<uint32_t>           done{ 0 };
+            uint32_t                        count;
+            std::mutex                      mutex;
+            std::condition_variable         cv;
+        };
+
+        auto state{ std::make_shared<State>() };
+        state->fn = fn;
+        state->count = count;
+
+        auto run{ [](State& s) {
+            for (uint32_t i = s.next++; i < s.count; i = s.next++) {
+                s.fn(i);
+                if (++s.done == s.count) {
+                    std::lock_guard<std::mutex> lock{ s.mutex };
+                    s.cv.notify_all();
+                }
+            }
+        } };
+
+        const uint32_t helpers{ std::min(count - 1, size()) };
+        for (uint32_t i = 0; i < helpers; ++i) {
+            submit([state, run]() { run(*state); });
+        }
+
+        run(*state);
+
+        std::unique_lock<std::mutex> lock{ state->mutex };
+        state->cv.wait(lock, [&]() { return state->done.load() == state->count; });
+    }
+
+    ThreadPool& ThreadPool::shared() {
+        static ThreadPool pool{ std::max(std::thread::hardware_concurrency(), 2u) - 1 };
+        return pool;
+    }
+
+    void ThreadPool::worker_loop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock{ _mutex };
+                _cv.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+                if (_stopping && _jobs.empty()) {
+                    return;
+                }
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+            job();
+        }
+    }
+}
@@ -1,9 +1,8 @@
 #include <iostream>
-#include <fstream>
 #include <memory>
-#include <sstream>
 #include <vector>
 #include "utils.hpp"
+#include "programCache.hpp"
 #include "globals.hpp"
 #include "camera.hpp"
 #include <STB_IMG/stb_image.h>
@@ -11,7 +10,7 @@
 #include <GLFW/glfw3.h>
 
 my_gl::Window my_gl::init_window() {
-    std::cout << "Starting GLFW context, OpenGL 3.3\n";
+    std::cout << "Starting GLFW context, OpenGL 4.5\n";
 
     my_gl::init_GLFW();
 
@@ -19,6 +18,22 @@ my_gl::Window my_gl::init_window() {
 
     my_gl::init_GLEW();
 
+    // programs built in the background compile on driver threads with the parallel compile extension, otherwise
+    // on a hidden window's context sharing objects with this one
+    if (!my_gl::ProgramCache::has_parallel_compile()) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        GLFWwindow* worker_window{ glfwCreateWindow(1, 1, "", nullptr, window.ptr_raw()) };
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        // ProgramCache::stop_worker destroys it, before the window we return
+        if (worker_window) {
+            my_gl::ProgramCache::shared().start_worker(
+                [worker_window] { glfwMakeContextCurrent(worker_window); },
+                [] { glfwMakeContextCurrent(nullptr); },
+                [worker_window] { glfwDestroyWindow(worker_window); }
+            );
+        }
+    }
+
     // error handling
 	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 	glDebugMessageCallback(my_gl::callback_debug_message, NULL);
@@ -55,8 +70,9 @@ void my_gl::init_GLFW() {
         std::exit(EXIT_FAILURE);
     }
  
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // dsa buffer/vao creation, compute and indirect draws need 4.5, llvmpipe provides it as well
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
 }
@@ -70,56 +86,48 @@ void my_gl::init_GLEW() {
     }
 }
 
-GLuint my_gl::create_program(const char* vertexShaderFilePath, const char* fragmentShaderFilePath) {
-    GLuint program{ glCreateProgram() };
-
-    GLuint vertexShader{ my_gl::create_shader(GL_VERTEX_SHADER, vertexShaderFilePath) };
-    GLuint fragShader{ my_gl::create_shader(GL_FRAGMENT_SHADER, fragmentShaderFilePath) };
+GLuint my_gl::create_program(const char* vertexShaderFilePath, const char* fragmentShaderFilePath, const std::vector<std::string>& defines) {
+    std::vector<my_gl::ShaderSource> stages{
+        { .type = GL_VERTEX_SHADER, .source = my_gl::load_shader_source(vertexShaderFilePath, defines), .path = vertexShaderFilePath },
+        { .type = GL_FRAGMENT_SHADER, .source = my_gl::load_shader_source(fragmentShaderFilePath, defines), .path = fragmentShaderFilePath },
+    };
 
-    std::vector<GLuint> shaders{ vertexShader, fragShader };
- 
-    for (size_t i{ 0 }; i < shaders.size(); ++i) {
-        glAttachShader(program, shaders[i]);
+    for (const auto& stage : stages) {
+        if (stage.source.empty()) {
+            std::cerr << "shader source load error from " << stage.path << '\n';
+            std::exit(EXIT_FAILURE);
+        }
     }
 
-    glLinkProgram(program);
-
-    GLint linkStatus;
-    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-
-    if (linkStatus == GL_FALSE) {
-        GLint infoLogLength;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
-
-        std::string buffer;
-        buffer.reserve(infoLogLength + 1);
-        glGetProgramInfoLog(program, infoLogLength, nullptr, buffer.data());
+    return my_gl::ProgramCache::shared().build(stages);
+}
 
-        std::cout << "Error when linking a program:\n" << buffer << '\n';
-    }
+GLuint my_gl::create_compute_program(const char* computeShaderFilePath, const std::vector<std::string>& defines) {
+    std::vector<my_gl::ShaderSource> stages{
+        { .type = GL_COMPUTE_SHADER, .source = my_gl::load_shader_source(computeShaderFilePath, defines), .path = computeShaderFilePath },
+    };
 
-    for (const auto shaderId : shaders) {
-        glDetachShader(program, shaderId);
-        glDeleteShader(shaderId);
+    if (stages[0].source.empty()) {
+        std::cerr << "shader source load error from " << computeShaderFilePath << '\n';
+        std::exit(EXIT_FAILURE);
     }
 
-    return program;
+    return my_gl::ProgramCache::shared().build(stages);
 }
 
+GLuint my_gl::create_shader(GLenum shaderType, const char* filePath) {
+    const std::string shaderSourceStr{ my_gl::load_shader_source(filePath) };
 
-GLuint my_gl::create_shader(GLenum shaderType, const char* filePath) {        
-    std::ifstream shaderFile{ filePath, std::ios_base::binary };
-
-    if (!shaderFile.is_open()) {
+    if (shaderSourceStr.empty()) {
         std::cerr << "shader source load error from " << filePath << '\n';
         std::exit(EXIT_FAILURE);
     }
 
-    std::stringstream shaderSourceStream;
-    shaderSourceStream << shaderFile.rdbuf();
-    shaderFile.close();
-    std::string shaderSourceStr{ shaderSourceStream.str()};
-    const GLchar* cStringShaderSource{ static_cast<const GLchar*>(shaderSourceStr.c_str())};
+    return my_gl::compile_shader(shaderType, shaderSourceStr.c_str(), filePath);
+}
+
+GLuint my_gl::compile_shader(GLenum shaderType, const char* source, const char* filePath) {
+    const GLchar* cStringShaderSource{ static_cast<const GLchar*>(source) };
 
     GLuint shaderId{ glCreateShader(shaderType) };
     glShaderSource(shaderId, 1, &cStringShaderSource, nullptr);
@@ -129,31 +137,38 @@ GLuint my_gl::create_shader(GLenum shaderType, const char* filePath) {
     glGetShaderiv(shaderId, GL_COMPILE_STATUS, &compileStatus);
 
     if (compileStatus == GL_FALSE) {
-        GLint infoLogLength;
-        glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &infoLogLength);
+        my_gl::print_shader_log(shaderId, shaderType, filePath);
+    }
+
+    return shaderId;
+}
+
+void my_gl::print_shader_log(GLuint shaderId, GLenum shaderType, const char* filePath) {
+    GLint infoLogLength;
+    glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &infoLogLength);
  
-        auto infoLogBuffer = std::make_unique_for_overwrite<char[]>(infoLogLength + 1);
-        glGetShaderInfoLog(shaderId, infoLogLength, nullptr, infoLogBuffer.get());
-
-        std::string_view shaderTypeStr;
-
-        switch (shaderType) {
-        case GL_VERTEX_SHADER:
-            shaderTypeStr = "vertex";
-            break;
-        case GL_FRAGMENT_SHADER:
-            shaderTypeStr = "fragment";
-            break;
-        case GL_GEOMETRY_SHADER:
-            shaderTypeStr = "geometry";
-            break;
-        }
+    auto infoLogBuffer = std::make_unique_for_overwrite<char[]>(infoLogLength + 1);
+    glGetShaderInfoLog(shaderId, infoLogLength, nullptr, infoLogBuffer.get());
 
-        std::cout << "Error when compiling a shader:\n" << shaderTypeStr << '\n' 
-        << infoLogBuffer << '\n';
+    std::string_view shaderTypeStr;
+
+    switch (shaderType) {
+    case GL_VERTEX_SHADER:
+        shaderTypeStr = "vertex";
+        break;
+    case GL_FRAGMENT_SHADER:
+        shaderTypeStr = "fragment";
+        break;
+    case GL_GEOMETRY_SHADER:
+        shaderTypeStr = "geometry";
+        break;
+    case GL_COMPUTE_SHADER:
+        shaderTypeStr = "compute";
+        break;
     }
 
-    return shaderId;
+    std::cout << "Error when compiling a shader:\n" << shaderTypeStr << ' ' << filePath << '\n' 
+    << infoLogBuffer << '\n';
 }
 
 // callbacks
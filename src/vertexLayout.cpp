@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include "vertexLayout.hpp"
+
+namespace my_gl {
+    namespace meshes {
+        namespace {
+            uint16_t encoded_size(VertexEncoding encoding, uint16_t count) {
+                // every element stays 4 byte aligned
+                switch (encoding) {
+                case VertexEncoding::UNORM16_BOUNDS:
+                case VertexEncoding::HALF_FLOAT:
+                    return static_cast<uint16_t>(sizeof(uint16_t) * (count + count % 2));
+                case VertexEncoding::SNORM10_PACKED:
+                    return sizeof(uint32_t);
+                case VertexEncoding::UNORM8:
+                    return static_cast<uint16_t>(4 * ((count + 3) / 4));
+                case VertexEncoding::FLOAT:
+                default:
+                    return static_cast<uint16_t>(sizeof(float) * count);
+                }
+            }
+
+            uint16_t to_half(float value) {
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+
+                const uint16_t sign{ static_cast<uint16_t>((bits >> 16) & 0x8000) };
+                const int32_t raw_exponent{ static_cast<int32_t>((bits >> 23) & 0xFF) };
+                const int32_t exponent{ raw_exponent - 127 + 15 };
+                uint32_t mantissa{ bits & 0x7FFFFF };
+
+                if (raw_exponent == 0xFF) {
+                    return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+                }
+                if (exponent >= 31) {
+                    return sign | 0x7C00;
+                }
+                if (exponent <= 0) {
+                    // subnormal half
+                    if (exponent < -10) {
+                        return sign;
+                    }
+                    mantissa |= 0x800000;
+                    const uint32_t shift{ static_cast<uint32_t>(14 - exponent) };
+                    uint32_t half{ mantissa >> shift };
+                    half += (mantissa >> (shift - 1)) & 1;
+                    return sign | static_cast<uint16_t>(half);
+                }
+
+                // a rounding carry into the exponent is still the right value
+                uint32_t half{ (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13) };
+                half += (mantissa >> 12) & 1;
+                return sign | static_cast<uint16_t>(half);
+            }
+
+            void encode(const LayoutElement& element, const float* src, uint8_t* dst, const Dequantize& dequantize) {
+                switch (element.encoding) {
+                case VertexEncoding::UNORM16_BOUNDS: {
+                    uint16_t packed[4]{};
+                    for (uint16_t c = 0; c < element.count && c < 3; ++c) {
+                        const float unit{ (src[c] - dequantize.offset[c]) / dequantize.scale[c] };
+                        packed[c] = static_cast<uint16_t>(std::lround(std::clamp(unit, 0.0f, 1.0f) * 65535.0f));
+                    }
+                    std::memcpy(dst, packed, encoded_size(element.encoding, element.count));
+                    break;
+                }
+                case VertexEncoding::SNORM10_PACKED: {
+                    uint32_t packed{ 0 };
+                    for (uint16_t c = 0; c < element.count && c < 3; ++c) {
+                        const int32_t q{ static_cast<int32_t>(std::lround(std::clamp(src[c], -1.0f, 1.0f) * 511.0f)) };
+                        packed |= (static_cast<uint32_t>(q) & 0x3FF) << (10 * c);
+                    }
+                    std::memcpy(dst, &packed, sizeof(packed));
+                    break;
+                }
+                case VertexEncoding::UNORM8:
+                    for (uint16_t c = 0; c < encoded_size(element.encoding, element.count); ++c) {
+                        dst[c] = c < element.count ? static_cast<uint8_t>(std::lround(std::clamp(src[c], 0.0f, 1.0f) * 255.0f)) : 0;
+                    }
+                    break;
+                case VertexEncoding::HALF_FLOAT: {
+                    uint16_t packed[4]{};
+                    for (uint16_t c = 0; c < element.count && c < 4; ++c) {
+                        packed[c] = to_half(src[c]);
+                    }
+                    std::memcpy(dst, packed, encoded_size(element.encoding, element.count));
+                    break;
+                }
+                case VertexEncoding::FLOAT:
+                default:
+                    std::memcpy(dst, src, sizeof(float) * element.count);
+                    break;
+                }
+            }
+        }
+
+        const LayoutElement* VertexLayout::find(std::string_view name) const {
+            for (const LayoutElement& element : elements) {
+                if (name == element.name) {
+                    return &element;
+                }
+            }
+            return nullptr;
+        }
+
+        std::size_t VertexLayout::stream_byte_offset(std::size_t stream, std::size_t vertex_count) const {
+            std::size_t offset{ 0 };
+            for (std::size_t s = 0; s < stream && s < stream_strides.size(); ++s) {
+                offset += stream_strides[s] * vertex_count;
+            }
+            return offset;
+        }
+
+        std::size_t VertexLayout::vertex_byte_size() const {
+            return std::accumulate(stream_strides.begin(), stream_strides.end(), std::size_t{ 0 });
+        }
+
+        std::size_t floats_per_vertex(const std::vector<VertexElement>& format) {
+            std::size_t floats{ 0 };
+            for (const VertexElement& element : format) {
+                floats += element.count;
+            }
+            return floats;
+        }
+
+        VertexLayout make_vertex_layout(const std::vector<VertexElement>& format, VertexLayoutType type) {
+            VertexLayout layout{ .type = type, .elements = {}, .stream_strides = {} };
+
+            for (std::size_t e = 0; e < format.size(); ++e) {
+                uint16_t stream{ 0 };
+                switch (type) {
+                case VertexLayoutType::PLANAR:
+                    stream = static_cast<uint16_t>(e);
+                    break;
+                case VertexLayoutType::INTERLEAVED:
+                    stream = 0;
+                    break;
+                case VertexLayoutType::HOT_COLD:
+                    stream = e == 0 ? 0 : 1;
+                    break;
+                }
+
+                // bounds quantization is undone through a matrix, only positions can go through it
+                VertexEncoding encoding{ format[e].encoding };
+                if (encoding == VertexEncoding::UNORM16_BOUNDS && e != 0) {
+                    encoding = VertexEncoding::HALF_FLOAT;
+                }
+
+                GLenum gl_type{ GL_FLOAT };
+                switch (encoding) {
+                case VertexEncoding::UNORM16_BOUNDS:    gl_type = GL_UNSIGNED_SHORT; break;
+                case VertexEncoding::SNORM10_PACKED:    gl_type = GL_INT_2_10_10_10_REV; break;
+                case VertexEncoding::UNORM8:            gl_type = GL_UNSIGNED_BYTE; break;
+                case VertexEncoding::HALF_FLOAT:        gl_type = GL_HALF_FLOAT; break;
+                case VertexEncoding::FLOAT:             gl_type = GL_FLOAT; break;
+                }
+
+                if (stream >= layout.stream_strides.size()) {
+                    layout.stream_strides.resize(stream + 1, 0);
+                }
+                layout.elements.push_back({
+                    .name = format[e].name,
+                    .count = format[e].count,
+                    .encoding = encoding,
+                    .stream = stream,
+                    .byte_offset = layout.stream_strides[stream],
+                    .gl_type = gl_type,
+                    // packed 2_10_10_10 formats are always read as 4 components
+                    .attrib_count = encoding == VertexEncoding::SNORM10_PACKED ? uint16_t{ 4 } : format[e].count,
+                    .normalized = encoding != VertexEncoding::FLOAT && encoding != VertexEncoding::HALF_FLOAT,
+                });
+                layout.stream_strides[stream] += encoded_size(encoding, format[e].count);
+            }
+
+            return layout;
+        }
+
+        std::vector<uint8_t> convert_vertices(std::span<const float> planar_vertices, const std::vector<VertexElement>& format, const VertexLayout& layout, Dequantize* dequantize) {
+            const std::size_t floats{ floats_per_vertex(format) };
+            if (floats == 0 || layout.elements.size() != format.size()) {
+                return {};
+            }
+
+            const std::size_t vertex_count{ planar_vertices.size() / floats };
+            std::vector<uint8_t> converted(layout.vertex_byte_size() * vertex_count);
+
+            // positions lead the planar data
+            Dequantize bounds;
+            if (!layout.elements.empty() && layout.elements[0].encoding == VertexEncoding::UNORM16_BOUNDS && vertex_count > 0) {
+                const uint16_t count{ std::min<uint16_t>(layout.elements[0].count, 3) };
+                for (uint16_t c = 0; c < count; ++c) {
+                    float min{ planar_vertices[c] };
+                    float max{ planar_vertices[c] };
+                    for (std::size_t v = 1; v < vertex_count; ++v) {
+                        min = std::min(min, planar_vertices[v * layout.elements[0].count + c]);
+                        max = std::max(max, planar_vertices[v * layout.elements[0].count + c]);
+                    }
+                    bounds.offset[c] = min;
+                    bounds.scale[c] = max > min ? max - min : 1.0f;
+                }
+            }
+            if (dequantize) {
+                *dequantize = bounds;
+            }
+
+            const float* block{ planar_vertices.data() };
+            for (const LayoutElement& element : layout.elements) {
+                const std::size_t stream_stride{ layout.stream_strides[element.stream] };
+                uint8_t* dst{ converted.data() + layout.stream_byte_offset(element.stream, vertex_count) + element.byte_offset };
+
+                for (std::size_t v = 0; v < vertex_count; ++v) {
+                    encode(element, block + v * element.count, dst + v * stream_stride, bounds);
+                }
+                block += element.count * vertex_count;
+            }
+
+            return converted;
+        }
+    }
+}